@@ -0,0 +1,45 @@
+// Compare two benchmark reports produced by `npm run bench`.
+//
+// Usage: node bench/compare.js <before.json> <after.json>
+//
+// Prints the relative change in time per operation for every case present in
+// both reports. Negative changes are improvements.
+
+const fs = require("fs");
+
+function load(path) {
+  const report = JSON.parse(fs.readFileSync(path, "utf8"));
+
+  return new Map(report.results.map(result => [result.name, result]));
+}
+
+function main() {
+  const [beforePath, afterPath] = process.argv.slice(2);
+
+  if (beforePath === undefined || afterPath === undefined) {
+    process.stderr.write("Usage: compare.js <before.json> <after.json>\n");
+    process.exit(2);
+  }
+
+  const before = load(beforePath);
+  const after = load(afterPath);
+
+  for (const [name, result] of after) {
+    const baseline = before.get(name);
+
+    if (baseline === undefined) {
+      continue;
+    }
+
+    const change = (result.nsPerOp / baseline.nsPerOp - 1) * 100;
+    const sign = change > 0 ? "+" : "";
+
+    process.stdout.write(
+      `${name.padEnd(60)} ${baseline.nsPerOp.toFixed(0).padStart(12)} ns ` +
+        `-> ${result.nsPerOp.toFixed(0).padStart(12)} ns ` +
+        `(${sign}${change.toFixed(1)}%)\n`
+    );
+  }
+}
+
+main();
@@ -0,0 +1,119 @@
+// Microbenchmarks for the bind and result marshalling paths.
+//
+// Usage: npm run bench [-- [--filter=<regex>] [--time=<ms>]]
+//
+// Each case measures a single statement method (run, one or all) against an
+// in-memory database for a given cell type, column count, row count and bind
+// style. Results are written to stdout as JSON so that they can be archived
+// and compared between releases; see `compare.js`.
+
+const Database = require("..");
+const workloads = require("./workloads");
+
+function parseArgs(argv) {
+  const args = { filter: null, time: 500 };
+
+  for (const arg of argv) {
+    const match = /^--(\w+)=(.*)$/.exec(arg);
+
+    if (match === null) {
+      throw new Error(`Unrecognized argument: ${arg}`);
+    }
+
+    const [, key, value] = match;
+
+    switch (key) {
+      case "filter":
+        args.filter = new RegExp(value);
+        break;
+
+      case "time":
+        args.time = Number(value);
+        break;
+
+      default:
+        throw new Error(`Unrecognized argument: ${arg}`);
+    }
+  }
+
+  return args;
+}
+
+function measure(fn, minTimeMs) {
+  // Warm up so that the JIT has settled and SQLite's page cache is hot.
+
+  for (let i = 0; i < 10; i++) {
+    fn();
+  }
+
+  const minTimeNs = BigInt(Math.round(minTimeMs * 1e6));
+  const start = process.hrtime.bigint();
+  let elapsed = 0n;
+  let ops = 0;
+  let batch = 1;
+
+  while (elapsed < minTimeNs) {
+    for (let i = 0; i < batch; i++) {
+      fn();
+    }
+
+    ops += batch;
+    batch *= 2;
+    elapsed = process.hrtime.bigint() - start;
+  }
+
+  return { ops, ns: Number(elapsed) };
+}
+
+function runCase(spec, minTimeMs) {
+  const db = new Database(":memory:");
+
+  try {
+    const { fn, rowsPerOp } = workloads.prepare(db, spec);
+    const { ops, ns } = measure(fn, minTimeMs);
+    const nsPerOp = ns / ops;
+
+    return {
+      name: workloads.name(spec),
+      ...spec,
+      ops,
+      opsPerSec: 1e9 / nsPerOp,
+      nsPerOp,
+      nsPerRow: rowsPerOp > 0 ? nsPerOp / rowsPerOp : null,
+      nsPerCell: rowsPerOp > 0 ? nsPerOp / (rowsPerOp * spec.columns) : null
+    };
+  } finally {
+    db.close();
+  }
+}
+
+function main() {
+  const args = parseArgs(process.argv.slice(2));
+  const db = new Database(":memory:");
+  const { version } = db.prepare("select sqlite_version() as version").one();
+  const results = [];
+
+  db.close();
+
+  for (const spec of workloads.cases()) {
+    if (args.filter !== null && !args.filter.test(workloads.name(spec))) {
+      continue;
+    }
+
+    process.stderr.write(`${workloads.name(spec)}\n`);
+    results.push(runCase(spec, args.time));
+  }
+
+  const report = {
+    package: require("../package.json").version,
+    sqlite: version,
+    node: process.version,
+    platform: `${process.platform}-${process.arch}`,
+    date: new Date().toISOString(),
+    results
+  };
+
+  process.stdout.write(JSON.stringify(report, null, 2) + "\n");
+}
+
+main();
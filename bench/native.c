@@ -0,0 +1,488 @@
+/*
+ * Native counterpart to the JavaScript microbenchmarks in `workloads.js`.
+ *
+ * Replays the same workloads directly against the SQLite C API, using the same
+ * statically-linked SQLite build as the N-API module. Results are emitted in
+ * the same JSON format with the same case names, so comparing the two reports
+ * with `compare.js` isolates the cost of the N-API marshalling layer from the
+ * cost of SQLite itself.
+ *
+ * Usage: nsql_bench [--filter=<substring>] [--time=<ms>]
+ */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include <sqlite3.h>
+
+#define countof(x) (sizeof(x) / sizeof((x)[0]))
+
+#define LONG_TEXT_NBYTES 4096
+#define BLOB_NBYTES 1024
+
+enum bench_type {
+  BENCH_INTEGER,
+  BENCH_REAL,
+  BENCH_TEXT,
+  BENCH_LONGTEXT,
+  BENCH_BLOB
+};
+
+struct bench_case {
+  const char *op;
+  enum bench_type type;
+  int columns;
+  int rows;
+  const char *binds;
+};
+
+struct bench_args {
+  const char *filter;
+  double time_ms;
+};
+
+static const char *const bench_type_names[] = {"integer", "real", "text",
+                                               "longtext", "blob"};
+
+static const int bench_columns[] = {1, 4, 16};
+
+/* Keep these in sync with ROWS in workloads.js */
+
+static const int bench_rows[][3] = {{1, 100, 10000},
+                                    {1, 100, 10000},
+                                    {1, 100, 10000},
+                                    {1, 100, 1000},
+                                    {1, 100, 1000}};
+
+static const char *const bench_binds[] = {"positional", "named"};
+
+static char bench_long_text[LONG_TEXT_NBYTES];
+static unsigned char bench_blob[BLOB_NBYTES];
+
+/* Prevents the compiler from optimizing away column accesses */
+
+static volatile uint64_t bench_sink;
+
+static bool bench_first_result = true;
+
+static void die(sqlite3 *db, const char *what) {
+  fprintf(stderr, "%s: %s\n", what,
+          db != NULL ? sqlite3_errmsg(db) : "out of memory");
+  exit(EXIT_FAILURE);
+}
+
+static uint64_t now_ns(void) {
+#ifdef _WIN32
+  LARGE_INTEGER freq;
+  LARGE_INTEGER count;
+
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+
+  return (uint64_t)((double)count.QuadPart * 1e9 / (double)freq.QuadPart);
+#else
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+#endif
+}
+
+static void case_name(const struct bench_case *c, char *out, size_t nbytes) {
+  snprintf(out, nbytes, "%s/%s/cols=%i/rows=%i/binds=%s", c->op,
+           bench_type_names[c->type], c->columns, c->rows, c->binds);
+}
+
+static void bind_value(sqlite3 *db, sqlite3_stmt *stmt, int ordinal,
+                       enum bench_type type, int i) {
+  char text[32];
+  int sqlr;
+
+  switch (type) {
+  case BENCH_INTEGER:
+    sqlr = sqlite3_bind_int64(stmt, ordinal, (sqlite3_int64)i * 7919);
+    break;
+
+  case BENCH_REAL:
+    sqlr = sqlite3_bind_double(stmt, ordinal, i + 0.25);
+    break;
+
+  case BENCH_TEXT:
+    snprintf(text, sizeof(text), "text-%i", i);
+    sqlr = sqlite3_bind_text(stmt, ordinal, text, -1, SQLITE_TRANSIENT);
+    break;
+
+  case BENCH_LONGTEXT:
+    sqlr = sqlite3_bind_text(stmt, ordinal, bench_long_text,
+                             LONG_TEXT_NBYTES, SQLITE_TRANSIENT);
+    break;
+
+  case BENCH_BLOB:
+    memset(bench_blob, i & 0xff, sizeof(bench_blob));
+    sqlr = sqlite3_bind_blob(stmt, ordinal, bench_blob, BLOB_NBYTES,
+                             SQLITE_TRANSIENT);
+    break;
+
+  default:
+    abort();
+  }
+
+  if (sqlr != SQLITE_OK) {
+    die(db, "bind");
+  }
+}
+
+/* Touch every cell of the current row in the same way as the N-API module's
+   result conversion code does. */
+
+static void read_row(sqlite3_stmt *stmt, int ncols) {
+  uint64_t acc;
+  int i;
+
+  acc = 0;
+
+  for (i = 0; i < ncols; i++) {
+    switch (sqlite3_column_type(stmt, i)) {
+    case SQLITE_INTEGER:
+      acc += (uint64_t)sqlite3_column_int64(stmt, i);
+      break;
+
+    case SQLITE_FLOAT:
+      acc += (uint64_t)sqlite3_column_double(stmt, i);
+      break;
+
+    case SQLITE_TEXT:
+      acc += (uintptr_t)sqlite3_column_text(stmt, i);
+      acc += (uint64_t)sqlite3_column_bytes(stmt, i);
+      break;
+
+    case SQLITE_BLOB:
+      acc += (uintptr_t)sqlite3_column_blob(stmt, i);
+      acc += (uint64_t)sqlite3_column_bytes(stmt, i);
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  bench_sink += acc;
+}
+
+static void finish(sqlite3 *db, sqlite3_stmt *stmt) {
+  (void)sqlite3_reset(stmt);
+
+  if (sqlite3_clear_bindings(stmt) != SQLITE_OK) {
+    die(db, "clear bindings");
+  }
+}
+
+static void exec(sqlite3 *db, const char *sql) {
+  if (sqlite3_exec(db, sql, NULL, NULL, NULL) != SQLITE_OK) {
+    die(db, sql);
+  }
+}
+
+static sqlite3_stmt *prepare(sqlite3 *db, const char *sql) {
+  sqlite3_stmt *stmt;
+
+  if (sqlite3_prepare_v2(db, sql, -1, &stmt, NULL) != SQLITE_OK) {
+    die(db, sql);
+  }
+
+  return stmt;
+}
+
+static void append(char *buf, size_t nbytes, const char *str) {
+  size_t len;
+
+  len = strlen(buf);
+  snprintf(buf + len, nbytes - len, "%s", str);
+}
+
+static void column_list(const struct bench_case *c, char *out, size_t nbytes) {
+  char col[16];
+  int i;
+
+  out[0] = '\0';
+
+  for (i = 0; i < c->columns; i++) {
+    snprintf(col, sizeof(col), i > 0 ? ", c%i" : "c%i", i);
+    append(out, nbytes, col);
+  }
+}
+
+static void placeholders(const struct bench_case *c, int count, char *out,
+                         size_t nbytes) {
+  char param[16];
+  int i;
+
+  out[0] = '\0';
+
+  for (i = 0; i < count; i++) {
+    if (strcmp(c->binds, "named") == 0) {
+      snprintf(param, sizeof(param), i > 0 ? ", @p%i" : "@p%i", i);
+    } else {
+      snprintf(param, sizeof(param), i > 0 ? ", ?" : "?");
+    }
+
+    append(out, nbytes, param);
+  }
+}
+
+static void populate(sqlite3 *db, const struct bench_case *c) {
+  struct bench_case positional;
+  sqlite3_stmt *stmt;
+  char cols[256];
+  char params[256];
+  char sql[640];
+  int i;
+  int j;
+
+  positional = *c;
+  positional.binds = "positional";
+
+  column_list(c, cols, sizeof(cols));
+  placeholders(&positional, c->columns, params, sizeof(params));
+
+  snprintf(sql, sizeof(sql), "create table t (%s)", cols);
+  exec(db, sql);
+  exec(db, "begin");
+
+  snprintf(sql, sizeof(sql), "insert into t values (%s)", params);
+  stmt = prepare(db, sql);
+
+  for (i = 0; i < c->rows; i++) {
+    for (j = 0; j < c->columns; j++) {
+      bind_value(db, stmt, j + 1, c->type, i);
+    }
+
+    if (sqlite3_step(stmt) != SQLITE_DONE) {
+      die(db, "insert");
+    }
+
+    finish(db, stmt);
+  }
+
+  sqlite3_finalize(stmt);
+  exec(db, "commit");
+}
+
+static void run_once(sqlite3 *db, sqlite3_stmt *stmt,
+                     const struct bench_case *c) {
+  int sqlr;
+  int i;
+
+  if (strcmp(c->op, "run") == 0) {
+    for (i = 0; i < c->columns; i++) {
+      bind_value(db, stmt, i + 1, c->type, i);
+    }
+
+    do {
+      sqlr = sqlite3_step(stmt);
+    } while (sqlr == SQLITE_ROW);
+  } else if (strcmp(c->op, "one") == 0) {
+    if (sqlite3_bind_int64(stmt, 1, 1) != SQLITE_OK) {
+      die(db, "bind");
+    }
+
+    sqlr = sqlite3_step(stmt);
+
+    if (sqlr == SQLITE_ROW) {
+      read_row(stmt, c->columns);
+      sqlr = SQLITE_DONE;
+    }
+  } else {
+    while ((sqlr = sqlite3_step(stmt)) == SQLITE_ROW) {
+      read_row(stmt, c->columns);
+    }
+  }
+
+  if (sqlr != SQLITE_DONE) {
+    die(db, "step");
+  }
+
+  finish(db, stmt);
+}
+
+static void run_case(const struct bench_case *c,
+                     const struct bench_args *args) {
+  sqlite3_stmt *stmt;
+  sqlite3 *db;
+  uint64_t min_ns;
+  uint64_t start;
+  uint64_t elapsed;
+  uint64_t batch;
+  uint64_t ops;
+  uint64_t i;
+  double ns_per_op;
+  int rows_per_op;
+  char name[128];
+  char cols[256];
+  char params[256];
+  char sql[640];
+
+  case_name(c, name, sizeof(name));
+  fprintf(stderr, "%s\n", name);
+
+  if (sqlite3_open(":memory:", &db) != SQLITE_OK) {
+    die(db, "open");
+  }
+
+  column_list(c, cols, sizeof(cols));
+
+  if (strcmp(c->op, "run") == 0) {
+    placeholders(c, c->columns, params, sizeof(params));
+    snprintf(sql, sizeof(sql), "select %s", params);
+    rows_per_op = 0;
+  } else if (strcmp(c->op, "one") == 0) {
+    populate(db, c);
+    placeholders(c, 1, params, sizeof(params));
+    snprintf(sql, sizeof(sql), "select %s from t where rowid = %s", cols,
+             params);
+    rows_per_op = 1;
+  } else {
+    populate(db, c);
+    snprintf(sql, sizeof(sql), "select %s from t", cols);
+    rows_per_op = c->rows;
+  }
+
+  stmt = prepare(db, sql);
+
+  for (i = 0; i < 10; i++) {
+    run_once(db, stmt, c);
+  }
+
+  min_ns = (uint64_t)(args->time_ms * 1e6);
+  start = now_ns();
+  elapsed = 0;
+  ops = 0;
+  batch = 1;
+
+  while (elapsed < min_ns) {
+    for (i = 0; i < batch; i++) {
+      run_once(db, stmt, c);
+    }
+
+    ops += batch;
+    batch *= 2;
+    elapsed = now_ns() - start;
+  }
+
+  sqlite3_finalize(stmt);
+  sqlite3_close(db);
+
+  ns_per_op = (double)elapsed / (double)ops;
+
+  printf("%s    {\n", bench_first_result ? "" : ",\n");
+  printf("      \"name\": \"%s\",\n", name);
+  printf("      \"op\": \"%s\",\n", c->op);
+  printf("      \"type\": \"%s\",\n", bench_type_names[c->type]);
+  printf("      \"columns\": %i,\n", c->columns);
+  printf("      \"rows\": %i,\n", c->rows);
+  printf("      \"binds\": \"%s\",\n", c->binds);
+  printf("      \"ops\": %llu,\n", (unsigned long long)ops);
+  printf("      \"opsPerSec\": %.17g,\n", 1e9 / ns_per_op);
+  printf("      \"nsPerOp\": %.17g,\n", ns_per_op);
+
+  if (rows_per_op > 0) {
+    printf("      \"nsPerRow\": %.17g,\n", ns_per_op / rows_per_op);
+    printf("      \"nsPerCell\": %.17g\n",
+           ns_per_op / ((double)rows_per_op * c->columns));
+  } else {
+    printf("      \"nsPerRow\": null,\n");
+    printf("      \"nsPerCell\": null\n");
+  }
+
+  printf("    }");
+  bench_first_result = false;
+}
+
+static void maybe_run(const struct bench_case *c,
+                      const struct bench_args *args) {
+  char name[128];
+
+  case_name(c, name, sizeof(name));
+
+  if (args->filter == NULL || strstr(name, args->filter) != NULL) {
+    run_case(c, args);
+  }
+}
+
+static void parse_args(int argc, char **argv, struct bench_args *out) {
+  int i;
+
+  out->filter = NULL;
+  out->time_ms = 500;
+
+  for (i = 1; i < argc; i++) {
+    if (strncmp(argv[i], "--filter=", 9) == 0) {
+      out->filter = argv[i] + 9;
+    } else if (strncmp(argv[i], "--time=", 7) == 0) {
+      out->time_ms = atof(argv[i] + 7);
+    } else {
+      fprintf(stderr, "Unrecognized argument: %s\n", argv[i]);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+int main(int argc, char **argv) {
+  struct bench_args args;
+  struct bench_case c;
+  size_t type;
+  size_t col;
+  size_t i;
+
+  parse_args(argc, argv, &args);
+  memset(bench_long_text, 'x', sizeof(bench_long_text));
+
+  printf("{\n");
+  printf("  \"sqlite\": \"%s\",\n", sqlite3_libversion());
+  printf("  \"node\": null,\n");
+  printf("  \"platform\": \"native\",\n");
+  printf("  \"results\": [\n");
+
+  for (type = 0; type < countof(bench_type_names); type++) {
+    for (col = 0; col < countof(bench_columns); col++) {
+      c.type = (enum bench_type)type;
+      c.columns = bench_columns[col];
+
+      for (i = 0; i < countof(bench_binds); i++) {
+        c.op = "run";
+        c.rows = 0;
+        c.binds = bench_binds[i];
+        maybe_run(&c, &args);
+      }
+
+      for (i = 0; i < countof(bench_binds); i++) {
+        c.op = "one";
+        c.rows = 1;
+        c.binds = bench_binds[i];
+        maybe_run(&c, &args);
+      }
+
+      for (i = 0; i < countof(bench_rows[type]); i++) {
+        c.op = "all";
+        c.rows = bench_rows[type][i];
+        c.binds = "none";
+        maybe_run(&c, &args);
+      }
+    }
+  }
+
+  printf("\n  ]\n}\n");
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,16 @@
+// Run the native benchmark executable built by `npm run bench:native`,
+// forwarding any command-line arguments to it.
+
+const { spawnSync } = require("child_process");
+const path = require("path");
+
+const exe = process.platform === "win32" ? "nsql_bench.exe" : "nsql_bench";
+const exePath = path.join(__dirname, "..", "build", "Release", exe);
+const result = spawnSync(exePath, process.argv.slice(2), { stdio: "inherit" });
+
+if (result.error !== undefined) {
+  process.stderr.write(`${result.error.message}\n`);
+  process.exit(1);
+}
+
+process.exit(result.status === null ? 1 : result.status);
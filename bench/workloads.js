@@ -0,0 +1,148 @@
+// Benchmark workload definitions, shared between the benchmark runner and any
+// tooling that needs to interpret its output.
+
+const TYPES = ["integer", "real", "text", "longtext", "blob"];
+const COLUMNS = [1, 4, 16];
+const BINDS = ["positional", "named"];
+
+// Large cells get fewer rows so that the test tables stay a reasonable size.
+
+const ROWS = {
+  integer: [1, 100, 10000],
+  real: [1, 100, 10000],
+  text: [1, 100, 10000],
+  longtext: [1, 100, 1000],
+  blob: [1, 100, 1000]
+};
+
+const LONG_TEXT = "x".repeat(4096);
+const BLOB_BYTES = 1024;
+
+function* cases() {
+  for (const type of TYPES) {
+    for (const columns of COLUMNS) {
+      // run(): bind parameters, step, discard results
+      for (const binds of BINDS) {
+        yield { op: "run", type, columns, rows: 0, binds };
+      }
+
+      // one(): bind a rowid, convert a single row
+      for (const binds of BINDS) {
+        yield { op: "one", type, columns, rows: 1, binds };
+      }
+
+      // all(): convert an entire table
+      for (const rows of ROWS[type]) {
+        yield { op: "all", type, columns, rows, binds: "none" };
+      }
+    }
+  }
+}
+
+function name(spec) {
+  const { op, type, columns, rows, binds } = spec;
+
+  return `${op}/${type}/cols=${columns}/rows=${rows}/binds=${binds}`;
+}
+
+function value(type, i) {
+  switch (type) {
+    case "integer":
+      return BigInt(i) * 7919n;
+
+    case "real":
+      return i + 0.25;
+
+    case "text":
+      return `text-${i}`;
+
+    case "longtext":
+      return LONG_TEXT;
+
+    case "blob":
+      return new Uint8Array(BLOB_BYTES).fill(i & 0xff).buffer;
+
+    default:
+      throw new Error(`Unknown type: ${type}`);
+  }
+}
+
+function columnNames(columns) {
+  return Array.from({ length: columns }, (_, i) => `c${i}`);
+}
+
+function populate(db, spec) {
+  const cols = columnNames(spec.columns);
+  const placeholders = cols.map(() => "?").join(", ");
+
+  db.exec(`create table t (${cols.join(", ")})`);
+  db.exec("begin");
+
+  const insert = db.prepare(`insert into t values (${placeholders})`);
+
+  for (let i = 0; i < spec.rows; i++) {
+    insert.run(cols.map(() => value(spec.type, i)));
+  }
+
+  insert.close();
+  db.exec("commit");
+}
+
+function bindParams(spec, values) {
+  if (spec.binds === "positional") {
+    return values;
+  }
+
+  const params = {};
+
+  values.forEach((value, i) => (params[`@p${i}`] = value));
+
+  return params;
+}
+
+function placeholders(spec, count) {
+  return Array.from({ length: count }, (_, i) =>
+    spec.binds === "named" ? `@p${i}` : "?"
+  ).join(", ");
+}
+
+// Returns the function to be timed, along with the number of result rows that
+// each invocation produces.
+
+function prepare(db, spec) {
+  const cols = columnNames(spec.columns);
+
+  switch (spec.op) {
+    case "run": {
+      const stmt = db.prepare(`select ${placeholders(spec, spec.columns)}`);
+      const values = cols.map((_, i) => value(spec.type, i));
+      const params = bindParams(spec, values);
+
+      return { fn: () => stmt.run(params), rowsPerOp: 0 };
+    }
+
+    case "one": {
+      populate(db, spec);
+
+      const select = `select ${cols.join(", ")} from t`;
+      const where = `where rowid = ${placeholders(spec, 1)}`;
+      const stmt = db.prepare(`${select} ${where}`);
+      const params = bindParams(spec, [1n]);
+
+      return { fn: () => stmt.one(params), rowsPerOp: 1 };
+    }
+
+    case "all": {
+      populate(db, spec);
+
+      const stmt = db.prepare(`select ${cols.join(", ")} from t`);
+
+      return { fn: () => stmt.all(), rowsPerOp: spec.rows };
+    }
+
+    default:
+      throw new Error(`Unknown op: ${spec.op}`);
+  }
+}
+
+module.exports = { cases, name, prepare };
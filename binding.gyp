@@ -7,6 +7,19 @@
 # https://web.archive.org/web/20160430013351/https://n8.io/converting-a-c-library-to-gyp/
 
 {
+  'variables': {
+    # Build variants. Any of these can be overridden from the command line,
+    # e.g. `npx node-gyp rebuild --nsql_memstatus=1`.
+
+    # Keep SQLite's global memory statistics up to date. This makes the
+    # counters returned by `Database.globalStatus()` meaningful, at the cost of
+    # some bookkeeping on every memory allocation.
+    'nsql_memstatus%': 0,
+
+    # Also build the `nsql_bench` executable, which replays the benchmark
+    # workloads directly against the same SQLite library. See INTERNALS.md.
+    'nsql_bench%': 0,
+  },
   'target_defaults': {
     'configurations': {
       'Debug': {},
@@ -33,21 +46,35 @@
         # Recommendations from https://www.sqlite.org/compile.html
         # a/o 2019-12-01
         'SQLITE_DQS=0',
-        'SQLITE_THREADSAFE=0',
-        'SQLITE_DEFAULT_MEMSTATUS=0',
+        # Connections are never shared between threads, but the background
+        # checkpointer runs on a thread of its own
+        'SQLITE_THREADSAFE=2',
+        'SQLITE_DEFAULT_MEMSTATUS=<(nsql_memstatus)',
         'SQLITE_DEFAULT_WAL_SYNCHRONOUS=1',
         'SQLITE_LIKE_DOESNT_MATCH_BLOBS',
         'SQLITE_MAX_EXPR_DEPTH=0',
         'SQLITE_OMIT_DECLTYPE',
         'SQLITE_OMIT_DEPRECATED',
-        'SQLITE_OMIT_PROGRESS_CALLBACK',
         'SQLITE_OMIT_SHARED_CACHE',
         'SQLITE_USE_ALLOCA',
 
         # Executive decisions
         'SQLITE_DEFAULT_FOREIGN_KEYS=1',
-        'SQLITE_ENABLE_STAT4'
+        'SQLITE_ENABLE_STAT4',
+        'SQLITE_ENABLE_STMT_SCANSTATUS',
+
+        # Changesets for Database.session() and Database.applyChangeset()
+        'SQLITE_ENABLE_PREUPDATE_HOOK',
+        'SQLITE_ENABLE_SESSION'
       ],
+      'direct_dependent_settings': {
+        # The session extension's declarations in sqlite3.h are conditional
+        # on these, so code that uses it must be compiled with them too
+        'defines': [
+          'SQLITE_ENABLE_PREUPDATE_HOOK',
+          'SQLITE_ENABLE_SESSION',
+        ],
+      },
       'include_dirs': [
         'native/sqlite',
       ],
@@ -68,15 +95,69 @@
         'native/nsql',
       ],
       'sources': [
+        'native/nsql/arrow.c',
         'native/nsql/bind.c',
+        'native/nsql/blob.c',
+        'native/nsql/buf.c',
+        'native/nsql/cache.c',
+        'native/nsql/carray.c',
+        'native/nsql/changes.c',
+        'native/nsql/checkpoint.c',
+        'native/nsql/clock.c',
+        'native/nsql/columnar.c',
+        'native/nsql/compress.c',
         'native/nsql/database.c',
         'native/nsql/dprintf.c',
         'native/nsql/error.c',
+        'native/nsql/explain.c',
+        'native/nsql/export.c',
+        'native/nsql/hash.c',
+        'native/nsql/import.c',
+        'native/nsql/intern.c',
+        'native/nsql/interrupt.c',
+        'native/nsql/json.c',
+        'native/nsql/lz4.c',
+        'native/nsql/memory.c',
         'native/nsql/module.c',
+        'native/nsql/options.c',
+        'native/nsql/packed.c',
+        'native/nsql/profile.c',
         'native/nsql/result.c',
+        'native/nsql/session.c',
+        'native/nsql/shard.c',
         'native/nsql/statement.c',
+        'native/nsql/status.c',
         'native/nsql/str.c',
+        'native/nsql/unixfile.c',
+        'native/nsql/uring.c',
       ]
     }
+  ],
+  'conditions': [
+    ['nsql_bench==1', {
+      'targets': [
+        {
+          'target_name': 'nsql_bench',
+          'type': 'executable',
+          'dependencies': [
+            'sqlite'
+          ],
+          'include_dirs': [
+            'native/sqlite',
+          ],
+          'sources': [
+            'bench/native.c',
+          ],
+          'conditions': [
+            ['OS!="win"', {
+              'libraries': [
+                '-ldl',
+                '-lm',
+              ],
+            }],
+          ],
+        }
+      ]
+    }]
   ]
 }
@@ -0,0 +1,1313 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sqlite3.h>
+
+#include "arrow.h"
+#include "buf.h"
+#include "hash.h"
+
+/* Columns containing TEXT values are dictionary-encoded if they turn out to
+   have at most this many distinct values, and if doing so at least halves the
+   number of values stored. */
+
+#define NSQL_ARROW_DICT_MAX 1024
+#define NSQL_ARROW_DICT_SLOTS 2048
+
+/* Constants from the Arrow flatbuffer schemas (Schema.fbs, Message.fbs). */
+
+#define NSQL_ARROW_METADATA_V5 4
+#define NSQL_ARROW_MSG_SCHEMA 1
+#define NSQL_ARROW_MSG_DICTIONARY_BATCH 2
+#define NSQL_ARROW_MSG_RECORD_BATCH 3
+#define NSQL_ARROW_TYPE_NULL 1
+#define NSQL_ARROW_TYPE_INT 2
+#define NSQL_ARROW_TYPE_FLOATING_POINT 3
+#define NSQL_ARROW_TYPE_BINARY 4
+#define NSQL_ARROW_TYPE_UTF8 5
+#define NSQL_ARROW_PRECISION_DOUBLE 2
+
+#define NSQL_FB_MAX_FIELDS 8
+
+enum nsql_arrow_kind {
+  NSQL_ARROW_NULL,
+  NSQL_ARROW_INT64,
+  NSQL_ARROW_FLOAT64,
+  NSQL_ARROW_UTF8,
+  NSQL_ARROW_BINARY,
+};
+
+/* A column's kind is decided by its first non-NULL value. INTEGER columns are
+   widened to Float64 if a REAL value appears later on; any other mismatched
+   value is converted using SQLite's usual rules. */
+
+struct nsql_arrow_column {
+  char *name;
+  enum nsql_arrow_kind kind;
+  int64_t null_count;
+  struct nsql_buf validity;
+  struct nsql_buf values;
+  struct nsql_buf offsets;
+
+  /* Dictionary candidate state, for Utf8 columns only */
+
+  bool dict;
+  uint32_t *slots;
+  uint32_t ndistinct;
+  struct nsql_buf indices;
+  struct nsql_buf dict_values;
+  struct nsql_buf dict_offsets;
+};
+
+/* Minimal FlatBuffers builder, sufficient for Arrow IPC metadata. Like the
+   reference implementation it builds back to front, so every object must be
+   complete before anything that refers to it is started. Objects are
+   identified by their distance from the end of the buffer. */
+
+struct nsql_fb {
+  uint8_t *bytes;
+  size_t capacity;
+  size_t size;
+  size_t minalign;
+  size_t fields[NSQL_FB_MAX_FIELDS];
+  int nfields;
+  size_t table_start;
+  bool oom;
+};
+
+/* Scratch state for assembling one record batch message body */
+
+struct nsql_arrow_batch {
+  struct nsql_buf body;
+  struct nsql_buf nodes;
+  struct nsql_buf buffers;
+  int64_t nnodes;
+  int64_t nbuffers;
+};
+
+static bool nsql_arrow_push_bit(struct nsql_arrow_column *col, int64_t row,
+                                bool valid);
+
+static bool nsql_arrow_push_null(struct nsql_arrow_column *col, int64_t row);
+
+static bool nsql_arrow_push_cell(struct nsql_arrow_column *col, int64_t row,
+                                 sqlite3_stmt *stmt, int i);
+
+static bool nsql_arrow_set_kind(struct nsql_arrow_column *col, int64_t nrows,
+                                int type);
+
+static void nsql_arrow_widen(struct nsql_arrow_column *col);
+
+static bool nsql_arrow_push_var(struct nsql_arrow_column *col,
+                                const void *bytes, int nbytes);
+
+static bool nsql_arrow_dict_add(struct nsql_arrow_column *col,
+                                const void *bytes, int nbytes);
+
+static void nsql_arrow_dict_abandon(struct nsql_arrow_column *col);
+
+static bool nsql_arrow_use_dict(const struct nsql_arrow *self,
+                                const struct nsql_arrow_column *col);
+
+static bool nsql_arrow_write_schema(struct nsql_arrow *self,
+                                    struct nsql_buf *out);
+
+static size_t nsql_arrow_write_field(struct nsql_fb *fb, int64_t id,
+                                     const struct nsql_arrow_column *col,
+                                     bool dict);
+
+static bool nsql_arrow_write_dictionary(struct nsql_arrow_column *col,
+                                        int64_t id, struct nsql_buf *out);
+
+static bool nsql_arrow_write_batch(struct nsql_arrow *self, int64_t start,
+                                   int64_t n, struct nsql_buf *out);
+
+static bool nsql_arrow_batch_column(struct nsql_arrow *self,
+                                    struct nsql_arrow_batch *batch,
+                                    const struct nsql_arrow_column *col,
+                                    int64_t start, int64_t n);
+
+static bool nsql_arrow_batch_node(struct nsql_arrow_batch *batch,
+                                  int64_t length, int64_t null_count);
+
+static bool nsql_arrow_batch_buffer(struct nsql_arrow_batch *batch,
+                                    const void *bytes, size_t nbytes);
+
+static bool nsql_arrow_batch_validity(struct nsql_arrow_batch *batch,
+                                      const struct nsql_arrow_column *col,
+                                      int64_t start, int64_t n,
+                                      int64_t *out_nulls);
+
+static bool nsql_arrow_batch_offsets(struct nsql_arrow_batch *batch,
+                                     const struct nsql_buf *offsets,
+                                     const struct nsql_buf *values,
+                                     int64_t start, int64_t n);
+
+static size_t nsql_arrow_batch_metadata(struct nsql_fb *fb,
+                                        struct nsql_arrow_batch *batch,
+                                        int64_t length);
+
+static bool nsql_arrow_write_message(struct nsql_buf *out, struct nsql_fb *fb,
+                                     uint8_t header_type, size_t header,
+                                     const struct nsql_buf *body);
+
+static void nsql_arrow_batch_free(struct nsql_arrow_batch *batch);
+
+static int32_t nsql_arrow_get_i32(const struct nsql_buf *buf, int64_t i);
+
+static uint8_t *nsql_fb_push(struct nsql_fb *fb, size_t nbytes);
+
+static void nsql_fb_prep(struct nsql_fb *fb, size_t align, size_t additional);
+
+static void nsql_fb_u8(struct nsql_fb *fb, uint8_t value);
+
+static void nsql_fb_u16(struct nsql_fb *fb, uint16_t value);
+
+static void nsql_fb_u32(struct nsql_fb *fb, uint32_t value);
+
+static void nsql_fb_u64(struct nsql_fb *fb, uint64_t value);
+
+static void nsql_fb_offset(struct nsql_fb *fb, size_t ref);
+
+static size_t nsql_fb_string(struct nsql_fb *fb, const char *str);
+
+static void nsql_fb_start_vector(struct nsql_fb *fb, size_t elem_size,
+                                 size_t n, size_t align);
+
+static size_t nsql_fb_end_vector(struct nsql_fb *fb, size_t n);
+
+static void nsql_fb_start_table(struct nsql_fb *fb);
+
+static void nsql_fb_slot(struct nsql_fb *fb, int slot);
+
+static size_t nsql_fb_end_table(struct nsql_fb *fb);
+
+static void nsql_fb_finish(struct nsql_fb *fb, size_t root);
+
+static void nsql_fb_reset(struct nsql_fb *fb);
+
+static void nsql_put_u16(uint8_t *p, uint16_t v);
+
+static void nsql_put_u32(uint8_t *p, uint32_t v);
+
+static void nsql_put_u64(uint8_t *p, uint64_t v);
+
+bool nsql_arrow_begin(struct nsql_arrow *self, sqlite3_stmt *stmt) {
+  const char *name;
+  size_t nbytes;
+  int i;
+
+  assert(self != NULL);
+  assert(stmt != NULL);
+  assert(!self->begun);
+
+  self->ncols = sqlite3_column_count(stmt);
+  self->cols = calloc(self->ncols > 0 ? self->ncols : 1, sizeof(*self->cols));
+
+  if (self->cols == NULL) {
+    self->ncols = 0;
+
+    return false;
+  }
+
+  for (i = 0; i < self->ncols; i++) {
+    name = sqlite3_column_name(stmt, i);
+
+    if (name == NULL) {
+      return false;
+    }
+
+    nbytes = strlen(name) + 1;
+    self->cols[i].name = malloc(nbytes);
+
+    if (self->cols[i].name == NULL) {
+      return false;
+    }
+
+    memcpy(self->cols[i].name, name, nbytes);
+  }
+
+  self->begun = true;
+
+  return true;
+}
+
+bool nsql_arrow_push_row(struct nsql_arrow *self, sqlite3_stmt *stmt) {
+  int i;
+
+  assert(self != NULL);
+  assert(self->begun);
+
+  for (i = 0; i < self->ncols; i++) {
+    if (!nsql_arrow_push_cell(&self->cols[i], self->nrows, stmt, i)) {
+      return false;
+    }
+  }
+
+  self->nrows++;
+
+  return true;
+}
+
+bool nsql_arrow_finish(struct nsql_arrow *self, int64_t batch_size,
+                       struct nsql_buf *out) {
+  uint8_t *p;
+  int64_t start;
+  int i;
+
+  assert(self != NULL);
+  assert(self->begun);
+  assert(batch_size > 0);
+  assert(out != NULL);
+
+  if (!nsql_arrow_write_schema(self, out)) {
+    return false;
+  }
+
+  for (i = 0; i < self->ncols; i++) {
+    if (nsql_arrow_use_dict(self, &self->cols[i]) &&
+        !nsql_arrow_write_dictionary(&self->cols[i], i, out)) {
+      return false;
+    }
+  }
+
+  for (start = 0; start < self->nrows; start += batch_size) {
+    if (!nsql_arrow_write_batch(self, start,
+                                self->nrows - start < batch_size
+                                    ? self->nrows - start
+                                    : batch_size,
+                                out)) {
+      return false;
+    }
+  }
+
+  /* End-of-stream marker: a continuation token and a zero metadata length */
+
+  p = nsql_buf_extend(out, 8);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  nsql_put_u32(p, UINT32_MAX);
+  nsql_put_u32(p + 4, 0);
+
+  return true;
+}
+
+void nsql_arrow_free(struct nsql_arrow *self) {
+  struct nsql_arrow_column *col;
+  int i;
+
+  assert(self != NULL);
+
+  for (i = 0; i < self->ncols; i++) {
+    col = &self->cols[i];
+
+    free(col->name);
+    nsql_buf_free(&col->validity);
+    nsql_buf_free(&col->values);
+    nsql_buf_free(&col->offsets);
+    nsql_arrow_dict_abandon(col);
+  }
+
+  free(self->cols);
+  memset(self, 0, sizeof(*self));
+}
+
+static bool nsql_arrow_push_bit(struct nsql_arrow_column *col, int64_t row,
+                                bool valid) {
+  uint8_t *p;
+
+  if (row % 8 == 0) {
+    p = nsql_buf_extend(&col->validity, 1);
+
+    if (p == NULL) {
+      return false;
+    }
+
+    *p = 0;
+  }
+
+  if (valid) {
+    col->validity.bytes[row / 8] |= (uint8_t)(1u << (row % 8));
+  }
+
+  return true;
+}
+
+static bool nsql_arrow_push_null(struct nsql_arrow_column *col, int64_t row) {
+  uint8_t *p;
+  int32_t offset;
+
+  if (!nsql_arrow_push_bit(col, row, false)) {
+    return false;
+  }
+
+  col->null_count++;
+
+  /* Null slots still occupy space in the value buffers */
+
+  switch (col->kind) {
+  case NSQL_ARROW_INT64:
+  case NSQL_ARROW_FLOAT64:
+    p = nsql_buf_extend(&col->values, 8);
+
+    if (p == NULL) {
+      return false;
+    }
+
+    memset(p, 0, 8);
+
+    return true;
+
+  case NSQL_ARROW_UTF8:
+  case NSQL_ARROW_BINARY:
+    offset = (int32_t)col->values.nbytes;
+
+    if (!nsql_buf_append(&col->offsets, &offset, sizeof(offset))) {
+      return false;
+    }
+
+    if (col->dict) {
+      offset = 0;
+
+      if (!nsql_buf_append(&col->indices, &offset, sizeof(offset))) {
+        return false;
+      }
+    }
+
+    return true;
+
+  default:
+    return true;
+  }
+}
+
+static bool nsql_arrow_push_cell(struct nsql_arrow_column *col, int64_t row,
+                                 sqlite3_stmt *stmt, int i) {
+  const void *bytes;
+  sqlite3_int64 integer;
+  double real;
+  int type;
+
+  type = sqlite3_column_type(stmt, i);
+
+  if (type == SQLITE_NULL) {
+    return nsql_arrow_push_null(col, row);
+  }
+
+  if (col->kind == NSQL_ARROW_NULL) {
+    if (!nsql_arrow_set_kind(col, row, type)) {
+      return false;
+    }
+  } else if (col->kind == NSQL_ARROW_INT64 && type == SQLITE_FLOAT) {
+    nsql_arrow_widen(col);
+  }
+
+  if (!nsql_arrow_push_bit(col, row, true)) {
+    return false;
+  }
+
+  switch (col->kind) {
+  case NSQL_ARROW_INT64:
+    integer = sqlite3_column_int64(stmt, i);
+
+    return nsql_buf_append(&col->values, &integer, sizeof(integer));
+
+  case NSQL_ARROW_FLOAT64:
+    real = sqlite3_column_double(stmt, i);
+
+    return nsql_buf_append(&col->values, &real, sizeof(real));
+
+  case NSQL_ARROW_UTF8:
+    bytes = sqlite3_column_text(stmt, i);
+
+    if (bytes == NULL) {
+      return false;
+    }
+
+    return nsql_arrow_push_var(col, bytes, sqlite3_column_bytes(stmt, i)) &&
+           nsql_arrow_dict_add(col, bytes, sqlite3_column_bytes(stmt, i));
+
+  default:
+    bytes = sqlite3_column_blob(stmt, i);
+
+    return nsql_arrow_push_var(col, bytes, sqlite3_column_bytes(stmt, i));
+  }
+}
+
+static bool nsql_arrow_set_kind(struct nsql_arrow_column *col, int64_t nrows,
+                                int type) {
+  uint8_t *p;
+  size_t nbytes;
+
+  switch (type) {
+  case SQLITE_INTEGER:
+    col->kind = NSQL_ARROW_INT64;
+    break;
+
+  case SQLITE_FLOAT:
+    col->kind = NSQL_ARROW_FLOAT64;
+    break;
+
+  case SQLITE_TEXT:
+    col->kind = NSQL_ARROW_UTF8;
+    col->dict = true;
+    break;
+
+  default:
+    col->kind = NSQL_ARROW_BINARY;
+    break;
+  }
+
+  /* Every row so far was NULL; back-fill their value slots */
+
+  if (col->kind == NSQL_ARROW_INT64 || col->kind == NSQL_ARROW_FLOAT64) {
+    if (nrows == 0) {
+      return true;
+    }
+
+    nbytes = (size_t)nrows * 8;
+    p = nsql_buf_extend(&col->values, nbytes);
+
+    if (p == NULL) {
+      return false;
+    }
+
+    memset(p, 0, nbytes);
+
+    return true;
+  }
+
+  nbytes = ((size_t)nrows + 1) * 4;
+  p = nsql_buf_extend(&col->offsets, nbytes);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  memset(p, 0, nbytes);
+
+  if (col->dict) {
+    if (nrows > 0) {
+      nbytes = (size_t)nrows * 4;
+      p = nsql_buf_extend(&col->indices, nbytes);
+
+      if (p == NULL) {
+        return false;
+      }
+
+      memset(p, 0, nbytes);
+    }
+
+    p = nsql_buf_extend(&col->dict_offsets, 4);
+
+    if (p == NULL) {
+      return false;
+    }
+
+    memset(p, 0, 4);
+  }
+
+  return true;
+}
+
+static void nsql_arrow_widen(struct nsql_arrow_column *col) {
+  int64_t integer;
+  double real;
+  size_t i;
+
+  for (i = 0; i < col->values.nbytes; i += 8) {
+    memcpy(&integer, col->values.bytes + i, 8);
+    real = (double)integer;
+    memcpy(col->values.bytes + i, &real, 8);
+  }
+
+  col->kind = NSQL_ARROW_FLOAT64;
+}
+
+static bool nsql_arrow_push_var(struct nsql_arrow_column *col,
+                                const void *bytes, int nbytes) {
+  int32_t offset;
+
+  if (col->values.nbytes + (size_t)nbytes > INT32_MAX) {
+    return false;
+  }
+
+  if (!nsql_buf_append(&col->values, bytes, (size_t)nbytes)) {
+    return false;
+  }
+
+  offset = (int32_t)col->values.nbytes;
+
+  return nsql_buf_append(&col->offsets, &offset, sizeof(offset));
+}
+
+static bool nsql_arrow_dict_add(struct nsql_arrow_column *col,
+                                const void *bytes, int nbytes) {
+  uint32_t slot;
+  int32_t index;
+  int32_t start;
+  int32_t end;
+
+  if (!col->dict) {
+    return true;
+  }
+
+  if (col->slots == NULL) {
+    col->slots = calloc(NSQL_ARROW_DICT_SLOTS, sizeof(*col->slots));
+
+    if (col->slots == NULL) {
+      return false;
+    }
+  }
+
+  /* Open addressing, slots hold dictionary index + 1 */
+
+  slot = nsql_hash32(bytes, (size_t)nbytes) % NSQL_ARROW_DICT_SLOTS;
+
+  while (col->slots[slot] != 0) {
+    index = (int32_t)col->slots[slot] - 1;
+    start = nsql_arrow_get_i32(&col->dict_offsets, index);
+    end = nsql_arrow_get_i32(&col->dict_offsets, index + 1);
+
+    if (end - start == nbytes &&
+        memcmp(col->dict_values.bytes + start, bytes, (size_t)nbytes) == 0) {
+      return nsql_buf_append(&col->indices, &index, sizeof(index));
+    }
+
+    slot = (slot + 1) % NSQL_ARROW_DICT_SLOTS;
+  }
+
+  if (col->ndistinct == NSQL_ARROW_DICT_MAX) {
+    nsql_arrow_dict_abandon(col);
+
+    return true;
+  }
+
+  index = (int32_t)col->ndistinct;
+
+  if (!nsql_buf_append(&col->dict_values, bytes, (size_t)nbytes)) {
+    return false;
+  }
+
+  end = (int32_t)col->dict_values.nbytes;
+
+  if (!nsql_buf_append(&col->dict_offsets, &end, sizeof(end)) ||
+      !nsql_buf_append(&col->indices, &index, sizeof(index))) {
+    return false;
+  }
+
+  col->slots[slot] = (uint32_t)index + 1;
+  col->ndistinct++;
+
+  return true;
+}
+
+static void nsql_arrow_dict_abandon(struct nsql_arrow_column *col) {
+  free(col->slots);
+  nsql_buf_free(&col->indices);
+  nsql_buf_free(&col->dict_values);
+  nsql_buf_free(&col->dict_offsets);
+
+  col->dict = false;
+  col->slots = NULL;
+  col->ndistinct = 0;
+}
+
+static bool nsql_arrow_use_dict(const struct nsql_arrow *self,
+                                const struct nsql_arrow_column *col) {
+  return col->dict &&
+         (int64_t)col->ndistinct * 2 <= self->nrows - col->null_count;
+}
+
+static bool nsql_arrow_write_schema(struct nsql_arrow *self,
+                                    struct nsql_buf *out) {
+  const uint16_t one = 1;
+  struct nsql_fb fb;
+  size_t *refs;
+  size_t fields;
+  size_t schema;
+  bool ok;
+  int i;
+
+  memset(&fb, 0, sizeof(fb));
+  refs = calloc(self->ncols > 0 ? self->ncols : 1, sizeof(*refs));
+
+  if (refs == NULL) {
+    return false;
+  }
+
+  for (i = 0; i < self->ncols; i++) {
+    refs[i] = nsql_arrow_write_field(&fb, i, &self->cols[i],
+                                     nsql_arrow_use_dict(self, &self->cols[i]));
+  }
+
+  nsql_fb_start_vector(&fb, 4, (size_t)self->ncols, 4);
+
+  for (i = self->ncols - 1; i >= 0; i--) {
+    nsql_fb_offset(&fb, refs[i]);
+  }
+
+  fields = nsql_fb_end_vector(&fb, (size_t)self->ncols);
+
+  /* Value buffers are written in host byte order */
+
+  nsql_fb_start_table(&fb);
+  nsql_fb_offset(&fb, fields);
+  nsql_fb_slot(&fb, 1);
+  nsql_fb_u16(&fb, *(const uint8_t *)&one == 1 ? 0 : 1);
+  nsql_fb_slot(&fb, 0);
+  schema = nsql_fb_end_table(&fb);
+
+  ok = nsql_arrow_write_message(out, &fb, NSQL_ARROW_MSG_SCHEMA, schema, NULL);
+
+  free(refs);
+  nsql_fb_reset(&fb);
+
+  return ok;
+}
+
+static size_t nsql_arrow_write_field(struct nsql_fb *fb, int64_t id,
+                                     const struct nsql_arrow_column *col,
+                                     bool dict) {
+  uint8_t type_type;
+  size_t index_type;
+  size_t encoding;
+  size_t children;
+  size_t type;
+  size_t name;
+
+  nsql_fb_start_table(fb);
+
+  switch (col->kind) {
+  case NSQL_ARROW_NULL:
+    type_type = NSQL_ARROW_TYPE_NULL;
+    break;
+
+  case NSQL_ARROW_INT64:
+    type_type = NSQL_ARROW_TYPE_INT;
+    nsql_fb_u32(fb, 64);
+    nsql_fb_slot(fb, 0);
+    nsql_fb_u8(fb, 1);
+    nsql_fb_slot(fb, 1);
+    break;
+
+  case NSQL_ARROW_FLOAT64:
+    type_type = NSQL_ARROW_TYPE_FLOATING_POINT;
+    nsql_fb_u16(fb, NSQL_ARROW_PRECISION_DOUBLE);
+    nsql_fb_slot(fb, 0);
+    break;
+
+  case NSQL_ARROW_UTF8:
+    type_type = NSQL_ARROW_TYPE_UTF8;
+    break;
+
+  default:
+    type_type = NSQL_ARROW_TYPE_BINARY;
+    break;
+  }
+
+  type = nsql_fb_end_table(fb);
+  encoding = 0;
+
+  if (dict) {
+    nsql_fb_start_table(fb);
+    nsql_fb_u32(fb, 32);
+    nsql_fb_slot(fb, 0);
+    nsql_fb_u8(fb, 1);
+    nsql_fb_slot(fb, 1);
+    index_type = nsql_fb_end_table(fb);
+
+    nsql_fb_start_table(fb);
+    nsql_fb_u64(fb, (uint64_t)id);
+    nsql_fb_slot(fb, 0);
+    nsql_fb_offset(fb, index_type);
+    nsql_fb_slot(fb, 1);
+    encoding = nsql_fb_end_table(fb);
+  }
+
+  name = nsql_fb_string(fb, col->name);
+
+  /* Some readers insist on a children vector, even an empty one */
+
+  nsql_fb_start_vector(fb, 4, 0, 4);
+  children = nsql_fb_end_vector(fb, 0);
+
+  nsql_fb_start_table(fb);
+  nsql_fb_offset(fb, name);
+  nsql_fb_slot(fb, 0);
+  nsql_fb_offset(fb, type);
+  nsql_fb_slot(fb, 3);
+
+  if (dict) {
+    nsql_fb_offset(fb, encoding);
+    nsql_fb_slot(fb, 4);
+  }
+
+  nsql_fb_offset(fb, children);
+  nsql_fb_slot(fb, 5);
+  nsql_fb_u8(fb, 1);
+  nsql_fb_slot(fb, 1);
+  nsql_fb_u8(fb, type_type);
+  nsql_fb_slot(fb, 2);
+
+  return nsql_fb_end_table(fb);
+}
+
+static bool nsql_arrow_write_dictionary(struct nsql_arrow_column *col,
+                                        int64_t id, struct nsql_buf *out) {
+  struct nsql_arrow_batch batch;
+  struct nsql_fb fb;
+  size_t data;
+  size_t header;
+  bool ok;
+
+  memset(&batch, 0, sizeof(batch));
+  memset(&fb, 0, sizeof(fb));
+
+  ok = nsql_arrow_batch_node(&batch, col->ndistinct, 0) &&
+       nsql_arrow_batch_buffer(&batch, NULL, 0) &&
+       nsql_arrow_batch_buffer(&batch, col->dict_offsets.bytes,
+                               col->dict_offsets.nbytes) &&
+       nsql_arrow_batch_buffer(&batch, col->dict_values.bytes,
+                               col->dict_values.nbytes);
+
+  if (ok) {
+    data = nsql_arrow_batch_metadata(&fb, &batch, col->ndistinct);
+
+    nsql_fb_start_table(&fb);
+    nsql_fb_u64(&fb, (uint64_t)id);
+    nsql_fb_slot(&fb, 0);
+    nsql_fb_offset(&fb, data);
+    nsql_fb_slot(&fb, 1);
+    header = nsql_fb_end_table(&fb);
+
+    ok = nsql_arrow_write_message(out, &fb, NSQL_ARROW_MSG_DICTIONARY_BATCH,
+                                  header, &batch.body);
+  }
+
+  nsql_arrow_batch_free(&batch);
+  nsql_fb_reset(&fb);
+
+  return ok;
+}
+
+static bool nsql_arrow_write_batch(struct nsql_arrow *self, int64_t start,
+                                   int64_t n, struct nsql_buf *out) {
+  struct nsql_arrow_batch batch;
+  struct nsql_fb fb;
+  size_t header;
+  bool ok;
+  int i;
+
+  memset(&batch, 0, sizeof(batch));
+  memset(&fb, 0, sizeof(fb));
+  ok = true;
+
+  for (i = 0; i < self->ncols && ok; i++) {
+    ok = nsql_arrow_batch_column(self, &batch, &self->cols[i], start, n);
+  }
+
+  if (ok) {
+    header = nsql_arrow_batch_metadata(&fb, &batch, n);
+    ok = nsql_arrow_write_message(out, &fb, NSQL_ARROW_MSG_RECORD_BATCH,
+                                  header, &batch.body);
+  }
+
+  nsql_arrow_batch_free(&batch);
+  nsql_fb_reset(&fb);
+
+  return ok;
+}
+
+static bool nsql_arrow_batch_column(struct nsql_arrow *self,
+                                    struct nsql_arrow_batch *batch,
+                                    const struct nsql_arrow_column *col,
+                                    int64_t start, int64_t n) {
+  int64_t nulls;
+
+  /* The Null type has no buffers at all, not even a validity bitmap */
+
+  if (col->kind == NSQL_ARROW_NULL) {
+    return nsql_arrow_batch_node(batch, n, n);
+  }
+
+  if (!nsql_arrow_batch_validity(batch, col, start, n, &nulls) ||
+      !nsql_arrow_batch_node(batch, n, nulls)) {
+    return false;
+  }
+
+  switch (col->kind) {
+  case NSQL_ARROW_INT64:
+  case NSQL_ARROW_FLOAT64:
+    return nsql_arrow_batch_buffer(batch, col->values.bytes + start * 8,
+                                   (size_t)n * 8);
+
+  default:
+    if (nsql_arrow_use_dict(self, col)) {
+      return nsql_arrow_batch_buffer(batch, col->indices.bytes + start * 4,
+                                     (size_t)n * 4);
+    }
+
+    return nsql_arrow_batch_offsets(batch, &col->offsets, &col->values, start,
+                                    n);
+  }
+}
+
+static bool nsql_arrow_batch_node(struct nsql_arrow_batch *batch,
+                                  int64_t length, int64_t null_count) {
+  uint8_t *p;
+
+  p = nsql_buf_extend(&batch->nodes, 16);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  nsql_put_u64(p, (uint64_t)length);
+  nsql_put_u64(p + 8, (uint64_t)null_count);
+  batch->nnodes++;
+
+  return true;
+}
+
+static bool nsql_arrow_batch_buffer(struct nsql_arrow_batch *batch,
+                                    const void *bytes, size_t nbytes) {
+  uint8_t *p;
+  size_t offset;
+  size_t pad;
+
+  offset = batch->body.nbytes;
+  pad = (8 - nbytes % 8) % 8;
+
+  if (!nsql_buf_append(&batch->body, bytes, nbytes)) {
+    return false;
+  }
+
+  if (pad > 0) {
+    p = nsql_buf_extend(&batch->body, pad);
+
+    if (p == NULL) {
+      return false;
+    }
+
+    memset(p, 0, pad);
+  }
+
+  p = nsql_buf_extend(&batch->buffers, 16);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  nsql_put_u64(p, offset);
+  nsql_put_u64(p + 8, nbytes);
+  batch->nbuffers++;
+
+  return true;
+}
+
+static bool nsql_arrow_batch_validity(struct nsql_arrow_batch *batch,
+                                      const struct nsql_arrow_column *col,
+                                      int64_t start, int64_t n,
+                                      int64_t *out_nulls) {
+  const uint8_t *src;
+  uint8_t *dest;
+  size_t nbytes;
+  int64_t nulls;
+  int64_t row;
+  int64_t i;
+
+  *out_nulls = 0;
+
+  /* An absent bitmap means that every value in the batch is valid */
+
+  if (col->null_count == 0) {
+    return nsql_arrow_batch_buffer(batch, NULL, 0);
+  }
+
+  src = col->validity.bytes;
+  nulls = 0;
+
+  for (i = 0; i < n; i++) {
+    row = start + i;
+
+    if (!(src[row / 8] & (1u << (row % 8)))) {
+      nulls++;
+    }
+  }
+
+  *out_nulls = nulls;
+
+  if (nulls == 0) {
+    return nsql_arrow_batch_buffer(batch, NULL, 0);
+  }
+
+  nbytes = (size_t)(n + 7) / 8;
+  dest = calloc(nbytes, 1);
+
+  if (dest == NULL) {
+    return false;
+  }
+
+  for (i = 0; i < n; i++) {
+    row = start + i;
+
+    if (src[row / 8] & (1u << (row % 8))) {
+      dest[i / 8] |= (uint8_t)(1u << (i % 8));
+    }
+  }
+
+  if (!nsql_arrow_batch_buffer(batch, dest, nbytes)) {
+    free(dest);
+
+    return false;
+  }
+
+  free(dest);
+
+  return true;
+}
+
+static bool nsql_arrow_batch_offsets(struct nsql_arrow_batch *batch,
+                                     const struct nsql_buf *offsets,
+                                     const struct nsql_buf *values,
+                                     int64_t start, int64_t n) {
+  int32_t *rebased;
+  int32_t base;
+  int32_t end;
+  int64_t i;
+  bool ok;
+
+  /* Offsets within a batch must start from zero */
+
+  rebased = malloc((size_t)(n + 1) * sizeof(*rebased));
+
+  if (rebased == NULL) {
+    return false;
+  }
+
+  base = nsql_arrow_get_i32(offsets, start);
+  end = nsql_arrow_get_i32(offsets, start + n);
+
+  for (i = 0; i <= n; i++) {
+    rebased[i] = nsql_arrow_get_i32(offsets, start + i) - base;
+  }
+
+  ok = nsql_arrow_batch_buffer(batch, rebased, (size_t)(n + 1) * 4) &&
+       nsql_arrow_batch_buffer(batch, values->bytes + base,
+                               (size_t)(end - base));
+
+  free(rebased);
+
+  return ok;
+}
+
+static size_t nsql_arrow_batch_metadata(struct nsql_fb *fb,
+                                        struct nsql_arrow_batch *batch,
+                                        int64_t length) {
+  uint8_t *p;
+  size_t buffers;
+  size_t nodes;
+
+  /* Vectors of structs are copied in as-is; the structs were serialized in
+     little-endian order when they were recorded. */
+
+  nsql_fb_start_vector(fb, 16, (size_t)batch->nnodes, 8);
+  p = nsql_fb_push(fb, batch->nodes.nbytes);
+
+  if (p != NULL && batch->nodes.nbytes > 0) {
+    memcpy(p, batch->nodes.bytes, batch->nodes.nbytes);
+  }
+
+  nodes = nsql_fb_end_vector(fb, (size_t)batch->nnodes);
+
+  nsql_fb_start_vector(fb, 16, (size_t)batch->nbuffers, 8);
+  p = nsql_fb_push(fb, batch->buffers.nbytes);
+
+  if (p != NULL && batch->buffers.nbytes > 0) {
+    memcpy(p, batch->buffers.bytes, batch->buffers.nbytes);
+  }
+
+  buffers = nsql_fb_end_vector(fb, (size_t)batch->nbuffers);
+
+  nsql_fb_start_table(fb);
+  nsql_fb_u64(fb, (uint64_t)length);
+  nsql_fb_slot(fb, 0);
+  nsql_fb_offset(fb, nodes);
+  nsql_fb_slot(fb, 1);
+  nsql_fb_offset(fb, buffers);
+  nsql_fb_slot(fb, 2);
+
+  return nsql_fb_end_table(fb);
+}
+
+static bool nsql_arrow_write_message(struct nsql_buf *out, struct nsql_fb *fb,
+                                     uint8_t header_type, size_t header,
+                                     const struct nsql_buf *body) {
+  size_t body_nbytes;
+  size_t nbytes;
+  size_t pad;
+  uint8_t *p;
+  size_t msg;
+
+  body_nbytes = body != NULL ? body->nbytes : 0;
+
+  nsql_fb_start_table(fb);
+  nsql_fb_u64(fb, body_nbytes);
+  nsql_fb_slot(fb, 3);
+  nsql_fb_offset(fb, header);
+  nsql_fb_slot(fb, 2);
+  nsql_fb_u16(fb, NSQL_ARROW_METADATA_V5);
+  nsql_fb_slot(fb, 0);
+  nsql_fb_u8(fb, header_type);
+  nsql_fb_slot(fb, 1);
+  msg = nsql_fb_end_table(fb);
+  nsql_fb_finish(fb, msg);
+
+  if (fb->oom) {
+    return false;
+  }
+
+  /* Encapsulated message: continuation token, metadata length (including
+     padding to a multiple of 8 bytes), metadata, then the body. */
+
+  nbytes = fb->size;
+  pad = (8 - nbytes % 8) % 8;
+  p = nsql_buf_extend(out, 8 + nbytes + pad);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  nsql_put_u32(p, UINT32_MAX);
+  nsql_put_u32(p + 4, (uint32_t)(nbytes + pad));
+  memcpy(p + 8, fb->bytes + fb->capacity - fb->size, nbytes);
+  memset(p + 8 + nbytes, 0, pad);
+
+  return body == NULL || nsql_buf_append(out, body->bytes, body->nbytes);
+}
+
+static void nsql_arrow_batch_free(struct nsql_arrow_batch *batch) {
+  nsql_buf_free(&batch->body);
+  nsql_buf_free(&batch->nodes);
+  nsql_buf_free(&batch->buffers);
+}
+
+static int32_t nsql_arrow_get_i32(const struct nsql_buf *buf, int64_t i) {
+  int32_t value;
+
+  memcpy(&value, buf->bytes + i * 4, sizeof(value));
+
+  return value;
+}
+
+static uint8_t *nsql_fb_push(struct nsql_fb *fb, size_t nbytes) {
+  uint8_t *bytes;
+  size_t capacity;
+
+  if (fb->oom) {
+    return NULL;
+  }
+
+  if (fb->capacity - fb->size < nbytes) {
+    capacity = fb->capacity > 0 ? fb->capacity : 256;
+
+    while (capacity - fb->size < nbytes) {
+      capacity *= 2;
+    }
+
+    bytes = malloc(capacity);
+
+    if (bytes == NULL) {
+      fb->oom = true;
+
+      return NULL;
+    }
+
+    /* Data lives at the end of the buffer */
+
+    if (fb->size > 0) {
+      memcpy(bytes + capacity - fb->size,
+             fb->bytes + fb->capacity - fb->size, fb->size);
+    }
+
+    free(fb->bytes);
+    fb->bytes = bytes;
+    fb->capacity = capacity;
+  }
+
+  fb->size += nbytes;
+
+  return fb->bytes + fb->capacity - fb->size;
+}
+
+static void nsql_fb_prep(struct nsql_fb *fb, size_t align, size_t additional) {
+  uint8_t *p;
+  size_t pad;
+
+  if (align > fb->minalign) {
+    fb->minalign = align;
+  }
+
+  pad = (~(fb->size + additional) + 1) & (align - 1);
+  p = nsql_fb_push(fb, pad);
+
+  if (p != NULL) {
+    memset(p, 0, pad);
+  }
+}
+
+static void nsql_fb_u8(struct nsql_fb *fb, uint8_t value) {
+  uint8_t *p;
+
+  p = nsql_fb_push(fb, 1);
+
+  if (p != NULL) {
+    *p = value;
+  }
+}
+
+static void nsql_fb_u16(struct nsql_fb *fb, uint16_t value) {
+  uint8_t *p;
+
+  nsql_fb_prep(fb, 2, 0);
+  p = nsql_fb_push(fb, 2);
+
+  if (p != NULL) {
+    nsql_put_u16(p, value);
+  }
+}
+
+static void nsql_fb_u32(struct nsql_fb *fb, uint32_t value) {
+  uint8_t *p;
+
+  nsql_fb_prep(fb, 4, 0);
+  p = nsql_fb_push(fb, 4);
+
+  if (p != NULL) {
+    nsql_put_u32(p, value);
+  }
+}
+
+static void nsql_fb_u64(struct nsql_fb *fb, uint64_t value) {
+  uint8_t *p;
+
+  nsql_fb_prep(fb, 8, 0);
+  p = nsql_fb_push(fb, 8);
+
+  if (p != NULL) {
+    nsql_put_u64(p, value);
+  }
+}
+
+static void nsql_fb_offset(struct nsql_fb *fb, size_t ref) {
+  nsql_fb_prep(fb, 4, 0);
+  nsql_fb_u32(fb, (uint32_t)(fb->size + 4 - ref));
+}
+
+static size_t nsql_fb_string(struct nsql_fb *fb, const char *str) {
+  uint8_t *p;
+  size_t nbytes;
+
+  nbytes = strlen(str);
+  nsql_fb_prep(fb, 4, nbytes + 1);
+  p = nsql_fb_push(fb, nbytes + 1);
+
+  if (p != NULL) {
+    memcpy(p, str, nbytes);
+    p[nbytes] = 0;
+  }
+
+  nsql_fb_u32(fb, (uint32_t)nbytes);
+
+  return fb->size;
+}
+
+static void nsql_fb_start_vector(struct nsql_fb *fb, size_t elem_size,
+                                 size_t n, size_t align) {
+  nsql_fb_prep(fb, 4, elem_size * n);
+  nsql_fb_prep(fb, align, elem_size * n);
+}
+
+static size_t nsql_fb_end_vector(struct nsql_fb *fb, size_t n) {
+  nsql_fb_u32(fb, (uint32_t)n);
+
+  return fb->size;
+}
+
+static void nsql_fb_start_table(struct nsql_fb *fb) {
+  memset(fb->fields, 0, sizeof(fb->fields));
+  fb->nfields = 0;
+  fb->table_start = fb->size;
+}
+
+static void nsql_fb_slot(struct nsql_fb *fb, int slot) {
+  assert(slot < NSQL_FB_MAX_FIELDS);
+
+  fb->fields[slot] = fb->size;
+
+  if (slot + 1 > fb->nfields) {
+    fb->nfields = slot + 1;
+  }
+}
+
+static size_t nsql_fb_end_table(struct nsql_fb *fb) {
+  size_t vtable;
+  size_t table;
+  int i;
+
+  /* The table starts with a signed offset to its vtable, which we write
+     immediately in front of it */
+
+  nsql_fb_u32(fb, 0);
+  table = fb->size;
+
+  for (i = fb->nfields - 1; i >= 0; i--) {
+    nsql_fb_u16(fb, fb->fields[i] != 0 ? (uint16_t)(table - fb->fields[i])
+                                       : 0);
+  }
+
+  nsql_fb_u16(fb, (uint16_t)(table - fb->table_start));
+  nsql_fb_u16(fb, (uint16_t)((fb->nfields + 2) * 2));
+  vtable = fb->size;
+
+  if (!fb->oom) {
+    nsql_put_u32(fb->bytes + fb->capacity - table, (uint32_t)(vtable - table));
+  }
+
+  return table;
+}
+
+static void nsql_fb_finish(struct nsql_fb *fb, size_t root) {
+  nsql_fb_prep(fb, fb->minalign, 4);
+  nsql_fb_offset(fb, root);
+}
+
+static void nsql_fb_reset(struct nsql_fb *fb) {
+  free(fb->bytes);
+  memset(fb, 0, sizeof(*fb));
+}
+
+static void nsql_put_u16(uint8_t *p, uint16_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void nsql_put_u32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void nsql_put_u64(uint8_t *p, uint64_t v) {
+  nsql_put_u32(p, (uint32_t)v);
+  nsql_put_u32(p + 4, (uint32_t)(v >> 32));
+}
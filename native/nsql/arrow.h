@@ -0,0 +1,48 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sqlite3.h>
+
+#include "buf.h"
+
+/*
+ * Writer that converts a result set into an Apache Arrow IPC stream. Values
+ * are appended to per-column builders as rows are stepped, and the stream is
+ * assembled once the result set is complete, since SQLite's dynamic typing
+ * means that a column's Arrow type is not known until every row has been seen.
+ *
+ * A zero-initialized `struct nsql_arrow` is ready for use.
+ */
+struct nsql_arrow {
+  struct nsql_arrow_column *cols;
+  int ncols;
+  int64_t nrows;
+  bool begun;
+};
+
+/*
+ * Set up one builder per result column. Must be called once, after the first
+ * call to `sqlite3_step()`. Returns false if memory allocation fails.
+ */
+bool nsql_arrow_begin(struct nsql_arrow *self, sqlite3_stmt *stmt);
+
+/*
+ * Append the statement's current row. Returns false if memory allocation fails
+ * or a column grows beyond the 2 GiB limit of Arrow's 32-bit offsets.
+ */
+bool nsql_arrow_push_row(struct nsql_arrow *self, sqlite3_stmt *stmt);
+
+/*
+ * Write the complete IPC stream (schema, dictionaries, record batches of at
+ * most `batch_size` rows and end-of-stream marker) to `out`. Returns false if
+ * memory allocation fails.
+ */
+bool nsql_arrow_finish(struct nsql_arrow *self, int64_t batch_size,
+                       struct nsql_buf *out);
+
+/*
+ * Release all memory owned by a writer.
+ */
+void nsql_arrow_free(struct nsql_arrow *self);
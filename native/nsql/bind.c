@@ -3,19 +3,29 @@
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <node_api.h>
 #include <sqlite3.h>
 
 #include "bind.h"
+#include "buf.h"
+#include "carray.h"
 #include "error.h"
 #include "str.h"
 
+/* Cache key tag for list parameters, above SQLite's fundamental datatype
+   codes and offset by the list's element type */
+
+#define NSQL_BIND_KEY_LIST 16
+
 static napi_status nsql_bind_array(napi_env env, napi_value values,
-                                   sqlite3_stmt *stmt, bool *ok);
+                                   sqlite3_stmt *stmt, struct nsql_buf *key,
+                                   bool *ok);
 
 static napi_status nsql_bind_object(napi_env env, napi_value obj,
-                                    sqlite3_stmt *stmt, bool *ok);
+                                    sqlite3_stmt *stmt, struct nsql_buf *key,
+                                    bool *ok);
 
 static napi_status nsql_bind_get_key(napi_env env, napi_value key,
                                      sqlite3_stmt *stmt, uint32_t *out);
@@ -24,29 +34,37 @@ static napi_status nsql_throw_bad_key(napi_env env, napi_value key);
 
 static napi_status nsql_bind_one(napi_env env, napi_value value,
                                  sqlite3_stmt *stmt, uint32_t ordinal,
-                                 bool *ok);
+                                 struct nsql_buf *key, bool *ok);
 
 static napi_status nsql_bind_null(napi_env env, sqlite3_stmt *stmt,
-                                  uint32_t ordinal, bool *ok);
+                                  uint32_t ordinal, struct nsql_buf *key,
+                                  bool *ok);
 
 static napi_status nsql_bind_float(napi_env env, napi_value value,
                                    sqlite3_stmt *stmt, uint32_t ordinal,
-                                   bool *ok);
+                                   struct nsql_buf *key, bool *ok);
 
 static napi_status nsql_bind_string(napi_env env, napi_value value,
                                     sqlite3_stmt *stmt, uint32_t ordinal,
-                                    bool *ok);
+                                    struct nsql_buf *key, bool *ok);
 
 static napi_status nsql_bind_buffer(napi_env env, napi_value value,
                                     sqlite3_stmt *stmt, uint32_t ordinal,
-                                    bool *ok);
+                                    struct nsql_buf *key, bool *ok);
 
 static napi_status nsql_bind_bigint(napi_env env, napi_value value,
                                     sqlite3_stmt *stmt, uint32_t ordinal,
-                                    bool *ok);
+                                    struct nsql_buf *key, bool *ok);
+
+static napi_status nsql_bind_list(napi_env env, napi_value value,
+                                  sqlite3_stmt *stmt, uint32_t ordinal,
+                                  struct nsql_buf *key, bool *ok);
+
+static bool nsql_bind_key(struct nsql_buf *key, uint32_t ordinal, int type,
+                          const void *bytes, size_t nbytes);
 
 napi_status nsql_bind(napi_env env, napi_value values, sqlite3_stmt *stmt,
-                      bool *ok) {
+                      struct nsql_buf *key, bool *ok) {
   bool is_array;
   napi_valuetype type;
   napi_status r;
@@ -81,9 +99,9 @@ napi_status nsql_bind(napi_env env, napi_value values, sqlite3_stmt *stmt,
   }
 
   if (is_array) {
-    r = nsql_bind_array(env, values, stmt, ok);
+    r = nsql_bind_array(env, values, stmt, key, ok);
   } else {
-    r = nsql_bind_object(env, values, stmt, ok);
+    r = nsql_bind_object(env, values, stmt, key, ok);
   }
 
   if (r != napi_ok || !*ok) {
@@ -99,7 +117,8 @@ end:
 }
 
 static napi_status nsql_bind_array(napi_env env, napi_value values,
-                                   sqlite3_stmt *stmt, bool *ok) {
+                                   sqlite3_stmt *stmt, struct nsql_buf *key,
+                                   bool *ok) {
   napi_value value;
   napi_status r;
   uint32_t len;
@@ -127,7 +146,7 @@ static napi_status nsql_bind_array(napi_env env, napi_value values,
       goto end;
     }
 
-    r = nsql_bind_one(env, value, stmt, i + 1, ok);
+    r = nsql_bind_one(env, value, stmt, i + 1, key, ok);
 
     if (r != napi_ok || !*ok) {
       goto end;
@@ -141,9 +160,10 @@ end:
 }
 
 static napi_status nsql_bind_object(napi_env env, napi_value obj,
-                                    sqlite3_stmt *stmt, bool *ok) {
+                                    sqlite3_stmt *stmt, struct nsql_buf *key,
+                                    bool *ok) {
   napi_value props;
-  napi_value key;
+  napi_value name;
   napi_value value;
   uint32_t ordinal;
   uint32_t nprops;
@@ -172,7 +192,7 @@ static napi_status nsql_bind_object(napi_env env, napi_value obj,
   }
 
   for (i = 0; i < nprops; i++) {
-    r = napi_get_element(env, props, i, &key);
+    r = napi_get_element(env, props, i, &name);
 
     if (r != napi_ok) {
       nsql_report_error(env, r);
@@ -180,13 +200,13 @@ static napi_status nsql_bind_object(napi_env env, napi_value obj,
       goto end;
     }
 
-    r = nsql_bind_get_key(env, key, stmt, &ordinal);
+    r = nsql_bind_get_key(env, name, stmt, &ordinal);
 
     if (r != napi_ok || ordinal == 0) {
       goto end;
     }
 
-    r = napi_get_property(env, obj, key, &value);
+    r = napi_get_property(env, obj, name, &value);
 
     if (r != napi_ok) {
       nsql_report_error(env, r);
@@ -194,7 +214,7 @@ static napi_status nsql_bind_object(napi_env env, napi_value obj,
       goto end;
     }
 
-    r = nsql_bind_one(env, value, stmt, ordinal, ok);
+    r = nsql_bind_one(env, value, stmt, ordinal, key, ok);
 
     if (r != napi_ok || !*ok) {
       goto end;
@@ -286,7 +306,7 @@ end:
 
 static napi_status nsql_bind_one(napi_env env, napi_value value,
                                  sqlite3_stmt *stmt, uint32_t ordinal,
-                                 bool *ok) {
+                                 struct nsql_buf *key, bool *ok) {
   napi_valuetype type;
   napi_status r;
 
@@ -305,19 +325,19 @@ static napi_status nsql_bind_one(napi_env env, napi_value value,
 
   switch (type) {
   case napi_null:
-    return nsql_bind_null(env, stmt, ordinal, ok);
+    return nsql_bind_null(env, stmt, ordinal, key, ok);
 
   case napi_number:
-    return nsql_bind_float(env, value, stmt, ordinal, ok);
+    return nsql_bind_float(env, value, stmt, ordinal, key, ok);
 
   case napi_string:
-    return nsql_bind_string(env, value, stmt, ordinal, ok);
+    return nsql_bind_string(env, value, stmt, ordinal, key, ok);
 
   case napi_object:
-    return nsql_bind_buffer(env, value, stmt, ordinal, ok);
+    return nsql_bind_buffer(env, value, stmt, ordinal, key, ok);
 
   case napi_bigint:
-    return nsql_bind_bigint(env, value, stmt, ordinal, ok);
+    return nsql_bind_bigint(env, value, stmt, ordinal, key, ok);
 
   default:
     return napi_throw_type_error(
@@ -327,7 +347,8 @@ static napi_status nsql_bind_one(napi_env env, napi_value value,
 }
 
 static napi_status nsql_bind_null(napi_env env, sqlite3_stmt *stmt,
-                                  uint32_t ordinal, bool *ok) {
+                                  uint32_t ordinal, struct nsql_buf *key,
+                                  bool *ok) {
   int sqlr;
 
   assert(stmt != NULL);
@@ -340,6 +361,10 @@ static napi_status nsql_bind_null(napi_env env, sqlite3_stmt *stmt,
     return nsql_throw_sqlite_error(env, sqlr, NULL);
   }
 
+  if (!nsql_bind_key(key, ordinal, SQLITE_NULL, NULL, 0)) {
+    return nsql_throw_oom(env);
+  }
+
   *ok = true;
 
   return napi_ok;
@@ -347,7 +372,7 @@ static napi_status nsql_bind_null(napi_env env, sqlite3_stmt *stmt,
 
 static napi_status nsql_bind_float(napi_env env, napi_value value,
                                    sqlite3_stmt *stmt, uint32_t ordinal,
-                                   bool *ok) {
+                                   struct nsql_buf *key, bool *ok) {
   double num;
   napi_status r;
   int sqlr;
@@ -372,6 +397,12 @@ static napi_status nsql_bind_float(napi_env env, napi_value value,
     goto end;
   }
 
+  if (!nsql_bind_key(key, ordinal, SQLITE_FLOAT, &num, sizeof(num))) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
   *ok = true;
 
 end:
@@ -380,7 +411,7 @@ end:
 
 static napi_status nsql_bind_string(napi_env env, napi_value value,
                                     sqlite3_stmt *stmt, uint32_t ordinal,
-                                    bool *ok) {
+                                    struct nsql_buf *key, bool *ok) {
   char *str;
   size_t nbytes;
   napi_status r;
@@ -409,6 +440,12 @@ static napi_status nsql_bind_string(napi_env env, napi_value value,
     goto end;
   }
 
+  if (!nsql_bind_key(key, ordinal, SQLITE_TEXT, str, nbytes)) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
   *ok = true;
 
 end:
@@ -417,7 +454,7 @@ end:
 
 static napi_status nsql_bind_buffer(napi_env env, napi_value value,
                                     sqlite3_stmt *stmt, uint32_t ordinal,
-                                    bool *ok) {
+                                    struct nsql_buf *key, bool *ok) {
   bool is_buffer;
   void *bytes;
   size_t nbytes;
@@ -438,9 +475,7 @@ static napi_status nsql_bind_buffer(napi_env env, napi_value value,
   }
 
   if (!is_buffer) {
-    r = napi_throw_type_error(
-        env, "ERR_INVALID_ARG_TYPE",
-        "Object parameter to prepared statement is not an ArrayBuffer");
+    r = nsql_bind_list(env, value, stmt, ordinal, key, ok);
 
     goto end;
   }
@@ -469,6 +504,12 @@ static napi_status nsql_bind_buffer(napi_env env, napi_value value,
     goto end;
   }
 
+  if (!nsql_bind_key(key, ordinal, SQLITE_BLOB, bytes, nbytes)) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
   *ok = true;
 
 end:
@@ -477,7 +518,7 @@ end:
 
 static napi_status nsql_bind_bigint(napi_env env, napi_value value,
                                     sqlite3_stmt *stmt, uint32_t ordinal,
-                                    bool *ok) {
+                                    struct nsql_buf *key, bool *ok) {
   bool fit;
   int64_t num;
   napi_status r;
@@ -510,8 +551,145 @@ static napi_status nsql_bind_bigint(napi_env env, napi_value value,
     goto end;
   }
 
+  if (!nsql_bind_key(key, ordinal, SQLITE_INTEGER, &num, sizeof(num))) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  *ok = true;
+
+end:
+  return r;
+}
+
+static napi_status nsql_bind_list(napi_env env, napi_value value,
+                                  sqlite3_stmt *stmt, uint32_t ordinal,
+                                  struct nsql_buf *key, bool *ok) {
+  struct nsql_carray *list;
+  size_t nbytes;
+  bool is_typedarray;
+  bool is_array;
+  napi_status r;
+  int sqlr;
+
+  assert(stmt != NULL);
+  assert(ok != NULL);
+
+  *ok = false;
+  list = NULL;
+
+  r = napi_is_typedarray(env, value, &is_typedarray);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (!is_typedarray) {
+    r = napi_is_array(env, value, &is_array);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    if (!is_array) {
+      r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                "Object parameter to prepared statement is not "
+                                "an ArrayBuffer, typed array or array");
+
+      goto end;
+    }
+  }
+
+  r = nsql_carray_from_value(env, value, &list);
+
+  if (r != napi_ok || list == NULL) {
+    goto end;
+  }
+
+  /* Like `sqlite3_bind_text()`, this takes ownership of `list` even if it
+     fails. The list is only visible to the `carray` table-valued function. */
+
+  sqlr = sqlite3_bind_pointer(stmt, ordinal, list, NSQL_CARRAY_POINTER_TYPE,
+                              nsql_carray_free);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, NULL);
+
+    goto end;
+  }
+
+  /* The statement now owns the list, which stays valid until the next reset */
+
+  switch (list->type) {
+  case NSQL_CARRAY_INT32:
+    nbytes = list->count * sizeof(int32_t);
+
+    break;
+
+  case NSQL_CARRAY_TEXT:
+    nbytes = list->offsets[list->count];
+
+    break;
+
+  default:
+    nbytes = list->count * sizeof(int64_t);
+
+    break;
+  }
+
+  if (!nsql_bind_key(key, ordinal, NSQL_BIND_KEY_LIST + list->type,
+                     list->values, nbytes) ||
+      (list->type == NSQL_CARRAY_TEXT &&
+       !nsql_bind_key(key, ordinal, NSQL_BIND_KEY_LIST + list->type,
+                      list->offsets, (list->count + 1) * sizeof(size_t)))) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
   *ok = true;
 
 end:
   return r;
 }
+
+static bool nsql_bind_key(struct nsql_buf *key, uint32_t ordinal, int type,
+                          const void *bytes, size_t nbytes) {
+  uint8_t *dest;
+  uint8_t tag;
+  uint64_t len;
+
+  if (key == NULL) {
+    return true;
+  }
+
+  /* Each parameter is recorded as its ordinal, type and length followed by its
+     value, so that no two different sets of bindings share a key */
+
+  dest = nsql_buf_extend(key, sizeof(ordinal) + sizeof(tag) + sizeof(len) +
+                                  nbytes);
+
+  if (dest == NULL) {
+    return false;
+  }
+
+  tag = (uint8_t)type;
+  len = nbytes;
+  memcpy(dest, &ordinal, sizeof(ordinal));
+  dest += sizeof(ordinal);
+  memcpy(dest, &tag, sizeof(tag));
+  dest += sizeof(tag);
+  memcpy(dest, &len, sizeof(len));
+  dest += sizeof(len);
+
+  if (nbytes > 0) {
+    memcpy(dest, bytes, nbytes);
+  }
+
+  return true;
+}
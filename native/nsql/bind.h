@@ -5,5 +5,14 @@
 #include <node_api.h>
 #include <sqlite3.h>
 
+#include "buf.h"
+
+/*
+ * Bind the elements of a JavaScript array, or the properties of a JavaScript
+ * object, to the parameters of `stmt`. If `key` is non-NULL then every bound
+ * value is also appended to it in a form that identifies the bindings exactly,
+ * for use as a result cache key. `*ok` is set to false and a JavaScript
+ * exception is thrown if any value cannot be bound.
+ */
 napi_status nsql_bind(napi_env env, napi_value values, sqlite3_stmt *stmt,
-                      bool *ok);
+                      struct nsql_buf *key, bool *ok);
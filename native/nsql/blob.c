@@ -0,0 +1,766 @@
+#include <assert.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "blob.h"
+#include "changes.h"
+#include "dprintf.h"
+#include "error.h"
+#include "macros.h"
+#include "options.h"
+#include "str.h"
+
+struct nsql_blob {
+  /* As with statements, holding an open BLOB handle keeps the underlying
+     connection alive until the handle is closed, even if the connection has
+     been closed from JavaScript in the meantime. */
+
+  sqlite3 *db;
+  sqlite3_blob *blob;
+
+  /* Writes through the handle bypass SQLite's update hook, so they are
+     reported to the connection's change feed here instead */
+
+  struct nsql_changes *changes;
+  char *table;
+  sqlite3_int64 rowid;
+};
+
+static napi_value nsql_blob_constructor(napi_env env, napi_callback_info ctx);
+
+static void nsql_blob_destructor(napi_env env, void *ptr, void *hint);
+
+static napi_value nsql_blob_close(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_blob_read(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_blob_write(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_blob_reopen(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_blob_get_size(napi_env env, napi_callback_info ctx);
+
+static napi_status nsql_blob_unwrap_open(napi_env env, napi_callback_info ctx,
+                                         size_t *argc, napi_value *argv,
+                                         struct nsql_blob **out);
+
+static napi_status nsql_blob_get_name(napi_env env, napi_value value,
+                                      const char *name, char **out);
+
+static napi_status nsql_blob_get_rowid(napi_env env, napi_value value,
+                                       sqlite3_int64 *out, bool *ok);
+
+static napi_status nsql_blob_get_bytes(napi_env env, napi_value value,
+                                       void **out, size_t *out_nbytes,
+                                       bool *ok);
+
+static napi_status nsql_blob_get_offset(napi_env env, napi_value value,
+                                        int *out, bool *ok);
+
+static const napi_property_descriptor nsql_blob_desc[] = {
+    {.utf8name = "close", .method = nsql_blob_close},
+    {.utf8name = "read", .method = nsql_blob_read},
+    {.utf8name = "write", .method = nsql_blob_write},
+    {.utf8name = "reopen", .method = nsql_blob_reopen},
+    {.utf8name = "size", .getter = nsql_blob_get_size}};
+
+napi_status nsql_blob_define_class(napi_env env, napi_value *out) {
+  napi_value nclass;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  nsql_dprintf("%s\n", __func__);
+
+  r = napi_define_class(env, "Blob", NAPI_AUTO_LENGTH, nsql_blob_constructor,
+                        NULL, countof(nsql_blob_desc), nsql_blob_desc,
+                        &nclass);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  *out = nclass;
+
+end:
+  return r;
+}
+
+napi_status nsql_blob_open(napi_env env, napi_value nclass, sqlite3 *db,
+                           struct nsql_changes *changes, napi_value table,
+                           napi_value column, napi_value rowid,
+                           napi_value opts, napi_value *out) {
+  struct nsql_blob *self;
+  char *ztable;
+  char *zcolumn;
+  sqlite3_int64 irowid;
+  napi_value nself;
+  napi_status r;
+  bool write;
+  bool ok;
+  int sqlr;
+
+  assert(db != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+  ztable = NULL;
+  zcolumn = NULL;
+
+  r = nsql_blob_get_name(env, table, "table", &ztable);
+
+  if (r != napi_ok || ztable == NULL) {
+    goto end;
+  }
+
+  r = nsql_blob_get_name(env, column, "column", &zcolumn);
+
+  if (r != napi_ok || zcolumn == NULL) {
+    goto end;
+  }
+
+  r = nsql_blob_get_rowid(env, rowid, &irowid, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  write = false;
+  r = nsql_options_get_bool(env, opts, "write", &write, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = napi_new_instance(env, nclass, 0, NULL, &nself);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  sqlr = sqlite3_blob_open(db, "main", ztable, zcolumn, irowid, write,
+                           &self->blob);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, db);
+
+    goto end;
+  }
+
+  self->db = db;
+  self->rowid = irowid;
+
+  if (write) {
+    self->changes = nsql_changes_retain(changes);
+    self->table = ztable;
+    ztable = NULL;
+  }
+
+  *out = nself;
+
+end:
+  free(zcolumn);
+  free(ztable);
+
+  return r;
+}
+
+static napi_value nsql_blob_constructor(napi_env env, napi_callback_info ctx) {
+  struct nsql_blob *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_wrap(env, nself, self, nsql_blob_destructor, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  nsql_dprintf("%s -> %p\n", __func__, self);
+
+  out = nself;
+  self = NULL;
+
+end:
+  nsql_blob_destructor(env, self, NULL);
+
+  return nsql_return(env, r, out);
+}
+
+static void nsql_blob_destructor(napi_env env, void *ptr, void *hint) {
+  struct nsql_blob *self;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  nsql_dprintf("%s(%p)\n", __func__, ptr);
+
+  self = ptr;
+
+  /* sqlite3_blob_close() always closes the handle. Any error it returns is
+     the result of a previous operation on the handle, not of closing it. */
+
+  (void)sqlite3_blob_close(self->blob);
+
+  nsql_changes_release(env, self->changes);
+  free(self->table);
+  free(self);
+}
+
+static napi_value nsql_blob_close(napi_env env, napi_callback_info ctx) {
+  struct nsql_blob *self;
+  napi_value nself;
+  napi_status r;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+
+  (void)sqlite3_blob_close(self->blob);
+
+  self->db = NULL;
+  self->blob = NULL;
+
+  nsql_dprintf("%s\n", __func__);
+
+  /* Closing a handle opened outside of a transaction commits its writes */
+
+  r = nsql_changes_flush(env, self->changes);
+  nsql_changes_release(env, self->changes);
+  self->changes = NULL;
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_blob_read(napi_env env, napi_callback_info ctx) {
+  struct nsql_blob *self;
+  size_t argc;
+  napi_value argv[2];
+  napi_value out;
+  void *bytes;
+  size_t nbytes;
+  napi_status r;
+  bool ok;
+  int offset;
+  int size;
+  int n;
+  int sqlr;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = nsql_blob_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = nsql_blob_get_bytes(env, argv[0], &bytes, &nbytes, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_blob_get_offset(env, argv[1], &offset, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  /* Short reads at the end of the BLOB are not an error, unlike in SQLite's
+     own API. This makes streaming reads straightforward. */
+
+  size = sqlite3_blob_bytes(self->blob);
+  n = offset < size ? size - offset : 0;
+
+  if ((size_t)n > nbytes) {
+    n = (int)nbytes;
+  }
+
+  if (n > 0) {
+    sqlr = sqlite3_blob_read(self->blob, bytes, n, offset);
+
+    if (sqlr != SQLITE_OK) {
+      r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+      goto end;
+    }
+  }
+
+  r = napi_create_int32(env, n, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_blob_write(napi_env env, napi_callback_info ctx) {
+  struct nsql_blob *self;
+  size_t argc;
+  napi_value argv[2];
+  void *bytes;
+  size_t nbytes;
+  napi_status r;
+  bool ok;
+  int offset;
+  int size;
+  int sqlr;
+
+  argc = countof(argv);
+  r = nsql_blob_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = nsql_blob_get_bytes(env, argv[0], &bytes, &nbytes, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_blob_get_offset(env, argv[1], &offset, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  /* Incremental I/O cannot change the size of a BLOB, so writes past the end
+     are an error. */
+
+  size = sqlite3_blob_bytes(self->blob);
+
+  if (offset > size || nbytes > (size_t)(size - offset)) {
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                               "Write extends past the end of the BLOB");
+
+    goto end;
+  }
+
+  if (nbytes > 0) {
+    sqlr = sqlite3_blob_write(self->blob, bytes, (int)nbytes, offset);
+
+    if (sqlr != SQLITE_OK) {
+      r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+      goto end;
+    }
+
+    nsql_changes_blob_write(self->changes, self->table, self->rowid);
+  }
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_blob_reopen(napi_env env, napi_callback_info ctx) {
+  struct nsql_blob *self;
+  size_t argc;
+  napi_value argv[1];
+  sqlite3_int64 rowid;
+  napi_status r;
+  bool ok;
+  int sqlr;
+
+  argc = countof(argv);
+  r = nsql_blob_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = nsql_blob_get_rowid(env, argv[0], &rowid, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  sqlr = sqlite3_blob_reopen(self->blob, rowid);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+  self->rowid = rowid;
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_blob_get_size(napi_env env, napi_callback_info ctx) {
+  struct nsql_blob *self;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = nsql_blob_unwrap_open(env, ctx, NULL, NULL, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = napi_create_int32(env, sqlite3_blob_bytes(self->blob), &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_status nsql_blob_unwrap_open(napi_env env, napi_callback_info ctx,
+                                         size_t *argc, napi_value *argv,
+                                         struct nsql_blob **out) {
+  struct nsql_blob *self;
+  napi_value nself;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+  self = NULL;
+
+  r = napi_get_cb_info(env, ctx, argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+
+  if (self->blob == NULL) {
+    r = napi_throw_error(env, NULL, "BLOB handle is closed");
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    goto end;
+  }
+
+  *out = self;
+
+end:
+  return r;
+}
+
+static napi_status nsql_blob_get_name(napi_env env, napi_value value,
+                                      const char *name, char **out) {
+  char msg[64];
+  napi_valuetype type;
+  napi_status r;
+
+  *out = NULL;
+
+  r = napi_typeof(env, value, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (type != napi_string) {
+    snprintf(msg, sizeof(msg), "%s: Expected string", name);
+
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", msg);
+  }
+
+  return nsql_get_string(env, value, out, NULL);
+}
+
+static napi_status nsql_blob_get_rowid(napi_env env, napi_value value,
+                                       sqlite3_int64 *out, bool *ok) {
+  napi_valuetype type;
+  int64_t num;
+  double dnum;
+  napi_status r;
+  bool fit;
+
+  *ok = false;
+
+  r = napi_typeof(env, value, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  /* ROWIDs are returned to JavaScript as BigInts, but accept safe integer
+     Numbers too since those are what most callers will have to hand. */
+
+  switch (type) {
+  case napi_bigint:
+    r = napi_get_value_bigint_int64(env, value, &num, &fit);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    if (!fit) {
+      return napi_throw_range_error(env, "ERR_VALUE_OUT_OF_RANGE",
+                                    "rowid: Does not fit in a 64-bit int");
+    }
+
+    break;
+
+  case napi_number:
+    r = napi_get_value_double(env, value, &dnum);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    if (dnum != trunc(dnum) || fabs(dnum) > 9007199254740991.0) {
+      return napi_throw_range_error(env, "ERR_VALUE_OUT_OF_RANGE",
+                                    "rowid: Expected a safe integer");
+    }
+
+    num = (int64_t)dnum;
+
+    break;
+
+  default:
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                 "rowid: Expected bigint or number");
+  }
+
+  *out = num;
+  *ok = true;
+
+  return napi_ok;
+}
+
+static napi_status nsql_blob_get_bytes(napi_env env, napi_value value,
+                                       void **out, size_t *out_nbytes,
+                                       bool *ok) {
+  napi_typedarray_type type;
+  size_t length;
+  bool is_buffer;
+  bool is_array;
+  bool is_view;
+  napi_status r;
+
+  *out = NULL;
+  *out_nbytes = 0;
+  *ok = false;
+
+  r = napi_is_arraybuffer(env, value, &is_buffer);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (is_buffer) {
+    r = napi_get_arraybuffer_info(env, value, out, out_nbytes);
+
+    goto end;
+  }
+
+  r = napi_is_typedarray(env, value, &is_array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (is_array) {
+    r = napi_get_typedarray_info(env, value, &type, &length, out, NULL, NULL);
+
+    if (r == napi_ok) {
+      /* `length` is in elements, not bytes */
+
+      switch (type) {
+      case napi_int8_array:
+      case napi_uint8_array:
+      case napi_uint8_clamped_array:
+        *out_nbytes = length;
+        break;
+
+      case napi_int16_array:
+      case napi_uint16_array:
+        *out_nbytes = length * 2;
+        break;
+
+      case napi_int32_array:
+      case napi_uint32_array:
+      case napi_float32_array:
+        *out_nbytes = length * 4;
+        break;
+
+      default:
+        *out_nbytes = length * 8;
+        break;
+      }
+    }
+
+    goto end;
+  }
+
+  r = napi_is_dataview(env, value, &is_view);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (is_view) {
+    r = napi_get_dataview_info(env, value, out_nbytes, out, NULL, NULL);
+
+    goto end;
+  }
+
+  return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                               "buffer: Expected ArrayBuffer or view");
+
+end:
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (*out_nbytes > INT_MAX) {
+    return napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                                  "buffer: Size exceeds SQLite limits");
+  }
+
+  *ok = true;
+
+  return r;
+}
+
+static napi_status nsql_blob_get_offset(napi_env env, napi_value value,
+                                        int *out, bool *ok) {
+  napi_valuetype type;
+  napi_status r;
+  double num;
+
+  *out = 0;
+  *ok = false;
+
+  r = napi_typeof(env, value, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (type == napi_undefined) {
+    *ok = true;
+
+    return r;
+  }
+
+  if (type != napi_number) {
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                 "offset: Expected number");
+  }
+
+  r = napi_get_value_double(env, value, &num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (num != trunc(num) || num < 0 || num > INT_MAX) {
+    return napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                                  "offset: Expected a non-negative integer");
+  }
+
+  *out = (int)num;
+  *ok = true;
+
+  return r;
+}
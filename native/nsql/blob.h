@@ -0,0 +1,27 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "changes.h"
+
+/*
+ * Define and return a JavaScript constructor function that can be used to
+ * create `Blob` objects. This constructor should not be invoked directly, but
+ * should instead be retained for use with `nsql_blob_open()`.
+ */
+napi_status nsql_blob_define_class(napi_env env, napi_value *out);
+
+/*
+ * Open an incremental I/O handle on a single BLOB value and wrap it in a newly
+ * constructed JavaScript `Blob` object. `table`, `column`, `rowid` and `opts`
+ * are the JavaScript arguments supplied by the caller, which are validated
+ * here. Requires a constructor function that was previously defined by
+ * `nsql_blob_define_class()`; this should be passed in the `nclass` parameter.
+ * Writes through the handle are reported to `changes`, the connection's change
+ * feed, which a writable handle retains.
+ */
+napi_status nsql_blob_open(napi_env env, napi_value nclass, sqlite3 *db,
+                           struct nsql_changes *changes, napi_value table,
+                           napi_value column, napi_value rowid,
+                           napi_value opts, napi_value *out);
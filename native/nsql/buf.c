@@ -0,0 +1,77 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "buf.h"
+
+#define NSQL_BUF_MIN_CAPACITY 256
+
+void nsql_buf_free(struct nsql_buf *self) {
+  assert(self != NULL);
+
+  free(self->bytes);
+
+  self->bytes = NULL;
+  self->nbytes = 0;
+  self->capacity = 0;
+}
+
+uint8_t *nsql_buf_extend(struct nsql_buf *self, size_t nbytes) {
+  uint8_t *bytes;
+  size_t capacity;
+
+  assert(self != NULL);
+
+  if (nbytes > SIZE_MAX - self->nbytes) {
+    return NULL;
+  }
+
+  if (self->nbytes + nbytes > self->capacity) {
+    capacity = self->capacity > 0 ? self->capacity : NSQL_BUF_MIN_CAPACITY;
+
+    while (capacity < self->nbytes + nbytes) {
+      if (capacity > SIZE_MAX / 2) {
+        capacity = self->nbytes + nbytes;
+
+        break;
+      }
+
+      capacity *= 2;
+    }
+
+    bytes = realloc(self->bytes, capacity);
+
+    if (bytes == NULL) {
+      return NULL;
+    }
+
+    self->bytes = bytes;
+    self->capacity = capacity;
+  }
+
+  bytes = self->bytes + self->nbytes;
+  self->nbytes += nbytes;
+
+  return bytes;
+}
+
+bool nsql_buf_append(struct nsql_buf *self, const void *bytes, size_t nbytes) {
+  uint8_t *dest;
+
+  if (nbytes == 0) {
+    return true;
+  }
+
+  dest = nsql_buf_extend(self, nbytes);
+
+  if (dest == NULL) {
+    return false;
+  }
+
+  memcpy(dest, bytes, nbytes);
+
+  return true;
+}
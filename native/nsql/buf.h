@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Growable byte buffer. A zero-initialized `struct nsql_buf` is a valid empty
+ * buffer.
+ */
+struct nsql_buf {
+  uint8_t *bytes;
+  size_t nbytes;
+  size_t capacity;
+};
+
+/*
+ * Release the memory owned by a buffer and reset it to empty.
+ */
+void nsql_buf_free(struct nsql_buf *self);
+
+/*
+ * Extend a buffer by `nbytes` uninitialized bytes and return a pointer to the
+ * start of the new region. Returns NULL if memory allocation fails, in which
+ * case the buffer is unchanged. The returned pointer is only valid until the
+ * next call that grows the buffer.
+ */
+uint8_t *nsql_buf_extend(struct nsql_buf *self, size_t nbytes);
+
+/*
+ * Append a copy of `nbytes` bytes to a buffer. Returns false if memory
+ * allocation fails, in which case the buffer is unchanged.
+ */
+bool nsql_buf_append(struct nsql_buf *self, const void *bytes, size_t nbytes);
@@ -0,0 +1,878 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "cache.h"
+#include "changes.h"
+#include "error.h"
+#include "hash.h"
+#include "macros.h"
+#include "options.h"
+
+/* Default memory budget */
+
+#define NSQL_CACHE_MAX_BYTES (16 * 1024 * 1024)
+
+/* Initial number of hash buckets, which must be a power of two */
+
+#define NSQL_CACHE_MIN_BUCKETS 64
+
+/* Reads the version counters that change when another connection commits to
+   the main database, or when any connection changes the schema */
+
+static const char nsql_cache_probe_sql[] =
+    "SELECT data_version, schema_version"
+    " FROM pragma_data_version, pragma_schema_version";
+
+/* Map a root page number from EXPLAIN output to the table it belongs to,
+   indexes included, for the main and temp databases respectively */
+
+static const char *const nsql_cache_lookup_sql[] = {
+    "SELECT tbl_name FROM sqlite_master WHERE rootpage = ?",
+    "SELECT tbl_name FROM sqlite_temp_master WHERE rootpage = ?"};
+
+/* Columns of an EXPLAIN result set, see https://sqlite.org/opcode.html */
+
+enum nsql_cache_explain_column {
+  NSQL_CACHE_EXPLAIN_OPCODE = 1,
+  NSQL_CACHE_EXPLAIN_P2 = 3,
+  NSQL_CACHE_EXPLAIN_P3 = 4,
+};
+
+struct nsql_cache_field {
+  const char *name;
+  double value;
+};
+
+/* A cached result set. The key, the encoded result set and the names of the
+   tables read, each terminated by a NUL, are stored back to back in `bytes`.
+   `any_table` is set if the statement reads something that cannot be named,
+   such as a virtual table, in which case every write invalidates the entry. */
+
+struct nsql_cache_entry {
+  struct nsql_cache_entry *next;
+  struct nsql_cache_entry *newer;
+  struct nsql_cache_entry *older;
+  uint64_t hash;
+  size_t key_nbytes;
+  size_t value_nbytes;
+  size_t tables_nbytes;
+  size_t nbytes;
+  bool any_table;
+  uint8_t bytes[];
+};
+
+struct nsql_cache {
+  int refs;
+  sqlite3 *db;
+  sqlite3_stmt *probe;
+  sqlite3_stmt *lookup[2];
+  bool configured;
+  bool enabled;
+
+  /* Entries are chained into hash buckets and also linked into a list in
+     order of use, newest first */
+
+  struct nsql_cache_entry **buckets;
+  size_t nbuckets;
+  struct nsql_cache_entry *newest;
+  struct nsql_cache_entry *oldest;
+  size_t count;
+  size_t nbytes;
+  size_t max_bytes;
+
+  /* Tables written on this connection since the last lookup, as reported by
+     the change feed. Row changes the feed cannot see, such as those made to
+     WITHOUT ROWID tables, show up as a discrepancy between `writes` and the
+     connection's total change count, which invalidates everything. */
+
+  char **dirty;
+  size_t ndirty;
+  size_t dirty_capacity;
+  const char *last_dirty;
+  bool dirty_overflow;
+  unsigned int writes;
+  unsigned int total_changes;
+
+  /* Version counters as of the last lookup */
+
+  sqlite3_int64 data_version;
+  sqlite3_int64 schema_version;
+  bool versioned;
+
+  double hits;
+  double misses;
+  double evictions;
+  double invalidations;
+};
+
+static void nsql_cache_write(void *ctx, const char *table);
+
+static bool nsql_cache_sync(struct nsql_cache *self);
+
+static bool nsql_cache_probe(struct nsql_cache *self);
+
+static bool nsql_cache_reads(struct nsql_cache *self, sqlite3_stmt *stmt,
+                             struct nsql_buf *tables, bool *any_table);
+
+static bool nsql_cache_add_table(struct nsql_cache *self, int schema,
+                                 int page, struct nsql_buf *tables,
+                                 bool *any_table);
+
+static bool nsql_cache_has_table(const struct nsql_buf *tables,
+                                 const char *name);
+
+static bool nsql_cache_is_dirty(const struct nsql_cache *self,
+                                const struct nsql_cache_entry *entry);
+
+static bool nsql_cache_grow(struct nsql_cache *self);
+
+static void nsql_cache_touch(struct nsql_cache *self,
+                             struct nsql_cache_entry *entry);
+
+static void nsql_cache_remove(struct nsql_cache *self,
+                              struct nsql_cache_entry *entry);
+
+static void nsql_cache_clear(struct nsql_cache *self);
+
+static void nsql_cache_clear_dirty(struct nsql_cache *self);
+
+static void nsql_cache_finalize(struct nsql_cache *self);
+
+static napi_status nsql_cache_set(napi_env env, napi_value obj,
+                                  const char *name, double value);
+
+struct nsql_cache *nsql_cache_alloc(void) {
+  struct nsql_cache *self;
+
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->refs = 1;
+
+  return self;
+}
+
+struct nsql_cache *nsql_cache_retain(struct nsql_cache *self) {
+  if (self != NULL) {
+    self->refs++;
+  }
+
+  return self;
+}
+
+void nsql_cache_release(struct nsql_cache *self) {
+  if (self == NULL || --self->refs > 0) {
+    return;
+  }
+
+  nsql_cache_finalize(self);
+  nsql_cache_clear(self);
+  nsql_cache_clear_dirty(self);
+  free(self->buckets);
+  free(self->dirty);
+  free(self);
+}
+
+napi_status nsql_cache_configure(napi_env env, struct nsql_cache *self,
+                                 sqlite3 *db, struct nsql_changes *changes,
+                                 napi_value opts) {
+  double max_bytes;
+  napi_status r;
+  bool enabled;
+  bool ok;
+
+  assert(self != NULL);
+  assert(db != NULL);
+  assert(changes != NULL);
+
+  enabled = true;
+  r = nsql_options_get_bool(env, opts, "enabled", &enabled, &ok);
+
+  if (r != napi_ok || !ok) {
+    return r;
+  }
+
+  max_bytes = NSQL_CACHE_MAX_BYTES;
+  r = nsql_options_get_double(env, opts, "maxBytes", &max_bytes, &ok);
+
+  if (r != napi_ok || !ok) {
+    return r;
+  }
+
+  /* Reconfiguring always starts over with no entries and fresh statistics */
+
+  nsql_cache_clear(self);
+  nsql_cache_clear_dirty(self);
+
+  self->db = db;
+  self->configured = true;
+  self->enabled = enabled;
+  self->max_bytes = (size_t)max_bytes;
+  self->writes = 0;
+  self->total_changes = (unsigned int)sqlite3_total_changes(db);
+  self->versioned = false;
+  self->hits = 0;
+  self->misses = 0;
+  self->evictions = 0;
+  self->invalidations = 0;
+
+  if (enabled) {
+    nsql_changes_observe(changes, db, nsql_cache_write, self);
+  } else {
+    nsql_changes_observe(changes, db, NULL, NULL);
+    nsql_cache_finalize(self);
+  }
+
+  return napi_ok;
+}
+
+void nsql_cache_detach(struct nsql_cache *self) {
+  assert(self != NULL);
+
+  nsql_cache_finalize(self);
+  nsql_cache_clear(self);
+  nsql_cache_clear_dirty(self);
+
+  self->db = NULL;
+  self->enabled = false;
+}
+
+bool nsql_cache_enabled(const struct nsql_cache *self) {
+  return self != NULL && self->enabled;
+}
+
+bool nsql_cache_get(struct nsql_cache *self, const struct nsql_buf *key,
+                    const uint8_t **bytes, size_t *nbytes) {
+  struct nsql_cache_entry *entry;
+  uint64_t hash;
+
+  assert(key != NULL);
+  assert(bytes != NULL);
+  assert(nbytes != NULL);
+
+  if (self == NULL || !nsql_cache_sync(self)) {
+    return false;
+  }
+
+  hash = nsql_hash64(key->bytes, key->nbytes);
+  entry = NULL;
+
+  if (self->nbuckets > 0) {
+    entry = self->buckets[hash & (self->nbuckets - 1)];
+  }
+
+  for (; entry != NULL; entry = entry->next) {
+    if (entry->hash == hash && entry->key_nbytes == key->nbytes &&
+        memcmp(entry->bytes, key->bytes, key->nbytes) == 0) {
+      break;
+    }
+  }
+
+  if (entry == NULL) {
+    self->misses++;
+
+    return false;
+  }
+
+  nsql_cache_touch(self, entry);
+  self->hits++;
+  *bytes = entry->bytes + entry->key_nbytes;
+  *nbytes = entry->value_nbytes;
+
+  return true;
+}
+
+void nsql_cache_put(struct nsql_cache *self, sqlite3_stmt *stmt,
+                    const struct nsql_buf *key, const void *bytes,
+                    size_t nbytes) {
+  struct nsql_cache_entry *entry;
+  struct nsql_cache_entry **bucket;
+  struct nsql_buf tables;
+  size_t entry_nbytes;
+  bool any_table;
+
+  assert(stmt != NULL);
+  assert(key != NULL);
+
+  memset(&tables, 0, sizeof(tables));
+
+  /* The version counters were checked by the lookup that missed, before the
+     statement ran. Checking them again now could pair them with a result that
+     predates them. */
+
+  if (self == NULL || !self->enabled || self->db == NULL ||
+      !sqlite3_get_autocommit(self->db) || !sqlite3_stmt_readonly(stmt)) {
+    goto end;
+  }
+
+  if (!nsql_cache_reads(self, stmt, &tables, &any_table)) {
+    goto end;
+  }
+
+  entry_nbytes = sizeof(*entry) + key->nbytes + nbytes + tables.nbytes;
+
+  if (entry_nbytes > self->max_bytes) {
+    goto end;
+  }
+
+  if (self->count >= self->nbuckets && !nsql_cache_grow(self)) {
+    goto end;
+  }
+
+  entry = malloc(entry_nbytes);
+
+  if (entry == NULL) {
+    goto end;
+  }
+
+  entry->hash = nsql_hash64(key->bytes, key->nbytes);
+  entry->key_nbytes = key->nbytes;
+  entry->value_nbytes = nbytes;
+  entry->tables_nbytes = tables.nbytes;
+  entry->nbytes = entry_nbytes;
+  entry->any_table = any_table;
+  memcpy(entry->bytes, key->bytes, key->nbytes);
+  memcpy(entry->bytes + key->nbytes, bytes, nbytes);
+
+  if (tables.nbytes > 0) {
+    memcpy(entry->bytes + key->nbytes + nbytes, tables.bytes, tables.nbytes);
+  }
+
+  bucket = &self->buckets[entry->hash & (self->nbuckets - 1)];
+  entry->next = *bucket;
+  *bucket = entry;
+
+  entry->older = self->newest;
+  entry->newer = NULL;
+
+  if (self->newest != NULL) {
+    self->newest->newer = entry;
+  } else {
+    self->oldest = entry;
+  }
+
+  self->newest = entry;
+  self->count++;
+  self->nbytes += entry_nbytes;
+
+  while (self->nbytes > self->max_bytes) {
+    nsql_cache_remove(self, self->oldest);
+    self->evictions++;
+  }
+
+end:
+  nsql_buf_free(&tables);
+}
+
+napi_status nsql_cache_stats(napi_env env, struct nsql_cache *self,
+                             napi_value *out) {
+  const double lookups = self->hits + self->misses;
+  const struct nsql_cache_field fields[] = {
+      {"hits", self->hits},
+      {"misses", self->misses},
+      {"hitRate", lookups > 0 ? self->hits / lookups : 0},
+      {"evictions", self->evictions},
+      {"invalidations", self->invalidations},
+      {"entries", (double)self->count},
+      {"bytes", (double)self->nbytes},
+      {"maxBytes", (double)self->max_bytes}};
+  napi_value obj;
+  napi_value value;
+  napi_status r;
+  size_t i;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  if (!self->configured) {
+    r = napi_get_null(env, out);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    return r;
+  }
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_get_boolean(env, self->enabled, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, "enabled", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  for (i = 0; i < countof(fields); i++) {
+    r = nsql_cache_set(env, obj, fields[i].name, fields[i].value);
+
+    if (r != napi_ok) {
+      return r;
+    }
+  }
+
+  *out = obj;
+
+  return napi_ok;
+}
+
+static void nsql_cache_write(void *ctx, const char *table) {
+  struct nsql_cache *self;
+  char **dirty;
+  size_t capacity;
+  size_t nbytes;
+  size_t i;
+
+  self = ctx;
+  self->writes++;
+
+  /* Consecutive changes nearly always hit the same table */
+
+  if (table == self->last_dirty || self->dirty_overflow) {
+    return;
+  }
+
+  for (i = 0; i < self->ndirty; i++) {
+    if (strcmp(self->dirty[i], table) == 0) {
+      self->last_dirty = table;
+
+      return;
+    }
+  }
+
+  if (self->ndirty == self->dirty_capacity) {
+    capacity = self->dirty_capacity > 0 ? self->dirty_capacity * 2 : 8;
+    dirty = realloc(self->dirty, capacity * sizeof(*dirty));
+
+    if (dirty == NULL) {
+      self->dirty_overflow = true;
+
+      return;
+    }
+
+    self->dirty = dirty;
+    self->dirty_capacity = capacity;
+  }
+
+  nbytes = strlen(table) + 1;
+  self->dirty[self->ndirty] = malloc(nbytes);
+
+  if (self->dirty[self->ndirty] == NULL) {
+    self->dirty_overflow = true;
+
+    return;
+  }
+
+  memcpy(self->dirty[self->ndirty++], table, nbytes);
+  self->last_dirty = table;
+}
+
+static bool nsql_cache_sync(struct nsql_cache *self) {
+  struct nsql_cache_entry *entry;
+  struct nsql_cache_entry *older;
+  unsigned int total_changes;
+
+  if (!self->enabled || self->db == NULL ||
+      !sqlite3_get_autocommit(self->db)) {
+    return false;
+  }
+
+  /* Apply the writes made on this connection since the last lookup. Writes
+     that total_changes does not count, such as those through a BLOB handle,
+     make the counts disagree and so clear everything. */
+
+  total_changes = (unsigned int)sqlite3_total_changes(self->db);
+
+  if (self->dirty_overflow ||
+      total_changes - self->total_changes != self->writes) {
+    self->invalidations += self->count;
+    nsql_cache_clear(self);
+  } else if (self->ndirty > 0) {
+    for (entry = self->newest; entry != NULL; entry = older) {
+      older = entry->older;
+
+      if (nsql_cache_is_dirty(self, entry)) {
+        nsql_cache_remove(self, entry);
+        self->invalidations++;
+      }
+    }
+  }
+
+  nsql_cache_clear_dirty(self);
+  self->writes = 0;
+  self->total_changes = total_changes;
+
+  return nsql_cache_probe(self);
+}
+
+static bool nsql_cache_probe(struct nsql_cache *self) {
+  sqlite3_int64 data_version;
+  sqlite3_int64 schema_version;
+  int sqlr;
+
+  if (self->probe == NULL) {
+    sqlr = sqlite3_prepare_v2(self->db, nsql_cache_probe_sql, -1, &self->probe,
+                              NULL);
+
+    if (sqlr != SQLITE_OK) {
+      return false;
+    }
+  }
+
+  /* Failing to read the counters, perhaps because the database is locked,
+     simply bypasses the cache for this call */
+
+  sqlr = sqlite3_step(self->probe);
+
+  if (sqlr != SQLITE_ROW) {
+    (void)sqlite3_reset(self->probe);
+
+    return false;
+  }
+
+  data_version = sqlite3_column_int64(self->probe, 0);
+  schema_version = sqlite3_column_int64(self->probe, 1);
+  (void)sqlite3_reset(self->probe);
+
+  if (self->versioned && (data_version != self->data_version ||
+                          schema_version != self->schema_version)) {
+    self->invalidations += self->count;
+    nsql_cache_clear(self);
+  }
+
+  self->data_version = data_version;
+  self->schema_version = schema_version;
+  self->versioned = true;
+
+  return true;
+}
+
+static bool nsql_cache_reads(struct nsql_cache *self, sqlite3_stmt *stmt,
+                             struct nsql_buf *tables, bool *any_table) {
+  const char *opcode;
+  bool cacheable;
+  int schema;
+  int mode;
+  int sqlr;
+
+  *any_table = false;
+  cacheable = false;
+  mode = sqlite3_stmt_isexplain(stmt);
+  (void)sqlite3_reset(stmt);
+
+  /* The statement's own bytecode reveals every table it opens, including
+     those read through views, without preparing it again */
+
+  if (sqlite3_stmt_explain(stmt, 1) != SQLITE_OK) {
+    return false;
+  }
+
+  for (;;) {
+    sqlr = sqlite3_step(stmt);
+
+    if (sqlr == SQLITE_DONE) {
+      cacheable = true;
+
+      break;
+    }
+
+    if (sqlr != SQLITE_ROW) {
+      break;
+    }
+
+    opcode = (const char *)sqlite3_column_text(stmt, NSQL_CACHE_EXPLAIN_OPCODE);
+
+    if (opcode == NULL) {
+      continue;
+    }
+
+    if (strcmp(opcode, "VOpen") == 0) {
+      *any_table = true;
+
+      continue;
+    }
+
+    if (strcmp(opcode, "OpenRead") != 0 && strcmp(opcode, "ReopenIdx") != 0) {
+      continue;
+    }
+
+    /* Other connections' writes to attached databases would go unnoticed */
+
+    schema = sqlite3_column_int(stmt, NSQL_CACHE_EXPLAIN_P3);
+
+    if (schema != 0 && schema != 1) {
+      break;
+    }
+
+    if (!nsql_cache_add_table(self, schema,
+                              sqlite3_column_int(stmt, NSQL_CACHE_EXPLAIN_P2),
+                              tables, any_table)) {
+      break;
+    }
+  }
+
+  (void)sqlite3_reset(stmt);
+
+  /* Switching explain mode can only fail if the statement is busy, and we
+     just reset it. */
+
+  sqlr = sqlite3_stmt_explain(stmt, mode);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_fatal_sqlite_error(sqlr);
+  }
+
+  return cacheable;
+}
+
+static bool nsql_cache_add_table(struct nsql_cache *self, int schema,
+                                 int page, struct nsql_buf *tables,
+                                 bool *any_table) {
+  const char *name;
+  sqlite3_stmt *stmt;
+  bool ok;
+  int sqlr;
+
+  /* A root page that cannot be named, such as that of the schema table
+     itself, makes the entry depend on every write, which is safe */
+
+  if (self->lookup[schema] == NULL) {
+    sqlr = sqlite3_prepare_v2(self->db, nsql_cache_lookup_sql[schema], -1,
+                              &self->lookup[schema], NULL);
+
+    if (sqlr != SQLITE_OK) {
+      *any_table = true;
+
+      return true;
+    }
+  }
+
+  stmt = self->lookup[schema];
+  ok = true;
+  name = NULL;
+
+  if (sqlite3_bind_int(stmt, 1, page) == SQLITE_OK &&
+      sqlite3_step(stmt) == SQLITE_ROW) {
+    name = (const char *)sqlite3_column_text(stmt, 0);
+  }
+
+  if (name == NULL) {
+    *any_table = true;
+  } else if (!nsql_cache_has_table(tables, name)) {
+    ok = nsql_buf_append(tables, name, strlen(name) + 1);
+  }
+
+  (void)sqlite3_reset(stmt);
+
+  return ok;
+}
+
+static bool nsql_cache_has_table(const struct nsql_buf *tables,
+                                 const char *name) {
+  size_t pos;
+
+  for (pos = 0; pos < tables->nbytes;
+       pos += strlen((const char *)tables->bytes + pos) + 1) {
+    if (strcmp((const char *)tables->bytes + pos, name) == 0) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool nsql_cache_is_dirty(const struct nsql_cache *self,
+                                const struct nsql_cache_entry *entry) {
+  const char *tables;
+  size_t pos;
+  size_t i;
+
+  if (entry->any_table) {
+    return true;
+  }
+
+  tables = (const char *)entry->bytes + entry->key_nbytes + entry->value_nbytes;
+
+  for (pos = 0; pos < entry->tables_nbytes; pos += strlen(tables + pos) + 1) {
+    for (i = 0; i < self->ndirty; i++) {
+      if (strcmp(tables + pos, self->dirty[i]) == 0) {
+        return true;
+      }
+    }
+  }
+
+  return false;
+}
+
+static bool nsql_cache_grow(struct nsql_cache *self) {
+  struct nsql_cache_entry **buckets;
+  struct nsql_cache_entry *entry;
+  struct nsql_cache_entry *next;
+  size_t nbuckets;
+  size_t i;
+
+  nbuckets = self->nbuckets > 0 ? self->nbuckets * 2 : NSQL_CACHE_MIN_BUCKETS;
+  buckets = calloc(nbuckets, sizeof(*buckets));
+
+  if (buckets == NULL) {
+    return false;
+  }
+
+  for (i = 0; i < self->nbuckets; i++) {
+    for (entry = self->buckets[i]; entry != NULL; entry = next) {
+      next = entry->next;
+      entry->next = buckets[entry->hash & (nbuckets - 1)];
+      buckets[entry->hash & (nbuckets - 1)] = entry;
+    }
+  }
+
+  free(self->buckets);
+  self->buckets = buckets;
+  self->nbuckets = nbuckets;
+
+  return true;
+}
+
+static void nsql_cache_touch(struct nsql_cache *self,
+                             struct nsql_cache_entry *entry) {
+  if (entry == self->newest) {
+    return;
+  }
+
+  /* Unlink, then relink at the head. The entry cannot be the newest, so it
+     has a newer neighbour. */
+
+  entry->newer->older = entry->older;
+
+  if (entry->older != NULL) {
+    entry->older->newer = entry->newer;
+  } else {
+    self->oldest = entry->newer;
+  }
+
+  entry->newer = NULL;
+  entry->older = self->newest;
+  self->newest->newer = entry;
+  self->newest = entry;
+}
+
+static void nsql_cache_remove(struct nsql_cache *self,
+                              struct nsql_cache_entry *entry) {
+  struct nsql_cache_entry **link;
+
+  link = &self->buckets[entry->hash & (self->nbuckets - 1)];
+
+  while (*link != entry) {
+    link = &(*link)->next;
+  }
+
+  *link = entry->next;
+
+  if (entry->newer != NULL) {
+    entry->newer->older = entry->older;
+  } else {
+    self->newest = entry->older;
+  }
+
+  if (entry->older != NULL) {
+    entry->older->newer = entry->newer;
+  } else {
+    self->oldest = entry->newer;
+  }
+
+  self->count--;
+  self->nbytes -= entry->nbytes;
+  free(entry);
+}
+
+static void nsql_cache_clear(struct nsql_cache *self) {
+  struct nsql_cache_entry *entry;
+  struct nsql_cache_entry *older;
+
+  for (entry = self->newest; entry != NULL; entry = older) {
+    older = entry->older;
+    free(entry);
+  }
+
+  if (self->nbuckets > 0) {
+    memset(self->buckets, 0, self->nbuckets * sizeof(*self->buckets));
+  }
+
+  self->newest = NULL;
+  self->oldest = NULL;
+  self->count = 0;
+  self->nbytes = 0;
+}
+
+static void nsql_cache_clear_dirty(struct nsql_cache *self) {
+  size_t i;
+
+  for (i = 0; i < self->ndirty; i++) {
+    free(self->dirty[i]);
+  }
+
+  self->ndirty = 0;
+  self->last_dirty = NULL;
+  self->dirty_overflow = false;
+}
+
+static void nsql_cache_finalize(struct nsql_cache *self) {
+  size_t i;
+
+  (void)sqlite3_finalize(self->probe);
+  self->probe = NULL;
+
+  for (i = 0; i < 2; i++) {
+    (void)sqlite3_finalize(self->lookup[i]);
+    self->lookup[i] = NULL;
+  }
+}
+
+static napi_status nsql_cache_set(napi_env env, napi_value obj,
+                                  const char *name, double value) {
+  napi_value nvalue;
+  napi_status r;
+
+  r = napi_create_double(env, value, &nvalue);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, nvalue);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
@@ -0,0 +1,92 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "changes.h"
+
+/*
+ * Opt-in cache of encoded result sets for a connection, keyed by SQL text and
+ * bind parameters (see `nsql_bind()`). Entries are evicted in least recently
+ * used order to stay within a memory budget.
+ *
+ * Each entry remembers which tables its statement reads. Writes made on the
+ * connection itself are reported by the change feed's observer and invalidate
+ * the entries that read the affected tables. Writes made by other connections
+ * are detected through `PRAGMA data_version` and schema changes through
+ * `PRAGMA schema_version`, either of which invalidates every entry. The cache
+ * is bypassed while a transaction is open, since its results may not survive.
+ *
+ * A cache is shared between a connection's wrapper object and all of its
+ * statements, which may outlive the wrapper, and is reference counted.
+ */
+struct nsql_cache;
+
+/*
+ * Allocate a disabled cache with a reference count of one. Returns NULL if
+ * memory allocation fails.
+ */
+struct nsql_cache *nsql_cache_alloc(void);
+
+/*
+ * Increment the reference count of a cache and return it. Does nothing if
+ * `self` is NULL.
+ */
+struct nsql_cache *nsql_cache_retain(struct nsql_cache *self);
+
+/*
+ * Decrement the reference count of a cache, freeing it once it reaches zero.
+ * Does nothing if `self` is NULL.
+ */
+void nsql_cache_release(struct nsql_cache *self);
+
+/*
+ * Validate the JavaScript options object `opts`, discard all entries and
+ * statistics, and enable or disable caching for `db` accordingly. While
+ * enabled, the cache observes the writes reported by `changes`.
+ */
+napi_status nsql_cache_configure(napi_env env, struct nsql_cache *self,
+                                 sqlite3 *db, struct nsql_changes *changes,
+                                 napi_value opts);
+
+/*
+ * Disable the cache and release the statements it holds on its connection.
+ * Statistics remain available. Must be called before the connection is closed.
+ */
+void nsql_cache_detach(struct nsql_cache *self);
+
+/*
+ * Return whether the cache is enabled. Returns false if `self` is NULL.
+ */
+bool nsql_cache_enabled(const struct nsql_cache *self);
+
+/*
+ * Look up the result set stored under `key`. On a hit, `*bytes` and `*nbytes`
+ * describe the stored encoding, which remains valid until the next call on
+ * this cache, and true is returned. Returns false on a miss, or if the cache
+ * cannot currently be used.
+ */
+bool nsql_cache_get(struct nsql_cache *self, const struct nsql_buf *key,
+                    const uint8_t **bytes, size_t *nbytes);
+
+/*
+ * Store a copy of the encoded result set produced by `stmt` under `key`, which
+ * must have just missed in `nsql_cache_get()`. `stmt` is reset. Results that
+ * cannot be cached safely, or that exceed the memory budget by themselves, are
+ * silently discarded.
+ */
+void nsql_cache_put(struct nsql_cache *self, sqlite3_stmt *stmt,
+                    const struct nsql_buf *key, const void *bytes,
+                    size_t nbytes);
+
+/*
+ * Return the cache's statistics as a JavaScript object, or `null` if it has
+ * never been enabled.
+ */
+napi_status nsql_cache_stats(napi_env env, struct nsql_cache *self,
+                             napi_value *out);
@@ -0,0 +1,531 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "carray.h"
+#include "error.h"
+
+#define NSQL_CARRAY_COLUMN_VALUE 0
+#define NSQL_CARRAY_COLUMN_POINTER 1
+
+struct nsql_carray_cursor {
+  sqlite3_vtab_cursor base;
+  const struct nsql_carray *list;
+  size_t pos;
+};
+
+static napi_status nsql_carray_from_typedarray(napi_env env, napi_value value,
+                                               struct nsql_carray **out);
+
+static napi_status nsql_carray_from_array(napi_env env, napi_value value,
+                                          struct nsql_carray **out);
+
+static int nsql_carray_connect(sqlite3 *db, void *aux, int argc,
+                               const char *const *argv, sqlite3_vtab **out,
+                               char **err);
+
+static int nsql_carray_best_index(sqlite3_vtab *vtab,
+                                  sqlite3_index_info *info);
+
+static int nsql_carray_disconnect(sqlite3_vtab *vtab);
+
+static int nsql_carray_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **out);
+
+static int nsql_carray_close(sqlite3_vtab_cursor *base);
+
+static int nsql_carray_filter(sqlite3_vtab_cursor *base, int idx_num,
+                              const char *idx_str, int argc,
+                              sqlite3_value **argv);
+
+static int nsql_carray_next(sqlite3_vtab_cursor *base);
+
+static int nsql_carray_eof(sqlite3_vtab_cursor *base);
+
+static int nsql_carray_column(sqlite3_vtab_cursor *base, sqlite3_context *ctx,
+                              int col);
+
+static int nsql_carray_rowid(sqlite3_vtab_cursor *base, sqlite3_int64 *out);
+
+static const sqlite3_module nsql_carray_module = {
+    .iVersion = 0,
+    .xConnect = nsql_carray_connect,
+    .xBestIndex = nsql_carray_best_index,
+    .xDisconnect = nsql_carray_disconnect,
+    .xOpen = nsql_carray_open,
+    .xClose = nsql_carray_close,
+    .xFilter = nsql_carray_filter,
+    .xNext = nsql_carray_next,
+    .xEof = nsql_carray_eof,
+    .xColumn = nsql_carray_column,
+    .xRowid = nsql_carray_rowid,
+};
+
+struct nsql_carray *nsql_carray_alloc(enum nsql_carray_type type, size_t count,
+                                      void *values, size_t *offsets) {
+  struct nsql_carray *self;
+
+  self = malloc(sizeof(*self));
+
+  if (self == NULL) {
+    free(values);
+    free(offsets);
+
+    return NULL;
+  }
+
+  self->type = type;
+  self->count = count;
+  self->values = values;
+  self->offsets = offsets;
+
+  return self;
+}
+
+napi_status nsql_carray_from_value(napi_env env, napi_value value,
+                                   struct nsql_carray **out) {
+  bool is_typedarray;
+  bool is_array;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_is_typedarray(env, value, &is_typedarray);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (is_typedarray) {
+    return nsql_carray_from_typedarray(env, value, out);
+  }
+
+  r = napi_is_array(env, value, &is_array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (is_array) {
+    return nsql_carray_from_array(env, value, out);
+  }
+
+  return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                               "Expected a typed array or an array of strings");
+}
+
+void nsql_carray_result(sqlite3_context *ctx, const struct nsql_carray *self,
+                        size_t pos) {
+  const char *text;
+
+  assert(self != NULL);
+  assert(pos < self->count);
+
+  switch (self->type) {
+  case NSQL_CARRAY_INT32:
+    sqlite3_result_int(ctx, ((const int32_t *)self->values)[pos]);
+
+    break;
+
+  case NSQL_CARRAY_INT64:
+    sqlite3_result_int64(ctx, ((const int64_t *)self->values)[pos]);
+
+    break;
+
+  case NSQL_CARRAY_DOUBLE:
+    sqlite3_result_double(ctx, ((const double *)self->values)[pos]);
+
+    break;
+
+  case NSQL_CARRAY_TEXT:
+    text = (const char *)self->values + self->offsets[pos];
+    sqlite3_result_text(ctx, text,
+                        (int)(self->offsets[pos + 1] - self->offsets[pos]),
+                        SQLITE_STATIC);
+
+    break;
+  }
+}
+
+void nsql_carray_free(void *ptr) {
+  struct nsql_carray *self;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  self = ptr;
+  free(self->values);
+  free(self->offsets);
+  free(self);
+}
+
+int nsql_carray_register(sqlite3 *db) {
+  assert(db != NULL);
+
+  /* No xCreate method makes this an eponymous-only virtual table: it exists in
+     every schema without a CREATE VIRTUAL TABLE statement, and cannot be
+     created explicitly. */
+
+  return sqlite3_create_module(db, "carray", &nsql_carray_module, NULL);
+}
+
+static int nsql_carray_connect(sqlite3 *db, void *aux, int argc,
+                               const char *const *argv, sqlite3_vtab **out,
+                               char **err) {
+  sqlite3_vtab *vtab;
+  int sqlr;
+
+  *out = NULL;
+  sqlr = sqlite3_declare_vtab(db, "CREATE TABLE x(value, pointer HIDDEN)");
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  vtab = calloc(1, sizeof(*vtab));
+
+  if (vtab == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+  *out = vtab;
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_best_index(sqlite3_vtab *vtab,
+                                  sqlite3_index_info *info) {
+  const struct sqlite3_index_constraint *cons;
+  bool unusable;
+  int i;
+
+  unusable = false;
+
+  for (i = 0; i < info->nConstraint; i++) {
+    cons = &info->aConstraint[i];
+
+    if (cons->iColumn != NSQL_CARRAY_COLUMN_POINTER ||
+        cons->op != SQLITE_INDEX_CONSTRAINT_EQ) {
+      continue;
+    }
+
+    if (!cons->usable) {
+      unusable = true;
+
+      continue;
+    }
+
+    info->aConstraintUsage[i].argvIndex = 1;
+    info->aConstraintUsage[i].omit = 1;
+    info->idxNum = 1;
+    info->estimatedCost = 1.0;
+    info->estimatedRows = 100;
+
+    return SQLITE_OK;
+  }
+
+  /* The list argument must be available before the table can be scanned, so
+     reject any plan that would evaluate it later. */
+
+  if (unusable) {
+    return SQLITE_CONSTRAINT;
+  }
+
+  info->idxNum = 0;
+  info->estimatedCost = 1.0;
+  info->estimatedRows = 1;
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_disconnect(sqlite3_vtab *vtab) {
+  free(vtab);
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **out) {
+  struct nsql_carray_cursor *cur;
+
+  cur = calloc(1, sizeof(*cur));
+
+  if (cur == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  *out = &cur->base;
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_close(sqlite3_vtab_cursor *base) {
+  free(base);
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_filter(sqlite3_vtab_cursor *base, int idx_num,
+                              const char *idx_str, int argc,
+                              sqlite3_value **argv) {
+  struct nsql_carray_cursor *cur;
+
+  cur = (struct nsql_carray_cursor *)base;
+  cur->pos = 0;
+
+  if (idx_num == 1 && argc == 1) {
+    cur->list = sqlite3_value_pointer(argv[0], NSQL_CARRAY_POINTER_TYPE);
+  } else {
+    cur->list = NULL;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_next(sqlite3_vtab_cursor *base) {
+  struct nsql_carray_cursor *cur;
+
+  cur = (struct nsql_carray_cursor *)base;
+  cur->pos++;
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_eof(sqlite3_vtab_cursor *base) {
+  struct nsql_carray_cursor *cur;
+
+  cur = (struct nsql_carray_cursor *)base;
+
+  return cur->list == NULL || cur->pos >= cur->list->count;
+}
+
+static int nsql_carray_column(sqlite3_vtab_cursor *base, sqlite3_context *ctx,
+                              int col) {
+  const struct nsql_carray_cursor *cur;
+  const struct nsql_carray *list;
+  size_t pos;
+
+  cur = (const struct nsql_carray_cursor *)base;
+  list = cur->list;
+  pos = cur->pos;
+
+  if (col != NSQL_CARRAY_COLUMN_VALUE) {
+    sqlite3_result_null(ctx);
+
+    return SQLITE_OK;
+  }
+
+  /* The list outlives the statement's current execution: a parameter cannot
+     be rebound while the statement is running. */
+
+  nsql_carray_result(ctx, list, pos);
+
+  return SQLITE_OK;
+}
+
+static int nsql_carray_rowid(sqlite3_vtab_cursor *base, sqlite3_int64 *out) {
+  const struct nsql_carray_cursor *cur;
+
+  cur = (const struct nsql_carray_cursor *)base;
+  *out = (sqlite3_int64)cur->pos + 1;
+
+  return SQLITE_OK;
+}
+
+static napi_status nsql_carray_from_typedarray(napi_env env, napi_value value,
+                                               struct nsql_carray **out) {
+  enum nsql_carray_type type;
+  napi_typedarray_type atype;
+  size_t count;
+  size_t elsize;
+  void *data;
+  void *values;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_get_typedarray_info(env, value, &atype, &count, &data, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  switch (atype) {
+  case napi_int32_array:
+    type = NSQL_CARRAY_INT32;
+    elsize = sizeof(int32_t);
+
+    break;
+
+  case napi_bigint64_array:
+    type = NSQL_CARRAY_INT64;
+    elsize = sizeof(int64_t);
+
+    break;
+
+  case napi_float64_array:
+    type = NSQL_CARRAY_DOUBLE;
+    elsize = sizeof(double);
+
+    break;
+
+  default:
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "Typed array must be an Int32Array, "
+                              "BigInt64Array or Float64Array");
+
+    goto end;
+  }
+
+  /* The typed array's memory belongs to the JavaScript heap and could be
+     detached or reused once we return, so SQLite gets a copy. */
+
+  values = malloc(count > 0 ? count * elsize : 1);
+
+  if (values == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  if (count > 0) {
+    memcpy(values, data, count * elsize);
+  }
+
+  *out = nsql_carray_alloc(type, count, values, NULL);
+
+  if (*out == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+end:
+  return r;
+}
+
+static napi_status nsql_carray_from_array(napi_env env, napi_value value,
+                                          struct nsql_carray **out) {
+  struct nsql_buf buf;
+  size_t *offsets;
+  napi_valuetype type;
+  napi_value item;
+  uint32_t count;
+  uint32_t i;
+  size_t nbytes;
+  uint8_t *bytes;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+  memset(&buf, 0, sizeof(buf));
+  offsets = NULL;
+
+  r = napi_get_array_length(env, value, &count);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  offsets = malloc(((size_t)count + 1) * sizeof(*offsets));
+
+  if (offsets == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  offsets[0] = 0;
+
+  for (i = 0; i < count; i++) {
+    r = napi_get_element(env, value, i, &item);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_typeof(env, item, &type);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    if (type != napi_string) {
+      r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                "Array elements must all be strings");
+
+      goto end;
+    }
+
+    r = napi_get_value_string_utf8(env, item, NULL, 0, &nbytes);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    /* N-API always writes a NUL terminator, which the next string (or the
+       end of the list) then overwrites. */
+
+    bytes = nsql_buf_extend(&buf, nbytes + 1);
+
+    if (bytes == NULL) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+
+    r = napi_get_value_string_utf8(env, item, (char *)bytes, nbytes + 1,
+                                   &nbytes);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    buf.nbytes--;
+    offsets[i + 1] = buf.nbytes;
+  }
+
+  *out = nsql_carray_alloc(NSQL_CARRAY_TEXT, count, buf.bytes, offsets);
+  memset(&buf, 0, sizeof(buf));
+  offsets = NULL;
+
+  if (*out == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+end:
+  nsql_buf_free(&buf);
+  free(offsets);
+
+  return r;
+}
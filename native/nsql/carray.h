@@ -0,0 +1,70 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Pointer type tag under which lists are bound with `sqlite3_bind_pointer()`.
+ * The `carray` table-valued function only accepts pointers carrying this tag.
+ */
+#define NSQL_CARRAY_POINTER_TYPE "nsql-carray"
+
+enum nsql_carray_type {
+  NSQL_CARRAY_INT32,
+  NSQL_CARRAY_INT64,
+  NSQL_CARRAY_DOUBLE,
+  NSQL_CARRAY_TEXT,
+};
+
+/*
+ * A list of values bound to a statement parameter, for use as in
+ * `WHERE id IN carray(?)`. The list owns a copy of its values. For
+ * `NSQL_CARRAY_TEXT`, `values` holds the UTF-8 bytes of every string back to
+ * back and string `i` spans `offsets[i]` up to `offsets[i + 1]`.
+ */
+struct nsql_carray {
+  enum nsql_carray_type type;
+  size_t count;
+  void *values;
+  size_t *offsets;
+};
+
+/*
+ * Allocate a list that takes ownership of `values` and `offsets`, both of which
+ * must have been allocated with `malloc()` (`offsets` may be NULL for numeric
+ * lists). Returns NULL if memory allocation fails, in which case `values` and
+ * `offsets` are freed.
+ */
+struct nsql_carray *nsql_carray_alloc(enum nsql_carray_type type, size_t count,
+                                      void *values, size_t *offsets);
+
+/*
+ * Copy the elements of an `Int32Array`, `BigInt64Array`, `Float64Array` or
+ * array of strings into a new list. A JavaScript exception is thrown and `*out`
+ * is set to NULL if `value` is anything else.
+ */
+napi_status nsql_carray_from_value(napi_env env, napi_value value,
+                                   struct nsql_carray **out);
+
+/*
+ * Set the result of an SQL function or virtual table column to element `pos`
+ * of a list. Text is not copied, so the list must outlive the result.
+ */
+void nsql_carray_result(sqlite3_context *ctx, const struct nsql_carray *self,
+                        size_t pos);
+
+/*
+ * Free a list and the values it owns. Suitable for use as the destructor
+ * passed to `sqlite3_bind_pointer()`. Does nothing if `ptr` is NULL.
+ */
+void nsql_carray_free(void *ptr);
+
+/*
+ * Register the eponymous `carray` virtual table on a connection. `carray(?)`
+ * yields one row per element of the list bound to `?`, in a single column
+ * named `value`, and no rows if the parameter is not bound to a list.
+ */
+int nsql_carray_register(sqlite3 *db);
@@ -0,0 +1,723 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "changes.h"
+#include "error.h"
+#include "str.h"
+
+/* Operation codes as seen from JavaScript */
+
+#define NSQL_CHANGES_INSERT 0
+#define NSQL_CHANGES_UPDATE 1
+#define NSQL_CHANGES_DELETE 2
+
+/* Changes are stored column-wise so that each column can be copied straight
+   into a typed array on delivery. Tables are stored as indexes into the
+   feed's list of table names. */
+
+struct nsql_changes_log {
+  struct nsql_buf rowids;
+  struct nsql_buf tables;
+  struct nsql_buf ops;
+  size_t count;
+  bool truncated;
+};
+
+struct nsql_changes {
+  int refs;
+  sqlite3 *db;
+  napi_ref listener;
+  void (*observer)(void *ctx, const char *table);
+  void *observer_ctx;
+  struct nsql_changes_log pending;
+  struct nsql_changes_log committed;
+  char **tables;
+  size_t ntables;
+  size_t capacity;
+  const char *last_table;
+  uint32_t last_index;
+  unsigned int total_changes;
+  unsigned int writes;
+};
+
+static void nsql_changes_update(void *ctx, int op, const char *db_name,
+                                const char *table, sqlite3_int64 rowid);
+
+static int nsql_changes_commit(void *ctx);
+
+static void nsql_changes_install(struct nsql_changes *self, sqlite3 *db);
+
+static void nsql_changes_check(struct nsql_changes *self);
+
+static void nsql_changes_rollback(void *ctx);
+
+static bool nsql_changes_table_index(struct nsql_changes *self,
+                                     const char *table, uint32_t *out);
+
+static void nsql_changes_clear_tables(struct nsql_changes *self);
+
+static bool nsql_changes_log_push(struct nsql_changes_log *log, uint8_t op,
+                                  uint32_t table, int64_t rowid);
+
+static void nsql_changes_log_append(struct nsql_changes_log *dest,
+                                    struct nsql_changes_log *src);
+
+static void nsql_changes_log_clear(struct nsql_changes_log *log);
+
+static void nsql_changes_log_free(struct nsql_changes_log *log);
+
+static napi_status nsql_changes_batch(napi_env env, struct nsql_changes *self,
+                                      napi_value *out);
+
+static napi_status nsql_changes_typed_array(napi_env env,
+                                            napi_typedarray_type type,
+                                            size_t count, napi_value buffer,
+                                            size_t offset, const char *name,
+                                            napi_value obj);
+
+struct nsql_changes *nsql_changes_alloc(void) {
+  struct nsql_changes *self;
+
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->refs = 1;
+
+  return self;
+}
+
+struct nsql_changes *nsql_changes_retain(struct nsql_changes *self) {
+  if (self != NULL) {
+    self->refs++;
+  }
+
+  return self;
+}
+
+void nsql_changes_release(napi_env env, struct nsql_changes *self) {
+  napi_status r;
+
+  if (self == NULL || --self->refs > 0) {
+    return;
+  }
+
+  if (self->listener != NULL) {
+    r = napi_delete_reference(env, self->listener);
+
+    if (r != napi_ok) {
+      nsql_fatal_error(env, r);
+    }
+  }
+
+  nsql_changes_log_free(&self->pending);
+  nsql_changes_log_free(&self->committed);
+  nsql_changes_clear_tables(self);
+  free(self->tables);
+  free(self);
+}
+
+napi_status nsql_changes_listen(napi_env env, struct nsql_changes *self,
+                                sqlite3 *db, napi_value listener) {
+  napi_valuetype type;
+  napi_ref ref;
+  napi_status r;
+
+  assert(self != NULL);
+  assert(db != NULL);
+
+  r = napi_typeof(env, listener, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (type != napi_function && type != napi_null && type != napi_undefined) {
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                 "listener: Expected function or null");
+  }
+
+  ref = NULL;
+
+  if (type == napi_function) {
+    r = napi_create_reference(env, listener, 1, &ref);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+  }
+
+  if (self->listener != NULL) {
+    r = napi_delete_reference(env, self->listener);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+  }
+
+  self->listener = ref;
+
+  if (ref == NULL) {
+    nsql_changes_log_clear(&self->pending);
+    nsql_changes_log_clear(&self->committed);
+    nsql_changes_clear_tables(self);
+  }
+
+  nsql_changes_install(self, db);
+
+  return r;
+}
+
+void nsql_changes_observe(struct nsql_changes *self, sqlite3 *db,
+                          void (*fn)(void *ctx, const char *table), void *ctx) {
+  assert(self != NULL);
+  assert(db != NULL);
+
+  self->observer = fn;
+  self->observer_ctx = ctx;
+  nsql_changes_install(self, db);
+}
+
+void nsql_changes_blob_write(struct nsql_changes *self, const char *table,
+                             sqlite3_int64 rowid) {
+  uint32_t index;
+
+  if (self == NULL || self->db == NULL) {
+    return;
+  }
+
+  if (self->observer != NULL) {
+    self->observer(self->observer_ctx, table);
+  }
+
+  if (self->listener == NULL) {
+    return;
+  }
+
+  /* This write is not counted by sqlite3_total_changes() either, so it must
+     not count towards the update hook's total */
+
+  if (!nsql_changes_table_index(self, table, &index) ||
+      !nsql_changes_log_push(&self->pending, NSQL_CHANGES_UPDATE, index,
+                             rowid)) {
+    self->pending.truncated = true;
+  }
+
+  /* Unlike SQLite's own table names, ours may be freed and its address reused
+     for a different name */
+
+  self->last_table = NULL;
+}
+
+void nsql_changes_detach(struct nsql_changes *self, sqlite3 *db) {
+  assert(self != NULL);
+  assert(db != NULL);
+
+  sqlite3_update_hook(db, NULL, NULL);
+  sqlite3_commit_hook(db, NULL, NULL);
+  sqlite3_rollback_hook(db, NULL, NULL);
+
+  self->db = NULL;
+  self->observer = NULL;
+  self->observer_ctx = NULL;
+  nsql_changes_log_clear(&self->pending);
+}
+
+napi_status nsql_changes_flush(napi_env env, struct nsql_changes *self) {
+  napi_value batch;
+  napi_value listener;
+  napi_value nundefined;
+  napi_status r;
+  bool pending;
+
+  if (self == NULL) {
+    return napi_ok;
+  }
+
+  nsql_changes_check(self);
+
+  if (self->committed.count == 0 && !self->committed.truncated) {
+    return napi_ok;
+  }
+
+  r = napi_is_exception_pending(env, &pending);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (pending) {
+    return napi_ok;
+  }
+
+  batch = NULL;
+
+  if (self->listener != NULL) {
+    r = nsql_changes_batch(env, self, &batch);
+
+    if (r != napi_ok) {
+      return r;
+    }
+  }
+
+  /* Consume the batch before calling out, since the listener may well execute
+     more SQL on this connection and thereby flush again */
+
+  nsql_changes_log_clear(&self->committed);
+
+  if (self->pending.count == 0) {
+    nsql_changes_clear_tables(self);
+  }
+
+  if (batch == NULL) {
+    return napi_ok;
+  }
+
+  r = napi_get_reference_value(env, self->listener, &listener);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_get_undefined(env, &nundefined);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_call_function(env, nundefined, listener, 1, &batch, NULL);
+
+  if (r != napi_ok && r != napi_pending_exception) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
+
+static void nsql_changes_update(void *ctx, int op, const char *db_name,
+                                const char *table, sqlite3_int64 rowid) {
+  struct nsql_changes *self;
+  uint32_t index;
+  uint8_t code;
+
+  self = ctx;
+
+  if (self->observer != NULL) {
+    self->observer(self->observer_ctx, table);
+  }
+
+  if (self->listener == NULL) {
+    return;
+  }
+
+  self->writes++;
+
+  switch (op) {
+  case SQLITE_INSERT:
+    code = NSQL_CHANGES_INSERT;
+
+    break;
+
+  case SQLITE_UPDATE:
+    code = NSQL_CHANGES_UPDATE;
+
+    break;
+
+  default:
+    code = NSQL_CHANGES_DELETE;
+
+    break;
+  }
+
+  /* There is no way to fail from here, so record that the batch is incomplete
+     and let the listener decide what to do about it */
+
+  if (!nsql_changes_table_index(self, table, &index) ||
+      !nsql_changes_log_push(&self->pending, code, index, rowid)) {
+    self->pending.truncated = true;
+  }
+}
+
+static int nsql_changes_commit(void *ctx) {
+  struct nsql_changes *self;
+
+  self = ctx;
+  nsql_changes_log_append(&self->committed, &self->pending);
+
+  /* Zero allows the commit to go ahead */
+
+  return 0;
+}
+
+static void nsql_changes_install(struct nsql_changes *self, sqlite3 *db) {
+  /* SQLite only has room for one update hook per connection, which the
+     listener and the observer therefore share */
+
+  self->db = db;
+  self->total_changes = (unsigned int)sqlite3_total_changes(db);
+  self->writes = 0;
+
+  if (self->listener != NULL || self->observer != NULL) {
+    sqlite3_update_hook(db, nsql_changes_update, self);
+    sqlite3_commit_hook(db, nsql_changes_commit, self);
+    sqlite3_rollback_hook(db, nsql_changes_rollback, self);
+  } else {
+    sqlite3_update_hook(db, NULL, NULL);
+    sqlite3_commit_hook(db, NULL, NULL);
+    sqlite3_rollback_hook(db, NULL, NULL);
+  }
+}
+
+static void nsql_changes_check(struct nsql_changes *self) {
+  sqlite3_stmt *stmt;
+  unsigned int total_changes;
+
+  if (self->db == NULL || self->listener == NULL ||
+      !sqlite3_get_autocommit(self->db)) {
+    return;
+  }
+
+  /* Some row changes never reach the update hook, most notably an
+     unconditional DELETE that SQLite optimizes into a truncation, but every
+     one of them is still counted by sqlite3_total_changes(). Once no
+     transaction is open, a difference between the two means that committed
+     changes went unrecorded. */
+
+  total_changes = (unsigned int)sqlite3_total_changes(self->db);
+
+  if (total_changes - self->total_changes != self->writes) {
+    /* A statement's changes are only counted once it completes, so wait if a
+       writing statement is still part way through, e.g. one whose RETURNING
+       rows have not all been read */
+
+    for (stmt = sqlite3_next_stmt(self->db, NULL); stmt != NULL;
+         stmt = sqlite3_next_stmt(self->db, stmt)) {
+      if (sqlite3_stmt_busy(stmt) && !sqlite3_stmt_readonly(stmt)) {
+        return;
+      }
+    }
+
+    self->committed.truncated = true;
+  }
+
+  self->total_changes = total_changes;
+  self->writes = 0;
+}
+
+static void nsql_changes_rollback(void *ctx) {
+  struct nsql_changes *self;
+
+  self = ctx;
+  nsql_changes_log_clear(&self->pending);
+}
+
+static bool nsql_changes_table_index(struct nsql_changes *self,
+                                     const char *table, uint32_t *out) {
+  char **tables;
+  size_t capacity;
+  size_t nbytes;
+  size_t i;
+
+  /* Consecutive changes nearly always hit the same table, whose name SQLite
+     passes in from the same schema object every time */
+
+  if (table == self->last_table && self->last_index < self->ntables) {
+    *out = self->last_index;
+
+    return true;
+  }
+
+  for (i = 0; i < self->ntables; i++) {
+    if (strcmp(self->tables[i], table) == 0) {
+      break;
+    }
+  }
+
+  if (i == self->ntables) {
+    if (self->ntables == self->capacity) {
+      capacity = self->capacity > 0 ? self->capacity * 2 : 8;
+      tables = realloc(self->tables, capacity * sizeof(*tables));
+
+      if (tables == NULL) {
+        return false;
+      }
+
+      self->tables = tables;
+      self->capacity = capacity;
+    }
+
+    nbytes = strlen(table) + 1;
+    self->tables[i] = malloc(nbytes);
+
+    if (self->tables[i] == NULL) {
+      return false;
+    }
+
+    memcpy(self->tables[i], table, nbytes);
+    self->ntables++;
+  }
+
+  self->last_table = table;
+  self->last_index = (uint32_t)i;
+  *out = (uint32_t)i;
+
+  return true;
+}
+
+static void nsql_changes_clear_tables(struct nsql_changes *self) {
+  size_t i;
+
+  for (i = 0; i < self->ntables; i++) {
+    free(self->tables[i]);
+  }
+
+  self->ntables = 0;
+  self->last_table = NULL;
+}
+
+static bool nsql_changes_log_push(struct nsql_changes_log *log, uint8_t op,
+                                  uint32_t table, int64_t rowid) {
+  if (!nsql_buf_append(&log->rowids, &rowid, sizeof(rowid))) {
+    return false;
+  }
+
+  if (!nsql_buf_append(&log->tables, &table, sizeof(table))) {
+    log->rowids.nbytes -= sizeof(rowid);
+
+    return false;
+  }
+
+  if (!nsql_buf_append(&log->ops, &op, sizeof(op))) {
+    log->rowids.nbytes -= sizeof(rowid);
+    log->tables.nbytes -= sizeof(table);
+
+    return false;
+  }
+
+  log->count++;
+
+  return true;
+}
+
+static void nsql_changes_log_append(struct nsql_changes_log *dest,
+                                    struct nsql_changes_log *src) {
+  struct nsql_changes_log tmp;
+
+  dest->truncated |= src->truncated;
+
+  /* Usually the destination is empty and the buffers can simply be swapped */
+
+  if (dest->count == 0) {
+    tmp = *dest;
+    *dest = *src;
+    dest->truncated |= tmp.truncated;
+    *src = tmp;
+  } else if (nsql_buf_append(&dest->rowids, src->rowids.bytes,
+                             src->rowids.nbytes) &&
+             nsql_buf_append(&dest->tables, src->tables.bytes,
+                             src->tables.nbytes) &&
+             nsql_buf_append(&dest->ops, src->ops.bytes, src->ops.nbytes)) {
+    dest->count += src->count;
+  } else {
+    dest->rowids.nbytes = dest->count * sizeof(int64_t);
+    dest->tables.nbytes = dest->count * sizeof(uint32_t);
+    dest->ops.nbytes = dest->count * sizeof(uint8_t);
+    dest->truncated = true;
+  }
+
+  nsql_changes_log_clear(src);
+}
+
+static void nsql_changes_log_clear(struct nsql_changes_log *log) {
+  log->rowids.nbytes = 0;
+  log->tables.nbytes = 0;
+  log->ops.nbytes = 0;
+  log->count = 0;
+  log->truncated = false;
+}
+
+static void nsql_changes_log_free(struct nsql_changes_log *log) {
+  nsql_buf_free(&log->rowids);
+  nsql_buf_free(&log->tables);
+  nsql_buf_free(&log->ops);
+}
+
+static napi_status nsql_changes_batch(napi_env env, struct nsql_changes *self,
+                                      napi_value *out) {
+  const struct nsql_changes_log *log;
+  napi_value obj;
+  napi_value buffer;
+  napi_value tables;
+  napi_value value;
+  uint8_t *bytes;
+  size_t nrowids;
+  size_t ntables;
+  size_t i;
+  napi_status r;
+
+  *out = NULL;
+  log = &self->committed;
+  nrowids = log->count * sizeof(int64_t);
+  ntables = log->count * sizeof(uint32_t);
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  /* All three columns share one ArrayBuffer, widest elements first so that
+     every view is aligned */
+
+  r = napi_create_arraybuffer(env, nrowids + ntables + log->count,
+                              (void **)&bytes, &buffer);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (log->count > 0) {
+    memcpy(bytes, log->rowids.bytes, nrowids);
+    memcpy(bytes + nrowids, log->tables.bytes, ntables);
+    memcpy(bytes + nrowids + ntables, log->ops.bytes, log->count);
+  }
+
+  r = nsql_changes_typed_array(env, napi_bigint64_array, log->count, buffer, 0,
+                               "rowid", obj);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_changes_typed_array(env, napi_uint32_array, log->count, buffer,
+                               nrowids, "table", obj);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_changes_typed_array(env, napi_uint8_array, log->count, buffer,
+                               nrowids + ntables, "op", obj);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = napi_create_array_with_length(env, self->ntables, &tables);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  for (i = 0; i < self->ntables; i++) {
+    r = nsql_create_string(env, self->tables[i], strlen(self->tables[i]),
+                           &value);
+
+    if (r != napi_ok) {
+      return r;
+    }
+
+    r = napi_set_element(env, tables, (uint32_t)i, value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+  }
+
+  r = napi_set_named_property(env, obj, "tables", tables);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_create_double(env, (double)log->count, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, "length", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_get_boolean(env, log->truncated, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, "truncated", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  *out = obj;
+
+  return napi_ok;
+}
+
+static napi_status nsql_changes_typed_array(napi_env env,
+                                            napi_typedarray_type type,
+                                            size_t count, napi_value buffer,
+                                            size_t offset, const char *name,
+                                            napi_value obj) {
+  napi_value array;
+  napi_status r;
+
+  r = napi_create_typedarray(env, type, count, buffer, offset, &array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
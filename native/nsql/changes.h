@@ -0,0 +1,83 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Commit-time change feed for a connection. While a listener is registered,
+ * SQLite's update, commit and rollback hooks record the operation, table and
+ * rowid of every row change into native buffers. Changes made by a transaction
+ * become deliverable once it commits and are discarded if it rolls back. Row
+ * changes that SQLite makes without calling the update hook are detected by
+ * comparing the number recorded with `sqlite3_total_changes()`, and mark the
+ * batch that would have contained them as truncated.
+ *
+ * Hooks run in the middle of statement execution, where calling into
+ * JavaScript is not safe, so delivery is deferred: every entry point that
+ * executes SQL calls `nsql_changes_flush()` once it has finished, which passes
+ * everything committed so far to the listener as a single batch.
+ *
+ * A change feed is shared between a connection's wrapper object and all of its
+ * statements, which may outlive the wrapper, and is reference counted.
+ */
+struct nsql_changes;
+
+/*
+ * Allocate a change feed with no listener and a reference count of one.
+ * Returns NULL if memory allocation fails.
+ */
+struct nsql_changes *nsql_changes_alloc(void);
+
+/*
+ * Increment the reference count of a change feed and return it. Does nothing
+ * if `self` is NULL.
+ */
+struct nsql_changes *nsql_changes_retain(struct nsql_changes *self);
+
+/*
+ * Decrement the reference count of a change feed, freeing it once it reaches
+ * zero. Does nothing if `self` is NULL.
+ */
+void nsql_changes_release(napi_env env, struct nsql_changes *self);
+
+/*
+ * Register `listener` to receive batches of changes made on `db`, replacing
+ * any previous listener, or stop recording if `listener` is `null` or
+ * `undefined`. A JavaScript exception is thrown if `listener` is anything
+ * else.
+ */
+napi_status nsql_changes_listen(napi_env env, struct nsql_changes *self,
+                                sqlite3 *db, napi_value listener);
+
+/*
+ * Call `fn` with the name of the table affected by every row change made on
+ * `db`, whether or not a listener is registered, replacing any previous
+ * observer. Pass NULL to remove the observer. `fn` runs inside SQLite's update
+ * hook and must not call back into SQLite or JavaScript.
+ */
+void nsql_changes_observe(struct nsql_changes *self, sqlite3 *db,
+                          void (*fn)(void *ctx, const char *table), void *ctx);
+
+/*
+ * Record an update of row `rowid` of `table` made through incremental BLOB
+ * I/O, which SQLite does not report to the update hook, and notify the
+ * observer. Like any other change, it becomes deliverable once the transaction
+ * that made it commits. Does nothing if `self` is NULL or detached.
+ */
+void nsql_changes_blob_write(struct nsql_changes *self, const char *table,
+                             sqlite3_int64 rowid);
+
+/*
+ * Stop recording changes made on `db`, remove the observer and discard the
+ * changes of the transaction in progress, if any. Must be called before the
+ * connection is closed.
+ */
+void nsql_changes_detach(struct nsql_changes *self, sqlite3 *db);
+
+/*
+ * Pass the changes committed since the last call to the listener. Does nothing
+ * if there are none, or if a JavaScript exception is already pending, in which
+ * case they are delivered by a later call. An exception thrown by the listener
+ * propagates to the caller. Does nothing if `self` is NULL.
+ */
+napi_status nsql_changes_flush(napi_env env, struct nsql_changes *self);
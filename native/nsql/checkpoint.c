@@ -0,0 +1,715 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+#include <uv.h>
+
+#include "checkpoint.h"
+#include "clock.h"
+#include "error.h"
+#include "macros.h"
+#include "options.h"
+
+#define NSQL_CHECKPOINT_INTERVAL_MS 1000
+
+/* How long a checkpoint waits for the writer lock, and then for readers, before
+   giving up for this pass. This is kept well below the main connection's busy
+   timeout, so that a writer blocked by the checkpoint outlasts it. */
+
+#define NSQL_CHECKPOINT_BUSY_TIMEOUT_MS 100
+
+/* Busy timeout given to the main connection while a checkpoint mode that
+   blocks writers is in use, unless it already has one */
+
+#define NSQL_CHECKPOINT_WRITER_TIMEOUT_MS 5000
+
+/* Size of the WAL file header and of each frame header, see
+   https://sqlite.org/fileformat2.html#walformat */
+
+#define NSQL_WAL_HEADER_SIZE 32
+#define NSQL_WAL_FRAME_HEADER_SIZE 24
+
+struct nsql_checkpointer_counters {
+  double checkpoints;
+  double busy;
+  double errors;
+  double alarms;
+  int last_error;
+  int wal_frames;
+  int checkpointed_frames;
+  int64_t wal_bytes;
+  uint64_t last_duration;
+  uint64_t max_duration;
+  uint64_t total_duration;
+};
+
+struct nsql_checkpointer_field {
+  const char *name;
+  double value;
+};
+
+struct nsql_checkpointer {
+  sqlite3 *db;
+  sqlite3 *conn;
+  int mode;
+  int page_size;
+  int prev_autocheckpoint;
+  int prev_busy_timeout;
+  uint64_t interval_ns;
+  double wal_size_limit;
+  napi_threadsafe_function on_limit;
+  uv_thread_t thread;
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  bool sync_init;
+  bool running;
+  bool stop;
+  bool over_limit;
+  struct nsql_checkpointer_counters counters;
+};
+
+static const int nsql_checkpoint_modes[] = {
+    SQLITE_CHECKPOINT_PASSIVE, SQLITE_CHECKPOINT_FULL,
+    SQLITE_CHECKPOINT_RESTART, SQLITE_CHECKPOINT_TRUNCATE};
+
+static napi_status
+nsql_checkpointer_read_options(napi_env env, struct nsql_checkpointer *self,
+                               napi_value opts, bool *ok);
+
+static napi_status nsql_checkpointer_open(napi_env env,
+                                          struct nsql_checkpointer *self,
+                                          bool *ok);
+
+static int nsql_checkpointer_pragma(sqlite3 *db, const char *sql, int *out,
+                                    bool *out_wal);
+
+static void nsql_checkpointer_main(void *ptr);
+
+static void nsql_checkpointer_run(struct nsql_checkpointer *self);
+
+static void nsql_checkpointer_call_js(napi_env env, napi_value callback,
+                                      void *ctx, void *data);
+
+static napi_status
+nsql_checkpointer_object(napi_env env, bool running,
+                         const struct nsql_checkpointer_counters *counters,
+                         napi_value *out);
+
+static napi_status nsql_checkpointer_set(napi_env env, napi_value obj,
+                                         const char *name, double value);
+
+napi_status nsql_checkpointer_start(napi_env env, sqlite3 *db, napi_value opts,
+                                    struct nsql_checkpointer **out) {
+  struct nsql_checkpointer *self;
+  napi_status r;
+  bool ok;
+
+  assert(db != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  self->db = db;
+
+  r = nsql_checkpointer_read_options(env, self, opts, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_checkpointer_open(env, self, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  if (uv_mutex_init(&self->mutex) != 0) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  if (uv_cond_init(&self->cond) != 0) {
+    uv_mutex_destroy(&self->mutex);
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  self->sync_init = true;
+
+  if (uv_thread_create(&self->thread, nsql_checkpointer_main, self) != 0) {
+    r = napi_throw_error(env, NULL, "Failed to start checkpointer thread");
+
+    goto end;
+  }
+
+  self->running = true;
+
+  /* From here on the main connection never checkpoints on commit */
+
+  (void)sqlite3_wal_autocheckpoint(db, 0);
+
+  /* Every mode apart from PASSIVE holds the writer lock while it works, and a
+     writer without a busy handler would fail immediately instead of waiting
+     for it */
+
+  if (self->mode != SQLITE_CHECKPOINT_PASSIVE && self->prev_busy_timeout == 0) {
+    (void)sqlite3_busy_timeout(db, NSQL_CHECKPOINT_WRITER_TIMEOUT_MS);
+  }
+
+  *out = self;
+  self = NULL;
+
+end:
+  nsql_checkpointer_free(self);
+
+  return r;
+}
+
+void nsql_checkpointer_stop(struct nsql_checkpointer *self) {
+  int sqlr;
+
+  assert(self != NULL);
+
+  if (self->running) {
+    uv_mutex_lock(&self->mutex);
+    self->stop = true;
+    uv_cond_signal(&self->cond);
+    uv_mutex_unlock(&self->mutex);
+
+    if (uv_thread_join(&self->thread) != 0) {
+      abort();
+    }
+
+    (void)sqlite3_wal_autocheckpoint(self->db, self->prev_autocheckpoint);
+
+    if (self->mode != SQLITE_CHECKPOINT_PASSIVE &&
+        self->prev_busy_timeout == 0) {
+      (void)sqlite3_busy_timeout(self->db, 0);
+    }
+
+    self->running = false;
+  }
+
+  if (self->conn != NULL) {
+    sqlr = sqlite3_close_v2(self->conn);
+
+    if (sqlr != SQLITE_OK) {
+      nsql_fatal_sqlite_error(sqlr);
+    }
+
+    self->conn = NULL;
+  }
+
+  if (self->on_limit != NULL) {
+    (void)napi_release_threadsafe_function(self->on_limit, napi_tsfn_release);
+    self->on_limit = NULL;
+  }
+}
+
+void nsql_checkpointer_free(struct nsql_checkpointer *self) {
+  if (self == NULL) {
+    return;
+  }
+
+  nsql_checkpointer_stop(self);
+
+  if (self->sync_init) {
+    uv_cond_destroy(&self->cond);
+    uv_mutex_destroy(&self->mutex);
+  }
+
+  free(self);
+}
+
+napi_status nsql_checkpointer_stats(napi_env env,
+                                    struct nsql_checkpointer *self,
+                                    napi_value *out) {
+  struct nsql_checkpointer_counters counters;
+
+  assert(self != NULL);
+
+  uv_mutex_lock(&self->mutex);
+  counters = self->counters;
+  uv_mutex_unlock(&self->mutex);
+
+  return nsql_checkpointer_object(env, self->running, &counters, out);
+}
+
+static napi_status
+nsql_checkpointer_read_options(napi_env env, struct nsql_checkpointer *self,
+                               napi_value opts, bool *ok) {
+  static const char *const modes[] = {"passive", "full", "restart",
+                                      "truncate", NULL};
+  napi_value on_limit;
+  napi_value name;
+  napi_status r;
+  double interval_ms;
+  int mode;
+
+  interval_ms = NSQL_CHECKPOINT_INTERVAL_MS;
+  r = nsql_options_get_double(env, opts, "intervalMs", &interval_ms, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  if (interval_ms < 1) {
+    *ok = false;
+
+    return napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                                  "intervalMs: Expected at least 1");
+  }
+
+  mode = 0;
+  r = nsql_options_get_enum(env, opts, "mode", modes, &mode, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  r = nsql_options_get_double(env, opts, "walSizeLimit", &self->wal_size_limit,
+                              ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  r = nsql_options_get_function(env, opts, "onWalSizeLimit", &on_limit, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  /* Intervals too long for the clock to reach mean the checkpointer never
+     runs, rather than overflowing into a busy loop */
+
+  if (interval_ms * 1e6 < (double)INT64_MAX) {
+    self->interval_ns = (uint64_t)(interval_ms * 1e6);
+  } else {
+    self->interval_ns = INT64_MAX;
+  }
+
+  self->mode = nsql_checkpoint_modes[mode];
+
+  if (on_limit == NULL) {
+    return napi_ok;
+  }
+
+  *ok = false;
+
+  r = napi_create_string_utf8(env, "nsql checkpointer", NAPI_AUTO_LENGTH,
+                              &name);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_create_threadsafe_function(env, on_limit, NULL, name, 0, 1, NULL,
+                                      NULL, NULL, nsql_checkpointer_call_js,
+                                      &self->on_limit);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  /* Alarms are delivered opportunistically and must not keep Node alive */
+
+  r = napi_unref_threadsafe_function(env, self->on_limit);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  *ok = true;
+
+  return napi_ok;
+}
+
+static napi_status nsql_checkpointer_open(napi_env env,
+                                          struct nsql_checkpointer *self,
+                                          bool *ok) {
+  const char *filename;
+  sqlite3_vfs *vfs;
+  bool wal;
+  int sqlr;
+
+  *ok = false;
+
+  filename = sqlite3_db_filename(self->db, "main");
+
+  if (filename == NULL || filename[0] == '\0') {
+    return napi_throw_error(env, NULL,
+                            "Checkpointing requires a file database");
+  }
+
+  sqlr = nsql_checkpointer_pragma(self->db, "PRAGMA main.journal_mode", NULL,
+                                  &wal);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, self->db);
+  }
+
+  if (!wal) {
+    return napi_throw_error(env, NULL,
+                            "Checkpointing requires WAL journal mode");
+  }
+
+  sqlr = nsql_checkpointer_pragma(self->db, "PRAGMA main.page_size",
+                                  &self->page_size, NULL);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, self->db);
+  }
+
+  sqlr = nsql_checkpointer_pragma(self->db, "PRAGMA wal_autocheckpoint",
+                                  &self->prev_autocheckpoint, NULL);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, self->db);
+  }
+
+  sqlr = nsql_checkpointer_pragma(self->db, "PRAGMA busy_timeout",
+                                  &self->prev_busy_timeout, NULL);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, self->db);
+  }
+
+  /* The checkpoint's writes go through the same VFS as the main connection's */
+
+  vfs = NULL;
+  sqlr = sqlite3_file_control(self->db, "main", SQLITE_FCNTL_VFS_POINTER, &vfs);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, self->db);
+  }
+
+  /* This connection is only ever used by the checkpointer thread */
+
+  sqlr = sqlite3_open_v2(filename, &self->conn,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX,
+                         vfs != NULL ? vfs->zName : NULL);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, NULL);
+  }
+
+  (void)sqlite3_busy_timeout(self->conn, NSQL_CHECKPOINT_BUSY_TIMEOUT_MS);
+
+  /* A connection only notices that the file is in WAL mode once it has read
+     from it, and until then checkpoints do nothing */
+
+  sqlr = nsql_checkpointer_pragma(self->conn, "PRAGMA main.journal_mode", NULL,
+                                  &wal);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, self->conn);
+  }
+
+  *ok = true;
+
+  return napi_ok;
+}
+
+static int nsql_checkpointer_pragma(sqlite3 *db, const char *sql, int *out,
+                                    bool *out_wal) {
+  sqlite3_stmt *stmt;
+  const char *text;
+  int sqlr;
+
+  sqlr = sqlite3_prepare_v2(db, sql, -1, &stmt, NULL);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  sqlr = sqlite3_step(stmt);
+
+  if (sqlr == SQLITE_ROW) {
+    if (out != NULL) {
+      *out = sqlite3_column_int(stmt, 0);
+    }
+
+    if (out_wal != NULL) {
+      text = (const char *)sqlite3_column_text(stmt, 0);
+      *out_wal = text != NULL && strcmp(text, "wal") == 0;
+    }
+
+    sqlr = SQLITE_OK;
+  }
+
+  (void)sqlite3_finalize(stmt);
+
+  return sqlr;
+}
+
+static void nsql_checkpointer_main(void *ptr) {
+  struct nsql_checkpointer *self;
+  uint64_t deadline;
+  uint64_t now;
+
+  self = ptr;
+
+  uv_mutex_lock(&self->mutex);
+
+  for (;;) {
+    deadline = nsql_clock_ns() + self->interval_ns;
+
+    while (!self->stop && (now = nsql_clock_ns()) < deadline) {
+      (void)uv_cond_timedwait(&self->cond, &self->mutex, deadline - now);
+    }
+
+    if (self->stop) {
+      break;
+    }
+
+    uv_mutex_unlock(&self->mutex);
+    nsql_checkpointer_run(self);
+    uv_mutex_lock(&self->mutex);
+  }
+
+  uv_mutex_unlock(&self->mutex);
+}
+
+static void nsql_checkpointer_run(struct nsql_checkpointer *self) {
+  struct nsql_checkpointer_counters *counters;
+  struct nsql_checkpointer_counters *alarm;
+  uint64_t start;
+  uint64_t elapsed;
+  int nlog;
+  int nckpt;
+  int sqlr;
+
+  nlog = -1;
+  nckpt = -1;
+  alarm = NULL;
+
+  start = nsql_clock_ns();
+
+  /* Copy as much of the WAL as possible without blocking anyone first, so
+     that the stronger modes only hold the writer lock for whatever has been
+     appended since */
+
+  sqlr = sqlite3_wal_checkpoint_v2(self->conn, "main",
+                                   SQLITE_CHECKPOINT_PASSIVE, &nlog, &nckpt);
+
+  if (sqlr == SQLITE_OK && self->mode != SQLITE_CHECKPOINT_PASSIVE) {
+    sqlr = sqlite3_wal_checkpoint_v2(self->conn, "main", self->mode, &nlog,
+                                     &nckpt);
+  }
+
+  elapsed = nsql_clock_ns() - start;
+
+  uv_mutex_lock(&self->mutex);
+
+  counters = &self->counters;
+
+  if (sqlr == SQLITE_OK) {
+    counters->checkpoints++;
+  } else if ((sqlr & 0xff) == SQLITE_BUSY || (sqlr & 0xff) == SQLITE_LOCKED) {
+    counters->busy++;
+  } else {
+    counters->errors++;
+    counters->last_error = sqlr;
+  }
+
+  counters->last_duration = elapsed;
+  counters->total_duration += elapsed;
+
+  if (elapsed > counters->max_duration) {
+    counters->max_duration = elapsed;
+  }
+
+  if (nlog >= 0) {
+    counters->wal_frames = nlog;
+    counters->checkpointed_frames = nckpt;
+    counters->wal_bytes =
+        nlog > 0 ? NSQL_WAL_HEADER_SIZE +
+                       (int64_t)nlog *
+                           (self->page_size + NSQL_WAL_FRAME_HEADER_SIZE)
+                 : 0;
+  }
+
+  /* Alarm once each time the WAL crosses the limit, not on every pass */
+
+  if (self->wal_size_limit > 0) {
+    if (counters->wal_bytes <= self->wal_size_limit) {
+      self->over_limit = false;
+    } else if (!self->over_limit) {
+      self->over_limit = true;
+      counters->alarms++;
+
+      if (self->on_limit != NULL) {
+        alarm = malloc(sizeof(*alarm));
+
+        if (alarm != NULL) {
+          *alarm = *counters;
+        }
+      }
+    }
+  }
+
+  uv_mutex_unlock(&self->mutex);
+
+  if (alarm != NULL &&
+      napi_call_threadsafe_function(self->on_limit, alarm,
+                                    napi_tsfn_nonblocking) != napi_ok) {
+    free(alarm);
+  }
+}
+
+static void nsql_checkpointer_call_js(napi_env env, napi_value callback,
+                                      void *ctx, void *data) {
+  napi_value undefined;
+  napi_value stats;
+  napi_status r;
+
+  /* env is NULL if the environment is being torn down */
+
+  if (env == NULL) {
+    goto end;
+  }
+
+  r = nsql_checkpointer_object(env, true, data, &stats);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = napi_get_undefined(env, &undefined);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  (void)napi_call_function(env, undefined, callback, 1, &stats, NULL);
+
+end:
+  free(data);
+}
+
+static napi_status
+nsql_checkpointer_object(napi_env env, bool running,
+                         const struct nsql_checkpointer_counters *counters,
+                         napi_value *out) {
+  const struct nsql_checkpointer_field fields[] = {
+      {"checkpoints", counters->checkpoints},
+      {"busy", counters->busy},
+      {"errors", counters->errors},
+      {"alarms", counters->alarms},
+      {"walFrames", counters->wal_frames},
+      {"checkpointedFrames", counters->checkpointed_frames},
+      {"walBytes", (double)counters->wal_bytes},
+      {"lastDuration", (double)counters->last_duration},
+      {"maxDuration", (double)counters->max_duration},
+      {"totalDuration", (double)counters->total_duration}};
+  napi_value obj;
+  napi_value value;
+  napi_status r;
+  size_t i;
+
+  *out = NULL;
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_get_boolean(env, running, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, obj, "running", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  for (i = 0; i < countof(fields); i++) {
+    r = nsql_checkpointer_set(env, obj, fields[i].name, fields[i].value);
+
+    if (r != napi_ok) {
+      goto end;
+    }
+  }
+
+  if (counters->last_error != 0) {
+    r = napi_create_string_utf8(env, sqlite3_errstr(counters->last_error),
+                                NAPI_AUTO_LENGTH, &value);
+  } else {
+    r = napi_get_null(env, &value);
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, obj, "lastError", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  *out = obj;
+
+end:
+  return r;
+}
+
+static napi_status nsql_checkpointer_set(napi_env env, napi_value obj,
+                                         const char *name, double value) {
+  napi_value nvalue;
+  napi_status r;
+
+  r = napi_create_double(env, value, &nvalue);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, nvalue);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
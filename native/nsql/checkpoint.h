@@ -0,0 +1,42 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Background WAL checkpointer. Automatic checkpoints are disabled on the
+ * connection being served, and `sqlite3_wal_checkpoint_v2()` is instead run at
+ * a fixed interval from a dedicated thread that owns a second connection to
+ * the same database file. Commits on the main connection therefore never pay
+ * for a checkpoint's I/O.
+ */
+struct nsql_checkpointer;
+
+/*
+ * Validate the JavaScript options object `opts` and start checkpointing `db`
+ * in the background. A JavaScript exception is thrown and `*out` is set to
+ * NULL if the options are invalid or `db` is not a file database in WAL mode.
+ */
+napi_status nsql_checkpointer_start(napi_env env, sqlite3 *db, napi_value opts,
+                                    struct nsql_checkpointer **out);
+
+/*
+ * Stop the background thread, waiting for any checkpoint in progress to
+ * finish, and restore automatic checkpointing on the main connection. The
+ * statistics gathered so far remain available. Does nothing if the
+ * checkpointer has already been stopped.
+ */
+void nsql_checkpointer_stop(struct nsql_checkpointer *self);
+
+/*
+ * Stop the checkpointer if necessary and free it. Does nothing if `self` is
+ * NULL.
+ */
+void nsql_checkpointer_free(struct nsql_checkpointer *self);
+
+/*
+ * Return the checkpointer's statistics as a JavaScript object.
+ */
+napi_status nsql_checkpointer_stats(napi_env env,
+                                    struct nsql_checkpointer *self,
+                                    napi_value *out);
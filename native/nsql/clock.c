@@ -0,0 +1,37 @@
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+#include "clock.h"
+
+#ifdef _WIN32
+
+uint64_t nsql_clock_ns(void) {
+  LARGE_INTEGER freq;
+  LARGE_INTEGER count;
+
+  /* Documented to always succeed on Windows XP and later */
+
+  QueryPerformanceFrequency(&freq);
+  QueryPerformanceCounter(&count);
+
+  return (uint64_t)(count.QuadPart / freq.QuadPart) * 1000000000u +
+         (uint64_t)(count.QuadPart % freq.QuadPart) * 1000000000u /
+             (uint64_t)freq.QuadPart;
+}
+
+#else
+
+uint64_t nsql_clock_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+#endif
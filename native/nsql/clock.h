@@ -0,0 +1,9 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Read a monotonic clock with nanosecond units. The epoch is unspecified, so
+ * this is only useful for measuring intervals.
+ */
+uint64_t nsql_clock_ns(void);
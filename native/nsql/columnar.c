@@ -0,0 +1,723 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "carray.h"
+#include "columnar.h"
+#include "error.h"
+#include "hash.h"
+#include "str.h"
+
+/* Query plans, passed from xBestIndex to xFilter as the index number. Lookups
+   on column `i` use plan `NSQL_COLUMNAR_PLAN_COLUMN + i`. */
+
+#define NSQL_COLUMNAR_PLAN_SCAN 0
+#define NSQL_COLUMNAR_PLAN_ROWID 1
+#define NSQL_COLUMNAR_PLAN_COLUMN 2
+
+#define NSQL_COLUMNAR_MIN_BUCKETS 16
+
+/* Hash index over one column. Rows are chained through `next` from their
+   bucket's head, and are stored plus one so that zero ends a chain. */
+
+struct nsql_columnar_index {
+  size_t nbuckets;
+  uint32_t *heads;
+  uint32_t *next;
+};
+
+struct nsql_columnar {
+  char *schema;
+  size_t ncols;
+  size_t nrows;
+  struct nsql_carray **columns;
+  struct nsql_columnar_index *indexes;
+};
+
+struct nsql_columnar_vtab {
+  sqlite3_vtab base;
+  struct nsql_columnar *table;
+};
+
+/* Lookups collect the matching row numbers into `matches` up front, since the
+   key passed to xFilter does not outlive the call. Scans leave it empty. */
+
+struct nsql_columnar_cursor {
+  sqlite3_vtab_cursor base;
+  struct nsql_buf matches;
+  bool scan;
+  size_t i;
+  size_t pos;
+};
+
+static void nsql_columnar_free(void *ptr);
+
+static bool nsql_columnar_is_numeric(const struct nsql_carray *column);
+
+static double nsql_columnar_get_double(const struct nsql_carray *column,
+                                       size_t pos);
+
+static uint32_t nsql_columnar_hash_double(double num);
+
+static uint32_t nsql_columnar_hash_row(const struct nsql_carray *column,
+                                       size_t pos);
+
+static int nsql_columnar_build_index(struct nsql_columnar *table, size_t col);
+
+static int nsql_columnar_lookup(struct nsql_columnar *table, size_t col,
+                                sqlite3_value *key, struct nsql_buf *matches,
+                                bool *scan);
+
+static int nsql_columnar_connect(sqlite3 *db, void *aux, int argc,
+                                 const char *const *argv, sqlite3_vtab **out,
+                                 char **err);
+
+static int nsql_columnar_best_index(sqlite3_vtab *vtab,
+                                    sqlite3_index_info *info);
+
+static int nsql_columnar_disconnect(sqlite3_vtab *vtab);
+
+static int nsql_columnar_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **out);
+
+static int nsql_columnar_close(sqlite3_vtab_cursor *base);
+
+static int nsql_columnar_filter(sqlite3_vtab_cursor *base, int idx_num,
+                                const char *idx_str, int argc,
+                                sqlite3_value **argv);
+
+static int nsql_columnar_next(sqlite3_vtab_cursor *base);
+
+static int nsql_columnar_eof(sqlite3_vtab_cursor *base);
+
+static int nsql_columnar_column(sqlite3_vtab_cursor *base,
+                                sqlite3_context *ctx, int col);
+
+static int nsql_columnar_rowid(sqlite3_vtab_cursor *base, sqlite3_int64 *out);
+
+static const sqlite3_module nsql_columnar_module = {
+    .iVersion = 0,
+    .xConnect = nsql_columnar_connect,
+    .xBestIndex = nsql_columnar_best_index,
+    .xDisconnect = nsql_columnar_disconnect,
+    .xOpen = nsql_columnar_open,
+    .xClose = nsql_columnar_close,
+    .xFilter = nsql_columnar_filter,
+    .xNext = nsql_columnar_next,
+    .xEof = nsql_columnar_eof,
+    .xColumn = nsql_columnar_column,
+    .xRowid = nsql_columnar_rowid,
+};
+
+napi_status nsql_columnar_register(napi_env env, sqlite3 *db, napi_value name,
+                                   napi_value columns) {
+  struct nsql_columnar *table;
+  napi_valuetype type;
+  napi_value props;
+  napi_value key;
+  napi_value value;
+  uint32_t nprops;
+  uint32_t i;
+  char *cname;
+  char *ckey;
+  napi_status r;
+  int sqlr;
+
+  assert(db != NULL);
+
+  table = NULL;
+  cname = NULL;
+  ckey = NULL;
+
+  r = napi_typeof(env, name, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_string) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "name: Expected string");
+
+    goto end;
+  }
+
+  r = napi_typeof(env, columns, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_object) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "columns: Expected object");
+
+    goto end;
+  }
+
+  r = napi_get_property_names(env, columns, &props);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_get_array_length(env, props, &nprops);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (nprops == 0) {
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                               "columns: Expected at least one column");
+
+    goto end;
+  }
+
+  table = calloc(1, sizeof(*table));
+
+  if (table == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  table->columns = calloc(nprops, sizeof(*table->columns));
+  table->indexes = calloc(nprops, sizeof(*table->indexes));
+  table->schema = sqlite3_mprintf("CREATE TABLE x(");
+
+  if (table->columns == NULL || table->indexes == NULL ||
+      table->schema == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  for (i = 0; i < nprops; i++) {
+    r = napi_get_element(env, props, i, &key);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_get_property(env, columns, key, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = nsql_carray_from_value(env, value, &table->columns[i]);
+
+    if (r != napi_ok || table->columns[i] == NULL) {
+      goto end;
+    }
+
+    table->ncols++;
+
+    if (i == 0) {
+      table->nrows = table->columns[i]->count;
+    } else if (table->columns[i]->count != table->nrows) {
+      r = napi_throw_range_error(
+          env, "ERR_OUT_OF_RANGE",
+          "columns: Columns must all be the same length");
+
+      goto end;
+    }
+
+    r = nsql_get_string(env, key, &ckey, NULL);
+
+    if (r != napi_ok || ckey == NULL) {
+      goto end;
+    }
+
+    table->schema = sqlite3_mprintf("%z%s\"%w\"", table->schema,
+                                    i > 0 ? ", " : "", ckey);
+    free(ckey);
+    ckey = NULL;
+
+    if (table->schema == NULL) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  if (table->nrows >= UINT32_MAX) {
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                               "columns: Too many rows");
+
+    goto end;
+  }
+
+  table->schema = sqlite3_mprintf("%z)", table->schema);
+
+  if (table->schema == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  r = nsql_get_string(env, name, &cname, NULL);
+
+  if (r != napi_ok || cname == NULL) {
+    goto end;
+  }
+
+  /* The module takes ownership of the table, and frees it once the module has
+     been replaced or the connection closed and no statement still uses it. It
+     is also freed if registration fails. */
+
+  sqlr = sqlite3_create_module_v2(db, cname, &nsql_columnar_module, table,
+                                  nsql_columnar_free);
+  table = NULL;
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, db);
+
+    goto end;
+  }
+
+end:
+  nsql_columnar_free(table);
+  free(cname);
+  free(ckey);
+
+  return r;
+}
+
+static void nsql_columnar_free(void *ptr) {
+  struct nsql_columnar *self;
+  size_t i;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  self = ptr;
+
+  for (i = 0; i < self->ncols; i++) {
+    nsql_carray_free(self->columns[i]);
+    free(self->indexes[i].heads);
+    free(self->indexes[i].next);
+  }
+
+  sqlite3_free(self->schema);
+  free(self->columns);
+  free(self->indexes);
+  free(self);
+}
+
+static bool nsql_columnar_is_numeric(const struct nsql_carray *column) {
+  return column->type != NSQL_CARRAY_TEXT;
+}
+
+static double nsql_columnar_get_double(const struct nsql_carray *column,
+                                       size_t pos) {
+  switch (column->type) {
+  case NSQL_CARRAY_INT32:
+    return ((const int32_t *)column->values)[pos];
+
+  case NSQL_CARRAY_INT64:
+    return (double)((const int64_t *)column->values)[pos];
+
+  case NSQL_CARRAY_DOUBLE:
+    return ((const double *)column->values)[pos];
+
+  default:
+    assert(false);
+
+    return 0;
+  }
+}
+
+static uint32_t nsql_columnar_hash_double(double num) {
+  uint64_t bits;
+
+  /* Numeric keys are compared as doubles, so that an INTEGER key finds an
+     equal REAL value and vice versa. Make -0.0 hash the same as 0.0. */
+
+  if (num == 0) {
+    num = 0;
+  }
+
+  memcpy(&bits, &num, sizeof(bits));
+
+  bits ^= bits >> 33;
+  bits *= UINT64_C(0xff51afd7ed558ccd);
+  bits ^= bits >> 33;
+
+  return (uint32_t)bits;
+}
+
+static uint32_t nsql_columnar_hash_row(const struct nsql_carray *column,
+                                       size_t pos) {
+  const char *text;
+  size_t nbytes;
+
+  if (nsql_columnar_is_numeric(column)) {
+    return nsql_columnar_hash_double(nsql_columnar_get_double(column, pos));
+  }
+
+  text = (const char *)column->values + column->offsets[pos];
+  nbytes = column->offsets[pos + 1] - column->offsets[pos];
+
+  return nsql_hash32(text, nbytes);
+}
+
+static int nsql_columnar_build_index(struct nsql_columnar *table, size_t col) {
+  struct nsql_columnar_index *index;
+  const struct nsql_carray *column;
+  size_t nbuckets;
+  size_t bucket;
+  size_t pos;
+
+  index = &table->indexes[col];
+  column = table->columns[col];
+
+  if (index->heads != NULL) {
+    return SQLITE_OK;
+  }
+
+  nbuckets = NSQL_COLUMNAR_MIN_BUCKETS;
+
+  while (nbuckets < table->nrows * 2) {
+    nbuckets *= 2;
+  }
+
+  index->heads = calloc(nbuckets, sizeof(*index->heads));
+  index->next = malloc((table->nrows + 1) * sizeof(*index->next));
+
+  if (index->heads == NULL || index->next == NULL) {
+    free(index->heads);
+    free(index->next);
+    memset(index, 0, sizeof(*index));
+
+    return SQLITE_NOMEM;
+  }
+
+  index->nbuckets = nbuckets;
+
+  /* Insert in reverse so that each chain lists its rows in ascending order */
+
+  for (pos = table->nrows; pos-- > 0;) {
+    bucket = nsql_columnar_hash_row(column, pos) & (nbuckets - 1);
+    index->next[pos] = index->heads[bucket];
+    index->heads[bucket] = (uint32_t)pos + 1;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_lookup(struct nsql_columnar *table, size_t col,
+                                sqlite3_value *key, struct nsql_buf *matches,
+                                bool *scan) {
+  const struct nsql_columnar_index *index;
+  const struct nsql_carray *column;
+  const char *text;
+  const char *row_text;
+  size_t ntext;
+  size_t row_ntext;
+  uint32_t hash;
+  uint32_t pos;
+  double num;
+  int type;
+  int sqlr;
+
+  column = table->columns[col];
+  type = sqlite3_value_type(key);
+
+  /* Only handle keys of the column's own storage class here. Any other key
+     may still compare equal once SQLite has applied column affinities, so
+     fall back to a full scan and let SQLite test each row. */
+
+  if (nsql_columnar_is_numeric(column)) {
+    if (type != SQLITE_INTEGER && type != SQLITE_FLOAT) {
+      *scan = true;
+
+      return SQLITE_OK;
+    }
+
+    num = sqlite3_value_double(key);
+    hash = nsql_columnar_hash_double(num);
+    text = NULL;
+    ntext = 0;
+  } else {
+    if (type != SQLITE_TEXT) {
+      *scan = true;
+
+      return SQLITE_OK;
+    }
+
+    text = (const char *)sqlite3_value_text(key);
+    ntext = sqlite3_value_bytes(key);
+
+    if (text == NULL) {
+      return SQLITE_NOMEM;
+    }
+
+    hash = nsql_hash32(text, ntext);
+    num = 0;
+  }
+
+  sqlr = nsql_columnar_build_index(table, col);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  index = &table->indexes[col];
+  pos = index->heads[hash & (index->nbuckets - 1)];
+
+  for (; pos != 0; pos = index->next[pos - 1]) {
+    if (text == NULL) {
+      if (nsql_columnar_get_double(column, pos - 1) != num) {
+        continue;
+      }
+    } else {
+      row_text = (const char *)column->values + column->offsets[pos - 1];
+      row_ntext = column->offsets[pos] - column->offsets[pos - 1];
+
+      if (row_ntext != ntext || memcmp(row_text, text, ntext) != 0) {
+        continue;
+      }
+    }
+
+    if (!nsql_buf_append(matches, &pos, sizeof(pos))) {
+      return SQLITE_NOMEM;
+    }
+  }
+
+  *scan = false;
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_connect(sqlite3 *db, void *aux, int argc,
+                                 const char *const *argv, sqlite3_vtab **out,
+                                 char **err) {
+  struct nsql_columnar_vtab *vtab;
+  struct nsql_columnar *table;
+  int sqlr;
+
+  *out = NULL;
+  table = aux;
+  sqlr = sqlite3_declare_vtab(db, table->schema);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  vtab = calloc(1, sizeof(*vtab));
+
+  if (vtab == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  sqlite3_vtab_config(db, SQLITE_VTAB_INNOCUOUS);
+  vtab->table = table;
+  *out = &vtab->base;
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_best_index(sqlite3_vtab *base,
+                                    sqlite3_index_info *info) {
+  const struct sqlite3_index_constraint *cons;
+  const struct nsql_columnar_vtab *vtab;
+  const char *coll;
+  int rowid;
+  int column;
+  int i;
+
+  vtab = (const struct nsql_columnar_vtab *)base;
+  rowid = -1;
+  column = -1;
+
+  for (i = 0; i < info->nConstraint; i++) {
+    cons = &info->aConstraint[i];
+
+    if (!cons->usable || cons->op != SQLITE_INDEX_CONSTRAINT_EQ) {
+      continue;
+    }
+
+    if (cons->iColumn < 0) {
+      rowid = i;
+    } else if (column < 0) {
+      coll = sqlite3_vtab_collation(info, i);
+
+      if (coll == NULL || sqlite3_stricmp(coll, "BINARY") == 0) {
+        column = i;
+      }
+    }
+  }
+
+  /* Constraints are never omitted: a lookup whose key is of the wrong type
+     falls back to a scan, which relies on SQLite checking every row. */
+
+  if (rowid >= 0) {
+    info->aConstraintUsage[rowid].argvIndex = 1;
+    info->idxNum = NSQL_COLUMNAR_PLAN_ROWID;
+    info->idxFlags = SQLITE_INDEX_SCAN_UNIQUE;
+    info->estimatedCost = 1.0;
+    info->estimatedRows = 1;
+  } else if (column >= 0) {
+    info->aConstraintUsage[column].argvIndex = 1;
+    info->idxNum =
+        NSQL_COLUMNAR_PLAN_COLUMN + info->aConstraint[column].iColumn;
+    info->estimatedCost = 10.0;
+    info->estimatedRows = 10;
+  } else {
+    info->idxNum = NSQL_COLUMNAR_PLAN_SCAN;
+    info->estimatedCost = (double)vtab->table->nrows + 1;
+    info->estimatedRows = (sqlite3_int64)vtab->table->nrows;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_disconnect(sqlite3_vtab *vtab) {
+  free(vtab);
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_open(sqlite3_vtab *vtab, sqlite3_vtab_cursor **out) {
+  struct nsql_columnar_cursor *cur;
+
+  cur = calloc(1, sizeof(*cur));
+
+  if (cur == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  *out = &cur->base;
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_close(sqlite3_vtab_cursor *base) {
+  struct nsql_columnar_cursor *cur;
+
+  cur = (struct nsql_columnar_cursor *)base;
+  nsql_buf_free(&cur->matches);
+  free(cur);
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_filter(sqlite3_vtab_cursor *base, int idx_num,
+                                const char *idx_str, int argc,
+                                sqlite3_value **argv) {
+  struct nsql_columnar_cursor *cur;
+  struct nsql_columnar *table;
+  sqlite3_int64 rowid;
+  uint32_t pos;
+  int sqlr;
+
+  cur = (struct nsql_columnar_cursor *)base;
+  table = ((struct nsql_columnar_vtab *)base->pVtab)->table;
+  cur->matches.nbytes = 0;
+  cur->scan = true;
+  cur->i = 0;
+  sqlr = SQLITE_OK;
+
+  if (idx_num == NSQL_COLUMNAR_PLAN_ROWID && argc == 1) {
+    if (sqlite3_value_type(argv[0]) == SQLITE_INTEGER) {
+      cur->scan = false;
+      rowid = sqlite3_value_int64(argv[0]);
+
+      if (rowid >= 1 && (sqlite3_uint64)rowid <= table->nrows) {
+        pos = (uint32_t)rowid;
+
+        if (!nsql_buf_append(&cur->matches, &pos, sizeof(pos))) {
+          sqlr = SQLITE_NOMEM;
+        }
+      }
+    }
+  } else if (idx_num >= NSQL_COLUMNAR_PLAN_COLUMN && argc == 1) {
+    sqlr = nsql_columnar_lookup(table, idx_num - NSQL_COLUMNAR_PLAN_COLUMN,
+                                argv[0], &cur->matches, &cur->scan);
+  }
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  if (!nsql_columnar_eof(base)) {
+    cur->pos = cur->scan ? 0 : ((uint32_t *)cur->matches.bytes)[0] - 1;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_next(sqlite3_vtab_cursor *base) {
+  struct nsql_columnar_cursor *cur;
+  const uint32_t *matches;
+
+  cur = (struct nsql_columnar_cursor *)base;
+  matches = (const uint32_t *)cur->matches.bytes;
+  cur->i++;
+
+  if (!nsql_columnar_eof(base)) {
+    cur->pos = cur->scan ? cur->i : matches[cur->i] - 1;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_eof(sqlite3_vtab_cursor *base) {
+  const struct nsql_columnar_cursor *cur;
+  const struct nsql_columnar *table;
+
+  cur = (const struct nsql_columnar_cursor *)base;
+  table = ((const struct nsql_columnar_vtab *)base->pVtab)->table;
+
+  if (cur->scan) {
+    return cur->i >= table->nrows;
+  } else {
+    return cur->i >= cur->matches.nbytes / sizeof(uint32_t);
+  }
+}
+
+static int nsql_columnar_column(sqlite3_vtab_cursor *base,
+                                sqlite3_context *ctx, int col) {
+  const struct nsql_columnar_cursor *cur;
+  const struct nsql_columnar *table;
+
+  cur = (const struct nsql_columnar_cursor *)base;
+  table = ((const struct nsql_columnar_vtab *)base->pVtab)->table;
+
+  /* The table, and hence its text, lives at least as long as any statement
+     that reads from it. */
+
+  nsql_carray_result(ctx, table->columns[col], cur->pos);
+
+  return SQLITE_OK;
+}
+
+static int nsql_columnar_rowid(sqlite3_vtab_cursor *base, sqlite3_int64 *out) {
+  const struct nsql_columnar_cursor *cur;
+
+  cur = (const struct nsql_columnar_cursor *)base;
+  *out = (sqlite3_int64)cur->pos + 1;
+
+  return SQLITE_OK;
+}
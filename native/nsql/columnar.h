@@ -0,0 +1,21 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Register an eponymous, read-only virtual table called `name` on `db` whose
+ * columns are the properties of the JavaScript object `columns`. Each property
+ * must be a typed array or array of strings accepted by
+ * `nsql_carray_from_value()`, and all of them must have the same length.
+ *
+ * The column data is copied once, at registration, into native memory that the
+ * table then reads from directly. Equality constraints on `rowid` are resolved
+ * by position, and on other columns through a hash index that is built the
+ * first time a query asks for it. Registering a table under an existing name
+ * replaces it.
+ *
+ * A JavaScript exception is thrown if the arguments are invalid.
+ */
+napi_status nsql_columnar_register(napi_env env, sqlite3 *db, napi_value name,
+                                   napi_value columns);
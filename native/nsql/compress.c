@@ -0,0 +1,877 @@
+#if defined(__linux__)
+#define _GNU_SOURCE /* fallocate() */
+#endif
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sqlite3.h>
+
+#if defined(__linux__)
+#include <errno.h>
+#include <fcntl.h>
+#endif
+
+#include "compress.h"
+#include "lz4.h"
+#include "unixfile.h"
+
+/* Size of the header block, to which slots are also aligned so that the hole
+   at the end of each one is made of whole filesystem blocks */
+
+#define NSQL_COMPRESS_BLOCK_NBYTES 4096
+
+/* The header block begins with a magic string, followed by the format version
+   and page size as big-endian 32-bit integers */
+
+#define NSQL_COMPRESS_MAGIC "nsql-compress\0\0\0"
+#define NSQL_COMPRESS_MAGIC_NBYTES 16
+#define NSQL_COMPRESS_VERSION 1
+
+/* Each slot begins with a marker byte, the kind of record that follows and its
+   length as a big-endian 32-bit integer. A slot that begins with zeros has
+   never been written and holds a page of zeros. */
+
+#define NSQL_COMPRESS_RECORD_MARKER 'z'
+#define NSQL_COMPRESS_RECORD_NBYTES 8
+
+enum nsql_compress_kind {
+  NSQL_COMPRESS_KIND_RAW = 1,
+  NSQL_COMPRESS_KIND_LZ4 = 2,
+};
+
+/* The default VFS's own file object follows this structure in memory. The page
+   size is zero until the header has been read or written. */
+
+struct nsql_compress_file {
+  sqlite3_file base;
+  sqlite3_file *real;
+  int fd;
+  unsigned page_nbytes;
+  size_t slot_nbytes;
+  uint8_t *slot;
+  uint8_t *page;
+
+  /* Hints: the number of bytes stored for each page, zero if unknown, and the
+     size of the underlying file as last seen */
+
+  uint32_t *stored;
+  size_t nstored;
+  sqlite3_int64 end;
+};
+
+static sqlite3_vfs *nsql_compress_base;
+static sqlite3_vfs nsql_compress_vfs;
+
+static int nsql_compress_open(sqlite3_vfs *vfs, sqlite3_filename name,
+                              sqlite3_file *file, int flags, int *out_flags);
+
+static int nsql_compress_close(sqlite3_file *file);
+
+static int nsql_compress_read(sqlite3_file *file, void *buf, int amt,
+                              sqlite3_int64 off);
+
+static int nsql_compress_write(sqlite3_file *file, const void *buf, int amt,
+                               sqlite3_int64 off);
+
+static int nsql_compress_truncate(sqlite3_file *file, sqlite3_int64 size);
+
+static int nsql_compress_sync(sqlite3_file *file, int flags);
+
+static int nsql_compress_file_size(sqlite3_file *file, sqlite3_int64 *out);
+
+static int nsql_compress_lock(sqlite3_file *file, int lock);
+
+static int nsql_compress_unlock(sqlite3_file *file, int lock);
+
+static int nsql_compress_check_reserved_lock(sqlite3_file *file, int *out);
+
+static int nsql_compress_file_control(sqlite3_file *file, int op, void *arg);
+
+static int nsql_compress_sector_size(sqlite3_file *file);
+
+static int nsql_compress_device_characteristics(sqlite3_file *file);
+
+static int nsql_compress_shm_map(sqlite3_file *file, int region, int nbytes,
+                                 int extend, void volatile **out);
+
+static int nsql_compress_shm_lock(sqlite3_file *file, int offset, int n,
+                                  int flags);
+
+static void nsql_compress_shm_barrier(sqlite3_file *file);
+
+static int nsql_compress_shm_unmap(sqlite3_file *file, int delete_flag);
+
+static int nsql_compress_fetch(sqlite3_file *file, sqlite3_int64 off, int amt,
+                               void **out);
+
+static int nsql_compress_unfetch(sqlite3_file *file, sqlite3_int64 off,
+                                 void *ptr);
+
+static int nsql_compress_ready(struct nsql_compress_file *self);
+
+static int nsql_compress_set_page_size(struct nsql_compress_file *self,
+                                       unsigned page_nbytes);
+
+static int nsql_compress_load(struct nsql_compress_file *self,
+                              sqlite3_int64 pgno, uint8_t *out);
+
+static int nsql_compress_store(struct nsql_compress_file *self,
+                               sqlite3_int64 pgno, const uint8_t *src);
+
+static void nsql_compress_punch(struct nsql_compress_file *self,
+                                sqlite3_int64 pgno, size_t nbytes);
+
+static sqlite3_int64 nsql_compress_slot_offset(
+    const struct nsql_compress_file *self, sqlite3_int64 pgno);
+
+static uint32_t nsql_compress_hint(const struct nsql_compress_file *self,
+                                   sqlite3_int64 pgno);
+
+static void nsql_compress_set_hint(struct nsql_compress_file *self,
+                                   sqlite3_int64 pgno, uint32_t nbytes);
+
+static bool nsql_compress_valid_page_size(sqlite3_int64 nbytes);
+
+static uint32_t nsql_compress_get32(const uint8_t *p);
+
+static void nsql_compress_put32(uint8_t *p, uint32_t value);
+
+static size_t nsql_compress_round(size_t nbytes);
+
+static const sqlite3_io_methods nsql_compress_methods = {
+    .iVersion = 3,
+    .xClose = nsql_compress_close,
+    .xRead = nsql_compress_read,
+    .xWrite = nsql_compress_write,
+    .xTruncate = nsql_compress_truncate,
+    .xSync = nsql_compress_sync,
+    .xFileSize = nsql_compress_file_size,
+    .xLock = nsql_compress_lock,
+    .xUnlock = nsql_compress_unlock,
+    .xCheckReservedLock = nsql_compress_check_reserved_lock,
+    .xFileControl = nsql_compress_file_control,
+    .xSectorSize = nsql_compress_sector_size,
+    .xDeviceCharacteristics = nsql_compress_device_characteristics,
+    .xShmMap = nsql_compress_shm_map,
+    .xShmLock = nsql_compress_shm_lock,
+    .xShmBarrier = nsql_compress_shm_barrier,
+    .xShmUnmap = nsql_compress_shm_unmap,
+    .xFetch = nsql_compress_fetch,
+    .xUnfetch = nsql_compress_unfetch};
+
+int nsql_compress_register(void) {
+  sqlite3_mutex *mutex;
+  sqlite3_vfs *base;
+  int sqlr;
+
+  sqlr = sqlite3_initialize();
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  /* As with the io_uring VFS, this is a copy of the default VFS with a
+     different `xOpen()` */
+
+  mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP1);
+  sqlite3_mutex_enter(mutex);
+
+  if (sqlite3_vfs_find(NSQL_COMPRESS_VFS) != NULL) {
+    goto end;
+  }
+
+  base = sqlite3_vfs_find(NULL);
+
+  if (base == NULL) {
+    sqlr = SQLITE_ERROR;
+
+    goto end;
+  }
+
+  nsql_compress_base = base;
+  nsql_compress_vfs = *base;
+  nsql_compress_vfs.pNext = NULL;
+  nsql_compress_vfs.zName = NSQL_COMPRESS_VFS;
+  nsql_compress_vfs.szOsFile =
+      sizeof(struct nsql_compress_file) + base->szOsFile;
+  nsql_compress_vfs.xOpen = nsql_compress_open;
+
+  sqlr = sqlite3_vfs_register(&nsql_compress_vfs, 0);
+
+end:
+  sqlite3_mutex_leave(mutex);
+
+  return sqlr;
+}
+
+static int nsql_compress_open(sqlite3_vfs *vfs, sqlite3_filename name,
+                              sqlite3_file *file, int flags, int *out_flags) {
+  struct nsql_compress_file *self;
+  sqlite3_vfs *base;
+  int sqlr;
+
+  base = nsql_compress_base;
+
+  if (name == NULL || (flags & SQLITE_OPEN_MAIN_DB) == 0) {
+    return base->xOpen(base, name, file, flags, out_flags);
+  }
+
+  self = (struct nsql_compress_file *)file;
+  memset(self, 0, sizeof(*self));
+  self->real = (sqlite3_file *)(self + 1);
+
+  sqlr = base->xOpen(base, name, self->real, flags, out_flags);
+
+  if (sqlr != SQLITE_OK) {
+    file->pMethods = NULL;
+
+    return sqlr;
+  }
+
+  file->pMethods = &nsql_compress_methods;
+  self->fd = nsql_unixfile_fd(self->real, name);
+
+  /* Refuse to open files that are not compressed databases, rather than fail
+     on the first read */
+
+  sqlr = nsql_compress_ready(self);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_compress_close(file);
+    file->pMethods = NULL;
+  }
+
+  return sqlr;
+}
+
+static int nsql_compress_close(sqlite3_file *file) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+  free(self->slot);
+  free(self->page);
+  free(self->stored);
+
+  return self->real->pMethods->xClose(self->real);
+}
+
+static int nsql_compress_read(sqlite3_file *file, void *buf, int amt,
+                              sqlite3_int64 off) {
+  struct nsql_compress_file *self;
+  sqlite3_int64 pgno;
+  uint8_t *dst;
+  size_t page_off;
+  size_t n;
+  bool whole;
+  int sqlr;
+
+  self = (struct nsql_compress_file *)file;
+  dst = buf;
+  sqlr = nsql_compress_ready(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  if (self->page_nbytes == 0) {
+    memset(buf, 0, amt);
+
+    return SQLITE_IOERR_SHORT_READ;
+  }
+
+  /* Reads are nearly always of whole pages, but the database header is also
+     read on its own */
+
+  while (amt > 0) {
+    pgno = off / self->page_nbytes;
+    page_off = off % self->page_nbytes;
+    n = self->page_nbytes - page_off;
+    n = n < (size_t)amt ? n : (size_t)amt;
+    whole = n == self->page_nbytes;
+
+    sqlr = nsql_compress_load(self, pgno, whole ? dst : self->page);
+
+    if (sqlr == SQLITE_IOERR_SHORT_READ) {
+      memset(dst, 0, amt);
+    }
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+
+    if (!whole) {
+      memcpy(dst, self->page + page_off, n);
+    }
+
+    dst += n;
+    off += n;
+    amt -= (int)n;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_compress_write(sqlite3_file *file, const void *buf, int amt,
+                               sqlite3_int64 off) {
+  struct nsql_compress_file *self;
+  uint8_t header[NSQL_COMPRESS_BLOCK_NBYTES];
+  sqlite3_int64 pgno;
+  size_t page_off;
+  int sqlr;
+
+  self = (struct nsql_compress_file *)file;
+  sqlr = nsql_compress_ready(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  /* The first page written to a new database establishes its page size */
+
+  if (self->page_nbytes == 0) {
+    if (off != 0 || !nsql_compress_valid_page_size(amt)) {
+      return SQLITE_IOERR_WRITE;
+    }
+
+    sqlr = nsql_compress_set_page_size(self, amt);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, NSQL_COMPRESS_MAGIC, NSQL_COMPRESS_MAGIC_NBYTES);
+    nsql_compress_put32(header + 16, NSQL_COMPRESS_VERSION);
+    nsql_compress_put32(header + 20, amt);
+
+    sqlr = self->real->pMethods->xWrite(self->real, header, sizeof(header), 0);
+
+    if (sqlr != SQLITE_OK) {
+      self->page_nbytes = 0;
+
+      return sqlr;
+    }
+  }
+
+  pgno = off / self->page_nbytes;
+  page_off = off % self->page_nbytes;
+
+  if (page_off == 0 && (size_t)amt == self->page_nbytes) {
+    return nsql_compress_store(self, pgno, buf);
+  }
+
+  /* SQLite never writes partial pages to a database file, and a page size that
+     differs from the file's cannot be accommodated */
+
+  if (page_off + amt > self->page_nbytes) {
+    return SQLITE_IOERR_WRITE;
+  }
+
+  sqlr = nsql_compress_load(self, pgno, self->page);
+
+  if (sqlr == SQLITE_IOERR_SHORT_READ) {
+    memset(self->page, 0, self->page_nbytes);
+  } else if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  memcpy(self->page + page_off, buf, amt);
+
+  return nsql_compress_store(self, pgno, self->page);
+}
+
+static int nsql_compress_truncate(sqlite3_file *file, sqlite3_int64 size) {
+  struct nsql_compress_file *self;
+  sqlite3_int64 npages;
+  sqlite3_int64 end;
+  int sqlr;
+
+  self = (struct nsql_compress_file *)file;
+  sqlr = nsql_compress_ready(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  if (self->page_nbytes == 0) {
+    return size == 0 ? SQLITE_OK : SQLITE_IOERR_TRUNCATE;
+  }
+
+  /* The header block stays, and with it the page size */
+
+  npages = (size + self->page_nbytes - 1) / self->page_nbytes;
+  end = nsql_compress_slot_offset(self, npages);
+  sqlr = self->real->pMethods->xTruncate(self->real, end);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  if ((size_t)npages < self->nstored) {
+    self->nstored = npages;
+  }
+
+  self->end = end;
+
+  return SQLITE_OK;
+}
+
+static int nsql_compress_sync(sqlite3_file *file, int flags) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xSync(self->real, flags);
+}
+
+static int nsql_compress_file_size(sqlite3_file *file, sqlite3_int64 *out) {
+  struct nsql_compress_file *self;
+  sqlite3_int64 size;
+  int sqlr;
+
+  self = (struct nsql_compress_file *)file;
+  *out = 0;
+  sqlr = nsql_compress_ready(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  sqlr = self->real->pMethods->xFileSize(self->real, &size);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  /* The last slot ends where its record does */
+
+  self->end = size;
+
+  if (self->page_nbytes != 0 && size > NSQL_COMPRESS_BLOCK_NBYTES) {
+    size -= NSQL_COMPRESS_BLOCK_NBYTES;
+    *out = (size + self->slot_nbytes - 1) / self->slot_nbytes *
+           self->page_nbytes;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_compress_lock(sqlite3_file *file, int lock) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xLock(self->real, lock);
+}
+
+static int nsql_compress_unlock(sqlite3_file *file, int lock) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xUnlock(self->real, lock);
+}
+
+static int nsql_compress_check_reserved_lock(sqlite3_file *file, int *out) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xCheckReservedLock(self->real, out);
+}
+
+static int nsql_compress_file_control(sqlite3_file *file, int op, void *arg) {
+  struct nsql_compress_file *self;
+  long page_nbytes;
+  char **pragma;
+
+  self = (struct nsql_compress_file *)file;
+
+  switch (op) {
+  case SQLITE_FCNTL_PRAGMA:
+    pragma = arg;
+
+    /* SQLite ignores invalid page sizes, so only valid ones are refused */
+
+    if (sqlite3_stricmp(pragma[1], "page_size") != 0 || pragma[2] == NULL ||
+        self->page_nbytes == 0) {
+      break;
+    }
+
+    page_nbytes = strtol(pragma[2], NULL, 10);
+
+    if (nsql_compress_valid_page_size(page_nbytes) &&
+        page_nbytes != (long)self->page_nbytes) {
+      pragma[0] = sqlite3_mprintf(
+          "The page size of a compressed database cannot be changed");
+
+      return SQLITE_ERROR;
+    }
+
+    break;
+
+  /* Both of these would make the default VFS allocate space in the holes, and
+     the latter also rounds up the size of the file when truncating it */
+
+  case SQLITE_FCNTL_SIZE_HINT:
+  case SQLITE_FCNTL_CHUNK_SIZE:
+    return SQLITE_OK;
+  }
+
+  return self->real->pMethods->xFileControl(self->real, op, arg);
+}
+
+static int nsql_compress_sector_size(sqlite3_file *file) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xSectorSize(self->real);
+}
+
+static int nsql_compress_device_characteristics(sqlite3_file *file) {
+  struct nsql_compress_file *self;
+
+  /* A page write is a single write of its record, but that is all */
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xDeviceCharacteristics(self->real) &
+         ~SQLITE_IOCAP_BATCH_ATOMIC;
+}
+
+static int nsql_compress_shm_map(sqlite3_file *file, int region, int nbytes,
+                                 int extend, void volatile **out) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xShmMap(self->real, region, nbytes, extend,
+                                       out);
+}
+
+static int nsql_compress_shm_lock(sqlite3_file *file, int offset, int n,
+                                  int flags) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xShmLock(self->real, offset, n, flags);
+}
+
+static void nsql_compress_shm_barrier(sqlite3_file *file) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+  self->real->pMethods->xShmBarrier(self->real);
+}
+
+static int nsql_compress_shm_unmap(sqlite3_file *file, int delete_flag) {
+  struct nsql_compress_file *self;
+
+  self = (struct nsql_compress_file *)file;
+
+  return self->real->pMethods->xShmUnmap(self->real, delete_flag);
+}
+
+static int nsql_compress_fetch(sqlite3_file *file, sqlite3_int64 off, int amt,
+                               void **out) {
+  /* Memory-mapped pages would be compressed, so SQLite must read them */
+
+  *out = NULL;
+
+  return SQLITE_OK;
+}
+
+static int nsql_compress_unfetch(sqlite3_file *file, sqlite3_int64 off,
+                                 void *ptr) {
+  return SQLITE_OK;
+}
+
+static int nsql_compress_ready(struct nsql_compress_file *self) {
+  uint8_t header[24];
+  sqlite3_int64 size;
+  uint32_t page_nbytes;
+  int sqlr;
+
+  /* Another connection may have created the database since this file was
+     opened, so look for a header until one is found */
+
+  if (self->page_nbytes != 0) {
+    return SQLITE_OK;
+  }
+
+  sqlr = self->real->pMethods->xFileSize(self->real, &size);
+
+  if (sqlr != SQLITE_OK || size == 0) {
+    return sqlr;
+  }
+
+  sqlr = self->real->pMethods->xRead(self->real, header, sizeof(header), 0);
+
+  if (sqlr == SQLITE_IOERR_SHORT_READ) {
+    return SQLITE_NOTADB;
+  }
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  page_nbytes = nsql_compress_get32(header + 20);
+
+  if (memcmp(header, NSQL_COMPRESS_MAGIC, NSQL_COMPRESS_MAGIC_NBYTES) != 0 ||
+      nsql_compress_get32(header + 16) != NSQL_COMPRESS_VERSION ||
+      !nsql_compress_valid_page_size(page_nbytes)) {
+    return SQLITE_NOTADB;
+  }
+
+  self->end = size;
+
+  return nsql_compress_set_page_size(self, page_nbytes);
+}
+
+static int nsql_compress_set_page_size(struct nsql_compress_file *self,
+                                       unsigned page_nbytes) {
+  size_t slot_nbytes;
+
+  slot_nbytes = nsql_compress_round(NSQL_COMPRESS_RECORD_NBYTES + page_nbytes);
+  self->slot = malloc(slot_nbytes);
+  self->page = malloc(page_nbytes);
+
+  if (self->slot == NULL || self->page == NULL) {
+    free(self->slot);
+    self->slot = NULL;
+    free(self->page);
+    self->page = NULL;
+
+    return SQLITE_NOMEM;
+  }
+
+  self->page_nbytes = page_nbytes;
+  self->slot_nbytes = slot_nbytes;
+
+  return SQLITE_OK;
+}
+
+static int nsql_compress_load(struct nsql_compress_file *self,
+                              sqlite3_int64 pgno, uint8_t *out) {
+  sqlite3_int64 off;
+  ptrdiff_t n;
+  size_t want;
+  uint32_t stored;
+  uint8_t kind;
+  bool short_read;
+  int sqlr;
+
+  /* Read as much of the slot as the page occupied last time, if known, and
+     otherwise all of it, since holes cost nothing to read */
+
+  off = nsql_compress_slot_offset(self, pgno);
+  want = nsql_compress_round(nsql_compress_hint(self, pgno));
+
+  if (want == 0 || want > self->slot_nbytes) {
+    want = self->slot_nbytes;
+  }
+
+  sqlr = self->real->pMethods->xRead(self->real, self->slot, (int)want, off);
+  short_read = sqlr == SQLITE_IOERR_SHORT_READ;
+
+  if (sqlr != SQLITE_OK && !short_read) {
+    return sqlr;
+  }
+
+  kind = self->slot[1];
+  stored = nsql_compress_get32(self->slot + 4);
+
+  if (self->slot[0] == 0 && kind == 0) {
+    memset(out, 0, self->page_nbytes);
+
+    return short_read ? SQLITE_IOERR_SHORT_READ : SQLITE_OK;
+  }
+
+  if (self->slot[0] != NSQL_COMPRESS_RECORD_MARKER ||
+      stored > self->slot_nbytes - NSQL_COMPRESS_RECORD_NBYTES) {
+    return SQLITE_CORRUPT;
+  }
+
+  /* The page may have grown since its length was cached */
+
+  if (NSQL_COMPRESS_RECORD_NBYTES + stored > want) {
+    sqlr = self->real->pMethods->xRead(
+        self->real, self->slot + want,
+        (int)(NSQL_COMPRESS_RECORD_NBYTES + stored - want), off + want);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr == SQLITE_IOERR_SHORT_READ ? SQLITE_CORRUPT : sqlr;
+    }
+  }
+
+  switch (kind) {
+  case NSQL_COMPRESS_KIND_RAW:
+    if (stored != self->page_nbytes) {
+      return SQLITE_CORRUPT;
+    }
+
+    memcpy(out, self->slot + NSQL_COMPRESS_RECORD_NBYTES, stored);
+
+    break;
+
+  case NSQL_COMPRESS_KIND_LZ4:
+    n = nsql_lz4_decompress(self->slot + NSQL_COMPRESS_RECORD_NBYTES, stored,
+                            out, self->page_nbytes);
+
+    if (n != (ptrdiff_t)self->page_nbytes) {
+      return SQLITE_CORRUPT;
+    }
+
+    break;
+
+  default:
+    return SQLITE_CORRUPT;
+  }
+
+  nsql_compress_set_hint(self, pgno, NSQL_COMPRESS_RECORD_NBYTES + stored);
+
+  return SQLITE_OK;
+}
+
+static int nsql_compress_store(struct nsql_compress_file *self,
+                               sqlite3_int64 pgno, const uint8_t *src) {
+  sqlite3_int64 off;
+  size_t nbytes;
+  size_t stored;
+  uint8_t kind;
+  int sqlr;
+
+  /* Pages that do not compress into less than a page are stored as they are,
+     which is why a slot is larger than a page */
+
+  stored = nsql_lz4_compress(src, self->page_nbytes,
+                             self->slot + NSQL_COMPRESS_RECORD_NBYTES,
+                             self->page_nbytes - NSQL_COMPRESS_RECORD_NBYTES);
+  kind = NSQL_COMPRESS_KIND_LZ4;
+
+  if (stored == 0) {
+    memcpy(self->slot + NSQL_COMPRESS_RECORD_NBYTES, src, self->page_nbytes);
+    stored = self->page_nbytes;
+    kind = NSQL_COMPRESS_KIND_RAW;
+  }
+
+  self->slot[0] = NSQL_COMPRESS_RECORD_MARKER;
+  self->slot[1] = kind;
+  self->slot[2] = 0;
+  self->slot[3] = 0;
+  nsql_compress_put32(self->slot + 4, (uint32_t)stored);
+
+  off = nsql_compress_slot_offset(self, pgno);
+  nbytes = NSQL_COMPRESS_RECORD_NBYTES + stored;
+  sqlr = self->real->pMethods->xWrite(self->real, self->slot, (int)nbytes, off);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  nsql_compress_punch(self, pgno, nbytes);
+  nsql_compress_set_hint(self, pgno, (uint32_t)nbytes);
+
+  if (off + (sqlite3_int64)nbytes > self->end) {
+    self->end = off + nbytes;
+  }
+
+  return SQLITE_OK;
+}
+
+static void nsql_compress_punch(struct nsql_compress_file *self,
+                                sqlite3_int64 pgno, size_t nbytes) {
+#if defined(__linux__) && defined(FALLOC_FL_PUNCH_HOLE)
+  sqlite3_int64 off;
+  size_t start;
+  size_t prev;
+
+  /* Release the blocks that the page's previous record occupied beyond the
+     end of this one. Slots past the end of the file have none, and neither do
+     slots whose previous record was no longer than this one. */
+
+  if (self->fd < 0) {
+    return;
+  }
+
+  off = nsql_compress_slot_offset(self, pgno);
+  start = nsql_compress_round(nbytes);
+  prev = nsql_compress_round(nsql_compress_hint(self, pgno));
+
+  if (off + (sqlite3_int64)start >= self->end || start >= self->slot_nbytes ||
+      (prev != 0 && prev <= start)) {
+    return;
+  }
+
+  if (fallocate(self->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                off + start, self->slot_nbytes - start) != 0 &&
+      errno == EOPNOTSUPP) {
+    self->fd = -1;
+  }
+#endif
+}
+
+static sqlite3_int64 nsql_compress_slot_offset(
+    const struct nsql_compress_file *self, sqlite3_int64 pgno) {
+  return NSQL_COMPRESS_BLOCK_NBYTES + pgno * (sqlite3_int64)self->slot_nbytes;
+}
+
+static uint32_t nsql_compress_hint(const struct nsql_compress_file *self,
+                                   sqlite3_int64 pgno) {
+  return (size_t)pgno < self->nstored ? self->stored[pgno] : 0;
+}
+
+static void nsql_compress_set_hint(struct nsql_compress_file *self,
+                                   sqlite3_int64 pgno, uint32_t nbytes) {
+  uint32_t *stored;
+  size_t n;
+
+  /* Hints are optional, so failing to allocate room for one is not an error */
+
+  if ((size_t)pgno >= self->nstored) {
+    n = self->nstored > 0 ? self->nstored : 64;
+
+    while (n <= (size_t)pgno) {
+      n *= 2;
+    }
+
+    stored = realloc(self->stored, n * sizeof(*stored));
+
+    if (stored == NULL) {
+      return;
+    }
+
+    memset(stored + self->nstored, 0, (n - self->nstored) * sizeof(*stored));
+    self->stored = stored;
+    self->nstored = n;
+  }
+
+  self->stored[pgno] = nbytes;
+}
+
+static bool nsql_compress_valid_page_size(sqlite3_int64 nbytes) {
+  return nbytes >= 512 && nbytes <= 65536 && (nbytes & (nbytes - 1)) == 0;
+}
+
+static uint32_t nsql_compress_get32(const uint8_t *p) {
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 |
+         p[3];
+}
+
+static void nsql_compress_put32(uint8_t *p, uint32_t value) {
+  p[0] = (uint8_t)(value >> 24);
+  p[1] = (uint8_t)(value >> 16);
+  p[2] = (uint8_t)(value >> 8);
+  p[3] = (uint8_t)value;
+}
+
+static size_t nsql_compress_round(size_t nbytes) {
+  return (nbytes + NSQL_COMPRESS_BLOCK_NBYTES - 1) /
+         NSQL_COMPRESS_BLOCK_NBYTES * NSQL_COMPRESS_BLOCK_NBYTES;
+}
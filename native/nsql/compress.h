@@ -0,0 +1,25 @@
+#pragma once
+
+/*
+ * Name under which the page-compression VFS is registered
+ */
+#define NSQL_COMPRESS_VFS "nsql-compress"
+
+/*
+ * Register a VFS that layers page compression on top of the default VFS,
+ * unless it has already been registered. It is not made the default. Returns
+ * an SQLite result code.
+ *
+ * Main database files opened through it begin with a header block recording
+ * the page size, followed by one fixed-size slot per page. Each page is stored
+ * at the start of its slot, compressed with LZ4 if that makes it smaller, and
+ * the rest of the slot is left as a hole in a sparse file. Pages are found by
+ * position alone, so no separate map has to be kept consistent with the data;
+ * the stored length of each page is cached in memory only to size reads.
+ *
+ * Storage only shrinks where the filesystem supports sparse files and a page
+ * compresses by at least one filesystem block, so large page sizes work best.
+ * The page size of a compressed database cannot be changed once it has been
+ * created. Journals and WAL files are left to the default VFS uncompressed.
+ */
+int nsql_compress_register(void);
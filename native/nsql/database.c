@@ -1,23 +1,58 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
 
 #include <node_api.h>
 #include <sqlite3.h>
 
+#include "blob.h"
+#include "cache.h"
+#include "carray.h"
+#include "changes.h"
+#include "checkpoint.h"
+#include "columnar.h"
+#include "compress.h"
 #include "dprintf.h"
 #include "error.h"
+#include "import.h"
+#include "interrupt.h"
 #include "macros.h"
+#include "memory.h"
+#include "options.h"
+#include "profile.h"
+#include "session.h"
+#include "shard.h"
 #include "statement.h"
+#include "status.h"
 #include "str.h"
+#include "uring.h"
+
+/* Values of the `vfs` constructor option and the VFS that each selects, NULL
+   being the default */
+
+static const char *const nsql_database_vfs_choices[] = {
+    "default", "io_uring", "compressed", NULL};
+
+static const char *const nsql_database_vfs_names[] = {NULL, NSQL_URING_VFS,
+                                                      NSQL_COMPRESS_VFS};
 
 struct nsql_database_class {
   napi_ref stmt_class;
+  napi_ref blob_class;
+  napi_ref session_class;
 };
 
 struct nsql_database {
   struct nsql_database_class *class_;
   sqlite3 *db;
+  struct nsql_profile *profile;
+  struct nsql_checkpointer *checkpointer;
+  struct nsql_changes *changes;
+  struct nsql_cache *cache;
+  struct nsql_memory *memory;
+  uint32_t interrupt;
 };
 
 static void nsql_database_class_destructor(napi_env env, void *ptr, void *hint);
@@ -31,20 +66,109 @@ static napi_value nsql_database_close(napi_env env, napi_callback_info ctx);
 
 static napi_value nsql_database_exec(napi_env env, napi_callback_info ctx);
 
+static napi_value nsql_database_apply_changeset(napi_env env,
+                                                napi_callback_info ctx);
+
+static napi_value nsql_database_checkpointer(napi_env env,
+                                             napi_callback_info ctx);
+
+static napi_value nsql_database_checkpointer_stats(napi_env env,
+                                                   napi_callback_info ctx);
+
+static napi_value nsql_database_import_file(napi_env env,
+                                            napi_callback_info ctx);
+
+static napi_value nsql_database_interrupt_handle(napi_env env,
+                                                 napi_callback_info ctx);
+
+static napi_value nsql_database_on_change(napi_env env,
+                                          napi_callback_info ctx);
+
+static napi_value nsql_database_open_blob(napi_env env,
+                                          napi_callback_info ctx);
+
 static napi_value nsql_database_prepare(napi_env env, napi_callback_info ctx);
 
+static napi_value nsql_database_profile(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_database_profile_snapshot(napi_env env,
+                                                 napi_callback_info ctx);
+
+static napi_value nsql_database_result_cache(napi_env env,
+                                             napi_callback_info ctx);
+
+static napi_value nsql_database_result_cache_stats(napi_env env,
+                                                   napi_callback_info ctx);
+
+static napi_value nsql_database_register_columnar_table(napi_env env,
+                                                        napi_callback_info ctx);
+
+static napi_value nsql_database_release_memory(napi_env env,
+                                               napi_callback_info ctx);
+
+static napi_value nsql_database_session(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_database_status(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_database_global_status(napi_env env,
+                                              napi_callback_info ctx);
+
+static napi_value nsql_database_heap_limit(napi_env env,
+                                           napi_callback_info ctx);
+
+static napi_value nsql_database_interrupt(napi_env env,
+                                          napi_callback_info ctx);
+
+static napi_value nsql_database_sharded_all(napi_env env,
+                                            napi_callback_info ctx);
+
 static napi_value nsql_database_get_db_filename(napi_env env,
                                                 napi_callback_info ctx);
 
+static void nsql_database_unhook(napi_env env, struct nsql_database *self);
+
 static const napi_property_descriptor nsql_database_desc[] = {
     {.utf8name = "close", .method = nsql_database_close},
     {.utf8name = "exec", .method = nsql_database_exec},
+    {.utf8name = "applyChangeset", .method = nsql_database_apply_changeset},
+    {.utf8name = "checkpointer", .method = nsql_database_checkpointer},
+    {.utf8name = "checkpointerStats",
+     .method = nsql_database_checkpointer_stats},
+    {.utf8name = "importFile", .method = nsql_database_import_file},
+    {.utf8name = "interruptHandle",
+     .method = nsql_database_interrupt_handle},
+    {.utf8name = "onChange", .method = nsql_database_on_change},
+    {.utf8name = "openBlob", .method = nsql_database_open_blob},
     {.utf8name = "prepare", .method = nsql_database_prepare},
+    {.utf8name = "profile", .method = nsql_database_profile},
+    {.utf8name = "profileSnapshot", .method = nsql_database_profile_snapshot},
+    {.utf8name = "resultCache", .method = nsql_database_result_cache},
+    {.utf8name = "resultCacheStats",
+     .method = nsql_database_result_cache_stats},
+    {.utf8name = "registerColumnarTable",
+     .method = nsql_database_register_columnar_table},
+    {.utf8name = "releaseMemory", .method = nsql_database_release_memory},
+    {.utf8name = "session", .method = nsql_database_session},
+    {.utf8name = "status", .method = nsql_database_status},
+    {.utf8name = "globalStatus",
+     .method = nsql_database_global_status,
+     .attributes = napi_static},
+    {.utf8name = "heapLimit",
+     .method = nsql_database_heap_limit,
+     .attributes = napi_static},
+    {.utf8name = "interrupt",
+     .method = nsql_database_interrupt,
+     .attributes = napi_static},
+    {.utf8name = "_shardedAll",
+     .method = nsql_database_sharded_all,
+     .attributes = napi_static},
     {.utf8name = "dbFilename", .getter = nsql_database_get_db_filename}};
 
 napi_status nsql_database_define_class(napi_env env, napi_value *out) {
   struct nsql_database_class *class_;
   napi_value stmt_nclass;
+  napi_value blob_nclass;
+  napi_value session_nclass;
   napi_value nclass;
   napi_status r;
 
@@ -76,6 +200,34 @@ napi_status nsql_database_define_class(napi_env env, napi_value *out) {
     goto end;
   }
 
+  r = nsql_blob_define_class(env, &blob_nclass);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = napi_create_reference(env, blob_nclass, 1, &class_->blob_class);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = nsql_session_define_class(env, &session_nclass);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = napi_create_reference(env, session_nclass, 1, &class_->session_class);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
   r = napi_define_class(
       env, "Database", NAPI_AUTO_LENGTH, nsql_database_constructor, class_,
       countof(nsql_database_desc), nsql_database_desc, &nclass);
@@ -98,6 +250,22 @@ napi_status nsql_database_define_class(napi_env env, napi_value *out) {
     goto end;
   }
 
+  r = napi_set_named_property(env, nclass, "_Blob", blob_nclass);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, nclass, "_Session", session_nclass);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
   r = napi_add_finalizer(env, nclass, class_, nsql_database_class_destructor,
                          NULL, NULL);
 
@@ -137,6 +305,22 @@ static void nsql_database_class_destructor(napi_env env, void *ptr,
     }
   }
 
+  if (class_->blob_class != NULL) {
+    r = napi_delete_reference(env, class_->blob_class);
+
+    if (r != napi_ok) {
+      nsql_fatal_error(env, r);
+    }
+  }
+
+  if (class_->session_class != NULL) {
+    r = napi_delete_reference(env, class_->session_class);
+
+    if (r != napi_ok) {
+      nsql_fatal_error(env, r);
+    }
+  }
+
   free(class_);
 }
 
@@ -147,10 +331,12 @@ static napi_value nsql_database_constructor(napi_env env,
   struct nsql_database *self;
   size_t argc;
   napi_valuetype type;
-  napi_value argv[1];
+  napi_value argv[2];
   napi_value target;
   napi_value nself;
   napi_status r;
+  bool ok;
+  int vfs;
   int sqlr;
 
   uri = NULL;
@@ -206,6 +392,14 @@ static napi_value nsql_database_constructor(napi_env env,
     goto end;
   }
 
+  vfs = 0;
+  r = nsql_options_get_enum(env, argv[1], "vfs", nsql_database_vfs_choices,
+                            &vfs, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
   r = nsql_get_string(env, argv[0], &uri, NULL);
 
   if (r != napi_ok || uri == NULL) {
@@ -223,8 +417,18 @@ static napi_value nsql_database_constructor(napi_env env,
   }
 
   self->class_ = class_;
+  self->changes = nsql_changes_alloc();
+  self->cache = nsql_cache_alloc();
+
+  if (self->changes == NULL || self->cache == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
   sqlr = sqlite3_open_v2(uri, &self->db,
-                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE,
+                         nsql_database_vfs_names[vfs]);
 
   if (sqlr != SQLITE_OK) {
     r = nsql_throw_sqlite_error(env, sqlr, NULL);
@@ -232,6 +436,14 @@ static napi_value nsql_database_constructor(napi_env env,
     goto end;
   }
 
+  self->memory = nsql_memory_alloc(self->db);
+
+  if (self->memory == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
   sqlr = sqlite3_extended_result_codes(self->db, 1);
 
   if (sqlr != SQLITE_OK) {
@@ -240,6 +452,14 @@ static napi_value nsql_database_constructor(napi_env env,
     goto end;
   }
 
+  sqlr = nsql_carray_register(self->db);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
   /* Bind wrapper object */
 
   r = napi_wrap(env, nself, self, nsql_database_destructor, NULL, NULL);
@@ -271,12 +491,19 @@ static void nsql_database_destructor(napi_env env, void *ptr, void *hint) {
   nsql_dprintf("%s(%p)\n", __func__, ptr);
 
   self = ptr;
+  nsql_database_unhook(env, self);
+  nsql_interrupt_unregister(self->interrupt);
   sqlr = sqlite3_close_v2(self->db);
 
   if (sqlr != SQLITE_OK) {
     nsql_fatal_sqlite_error(sqlr);
   }
 
+  nsql_profile_free(self->profile);
+  nsql_checkpointer_free(self->checkpointer);
+  nsql_changes_release(env, self->changes);
+  nsql_cache_release(self->cache);
+  nsql_memory_release(env, self->memory);
   free(self);
 }
 
@@ -302,6 +529,12 @@ static napi_value nsql_database_close(napi_env env, napi_callback_info ctx) {
     goto end;
   }
 
+  /* Stop other threads from interrupting the connection before closing it,
+     since `sqlite3_interrupt()` must not race with `sqlite3_close()` */
+
+  nsql_database_unhook(env, self);
+  nsql_interrupt_unregister(self->interrupt);
+  self->interrupt = 0;
   sqlr = sqlite3_close_v2(self->db);
 
   if (sqlr != SQLITE_OK) {
@@ -390,8 +623,18 @@ static napi_value nsql_database_exec(napi_env env, napi_callback_info ctx) {
 
   if (sqlr != SQLITE_OK) {
     r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+  r = nsql_memory_update(env, self->memory);
+
+  if (r != napi_ok) {
+    goto end;
   }
 
+  r = nsql_changes_flush(env, self->changes);
+
 end:
   free(sql);
 
@@ -450,7 +693,8 @@ static napi_value nsql_database_prepare(napi_env env, napi_callback_info ctx) {
     goto end;
   }
 
-  r = nsql_statement_prepare(env, nclass_stmt, self->db, argv[0], &out);
+  r = nsql_statement_prepare(env, nclass_stmt, self->db, self->changes,
+                             self->cache, self->memory, argv[0], &out);
 
   if (r != napi_ok || out == NULL) {
     goto end;
@@ -460,10 +704,99 @@ end:
   return nsql_return(env, r, out);
 }
 
-static napi_value nsql_database_get_db_filename(napi_env env,
-                                                napi_callback_info ctx) {
+static napi_value nsql_database_profile(napi_env env, napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value nself;
+  napi_status r;
+  bool enabled;
+  bool reset;
+  bool ok;
+  int sqlr;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  if (argc < 1) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "Expected an options parameter");
+
+    goto end;
+  }
+
+  enabled = false;
+  reset = false;
+
+  r = nsql_options_get_bool(env, argv[0], "enabled", &enabled, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_options_get_bool(env, argv[0], "reset", &reset, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  if (self->profile == NULL) {
+    self->profile = nsql_profile_alloc();
+
+    if (self->profile == NULL) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  if (reset) {
+    nsql_profile_clear(self->profile);
+  }
+
+  /* The trace callback runs synchronously inside sqlite3_step() and only ever
+     touches native memory, so no JavaScript is executed per statement. */
+
+  if (enabled) {
+    sqlr = sqlite3_trace_v2(self->db, SQLITE_TRACE_PROFILE, nsql_profile_trace,
+                            self->profile);
+  } else {
+    sqlr = sqlite3_trace_v2(self->db, 0, NULL, NULL);
+  }
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_database_profile_snapshot(napi_env env,
+                                                 napi_callback_info ctx) {
   struct nsql_database *self;
-  const char *str;
   napi_value nself;
   napi_value out;
   napi_status r;
@@ -486,13 +819,77 @@ static napi_value nsql_database_get_db_filename(napi_env env,
     goto end;
   }
 
-  if (self->db != NULL) {
-    str = sqlite3_db_filename(self->db, "main");
-  } else {
-    str = "#CLOSED";
+  if (self->profile == NULL) {
+    r = napi_create_array(env, &out);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    goto end;
   }
 
-  r = napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, &out);
+  r = nsql_profile_snapshot(env, self->profile, &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_result_cache(napi_env env,
+                                             napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value nself;
+  napi_status r;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = nsql_cache_configure(env, self->cache, self->db, self->changes, argv[0]);
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_database_result_cache_stats(napi_env env,
+                                                   napi_callback_info ctx) {
+  struct nsql_database *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
 
   if (r != napi_ok) {
     nsql_report_error(env, r);
@@ -500,6 +897,782 @@ static napi_value nsql_database_get_db_filename(napi_env env,
     goto end;
   }
 
+  r = nsql_cache_stats(env, self->cache, &out);
+
 end:
   return nsql_return(env, r, out);
 }
+
+static napi_value
+nsql_database_register_columnar_table(napi_env env, napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[2];
+  napi_value nself;
+  napi_status r;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = nsql_columnar_register(env, self->db, argv[0], argv[1]);
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_database_release_memory(napi_env env,
+                                               napi_callback_info ctx) {
+  struct nsql_database *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+  int before;
+  int after;
+  int hi;
+  int sqlr;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  /* Pages that are in use or dirty stay in the cache, so report how much the
+     cache actually shrank */
+
+  sqlr = sqlite3_db_status(self->db, SQLITE_DBSTATUS_CACHE_USED, &before, &hi,
+                           0);
+
+  if (sqlr == SQLITE_OK) {
+    sqlr = sqlite3_db_release_memory(self->db);
+  }
+
+  if (sqlr == SQLITE_OK) {
+    sqlr = sqlite3_db_status(self->db, SQLITE_DBSTATUS_CACHE_USED, &after,
+                             &hi, 0);
+  }
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+  r = nsql_memory_update(env, self->memory);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = napi_create_double(env, before > after ? before - after : 0, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_apply_changeset(napi_env env,
+                                                napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[2];
+  napi_value nself;
+  napi_status r;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = nsql_session_apply(env, self->db, argv[0], argv[1]);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = nsql_memory_update(env, self->memory);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = nsql_changes_flush(env, self->changes);
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_database_checkpointer(napi_env env,
+                                             napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value nself;
+  napi_status r;
+  bool enabled;
+  bool ok;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  enabled = true;
+  r = nsql_options_get_bool(env, argv[0], "enabled", &enabled, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  /* Reconfiguring always starts over with a fresh thread and statistics */
+
+  nsql_checkpointer_free(self->checkpointer);
+  self->checkpointer = NULL;
+
+  if (enabled) {
+    r = nsql_checkpointer_start(env, self->db, argv[0], &self->checkpointer);
+  }
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_database_checkpointer_stats(napi_env env,
+                                                   napi_callback_info ctx) {
+  struct nsql_database *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->checkpointer == NULL) {
+    r = napi_get_null(env, &out);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    goto end;
+  }
+
+  r = nsql_checkpointer_stats(env, self->checkpointer, &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_import_file(napi_env env,
+                                            napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[3];
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = nsql_import_file(env, self->db, argv[0], argv[1], argv[2], &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_interrupt_handle(napi_env env,
+                                                 napi_callback_info ctx) {
+  struct nsql_database *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  /* Connections are registered on first use, so that opening a database does
+     not contend for the registry's lock */
+
+  if (self->interrupt == 0) {
+    self->interrupt = nsql_interrupt_register(self->db);
+
+    if (self->interrupt == 0) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  r = napi_create_uint32(env, self->interrupt, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_on_change(napi_env env,
+                                          napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value nself;
+  napi_status r;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = nsql_changes_listen(env, self->changes, self->db, argv[0]);
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_database_open_blob(napi_env env,
+                                          napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[4];
+  napi_value nclass_blob;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+  assert(self->class_ != NULL);
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = napi_get_reference_value(env, self->class_->blob_class, &nclass_blob);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = nsql_blob_open(env, nclass_blob, self->db, self->changes, argv[0],
+                     argv[1], argv[2], argv[3], &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_session(napi_env env, napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value nclass_session;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+  assert(self->class_ != NULL);
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  r = napi_get_reference_value(env, self->class_->session_class,
+                               &nclass_session);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = nsql_session_open(env, nclass_session, self->db, argv[0], &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_status(napi_env env, napi_callback_info ctx) {
+  struct nsql_database *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+  bool reset;
+  bool ok;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db == NULL) {
+    r = napi_throw_error(env, NULL, "Database handle is closed");
+
+    goto end;
+  }
+
+  reset = false;
+  r = nsql_options_get_bool(env, argv[0], "reset", &reset, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_status_db(env, self->db, reset, &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_global_status(napi_env env,
+                                              napi_callback_info ctx) {
+  size_t argc;
+  napi_value argv[1];
+  napi_value out;
+  napi_status r;
+  bool reset;
+  bool ok;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  reset = false;
+  r = nsql_options_get_bool(env, argv[0], "reset", &reset, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_status_global(env, reset, &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_heap_limit(napi_env env,
+                                           napi_callback_info ctx) {
+  size_t argc;
+  napi_value argv[1];
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = nsql_memory_heap_limit(env, argv[0], &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_interrupt(napi_env env,
+                                          napi_callback_info ctx) {
+  size_t argc;
+  napi_valuetype type;
+  napi_value argv[1];
+  napi_value out;
+  napi_status r;
+  uint32_t handle;
+  double value;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_typeof(env, argv[0], &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_number) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "handle: Expected number");
+
+    goto end;
+  }
+
+  r = napi_get_value_double(env, argv[0], &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (!(value >= 1 && value <= UINT32_MAX) || value != (uint32_t)value) {
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                               "handle: Expected an interrupt handle");
+
+    goto end;
+  }
+
+  /* This does not touch any JavaScript object belonging to the connection, so
+     it works from any thread, including a worker thread that is running while
+     the connection's own thread is blocked inside SQLite. */
+
+  handle = (uint32_t)value;
+  r = napi_get_boolean(env, nsql_interrupt(handle), &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_sharded_all(napi_env env,
+                                            napi_callback_info ctx) {
+  size_t argc;
+  napi_value argv[3];
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = napi_get_cb_info(env, ctx, &argc, argv, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = nsql_shard_all(env, argv[0], argv[1], argv[2], &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_database_get_db_filename(napi_env env,
+                                                napi_callback_info ctx) {
+  struct nsql_database *self;
+  const char *str;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (self->db != NULL) {
+    str = sqlite3_db_filename(self->db, "main");
+  } else {
+    str = "#CLOSED";
+  }
+
+  r = napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static void nsql_database_unhook(napi_env env, struct nsql_database *self) {
+  int sqlr;
+
+  assert(self != NULL);
+
+  /* Statements can outlive their connection's wrapper object and keep the
+     underlying connection alive, so callbacks whose context is owned by the
+     wrapper must be detached before the wrapper goes away. */
+
+  if (self->db == NULL) {
+    return;
+  }
+
+  sqlr = sqlite3_trace_v2(self->db, 0, NULL, NULL);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_fatal_sqlite_error(sqlr);
+  }
+
+  /* The checkpointer's own connection must not outlive this one either */
+
+  if (self->checkpointer != NULL) {
+    nsql_checkpointer_stop(self->checkpointer);
+  }
+
+  if (self->changes != NULL) {
+    nsql_changes_detach(self->changes, self->db);
+  }
+
+  /* The cache holds statements of its own on this connection */
+
+  if (self->cache != NULL) {
+    nsql_cache_detach(self->cache);
+  }
+
+  /* Nothing is measured once the connection closes, even if statements keep
+     it open for a while longer */
+
+  (void)nsql_memory_detach(env, self->memory);
+}
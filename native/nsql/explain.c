@@ -0,0 +1,346 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "error.h"
+#include "explain.h"
+
+/* Columns of an EXPLAIN QUERY PLAN result set, see
+   https://sqlite.org/eqp.html */
+
+enum { NSQL_EQP_ID, NSQL_EQP_PARENT, NSQL_EQP_NOTUSED, NSQL_EQP_DETAIL };
+
+static napi_status nsql_explain_plan_row(napi_env env, sqlite3_stmt *stmt,
+                                         napi_value *out);
+
+static napi_status nsql_explain_scan_row(napi_env env, sqlite3_stmt *stmt,
+                                         int idx, napi_value *out, bool *eof);
+
+static napi_status nsql_explain_set_number(napi_env env, napi_value obj,
+                                           const char *name, double value);
+
+static napi_status nsql_explain_set_string(napi_env env, napi_value obj,
+                                           const char *name, const char *str);
+
+napi_status nsql_explain_plan(napi_env env, sqlite3 *db, sqlite3_stmt *stmt,
+                              napi_value *out) {
+  napi_value result;
+  napi_value row;
+  napi_status r;
+  uint32_t nrows;
+  int mode;
+  int sqlr;
+
+  assert(db != NULL);
+  assert(stmt != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+  nrows = 0;
+  mode = sqlite3_stmt_isexplain(stmt);
+
+  r = napi_create_array(env, &result);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  sqlr = sqlite3_stmt_explain(stmt, 2);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, db);
+  }
+
+  for (;;) {
+    sqlr = sqlite3_step(stmt);
+
+    if (sqlr == SQLITE_DONE) {
+      break;
+    }
+
+    if (sqlr != SQLITE_ROW) {
+      r = nsql_throw_sqlite_error(env, sqlr, db);
+
+      goto end;
+    }
+
+    r = nsql_explain_plan_row(env, stmt, &row);
+
+    if (r != napi_ok) {
+      goto end;
+    }
+
+    r = napi_set_element(env, result, nrows++, row);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+  }
+
+  *out = result;
+
+end:
+  (void)sqlite3_reset(stmt);
+
+  /* Switching explain mode can only fail if the statement is busy, and we
+     just reset it. */
+
+  sqlr = sqlite3_stmt_explain(stmt, mode);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_fatal_sqlite_error(sqlr);
+  }
+
+  return r;
+}
+
+static napi_status nsql_explain_plan_row(napi_env env, sqlite3_stmt *stmt,
+                                         napi_value *out) {
+  napi_value obj;
+  napi_status r;
+
+  *out = NULL;
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "id",
+                              sqlite3_column_int(stmt, NSQL_EQP_ID));
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "parent",
+                              sqlite3_column_int(stmt, NSQL_EQP_PARENT));
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_string(
+      env, obj, "detail",
+      (const char *)sqlite3_column_text(stmt, NSQL_EQP_DETAIL));
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  *out = obj;
+
+  return r;
+}
+
+napi_status nsql_explain_scan_stats(napi_env env, sqlite3_stmt *stmt,
+                                    bool reset, napi_value *out) {
+  napi_value result;
+  napi_value row;
+  napi_status r;
+  bool eof;
+  int idx;
+
+  assert(stmt != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_create_array(env, &result);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  for (idx = 0;; idx++) {
+    r = nsql_explain_scan_row(env, stmt, idx, &row, &eof);
+
+    if (r != napi_ok) {
+      return r;
+    }
+
+    if (eof) {
+      break;
+    }
+
+    r = napi_set_element(env, result, (uint32_t)idx, row);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+  }
+
+  if (reset) {
+    sqlite3_stmt_scanstatus_reset(stmt);
+  }
+
+  *out = result;
+
+  return r;
+}
+
+static napi_status nsql_explain_scan_row(napi_env env, sqlite3_stmt *stmt,
+                                         int idx, napi_value *out, bool *eof) {
+  const int flags = SQLITE_SCANSTAT_COMPLEX;
+  sqlite3_int64 nloop;
+  sqlite3_int64 nvisit;
+  sqlite3_int64 ncycle;
+  double est;
+  const char *name;
+  const char *explain;
+  int id;
+  int parent;
+  napi_value obj;
+  napi_status r;
+
+  *out = NULL;
+  *eof = false;
+
+  /* A non-zero return means that `idx` is out of range. Other items cannot
+     fail once the first one has succeeded. */
+
+  if (sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_SELECTID, flags,
+                                 &id) != 0) {
+    *eof = true;
+
+    return napi_ok;
+  }
+
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_PARENTID, flags,
+                             &parent);
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NAME, flags, &name);
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_EXPLAIN, flags,
+                             &explain);
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NLOOP, flags, &nloop);
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NVISIT, flags,
+                             &nvisit);
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_EST, flags, &est);
+  sqlite3_stmt_scanstatus_v2(stmt, idx, SQLITE_SCANSTAT_NCYCLE, flags,
+                             &ncycle);
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "id", id);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "parent", parent);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_string(env, obj, "name", name);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_string(env, obj, "detail", explain);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "loops", (double)nloop);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "rowsVisited", (double)nvisit);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  /* SQLite's estimate is per loop; scale it so that it can be compared with
+     the number of rows that were actually visited. */
+
+  r = nsql_explain_set_number(env, obj, "estimatedRows", est * (double)nloop);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  r = nsql_explain_set_number(env, obj, "cycles", (double)ncycle);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  *out = obj;
+
+  return r;
+}
+
+static napi_status nsql_explain_set_number(napi_env env, napi_value obj,
+                                           const char *name, double value) {
+  napi_value num;
+  napi_status r;
+
+  r = napi_create_double(env, value, &num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
+
+static napi_status nsql_explain_set_string(napi_env env, napi_value obj,
+                                           const char *name, const char *str) {
+  napi_value value;
+  napi_status r;
+
+  if (str != NULL) {
+    r = napi_create_string_utf8(env, str, NAPI_AUTO_LENGTH, &value);
+  } else {
+    r = napi_get_null(env, &value);
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
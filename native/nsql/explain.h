@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Run `EXPLAIN QUERY PLAN` on a prepared statement and return the resulting
+ * plan as an array of `{ id, parent, detail }` objects. The statement must not
+ * be in the middle of an execution. It is returned to its original explain
+ * mode afterwards.
+ *
+ * `db` is the statement's connection, used for error reporting.
+ */
+napi_status nsql_explain_plan(napi_env env, sqlite3 *db, sqlite3_stmt *stmt,
+                              napi_value *out);
+
+/*
+ * Collect the `sqlite3_stmt_scanstatus_v2()` counters for each element of a
+ * statement's query plan into an array of JavaScript objects. Counters
+ * accumulate across executions; if `reset` is true then they are zeroed after
+ * they have been read.
+ *
+ * Requires an SQLite build with `SQLITE_ENABLE_STMT_SCANSTATUS`.
+ */
+napi_status nsql_explain_scan_stats(napi_env env, sqlite3_stmt *stmt,
+                                    bool reset, napi_value *out);
@@ -0,0 +1,636 @@
+#include <assert.h>
+#include <errno.h>
+#include <limits.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "error.h"
+#include "export.h"
+#include "json.h"
+#include "options.h"
+#include "str.h"
+
+/* Buffered output is written out once it reaches this size */
+
+#define NSQL_EXPORT_FLUSH_SIZE (256 * 1024)
+
+/* Values at least this large are written from SQLite's memory, not copied */
+
+#define NSQL_EXPORT_DIRECT_SIZE (16 * 1024)
+
+/* Maximum number of pieces gathered into a single writev() call */
+
+#define NSQL_EXPORT_MAX_SEGMENTS 64
+
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+enum nsql_export_format {
+  NSQL_EXPORT_CSV,
+  NSQL_EXPORT_NDJSON,
+  NSQL_EXPORT_TSV,
+};
+
+/* A piece of pending output: either a range of the buffer (`bytes` is NULL)
+   or a value that still lives in SQLite's memory. */
+
+struct nsql_export_segment {
+  const uint8_t *bytes;
+  size_t offset;
+  size_t nbytes;
+};
+
+static napi_status nsql_export_open_path(napi_env env,
+                                         struct nsql_export *self,
+                                         napi_value target, bool *ok);
+
+static bool nsql_export_value(struct nsql_export *self, sqlite3_stmt *stmt,
+                              int i);
+
+static bool nsql_export_text(struct nsql_export *self, const uint8_t *bytes,
+                             size_t nbytes);
+
+static bool nsql_export_escape_csv(struct nsql_export *self,
+                                   const uint8_t *bytes, size_t nbytes);
+
+static bool nsql_export_escape_tsv(struct nsql_export *self,
+                                   const uint8_t *bytes, size_t nbytes);
+
+static bool nsql_export_put(struct nsql_export *self, const void *bytes,
+                            size_t nbytes);
+
+static bool nsql_export_putc(struct nsql_export *self, char c);
+
+static bool nsql_export_direct(struct nsql_export *self, const uint8_t *bytes,
+                               size_t nbytes);
+
+static void nsql_export_seal(struct nsql_export *self);
+
+static bool nsql_export_flush(struct nsql_export *self);
+
+static bool nsql_export_write(struct nsql_export *self);
+
+napi_status nsql_export_open(napi_env env, struct nsql_export *self,
+                             napi_value target, napi_value opts, bool *ok) {
+  static const char *const formats[] = {"csv", "ndjson", "tsv", NULL};
+  napi_valuetype type;
+  napi_status r;
+  double fd;
+
+  assert(self != NULL);
+  assert(ok != NULL);
+
+  *ok = false;
+  self->header = true;
+
+  r = nsql_options_get_enum(env, opts, "format", formats, &self->format, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  r = nsql_options_get_bool(env, opts, "header", &self->header, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  *ok = false;
+  self->segments =
+      calloc(NSQL_EXPORT_MAX_SEGMENTS, sizeof(struct nsql_export_segment));
+
+  if (self->segments == NULL) {
+    return nsql_throw_oom(env);
+  }
+
+  r = napi_typeof(env, target, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (type == napi_string) {
+    return nsql_export_open_path(env, self, target, ok);
+  }
+
+  if (type != napi_number) {
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                 "target: Expected file descriptor or path");
+  }
+
+  r = napi_get_value_double(env, target, &fd);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (!(fd >= 0 && fd <= INT_MAX && fd == floor(fd))) {
+    return napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                                  "target: Invalid file descriptor");
+  }
+
+  self->fd = (int)fd;
+  *ok = true;
+
+  return napi_ok;
+}
+
+bool nsql_export_begin(struct nsql_export *self, sqlite3_stmt *stmt) {
+  const char *name;
+  int ncols;
+  int i;
+
+  assert(self != NULL);
+  assert(!self->begun);
+
+  self->begun = true;
+
+  if (self->format == NSQL_EXPORT_NDJSON) {
+    return nsql_json_begin(&self->json, stmt, true);
+  }
+
+  if (!self->header) {
+    return true;
+  }
+
+  ncols = sqlite3_column_count(stmt);
+
+  for (i = 0; i < ncols; i++) {
+    name = sqlite3_column_name(stmt, i);
+
+    if (name == NULL) {
+      return false;
+    }
+
+    if ((i > 0 &&
+         !nsql_export_putc(self,
+                           self->format == NSQL_EXPORT_TSV ? '\t' : ',')) ||
+        !nsql_export_text(self, (const uint8_t *)name, strlen(name))) {
+      return false;
+    }
+  }
+
+  return nsql_export_putc(self, '\n');
+}
+
+bool nsql_export_push_row(struct nsql_export *self, sqlite3_stmt *stmt) {
+  char sep;
+  int ncols;
+  int i;
+
+  assert(self != NULL);
+  assert(self->begun);
+
+  if (self->format == NSQL_EXPORT_NDJSON) {
+    if (!nsql_json_write_row(&self->json, &self->buf, stmt)) {
+      return false;
+    }
+  } else {
+    ncols = sqlite3_column_count(stmt);
+    sep = self->format == NSQL_EXPORT_TSV ? '\t' : ',';
+
+    for (i = 0; i < ncols; i++) {
+      if ((i > 0 && !nsql_export_putc(self, sep)) ||
+          !nsql_export_value(self, stmt, i)) {
+        return false;
+      }
+    }
+  }
+
+  if (!nsql_export_putc(self, '\n')) {
+    return false;
+  }
+
+  self->nrows++;
+
+  /* Values written directly must go out before the statement steps again */
+
+  if (self->nsegments > 0 || self->buf.nbytes >= NSQL_EXPORT_FLUSH_SIZE) {
+    return nsql_export_flush(self);
+  }
+
+  return true;
+}
+
+bool nsql_export_finish(struct nsql_export *self) {
+  assert(self != NULL);
+
+  return nsql_export_flush(self);
+}
+
+napi_status nsql_export_throw(napi_env env, const struct nsql_export *self) {
+  char msg[256];
+
+  assert(self != NULL);
+
+  if (self->error == 0) {
+    return nsql_throw_oom(env);
+  }
+
+  snprintf(msg, sizeof(msg), "Export failed: %s", strerror(self->error));
+
+  return napi_throw_error(env, NULL, msg);
+}
+
+bool nsql_export_close(struct nsql_export *self) {
+  bool ok;
+
+  assert(self != NULL);
+
+  ok = true;
+
+  if (self->close) {
+#ifdef _WIN32
+    if (_close(self->fd) != 0) {
+#else
+    if (close(self->fd) != 0) {
+#endif
+      self->error = errno;
+      ok = false;
+    }
+
+    self->close = false;
+  }
+
+  free(self->segments);
+  nsql_buf_free(&self->buf);
+  nsql_json_free(&self->json);
+  self->segments = NULL;
+  self->nsegments = 0;
+
+  return ok;
+}
+
+static napi_status nsql_export_open_path(napi_env env,
+                                         struct nsql_export *self,
+                                         napi_value target, bool *ok) {
+  char msg[512];
+  napi_status r;
+  char *path;
+#ifdef _WIN32
+  WCHAR *wpath;
+  int nchars;
+#endif
+
+  r = nsql_get_string(env, target, &path, NULL);
+
+  if (r != napi_ok || path == NULL) {
+    return r;
+  }
+
+#ifdef _WIN32
+  self->fd = -1;
+  nchars = MultiByteToWideChar(CP_UTF8, 0, path, -1, NULL, 0);
+  wpath = nchars > 0 ? malloc(nchars * sizeof(*wpath)) : NULL;
+  errno = ENOMEM;
+
+  if (wpath != NULL &&
+      MultiByteToWideChar(CP_UTF8, 0, path, -1, wpath, nchars) > 0) {
+    self->fd = _wopen(wpath, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY,
+                      _S_IREAD | _S_IWRITE);
+  }
+
+  free(wpath);
+#else
+  self->fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+#endif
+
+  if (self->fd < 0) {
+    snprintf(msg, sizeof(msg), "%s: %s", path, strerror(errno));
+    free(path);
+
+    return napi_throw_error(env, NULL, msg);
+  }
+
+  free(path);
+  self->close = true;
+  *ok = true;
+
+  return napi_ok;
+}
+
+static bool nsql_export_value(struct nsql_export *self, sqlite3_stmt *stmt,
+                              int i) {
+  const uint8_t *bytes;
+  double real;
+
+  switch (sqlite3_column_type(stmt, i)) {
+  case SQLITE_INTEGER:
+    return nsql_json_write_int64(&self->buf, sqlite3_column_int64(stmt, i));
+
+  case SQLITE_FLOAT:
+    real = sqlite3_column_double(stmt, i);
+
+    /* Spelled the way Number() parses them */
+
+    if (isinf(real)) {
+      return real > 0 ? nsql_export_put(self, "Infinity", 8)
+                      : nsql_export_put(self, "-Infinity", 9);
+    }
+
+    return nsql_json_write_double(&self->buf, real);
+
+  case SQLITE_TEXT:
+    bytes = sqlite3_column_text(stmt, i);
+
+    if (bytes == NULL) {
+      return false;
+    }
+
+    return nsql_export_text(self, bytes, sqlite3_column_bytes(stmt, i));
+
+  case SQLITE_BLOB:
+    bytes = sqlite3_column_blob(stmt, i);
+
+    return nsql_json_write_base64(&self->buf, bytes,
+                                  sqlite3_column_bytes(stmt, i));
+
+  default:
+    /* CSV has no NULL, so an empty field stands in for one. TSV uses the
+       same \N convention as PostgreSQL and MySQL. */
+
+    return self->format == NSQL_EXPORT_TSV ? nsql_export_put(self, "\\N", 2)
+                                           : true;
+  }
+}
+
+static bool nsql_export_text(struct nsql_export *self, const uint8_t *bytes,
+                             size_t nbytes) {
+  size_t i;
+
+  /* An empty CSV string must be quoted to tell it apart from NULL */
+
+  if (nbytes == 0) {
+    return self->format == NSQL_EXPORT_TSV || nsql_export_put(self, "\"\"", 2);
+  }
+
+  for (i = 0; i < nbytes; i++) {
+    switch (bytes[i]) {
+    case '\n':
+    case '\r':
+      goto escape;
+
+    case ',':
+    case '"':
+      if (self->format == NSQL_EXPORT_CSV) {
+        goto escape;
+      }
+
+      break;
+
+    case '\t':
+    case '\\':
+      if (self->format == NSQL_EXPORT_TSV) {
+        goto escape;
+      }
+
+      break;
+    }
+  }
+
+  if (nbytes >= NSQL_EXPORT_DIRECT_SIZE) {
+    return nsql_export_direct(self, bytes, nbytes);
+  }
+
+  return nsql_export_put(self, bytes, nbytes);
+
+escape:
+  return self->format == NSQL_EXPORT_TSV
+             ? nsql_export_escape_tsv(self, bytes, nbytes)
+             : nsql_export_escape_csv(self, bytes, nbytes);
+}
+
+static bool nsql_export_escape_csv(struct nsql_export *self,
+                                   const uint8_t *bytes, size_t nbytes) {
+  const uint8_t *end;
+  const uint8_t *q;
+
+  if (!nsql_export_putc(self, '"')) {
+    return false;
+  }
+
+  end = bytes + nbytes;
+
+  /* Double every quote; everything else appears literally */
+
+  while ((q = memchr(bytes, '"', end - bytes)) != NULL) {
+    if (!nsql_export_put(self, bytes, q - bytes + 1) ||
+        !nsql_export_putc(self, '"')) {
+      return false;
+    }
+
+    bytes = q + 1;
+  }
+
+  return nsql_export_put(self, bytes, end - bytes) &&
+         nsql_export_putc(self, '"');
+}
+
+static bool nsql_export_escape_tsv(struct nsql_export *self,
+                                   const uint8_t *bytes, size_t nbytes) {
+  size_t start;
+  size_t i;
+  char esc;
+
+  start = 0;
+
+  for (i = 0; i < nbytes; i++) {
+    switch (bytes[i]) {
+    case '\t':
+      esc = 't';
+      break;
+
+    case '\n':
+      esc = 'n';
+      break;
+
+    case '\r':
+      esc = 'r';
+      break;
+
+    case '\\':
+      esc = '\\';
+      break;
+
+    default:
+      continue;
+    }
+
+    if (!nsql_export_put(self, bytes + start, i - start) ||
+        !nsql_export_putc(self, '\\') || !nsql_export_putc(self, esc)) {
+      return false;
+    }
+
+    start = i + 1;
+  }
+
+  return nsql_export_put(self, bytes + start, nbytes - start);
+}
+
+static bool nsql_export_put(struct nsql_export *self, const void *bytes,
+                            size_t nbytes) {
+  return nbytes == 0 || nsql_buf_append(&self->buf, bytes, nbytes);
+}
+
+static bool nsql_export_putc(struct nsql_export *self, char c) {
+  return nsql_buf_append(&self->buf, &c, 1);
+}
+
+static bool nsql_export_direct(struct nsql_export *self, const uint8_t *bytes,
+                               size_t nbytes) {
+  /* Leave room for this segment and for sealing the buffer after it */
+
+  if (self->nsegments + 3 > NSQL_EXPORT_MAX_SEGMENTS &&
+      !nsql_export_flush(self)) {
+    return false;
+  }
+
+  nsql_export_seal(self);
+
+  self->segments[self->nsegments].bytes = bytes;
+  self->segments[self->nsegments].offset = 0;
+  self->segments[self->nsegments].nbytes = nbytes;
+  self->nsegments++;
+
+  return true;
+}
+
+static void nsql_export_seal(struct nsql_export *self) {
+  if (self->buf.nbytes == self->mark) {
+    return;
+  }
+
+  self->segments[self->nsegments].bytes = NULL;
+  self->segments[self->nsegments].offset = self->mark;
+  self->segments[self->nsegments].nbytes = self->buf.nbytes - self->mark;
+  self->nsegments++;
+  self->mark = self->buf.nbytes;
+}
+
+static bool nsql_export_flush(struct nsql_export *self) {
+  nsql_export_seal(self);
+
+  if (self->nsegments > 0 && !nsql_export_write(self)) {
+    return false;
+  }
+
+  self->nsegments = 0;
+  self->mark = 0;
+  self->buf.nbytes = 0;
+
+  return true;
+}
+
+#ifdef _WIN32
+
+static bool nsql_export_write(struct nsql_export *self) {
+  const struct nsql_export_segment *seg;
+  const uint8_t *bytes;
+  size_t nbytes;
+  int chunk;
+  int n;
+  int i;
+
+  /* No writev() here; write each piece in turn */
+
+  for (i = 0; i < self->nsegments; i++) {
+    seg = &self->segments[i];
+    bytes = seg->bytes != NULL ? seg->bytes : self->buf.bytes + seg->offset;
+    nbytes = seg->nbytes;
+
+    while (nbytes > 0) {
+      chunk = nbytes > INT_MAX ? INT_MAX : (int)nbytes;
+      n = _write(self->fd, bytes, chunk);
+
+      if (n < 0) {
+        self->error = errno;
+
+        return false;
+      }
+
+      bytes += n;
+      nbytes -= n;
+    }
+  }
+
+  return true;
+}
+
+#else
+
+static bool nsql_export_write(struct nsql_export *self) {
+  struct iovec iov[NSQL_EXPORT_MAX_SEGMENTS];
+  const struct nsql_export_segment *seg;
+  struct iovec *v;
+  ssize_t n;
+  int count;
+  int i;
+
+  for (i = 0; i < self->nsegments; i++) {
+    seg = &self->segments[i];
+    iov[i].iov_base = seg->bytes != NULL
+                          ? (void *)seg->bytes
+                          : (void *)(self->buf.bytes + seg->offset);
+    iov[i].iov_len = seg->nbytes;
+  }
+
+  v = iov;
+  count = self->nsegments;
+
+  while (count > 0) {
+    n = writev(self->fd, v, count < IOV_MAX ? count : IOV_MAX);
+
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+
+      self->error = errno;
+
+      return false;
+    }
+
+    /* Skip whatever was written completely, then resume part-way through the
+       first piece that was not */
+
+    while (count > 0 && (size_t)n >= v->iov_len) {
+      n -= v->iov_len;
+      v++;
+      count--;
+    }
+
+    if (count > 0) {
+      v->iov_base = (uint8_t *)v->iov_base + n;
+      v->iov_len -= n;
+    }
+  }
+
+  return true;
+}
+
+#endif
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "json.h"
+
+/*
+ * Writer that streams a result set to a file descriptor as CSV, TSV or NDJSON.
+ * Rows are formatted into a buffer that is written out with `writev()` once
+ * it fills up, so memory usage does not depend on the size of the result set.
+ * Large values that need no escaping are written straight from SQLite's
+ * memory instead of being copied into the buffer.
+ *
+ * A zero-initialized `struct nsql_export` is ready for use.
+ */
+struct nsql_export {
+  struct nsql_export_segment *segments;
+  int nsegments;
+  size_t mark;
+  struct nsql_buf buf;
+  struct nsql_json json;
+  int format;
+  bool header;
+  bool begun;
+  int fd;
+  bool close;
+  int error;
+  int64_t nrows;
+};
+
+/*
+ * Open the export target and read the `format` and `header` options. `target`
+ * is either a file descriptor, which is left open afterwards, or a path, which
+ * is created or truncated. A JavaScript exception is thrown and `*ok` is set
+ * to false if the arguments are invalid or the file cannot be opened.
+ */
+napi_status nsql_export_open(napi_env env, struct nsql_export *self,
+                             napi_value target, napi_value opts, bool *ok);
+
+/*
+ * Write the header row, if any. Must be called once, after the first call to
+ * `sqlite3_step()`. Returns false on failure; see `nsql_export_throw()`.
+ */
+bool nsql_export_begin(struct nsql_export *self, sqlite3_stmt *stmt);
+
+/*
+ * Format the statement's current row. This may write to the target, and must
+ * be called before the statement is stepped again. Returns false on failure.
+ */
+bool nsql_export_push_row(struct nsql_export *self, sqlite3_stmt *stmt);
+
+/*
+ * Write out anything still buffered. Returns false on failure.
+ */
+bool nsql_export_finish(struct nsql_export *self);
+
+/*
+ * Throw a JavaScript exception describing why a previous call failed.
+ */
+napi_status nsql_export_throw(napi_env env, const struct nsql_export *self);
+
+/*
+ * Close the target if it was opened by path, and release all memory owned by
+ * the writer. Returns false if closing the file failed, in which case data may
+ * have been lost.
+ */
+bool nsql_export_close(struct nsql_export *self);
@@ -0,0 +1,44 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "hash.h"
+
+/* FNV-1a offset bases and primes, see
+   http://www.isthe.com/chongo/tech/comp/fnv/ */
+
+#define NSQL_HASH32_BASIS 2166136261u
+#define NSQL_HASH32_PRIME 16777619u
+#define NSQL_HASH64_BASIS UINT64_C(0xcbf29ce484222325)
+#define NSQL_HASH64_PRIME UINT64_C(0x100000001b3)
+
+uint32_t nsql_hash32(const void *bytes, size_t nbytes) {
+  const uint8_t *p;
+  uint32_t hash;
+  size_t i;
+
+  p = bytes;
+  hash = NSQL_HASH32_BASIS;
+
+  for (i = 0; i < nbytes; i++) {
+    hash ^= p[i];
+    hash *= NSQL_HASH32_PRIME;
+  }
+
+  return hash;
+}
+
+uint64_t nsql_hash64(const void *bytes, size_t nbytes) {
+  const uint8_t *p;
+  uint64_t hash;
+  size_t i;
+
+  p = bytes;
+  hash = NSQL_HASH64_BASIS;
+
+  for (i = 0; i < nbytes; i++) {
+    hash ^= p[i];
+    hash *= NSQL_HASH64_PRIME;
+  }
+
+  return hash;
+}
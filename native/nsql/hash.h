@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Hash `nbytes` bytes with 32-bit FNV-1a. Fast and good enough for hash tables
+ * keyed by short strings, but not resistant to deliberate collisions.
+ */
+uint32_t nsql_hash32(const void *bytes, size_t nbytes);
+
+/*
+ * Hash `nbytes` bytes with 64-bit FNV-1a, as for `nsql_hash32`.
+ */
+uint64_t nsql_hash64(const void *bytes, size_t nbytes);
@@ -0,0 +1,2022 @@
+#include <assert.h>
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <node_api.h>
+#include <sqlite3.h>
+#include <uv.h>
+
+#include "buf.h"
+#include "error.h"
+#include "import.h"
+#include "options.h"
+#include "str.h"
+
+/* Default number of rows inserted per transaction */
+
+#define NSQL_IMPORT_BATCH_SIZE 10000
+
+/* How long the import's connection waits for locks held by other
+   connections, such as the caller's own, before failing with SQLITE_BUSY */
+
+#define NSQL_IMPORT_BUSY_TIMEOUT_MS 5000
+
+/* Longest numeric token accepted in NDJSON input */
+
+#define NSQL_IMPORT_MAX_NUMBER 64
+
+#define NSQL_IMPORT_QUOTED 1
+#define NSQL_IMPORT_ESCAPED 2
+
+#define NSQL_SWAR_ONES 0x0101010101010101ull
+#define NSQL_SWAR_HIGHS 0x8080808080808080ull
+
+enum nsql_import_format { NSQL_IMPORT_CSV, NSQL_IMPORT_NDJSON };
+
+struct nsql_import_field {
+  const uint8_t *bytes;
+  size_t nbytes;
+  int flags;
+};
+
+struct nsql_import {
+  napi_env env;
+  napi_async_work work;
+  napi_deferred deferred;
+
+  /* Connection dedicated to the import, opened on the worker thread. The
+     caller's connection is never touched once the import has started. */
+
+  sqlite3 *db;
+  sqlite3_stmt *stmt;
+  char *filename;
+  const char *vfs;
+  bool txn;
+
+  char *path;
+  char *table;
+  int format;
+  bool header;
+  int64_t batch_size;
+
+  /* Progress callback, and the handshake that makes the worker wait for it
+     to return after each batch. An exception thrown by the callback is kept
+     in `exception` and stops the import. */
+
+  napi_threadsafe_function on_progress;
+  uv_mutex_t mutex;
+  uv_cond_t cond;
+  bool sync_init;
+  bool acked;
+  bool aborted;
+  napi_ref exception;
+
+  /* Input file, mapped into memory in its entirety */
+
+  const uint8_t *bytes;
+  size_t nbytes;
+  size_t pos;
+  size_t record;
+#ifdef _WIN32
+  HANDLE mapping;
+#endif
+
+  /* Target column names, if known. Otherwise values are inserted
+     positionally. */
+
+  char **columns;
+  int ncols;
+
+  /* Fields of the current CSV record */
+
+  struct nsql_import_field *fields;
+  int nfields;
+  int fields_capacity;
+
+  /* Unescaped copies of quoted values */
+
+  struct nsql_buf scratch;
+
+  /* Failure details: a parse error message, an SQLite result code, an OS
+     error code from reading the input file, or memory exhaustion. */
+
+  bool failed;
+  const char *error;
+  int sqlr;
+  unsigned long os_error;
+  bool oom;
+
+  int64_t rows;
+};
+
+static napi_status nsql_import_get_options(struct nsql_import *self,
+                                           napi_value opts, bool *ok);
+
+static napi_status nsql_import_get_progress(struct nsql_import *self,
+                                            napi_value on_progress);
+
+static napi_status nsql_import_get_columns(struct nsql_import *self,
+                                           napi_value columns, bool *ok);
+
+static napi_status nsql_import_start(struct nsql_import *self,
+                                     napi_value *out);
+
+static void nsql_import_free(napi_env env, struct nsql_import *self);
+
+static void nsql_import_execute(napi_env env, void *data);
+
+static void nsql_import_complete(napi_env env, napi_status status,
+                                 void *data);
+
+static bool nsql_import_map(struct nsql_import *self);
+
+static void nsql_import_unmap(struct nsql_import *self);
+
+static bool nsql_import_run(struct nsql_import *self);
+
+static bool nsql_import_next(struct nsql_import *self, bool *found);
+
+static bool nsql_import_prepare(struct nsql_import *self, int nparams);
+
+static bool nsql_import_progress(struct nsql_import *self);
+
+static void nsql_import_call_js(napi_env env, napi_value callback, void *ctx,
+                                void *data);
+
+static napi_status nsql_import_throw(struct nsql_import *self);
+
+static bool nsql_import_add_column(struct nsql_import *self,
+                                   const uint8_t *name, size_t nbytes);
+
+static bool nsql_import_fail(struct nsql_import *self, const char *error);
+
+static bool nsql_import_csv_header(struct nsql_import *self);
+
+static bool nsql_import_csv_record(struct nsql_import *self, bool *found);
+
+static bool nsql_import_csv_bind(struct nsql_import *self);
+
+static bool nsql_import_csv_unescape(struct nsql_import *self,
+                                     const struct nsql_import_field *field);
+
+static bool nsql_import_ndjson_record(struct nsql_import *self, bool infer,
+                                      bool *found);
+
+static bool nsql_import_json_value(struct nsql_import *self,
+                                   const uint8_t **pp, int col);
+
+static bool nsql_import_json_string(struct nsql_import *self,
+                                    const uint8_t **pp, const uint8_t **out,
+                                    size_t *out_nbytes, bool *copied);
+
+static bool nsql_import_json_number(struct nsql_import *self,
+                                    const uint8_t **pp, int col);
+
+static bool nsql_import_json_skip(struct nsql_import *self,
+                                  const uint8_t **pp);
+
+static bool nsql_import_json_literal(const uint8_t **pp, const uint8_t *end,
+                                     const char *literal);
+
+static int nsql_import_lookup(struct nsql_import *self, const uint8_t *name,
+                              size_t nbytes, int *hint);
+
+static bool nsql_import_bind(struct nsql_import *self, int sqlr);
+
+static const uint8_t *nsql_import_ws(const uint8_t *p, const uint8_t *end);
+
+static const uint8_t *nsql_import_scan(const uint8_t *p, const uint8_t *end,
+                                       uint8_t a, uint8_t b, uint8_t c);
+
+static int nsql_import_hex(const uint8_t *p);
+
+static size_t nsql_import_utf8(uint8_t *out, uint32_t cp);
+
+napi_status nsql_import_file(napi_env env, sqlite3 *db, napi_value path,
+                             napi_value table, napi_value opts,
+                             napi_value *out) {
+  struct nsql_import *self;
+  const char *filename;
+  sqlite3_vfs *vfs;
+  napi_valuetype type;
+  napi_status r;
+  bool ok;
+  int sqlr;
+
+  assert(db != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  self->env = env;
+  self->header = true;
+  self->batch_size = NSQL_IMPORT_BATCH_SIZE;
+
+  r = napi_typeof(env, path, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_string) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "path: Expected string");
+
+    goto end;
+  }
+
+  r = napi_typeof(env, table, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_string) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "table: Expected string");
+
+    goto end;
+  }
+
+  r = nsql_import_get_options(self, opts, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_get_string(env, path, &self->path, NULL);
+
+  if (r != napi_ok || self->path == NULL) {
+    goto end;
+  }
+
+  r = nsql_get_string(env, table, &self->table, NULL);
+
+  if (r != napi_ok || self->table == NULL) {
+    goto end;
+  }
+
+  /* Batches are committed as we go, which would be meaningless inside a
+     transaction that the caller has already opened. */
+
+  if (!sqlite3_get_autocommit(db)) {
+    r = napi_throw_error(env, NULL,
+                         "Cannot import a file inside a transaction");
+
+    goto end;
+  }
+
+  /* The import runs on a connection of its own, which must therefore be able
+     to open the same database through the same VFS */
+
+  filename = sqlite3_db_filename(db, "main");
+
+  if (filename == NULL || filename[0] == '\0') {
+    r = napi_throw_error(env, NULL, "Importing requires a file database");
+
+    goto end;
+  }
+
+  vfs = NULL;
+  sqlr = sqlite3_file_control(db, "main", SQLITE_FCNTL_VFS_POINTER, &vfs);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, db);
+
+    goto end;
+  }
+
+  self->vfs = vfs != NULL ? vfs->zName : NULL;
+  self->filename = strdup(filename);
+
+  if (self->filename == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  r = nsql_import_start(self, out);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  self = NULL;
+
+end:
+  nsql_import_free(env, self);
+
+  return r;
+}
+
+static napi_status nsql_import_get_options(struct nsql_import *self,
+                                           napi_value opts, bool *ok) {
+  static const char *const formats[] = {"csv", "ndjson", NULL};
+  napi_value on_progress;
+  napi_value columns;
+  double batch_size;
+  napi_status r;
+
+  r = nsql_options_get_enum(self->env, opts, "format", formats, &self->format,
+                            ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  r = nsql_options_get_bool(self->env, opts, "header", &self->header, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  batch_size = NSQL_IMPORT_BATCH_SIZE;
+  r = nsql_options_get_double(self->env, opts, "batchSize", &batch_size, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  if (batch_size < 1 || batch_size != floor(batch_size) ||
+      batch_size > INT32_MAX) {
+    *ok = false;
+
+    return napi_throw_range_error(self->env, "ERR_OUT_OF_RANGE",
+                                  "batchSize: Expected a positive integer");
+  }
+
+  self->batch_size = (int64_t)batch_size;
+
+  r = nsql_options_get_function(self->env, opts, "onProgress", &on_progress,
+                                ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  if (on_progress != NULL) {
+    *ok = false;
+    r = nsql_import_get_progress(self, on_progress);
+
+    if (r != napi_ok) {
+      return r;
+    }
+
+    *ok = true;
+  }
+
+  r = nsql_options_get_object(self->env, opts, "columns", &columns, ok);
+
+  if (r != napi_ok || !*ok || columns == NULL) {
+    return r;
+  }
+
+  return nsql_import_get_columns(self, columns, ok);
+}
+
+static napi_status nsql_import_get_columns(struct nsql_import *self,
+                                           napi_value columns, bool *ok) {
+  napi_valuetype type;
+  napi_value value;
+  napi_status r;
+  uint32_t length;
+  uint32_t i;
+  bool array;
+
+  *ok = false;
+
+  r = napi_is_array(self->env, columns, &array);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  if (!array) {
+    return napi_throw_type_error(self->env, "ERR_INVALID_ARG_TYPE",
+                                 "columns: Expected an array of strings");
+  }
+
+  r = napi_get_array_length(self->env, columns, &length);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  if (length == 0) {
+    return napi_throw_range_error(self->env, "ERR_OUT_OF_RANGE",
+                                  "columns: Expected at least one column");
+  }
+
+  self->columns = calloc(length, sizeof(*self->columns));
+
+  if (self->columns == NULL) {
+    return nsql_throw_oom(self->env);
+  }
+
+  for (i = 0; i < length; i++) {
+    r = napi_get_element(self->env, columns, i, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(self->env, r);
+
+      return r;
+    }
+
+    r = napi_typeof(self->env, value, &type);
+
+    if (r != napi_ok) {
+      nsql_report_error(self->env, r);
+
+      return r;
+    }
+
+    if (type != napi_string) {
+      return napi_throw_type_error(self->env, "ERR_INVALID_ARG_TYPE",
+                                   "columns: Expected an array of strings");
+    }
+
+    r = nsql_get_string(self->env, value, &self->columns[i], NULL);
+
+    if (r != napi_ok || self->columns[i] == NULL) {
+      return r;
+    }
+
+    self->ncols++;
+  }
+
+  *ok = true;
+
+  return napi_ok;
+}
+
+static napi_status nsql_import_get_progress(struct nsql_import *self,
+                                            napi_value on_progress) {
+  napi_value name;
+  napi_status r;
+
+  if (uv_mutex_init(&self->mutex) != 0) {
+    return nsql_throw_oom(self->env);
+  }
+
+  if (uv_cond_init(&self->cond) != 0) {
+    uv_mutex_destroy(&self->mutex);
+
+    return nsql_throw_oom(self->env);
+  }
+
+  self->sync_init = true;
+
+  r = napi_create_string_utf8(self->env, "nsql import", NAPI_AUTO_LENGTH,
+                              &name);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  r = napi_create_threadsafe_function(self->env, on_progress, NULL, name, 0, 1,
+                                      NULL, NULL, self, nsql_import_call_js,
+                                      &self->on_progress);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+  }
+
+  return r;
+}
+
+static napi_status nsql_import_start(struct nsql_import *self,
+                                     napi_value *out) {
+  napi_value name;
+  napi_value promise;
+  napi_status r;
+
+  r = napi_create_string_utf8(self->env, "nsql import", NAPI_AUTO_LENGTH,
+                              &name);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  r = napi_create_async_work(self->env, NULL, name, nsql_import_execute,
+                             nsql_import_complete, self, &self->work);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  r = napi_create_promise(self->env, &self->deferred, &promise);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  r = napi_queue_async_work(self->env, self->work);
+
+  if (r != napi_ok) {
+    nsql_report_error(self->env, r);
+
+    return r;
+  }
+
+  *out = promise;
+
+  return napi_ok;
+}
+
+static void nsql_import_free(napi_env env, struct nsql_import *self) {
+  int sqlr;
+  int i;
+
+  if (self == NULL) {
+    return;
+  }
+
+  if (self->work != NULL) {
+    (void)napi_delete_async_work(env, self->work);
+  }
+
+  if (self->on_progress != NULL) {
+    (void)napi_release_threadsafe_function(self->on_progress,
+                                           napi_tsfn_release);
+  }
+
+  if (self->exception != NULL) {
+    (void)napi_delete_reference(env, self->exception);
+  }
+
+  if (self->sync_init) {
+    uv_cond_destroy(&self->cond);
+    uv_mutex_destroy(&self->mutex);
+  }
+
+  sqlite3_finalize(self->stmt);
+  sqlr = sqlite3_close_v2(self->db);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_fatal_sqlite_error(sqlr);
+  }
+
+  nsql_import_unmap(self);
+
+  for (i = 0; i < self->ncols; i++) {
+    free(self->columns[i]);
+  }
+
+  free(self->columns);
+  free(self->fields);
+  free(self->filename);
+  free(self->path);
+  free(self->table);
+  nsql_buf_free(&self->scratch);
+  free(self);
+}
+
+static void nsql_import_execute(napi_env env, void *data) {
+  struct nsql_import *self;
+  int sqlr;
+
+  /* This runs on a libuv worker thread, so it must not call into N-API */
+
+  self = data;
+  sqlr = sqlite3_open_v2(self->filename, &self->db,
+                         SQLITE_OPEN_READWRITE | SQLITE_OPEN_NOMUTEX,
+                         self->vfs);
+
+  if (sqlr != SQLITE_OK) {
+    self->sqlr = sqlr;
+    self->failed = true;
+
+    return;
+  }
+
+  (void)sqlite3_extended_result_codes(self->db, 1);
+  (void)sqlite3_busy_timeout(self->db, NSQL_IMPORT_BUSY_TIMEOUT_MS);
+
+  if (!nsql_import_map(self) || !nsql_import_run(self)) {
+    self->failed = true;
+  }
+}
+
+static void nsql_import_complete(napi_env env, napi_status status,
+                                 void *data) {
+  struct nsql_import *self;
+  napi_value value;
+  napi_status r;
+
+  self = data;
+  self->env = env;
+
+  if (self->exception != NULL) {
+    r = napi_get_reference_value(env, self->exception, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_reject_deferred(env, self->deferred, value);
+  } else if (self->failed) {
+    /* Throw first: rolling back would clobber SQLite's error message */
+
+    (void)nsql_import_throw(self);
+    r = napi_get_and_clear_last_exception(env, &value);
+
+    if (self->txn) {
+      sqlite3_exec(self->db, "ROLLBACK", NULL, NULL, NULL);
+    }
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_reject_deferred(env, self->deferred, value);
+  } else {
+    r = napi_create_int64(env, self->rows, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_resolve_deferred(env, self->deferred, value);
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+end:
+  nsql_import_free(env, self);
+}
+
+#ifdef _WIN32
+
+static bool nsql_import_map(struct nsql_import *self) {
+  LARGE_INTEGER size;
+  HANDLE file;
+  WCHAR *wpath;
+  int nchars;
+
+  file = INVALID_HANDLE_VALUE;
+  nchars = MultiByteToWideChar(CP_UTF8, 0, self->path, -1, NULL, 0);
+  wpath = nchars > 0 ? malloc(nchars * sizeof(*wpath)) : NULL;
+
+  if (wpath != NULL &&
+      MultiByteToWideChar(CP_UTF8, 0, self->path, -1, wpath, nchars) > 0) {
+    file = CreateFileW(wpath, GENERIC_READ, FILE_SHARE_READ, NULL,
+                       OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+  }
+
+  free(wpath);
+
+  if (file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size)) {
+    goto fail;
+  }
+
+  self->nbytes = (size_t)size.QuadPart;
+
+  if (self->nbytes > 0) {
+    self->mapping = CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (self->mapping == NULL) {
+      goto fail;
+    }
+
+    self->bytes = MapViewOfFile(self->mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (self->bytes == NULL) {
+      goto fail;
+    }
+  }
+
+  CloseHandle(file);
+
+  return true;
+
+fail:
+  self->os_error = GetLastError();
+
+  if (file != INVALID_HANDLE_VALUE) {
+    CloseHandle(file);
+  }
+
+  return false;
+}
+
+static void nsql_import_unmap(struct nsql_import *self) {
+  if (self->bytes != NULL) {
+    UnmapViewOfFile(self->bytes);
+  }
+
+  if (self->mapping != NULL) {
+    CloseHandle(self->mapping);
+  }
+
+  self->bytes = NULL;
+  self->mapping = NULL;
+}
+
+#else
+
+static bool nsql_import_map(struct nsql_import *self) {
+  struct stat st;
+  void *bytes;
+  int fd;
+
+  fd = open(self->path, O_RDONLY);
+
+  if (fd < 0 || fstat(fd, &st) != 0) {
+    goto fail;
+  }
+
+  /* mmap() refuses zero-length mappings, and an empty file imports trivially
+     anyway */
+
+  self->nbytes = (size_t)st.st_size;
+
+  if (self->nbytes > 0) {
+    bytes = mmap(NULL, self->nbytes, PROT_READ, MAP_PRIVATE, fd, 0);
+
+    if (bytes == MAP_FAILED) {
+      goto fail;
+    }
+
+    madvise(bytes, self->nbytes, MADV_SEQUENTIAL);
+    self->bytes = bytes;
+  }
+
+  close(fd);
+
+  return true;
+
+fail:
+  self->os_error = (unsigned long)errno;
+
+  if (fd >= 0) {
+    close(fd);
+  }
+
+  return false;
+}
+
+static void nsql_import_unmap(struct nsql_import *self) {
+  if (self->bytes != NULL) {
+    munmap((void *)self->bytes, self->nbytes);
+  }
+
+  self->bytes = NULL;
+}
+
+#endif
+
+static bool nsql_import_run(struct nsql_import *self) {
+  bool found;
+  int64_t n;
+  int sqlr;
+
+  if (self->format == NSQL_IMPORT_CSV) {
+    if (self->header && !nsql_import_csv_header(self)) {
+      return false;
+    }
+  } else if (self->ncols == 0) {
+    /* Take the column names from the keys of the first object */
+
+    if (!nsql_import_ndjson_record(self, true, &found)) {
+      return false;
+    }
+
+    if (!found) {
+      return true;
+    }
+
+    if (self->ncols == 0) {
+      self->pos = self->record;
+
+      return nsql_import_fail(self, "Expected at least one key");
+    }
+
+    self->pos = 0;
+  }
+
+  if (self->ncols > 0 && !nsql_import_prepare(self, self->ncols)) {
+    return false;
+  }
+
+  /* On failure, any open transaction is rolled back once the error has been
+     reported, see nsql_import_complete() */
+
+  do {
+    sqlr = sqlite3_exec(self->db, "BEGIN", NULL, NULL, NULL);
+
+    if (sqlr != SQLITE_OK) {
+      self->sqlr = sqlr;
+
+      return false;
+    }
+
+    self->txn = true;
+
+    for (n = 0; n < self->batch_size; n++) {
+      if (!nsql_import_next(self, &found)) {
+        return false;
+      }
+
+      if (!found) {
+        break;
+      }
+
+      sqlr = sqlite3_step(self->stmt);
+
+      if (sqlr != SQLITE_DONE) {
+        self->sqlr = sqlr;
+
+        return false;
+      }
+
+      sqlite3_reset(self->stmt);
+      sqlite3_clear_bindings(self->stmt);
+      self->rows++;
+    }
+
+    sqlr = sqlite3_exec(self->db, "COMMIT", NULL, NULL, NULL);
+
+    if (sqlr != SQLITE_OK) {
+      self->sqlr = sqlr;
+
+      return false;
+    }
+
+    self->txn = false;
+
+    if (n > 0 && self->on_progress != NULL && !nsql_import_progress(self)) {
+      return false;
+    }
+  } while (found);
+
+  return true;
+}
+
+static bool nsql_import_next(struct nsql_import *self, bool *found) {
+  int nparams;
+
+  if (self->format == NSQL_IMPORT_NDJSON) {
+    return nsql_import_ndjson_record(self, false, found);
+  }
+
+  if (!nsql_import_csv_record(self, found)) {
+    return false;
+  }
+
+  if (!*found) {
+    return true;
+  }
+
+  /* Without any column names the width of the first record decides the
+     shape of the INSERT */
+
+  if (self->stmt == NULL && !nsql_import_prepare(self, self->nfields)) {
+    return false;
+  }
+
+  nparams = sqlite3_bind_parameter_count(self->stmt);
+
+  if (self->nfields != nparams) {
+    self->pos = self->record;
+
+    return nsql_import_fail(self, "Wrong number of fields");
+  }
+
+  return nsql_import_csv_bind(self);
+}
+
+static bool nsql_import_prepare(struct nsql_import *self, int nparams) {
+  sqlite3_str *str;
+  char *sql;
+  int sqlr;
+  int i;
+
+  str = sqlite3_str_new(self->db);
+  sqlite3_str_appendf(str, "INSERT INTO \"%w\"", self->table);
+
+  if (self->ncols > 0) {
+    for (i = 0; i < self->ncols; i++) {
+      sqlite3_str_appendf(str, "%s\"%w\"", i == 0 ? " (" : ",",
+                          self->columns[i]);
+    }
+
+    sqlite3_str_appendall(str, ")");
+  }
+
+  for (i = 0; i < nparams; i++) {
+    sqlite3_str_appendall(str, i == 0 ? " VALUES (?" : ",?");
+  }
+
+  sqlite3_str_appendall(str, ")");
+
+  if (sqlite3_str_errcode(str) != SQLITE_OK) {
+    sqlite3_free(sqlite3_str_finish(str));
+    self->oom = true;
+
+    return false;
+  }
+
+  sql = sqlite3_str_finish(str);
+  sqlr = sqlite3_prepare_v3(self->db, sql, -1, SQLITE_PREPARE_PERSISTENT,
+                            &self->stmt, NULL);
+  sqlite3_free(sql);
+
+  if (sqlr != SQLITE_OK) {
+    self->sqlr = sqlr;
+
+    return false;
+  }
+
+  return true;
+}
+
+static bool nsql_import_progress(struct nsql_import *self) {
+  napi_status r;
+  bool aborted;
+
+  uv_mutex_lock(&self->mutex);
+  self->acked = false;
+  uv_mutex_unlock(&self->mutex);
+
+  r = napi_call_threadsafe_function(self->on_progress, self,
+                                    napi_tsfn_blocking);
+
+  if (r != napi_ok) {
+    /* The environment is being torn down */
+
+    self->aborted = true;
+
+    return false;
+  }
+
+  /* Wait for the callback to return, so that an exception thrown by it stops
+     the import before the next batch */
+
+  uv_mutex_lock(&self->mutex);
+
+  while (!self->acked) {
+    uv_cond_wait(&self->cond, &self->mutex);
+  }
+
+  aborted = self->aborted;
+  uv_mutex_unlock(&self->mutex);
+
+  return !aborted;
+}
+
+static void nsql_import_call_js(napi_env env, napi_value callback, void *ctx,
+                                void *data) {
+  struct nsql_import *self;
+  napi_value nundefined;
+  napi_value nprogress;
+  napi_value exception;
+  napi_value value;
+  napi_status r;
+  bool aborted;
+
+  self = data;
+  aborted = true;
+
+  /* env is NULL if the environment is being torn down */
+
+  if (env == NULL) {
+    goto end;
+  }
+
+  r = napi_create_object(env, &nprogress);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_int64(env, self->rows, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, nprogress, "rows", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_int64(env, (int64_t)self->pos, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, nprogress, "bytes", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_int64(env, (int64_t)self->nbytes, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, nprogress, "totalBytes", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_get_undefined(env, &nundefined);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  /* An exception thrown by the callback aborts the import, and is what the
+     import's promise rejects with */
+
+  r = napi_call_function(env, nundefined, callback, 1, &nprogress, NULL);
+
+  if (r == napi_pending_exception) {
+    r = napi_get_and_clear_last_exception(env, &exception);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_create_reference(env, exception, 1, &self->exception);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    goto end;
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  aborted = false;
+
+end:
+  uv_mutex_lock(&self->mutex);
+  self->acked = true;
+  self->aborted = aborted;
+  uv_cond_signal(&self->cond);
+  uv_mutex_unlock(&self->mutex);
+}
+
+static napi_status nsql_import_throw(struct nsql_import *self) {
+  char msg[512];
+  size_t line;
+  size_t i;
+
+  if (self->oom) {
+    return nsql_throw_oom(self->env);
+  }
+
+  if (self->sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(self->env, self->sqlr, self->db);
+  }
+
+  if (self->os_error != 0) {
+#ifdef _WIN32
+    snprintf(msg, sizeof(msg), "%s: Cannot read file (error %lu)", self->path,
+             self->os_error);
+#else
+    snprintf(msg, sizeof(msg), "%s: %s", self->path,
+             strerror((int)self->os_error));
+#endif
+
+    return napi_throw_error(self->env, NULL, msg);
+  }
+
+  if (self->aborted) {
+    return napi_throw_error(self->env, NULL, "Import aborted");
+  }
+
+  assert(self->error != NULL);
+
+  /* Only count lines once something has gone wrong */
+
+  line = 1;
+
+  for (i = 0; i < self->pos && i < self->nbytes; i++) {
+    if (self->bytes[i] == '\n') {
+      line++;
+    }
+  }
+
+  snprintf(msg, sizeof(msg), "%s:%zu: %s", self->path, line, self->error);
+
+  return napi_throw_error(self->env, NULL, msg);
+}
+
+static bool nsql_import_add_column(struct nsql_import *self,
+                                   const uint8_t *name, size_t nbytes) {
+  char **columns;
+  char *column;
+
+  column = malloc(nbytes + 1);
+
+  if (column == NULL) {
+    self->oom = true;
+
+    return false;
+  }
+
+  columns = realloc(self->columns, (self->ncols + 1) * sizeof(*columns));
+
+  if (columns == NULL) {
+    free(column);
+    self->oom = true;
+
+    return false;
+  }
+
+  memcpy(column, name, nbytes);
+  column[nbytes] = '\0';
+  columns[self->ncols++] = column;
+  self->columns = columns;
+
+  return true;
+}
+
+static bool nsql_import_fail(struct nsql_import *self, const char *error) {
+  self->error = error;
+
+  return false;
+}
+
+static bool nsql_import_csv_header(struct nsql_import *self) {
+  const struct nsql_import_field *field;
+  bool found;
+  int i;
+
+  if (!nsql_import_csv_record(self, &found)) {
+    return false;
+  }
+
+  if (!found) {
+    return true;
+  }
+
+  /* An explicit column list overrides the header row */
+
+  if (self->ncols > 0) {
+    return true;
+  }
+
+  for (i = 0; i < self->nfields; i++) {
+    field = &self->fields[i];
+
+    if (field->flags & NSQL_IMPORT_ESCAPED) {
+      if (!nsql_import_csv_unescape(self, field) ||
+          !nsql_import_add_column(self, self->scratch.bytes,
+                                  self->scratch.nbytes)) {
+        return false;
+      }
+    } else if (!nsql_import_add_column(self, field->bytes, field->nbytes)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool nsql_import_csv_record(struct nsql_import *self, bool *found) {
+  struct nsql_import_field *fields;
+  const uint8_t *start;
+  const uint8_t *end;
+  const uint8_t *p;
+  const uint8_t *q;
+  int capacity;
+  int flags;
+
+  *found = false;
+  end = self->bytes + self->nbytes;
+  p = self->bytes + self->pos;
+
+  /* Skip blank lines */
+
+  while (p < end && (*p == '\n' || *p == '\r')) {
+    p++;
+  }
+
+  self->pos = p - self->bytes;
+  self->record = self->pos;
+  self->nfields = 0;
+
+  if (p == end) {
+    return true;
+  }
+
+  for (;;) {
+    if (p < end && *p == '"') {
+      flags = NSQL_IMPORT_QUOTED;
+      start = ++p;
+
+      for (;;) {
+        q = memchr(p, '"', end - p);
+
+        if (q == NULL) {
+          return nsql_import_fail(self, "Unterminated quoted field");
+        }
+
+        if (q + 1 < end && q[1] == '"') {
+          flags |= NSQL_IMPORT_ESCAPED;
+          p = q + 2;
+
+          continue;
+        }
+
+        break;
+      }
+
+      p = q + 1;
+
+      if (p < end && *p != ',' && *p != '\n' && *p != '\r') {
+        self->pos = p - self->bytes;
+
+        return nsql_import_fail(self, "Unexpected character after quote");
+      }
+    } else {
+      flags = 0;
+      start = p;
+      q = p = nsql_import_scan(p, end, ',', '\n', '\r');
+    }
+
+    if (self->nfields == self->fields_capacity) {
+      capacity = self->fields_capacity > 0 ? self->fields_capacity * 2 : 16;
+      fields = realloc(self->fields, capacity * sizeof(*fields));
+
+      if (fields == NULL) {
+        self->oom = true;
+
+        return false;
+      }
+
+      self->fields = fields;
+      self->fields_capacity = capacity;
+    }
+
+    self->fields[self->nfields].bytes = start;
+    self->fields[self->nfields].nbytes = q - start;
+    self->fields[self->nfields].flags = flags;
+    self->nfields++;
+
+    if (p == end) {
+      break;
+    }
+
+    if (*p == ',') {
+      p++;
+
+      continue;
+    }
+
+    if (*p++ == '\r' && p < end && *p == '\n') {
+      p++;
+    }
+
+    break;
+  }
+
+  self->pos = p - self->bytes;
+  *found = true;
+
+  return true;
+}
+
+static bool nsql_import_csv_bind(struct nsql_import *self) {
+  const struct nsql_import_field *field;
+  int sqlr;
+  int i;
+
+  for (i = 0; i < self->nfields; i++) {
+    field = &self->fields[i];
+
+    /* An empty unquoted field is NULL, whereas "" is an empty string */
+
+    if (field->nbytes == 0 && !(field->flags & NSQL_IMPORT_QUOTED)) {
+      continue;
+    }
+
+    if (field->flags & NSQL_IMPORT_ESCAPED) {
+      if (!nsql_import_csv_unescape(self, field)) {
+        return false;
+      }
+
+      sqlr = sqlite3_bind_text(self->stmt, i + 1,
+                               (const char *)self->scratch.bytes,
+                               self->scratch.nbytes, SQLITE_TRANSIENT);
+    } else {
+      /* The mapping outlives the statement step, so no copy is needed */
+
+      sqlr = sqlite3_bind_text(self->stmt, i + 1, (const char *)field->bytes,
+                               field->nbytes, SQLITE_STATIC);
+    }
+
+    if (!nsql_import_bind(self, sqlr)) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static bool nsql_import_csv_unescape(struct nsql_import *self,
+                                     const struct nsql_import_field *field) {
+  const uint8_t *end;
+  const uint8_t *p;
+  const uint8_t *q;
+
+  self->scratch.nbytes = 0;
+  end = field->bytes + field->nbytes;
+
+  for (p = field->bytes; p < end; p = q + 2) {
+    q = memchr(p, '"', end - p);
+
+    if (q == NULL) {
+      q = end;
+    }
+
+    /* Keep one of each pair of quotes */
+
+    if (!nsql_buf_append(&self->scratch, p, q - p + (q < end))) {
+      self->oom = true;
+
+      return false;
+    }
+
+    if (q == end) {
+      break;
+    }
+  }
+
+  return true;
+}
+
+static bool nsql_import_ndjson_record(struct nsql_import *self, bool infer,
+                                      bool *found) {
+  const uint8_t *name;
+  const uint8_t *end;
+  const uint8_t *p;
+  size_t nbytes;
+  bool copied;
+  int hint;
+  int col;
+
+  *found = false;
+  end = self->bytes + self->nbytes;
+  p = self->bytes + self->pos;
+
+  while (p < end &&
+         (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) {
+    p++;
+  }
+
+  self->pos = p - self->bytes;
+  self->record = self->pos;
+
+  if (p == end) {
+    return true;
+  }
+
+  if (*p != '{') {
+    return nsql_import_fail(self, "Expected an object");
+  }
+
+  p = nsql_import_ws(p + 1, end);
+  hint = 0;
+
+  if (p < end && *p == '}') {
+    p++;
+  } else {
+    for (;;) {
+      if (p == end || *p != '"') {
+        self->pos = p - self->bytes;
+
+        return nsql_import_fail(self, "Expected a string key");
+      }
+
+      if (!nsql_import_json_string(self, &p, &name, &nbytes, &copied)) {
+        return false;
+      }
+
+      if (infer) {
+        if (nsql_import_lookup(self, name, nbytes, &hint) < 0 &&
+            !nsql_import_add_column(self, name, nbytes)) {
+          return false;
+        }
+
+        col = -1;
+      } else {
+        /* Keys that do not name a target column are ignored */
+
+        col = nsql_import_lookup(self, name, nbytes, &hint);
+      }
+
+      p = nsql_import_ws(p, end);
+
+      if (p == end || *p != ':') {
+        self->pos = p - self->bytes;
+
+        return nsql_import_fail(self, "Expected ':'");
+      }
+
+      p = nsql_import_ws(p + 1, end);
+
+      if (!nsql_import_json_value(self, &p, col)) {
+        return false;
+      }
+
+      p = nsql_import_ws(p, end);
+
+      if (p < end && *p == ',') {
+        p = nsql_import_ws(p + 1, end);
+
+        continue;
+      }
+
+      if (p < end && *p == '}') {
+        p++;
+
+        break;
+      }
+
+      self->pos = p - self->bytes;
+
+      return nsql_import_fail(self, "Expected ',' or '}'");
+    }
+  }
+
+  p = nsql_import_ws(p, end);
+
+  if (p < end && *p != '\n' && *p != '\r') {
+    self->pos = p - self->bytes;
+
+    return nsql_import_fail(self, "Expected end of line");
+  }
+
+  if (p < end && *p++ == '\r' && p < end && *p == '\n') {
+    p++;
+  }
+
+  self->pos = p - self->bytes;
+  *found = true;
+
+  return true;
+}
+
+static bool nsql_import_json_value(struct nsql_import *self,
+                                   const uint8_t **pp, int col) {
+  const uint8_t *bytes;
+  const uint8_t *end;
+  const uint8_t *p;
+  size_t nbytes;
+  bool copied;
+  int sqlr;
+
+  end = self->bytes + self->nbytes;
+  p = *pp;
+  sqlr = SQLITE_OK;
+
+  if (p == end) {
+    self->pos = self->nbytes;
+
+    return nsql_import_fail(self, "Expected a value");
+  }
+
+  switch (*p) {
+  case '"':
+    if (!nsql_import_json_string(self, pp, &bytes, &nbytes, &copied)) {
+      return false;
+    }
+
+    if (col >= 0) {
+      sqlr = sqlite3_bind_text(self->stmt, col + 1, (const char *)bytes,
+                               nbytes,
+                               copied ? SQLITE_TRANSIENT : SQLITE_STATIC);
+    }
+
+    return nsql_import_bind(self, sqlr);
+
+  case '{':
+  case '[':
+    /* Nested values are stored as JSON text, for use with SQLite's JSON
+       functions */
+
+    if (!nsql_import_json_skip(self, pp)) {
+      return false;
+    }
+
+    if (col >= 0) {
+      sqlr = sqlite3_bind_text(self->stmt, col + 1, (const char *)p, *pp - p,
+                               SQLITE_STATIC);
+    }
+
+    return nsql_import_bind(self, sqlr);
+
+  case 't':
+  case 'f':
+    if (!nsql_import_json_literal(pp, end, *p == 't' ? "true" : "false")) {
+      break;
+    }
+
+    if (col >= 0) {
+      sqlr = sqlite3_bind_int(self->stmt, col + 1, *p == 't');
+    }
+
+    return nsql_import_bind(self, sqlr);
+
+  case 'n':
+    if (!nsql_import_json_literal(pp, end, "null")) {
+      break;
+    }
+
+    if (col >= 0) {
+      sqlr = sqlite3_bind_null(self->stmt, col + 1);
+    }
+
+    return nsql_import_bind(self, sqlr);
+
+  default:
+    if (*p == '-' || (*p >= '0' && *p <= '9')) {
+      return nsql_import_json_number(self, pp, col);
+    }
+
+    break;
+  }
+
+  self->pos = p - self->bytes;
+
+  return nsql_import_fail(self, "Invalid value");
+}
+
+static bool nsql_import_json_string(struct nsql_import *self,
+                                    const uint8_t **pp, const uint8_t **out,
+                                    size_t *out_nbytes, bool *copied) {
+  uint8_t utf8[4];
+  const uint8_t *start;
+  const uint8_t *end;
+  const uint8_t *p;
+  uint32_t cp;
+  int lo;
+  int hi;
+  char c;
+
+  end = self->bytes + self->nbytes;
+  start = *pp + 1;
+  p = nsql_import_scan(start, end, '"', '\\', '\n');
+
+  /* Fast path: no escapes, so the value can be used in place */
+
+  if (p < end && *p == '"') {
+    *out = start;
+    *out_nbytes = p - start;
+    *copied = false;
+    *pp = p + 1;
+
+    return true;
+  }
+
+  self->scratch.nbytes = 0;
+
+  for (;;) {
+    if (!nsql_buf_append(&self->scratch, start, p - start)) {
+      self->oom = true;
+
+      return false;
+    }
+
+    if (p == end || *p == '\n') {
+      self->pos = *pp - self->bytes;
+
+      return nsql_import_fail(self, "Unterminated string");
+    }
+
+    if (*p == '"') {
+      break;
+    }
+
+    if (p + 1 == end) {
+      self->pos = p - self->bytes;
+
+      return nsql_import_fail(self, "Unterminated string");
+    }
+
+    c = (char)p[1];
+    p += 2;
+
+    switch (c) {
+    case '"':
+    case '\\':
+    case '/':
+      utf8[0] = (uint8_t)c;
+      break;
+
+    case 'b':
+      utf8[0] = '\b';
+      break;
+
+    case 'f':
+      utf8[0] = '\f';
+      break;
+
+    case 'n':
+      utf8[0] = '\n';
+      break;
+
+    case 'r':
+      utf8[0] = '\r';
+      break;
+
+    case 't':
+      utf8[0] = '\t';
+      break;
+
+    case 'u':
+      hi = end - p >= 4 ? nsql_import_hex(p) : -1;
+
+      if (hi < 0) {
+        self->pos = p - self->bytes;
+
+        return nsql_import_fail(self, "Invalid \\u escape");
+      }
+
+      p += 4;
+      cp = (uint32_t)hi;
+
+      /* Combine surrogate pairs; unpaired surrogates become U+FFFD */
+
+      if (hi >= 0xd800 && hi <= 0xdbff && end - p >= 6 && p[0] == '\\' &&
+          p[1] == 'u' && (lo = nsql_import_hex(p + 2)) >= 0xdc00 &&
+          lo <= 0xdfff) {
+        cp = 0x10000 + (((uint32_t)hi - 0xd800) << 10) +
+             ((uint32_t)lo - 0xdc00);
+        p += 6;
+      } else if (hi >= 0xd800 && hi <= 0xdfff) {
+        cp = 0xfffd;
+      }
+
+      if (!nsql_buf_append(&self->scratch, utf8,
+                           nsql_import_utf8(utf8, cp))) {
+        self->oom = true;
+
+        return false;
+      }
+
+      start = p;
+      p = nsql_import_scan(p, end, '"', '\\', '\n');
+
+      continue;
+
+    default:
+      self->pos = p - 2 - self->bytes;
+
+      return nsql_import_fail(self, "Invalid escape sequence");
+    }
+
+    if (!nsql_buf_append(&self->scratch, utf8, 1)) {
+      self->oom = true;
+
+      return false;
+    }
+
+    start = p;
+    p = nsql_import_scan(p, end, '"', '\\', '\n');
+  }
+
+  *out = self->scratch.bytes;
+  *out_nbytes = self->scratch.nbytes;
+  *copied = true;
+  *pp = p + 1;
+
+  return true;
+}
+
+static bool nsql_import_json_number(struct nsql_import *self,
+                                    const uint8_t **pp, int col) {
+  char str[NSQL_IMPORT_MAX_NUMBER];
+  const uint8_t *start;
+  const uint8_t *end;
+  const uint8_t *p;
+  sqlite3_int64 integer;
+  char *str_end;
+  double real;
+  bool is_int;
+  size_t n;
+  int sqlr;
+
+  end = self->bytes + self->nbytes;
+  start = p = *pp;
+  is_int = true;
+
+  while (p < end && ((*p >= '0' && *p <= '9') || *p == '-' || *p == '+' ||
+                     *p == '.' || *p == 'e' || *p == 'E')) {
+    if (*p == '.' || *p == 'e' || *p == 'E') {
+      is_int = false;
+    }
+
+    p++;
+  }
+
+  n = p - start;
+
+  if (n >= sizeof(str)) {
+    self->pos = start - self->bytes;
+
+    return nsql_import_fail(self, "Invalid number");
+  }
+
+  /* The mapped input is not NUL-terminated, so copy the token out before
+     handing it to strtod() */
+
+  memcpy(str, start, n);
+  str[n] = '\0';
+  *pp = p;
+
+  if (is_int) {
+    errno = 0;
+    integer = strtoll(str, &str_end, 10);
+
+    if (*str_end == '\0' && errno == 0) {
+      sqlr = col >= 0 ? sqlite3_bind_int64(self->stmt, col + 1, integer)
+                      : SQLITE_OK;
+
+      return nsql_import_bind(self, sqlr);
+    }
+  }
+
+  /* Integers that overflow 64 bits are stored as REALs */
+
+  real = strtod(str, &str_end);
+
+  if (*str_end != '\0' || n == 0) {
+    self->pos = start - self->bytes;
+
+    return nsql_import_fail(self, "Invalid number");
+  }
+
+  sqlr = col >= 0 ? sqlite3_bind_double(self->stmt, col + 1, real) : SQLITE_OK;
+
+  return nsql_import_bind(self, sqlr);
+}
+
+static bool nsql_import_json_skip(struct nsql_import *self,
+                                  const uint8_t **pp) {
+  const uint8_t *end;
+  const uint8_t *p;
+  size_t depth;
+
+  end = self->bytes + self->nbytes;
+  p = *pp;
+  depth = 0;
+
+  for (; p < end && *p != '\n'; p++) {
+    switch (*p) {
+    case '"':
+      p = nsql_import_scan(p + 1, end, '"', '\\', '\n');
+
+      while (p + 1 < end && *p == '\\') {
+        p = nsql_import_scan(p + 2, end, '"', '\\', '\n');
+      }
+
+      if (p == end || *p != '"') {
+        self->pos = *pp - self->bytes;
+
+        return nsql_import_fail(self, "Unterminated string");
+      }
+
+      break;
+
+    case '[':
+    case '{':
+      depth++;
+      break;
+
+    case ']':
+    case '}':
+      if (--depth == 0) {
+        *pp = p + 1;
+
+        return true;
+      }
+
+      break;
+    }
+  }
+
+  self->pos = *pp - self->bytes;
+
+  return nsql_import_fail(self, "Unterminated value");
+}
+
+static bool nsql_import_json_literal(const uint8_t **pp, const uint8_t *end,
+                                     const char *literal) {
+  size_t n;
+
+  n = strlen(literal);
+
+  if ((size_t)(end - *pp) < n || memcmp(*pp, literal, n) != 0) {
+    return false;
+  }
+
+  *pp += n;
+
+  return true;
+}
+
+static int nsql_import_lookup(struct nsql_import *self, const uint8_t *name,
+                              size_t nbytes, int *hint) {
+  int col;
+  int i;
+
+  /* Rows usually list their keys in the same order, so resume the search
+     after the previous match */
+
+  for (i = 0; i < self->ncols; i++) {
+    col = (*hint + i) % self->ncols;
+
+    if (strncmp(self->columns[col], (const char *)name, nbytes) == 0 &&
+        self->columns[col][nbytes] == '\0') {
+      *hint = col + 1;
+
+      return col;
+    }
+  }
+
+  return -1;
+}
+
+static bool nsql_import_bind(struct nsql_import *self, int sqlr) {
+  if (sqlr != SQLITE_OK) {
+    self->sqlr = sqlr;
+
+    return false;
+  }
+
+  return true;
+}
+
+static const uint8_t *nsql_import_ws(const uint8_t *p, const uint8_t *end) {
+  while (p < end && (*p == ' ' || *p == '\t')) {
+    p++;
+  }
+
+  return p;
+}
+
+static const uint8_t *nsql_import_scan(const uint8_t *p, const uint8_t *end,
+                                       uint8_t a, uint8_t b, uint8_t c) {
+  uint64_t word;
+  uint64_t x;
+  uint64_t y;
+  uint64_t z;
+
+  /* Test eight bytes at a time for any of the three needles, then locate the
+     exact position bytewise. The zero-byte test can report false positives
+     above a genuine match, but never false negatives. */
+
+  while (end - p >= 8) {
+    memcpy(&word, p, sizeof(word));
+    x = word ^ (NSQL_SWAR_ONES * a);
+    y = word ^ (NSQL_SWAR_ONES * b);
+    z = word ^ (NSQL_SWAR_ONES * c);
+
+    if (((x - NSQL_SWAR_ONES) & ~x & NSQL_SWAR_HIGHS) |
+        ((y - NSQL_SWAR_ONES) & ~y & NSQL_SWAR_HIGHS) |
+        ((z - NSQL_SWAR_ONES) & ~z & NSQL_SWAR_HIGHS)) {
+      break;
+    }
+
+    p += 8;
+  }
+
+  while (p < end && *p != a && *p != b && *p != c) {
+    p++;
+  }
+
+  return p;
+}
+
+static int nsql_import_hex(const uint8_t *p) {
+  int value;
+  int i;
+
+  value = 0;
+
+  for (i = 0; i < 4; i++) {
+    value <<= 4;
+
+    if (p[i] >= '0' && p[i] <= '9') {
+      value |= p[i] - '0';
+    } else if (p[i] >= 'a' && p[i] <= 'f') {
+      value |= p[i] - 'a' + 10;
+    } else if (p[i] >= 'A' && p[i] <= 'F') {
+      value |= p[i] - 'A' + 10;
+    } else {
+      return -1;
+    }
+  }
+
+  return value;
+}
+
+static size_t nsql_import_utf8(uint8_t *out, uint32_t cp) {
+  if (cp < 0x80) {
+    out[0] = (uint8_t)cp;
+
+    return 1;
+  }
+
+  if (cp < 0x800) {
+    out[0] = (uint8_t)(0xc0 | cp >> 6);
+    out[1] = (uint8_t)(0x80 | (cp & 0x3f));
+
+    return 2;
+  }
+
+  if (cp < 0x10000) {
+    out[0] = (uint8_t)(0xe0 | cp >> 12);
+    out[1] = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+    out[2] = (uint8_t)(0x80 | (cp & 0x3f));
+
+    return 3;
+  }
+
+  out[0] = (uint8_t)(0xf0 | cp >> 18);
+  out[1] = (uint8_t)(0x80 | ((cp >> 12) & 0x3f));
+  out[2] = (uint8_t)(0x80 | ((cp >> 6) & 0x3f));
+  out[3] = (uint8_t)(0x80 | (cp & 0x3f));
+
+  return 4;
+}
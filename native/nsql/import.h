@@ -0,0 +1,19 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Bulk-load a CSV or NDJSON file into a table. `path`, `table` and `opts` are
+ * the JavaScript arguments supplied by the caller, which are validated here.
+ * The file is parsed in place and every record is bound directly into a single
+ * prepared `INSERT` statement, which is committed in batches.
+ *
+ * The import runs on a libuv worker thread, using a connection of its own to
+ * the same database file, so `db` must be a file database. A Promise for the
+ * number of rows inserted is returned through `out`. Invalid arguments are
+ * thrown synchronously; everything else rejects the Promise.
+ */
+napi_status nsql_import_file(napi_env env, sqlite3 *db, napi_value path,
+                             napi_value table, napi_value opts,
+                             napi_value *out);
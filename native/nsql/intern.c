@@ -0,0 +1,137 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+
+#include "error.h"
+#include "hash.h"
+#include "intern.h"
+#include "str.h"
+
+/* Longest string that is interned. Longer values are unlikely to repeat, and
+   comparing them would cost more than it saves. */
+
+#define NSQL_INTERN_MAX_BYTES 64
+
+/* Hash table size, which must be a power of two, and the number of distinct
+   strings after which no more are added, keeping the load factor at 1/2 */
+
+#define NSQL_INTERN_SLOTS 2048
+#define NSQL_INTERN_MAX_ENTRIES (NSQL_INTERN_SLOTS / 2)
+
+/* Entries refer to their string by its index in the `strings` array, plus
+   one so that zero marks an empty slot */
+
+struct nsql_intern_entry {
+  uint32_t index;
+  uint32_t hash;
+  uint32_t nbytes;
+  char bytes[NSQL_INTERN_MAX_BYTES];
+};
+
+napi_status nsql_intern_init(napi_env env, struct nsql_intern *self) {
+  napi_status r;
+
+  assert(self != NULL);
+
+  memset(self, 0, sizeof(*self));
+
+  r = napi_create_array(env, &self->strings);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
+
+napi_status nsql_intern_get(napi_env env, struct nsql_intern *self,
+                            const char *bytes, size_t nbytes,
+                            napi_value *out) {
+  struct nsql_intern_entry *entry;
+  napi_status r;
+  uint32_t hash;
+  uint32_t slot;
+
+  assert(self != NULL);
+  assert(out != NULL);
+
+  entry = NULL;
+  hash = 0;
+
+  if (nbytes > NSQL_INTERN_MAX_BYTES) {
+    goto create;
+  }
+
+  if (self->slots == NULL) {
+    self->slots = calloc(NSQL_INTERN_SLOTS, sizeof(*self->slots));
+
+    if (self->slots == NULL) {
+      return nsql_throw_oom(env);
+    }
+  }
+
+  hash = nsql_hash32(bytes, nbytes);
+
+  for (slot = hash;; slot++) {
+    entry = &self->slots[slot & (NSQL_INTERN_SLOTS - 1)];
+
+    if (entry->index == 0) {
+      break;
+    }
+
+    if (entry->hash == hash && entry->nbytes == nbytes &&
+        memcmp(entry->bytes, bytes, nbytes) == 0) {
+      self->hits++;
+      r = napi_get_element(env, self->strings, entry->index - 1, out);
+
+      if (r != napi_ok) {
+        nsql_report_error(env, r);
+      }
+
+      return r;
+    }
+  }
+
+  self->misses++;
+
+  /* Once the table is full, convert new strings without remembering them */
+
+  if (self->nentries >= NSQL_INTERN_MAX_ENTRIES) {
+    entry = NULL;
+  }
+
+create:
+  r = nsql_create_string(env, bytes, nbytes, out);
+
+  if (r != napi_ok || entry == NULL) {
+    return r;
+  }
+
+  r = napi_set_element(env, self->strings, self->nentries, *out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  entry->index = self->nentries + 1;
+  entry->hash = hash;
+  entry->nbytes = (uint32_t)nbytes;
+  memcpy(entry->bytes, bytes, nbytes);
+  self->nentries++;
+
+  return napi_ok;
+}
+
+void nsql_intern_free(struct nsql_intern *self) {
+  assert(self != NULL);
+
+  free(self->slots);
+  memset(self, 0, sizeof(*self));
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <node_api.h>
+
+/*
+ * Table of short strings that have already been converted to JavaScript
+ * strings during a single call. Identical TEXT values in a result set then
+ * share a single JavaScript string instead of each allocating their own, which
+ * greatly reduces heap usage for low-cardinality columns.
+ *
+ * The interned strings are held in a JavaScript array, so a table is only
+ * valid within the N-API call that initialized it.
+ */
+struct nsql_intern {
+  struct nsql_intern_entry *slots;
+  napi_value strings;
+  uint32_t nentries;
+  double hits;
+  double misses;
+};
+
+/*
+ * Initialize an empty table. Must be called outside of any handle scope that
+ * is closed before the table is freed.
+ */
+napi_status nsql_intern_init(napi_env env, struct nsql_intern *self);
+
+/*
+ * Convert a UTF-8 string into a JavaScript string, reusing the result of an
+ * earlier conversion of the same bytes if there is one. Strings too long to be
+ * worth interning are always converted afresh.
+ */
+napi_status nsql_intern_get(napi_env env, struct nsql_intern *self,
+                            const char *bytes, size_t nbytes, napi_value *out);
+
+/*
+ * Release all memory owned by a table. A zero-initialized table may be freed
+ * as well.
+ */
+void nsql_intern_free(struct nsql_intern *self);
@@ -0,0 +1,131 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <sqlite3.h>
+#include <uv.h>
+
+#include "interrupt.h"
+
+struct nsql_interrupt_entry {
+  uint32_t handle;
+  sqlite3 *db;
+};
+
+/* The registry is shared by every thread that has loaded the addon, so it is
+   guarded by a mutex. Holding that mutex while calling `sqlite3_interrupt()`
+   guarantees that the connection cannot be closed underneath us. */
+
+static uv_once_t nsql_interrupt_once = UV_ONCE_INIT;
+static uv_mutex_t nsql_interrupt_mutex;
+static struct nsql_interrupt_entry *nsql_interrupt_entries;
+static size_t nsql_interrupt_count;
+static size_t nsql_interrupt_capacity;
+static uint32_t nsql_interrupt_next = 1;
+
+static void nsql_interrupt_init(void);
+
+static struct nsql_interrupt_entry *nsql_interrupt_find(uint32_t handle);
+
+static void nsql_interrupt_init(void) {
+  if (uv_mutex_init(&nsql_interrupt_mutex) != 0) {
+    abort();
+  }
+}
+
+static struct nsql_interrupt_entry *nsql_interrupt_find(uint32_t handle) {
+  size_t i;
+
+  for (i = 0; i < nsql_interrupt_count; i++) {
+    if (nsql_interrupt_entries[i].handle == handle) {
+      return &nsql_interrupt_entries[i];
+    }
+  }
+
+  return NULL;
+}
+
+uint32_t nsql_interrupt_register(sqlite3 *db) {
+  struct nsql_interrupt_entry *entries;
+  size_t capacity;
+  uint32_t handle;
+
+  assert(db != NULL);
+
+  uv_once(&nsql_interrupt_once, nsql_interrupt_init);
+  uv_mutex_lock(&nsql_interrupt_mutex);
+
+  handle = 0;
+
+  if (nsql_interrupt_count == nsql_interrupt_capacity) {
+    capacity = nsql_interrupt_capacity ? nsql_interrupt_capacity * 2 : 16;
+    entries = realloc(nsql_interrupt_entries, capacity * sizeof(*entries));
+
+    if (entries == NULL) {
+      goto end;
+    }
+
+    nsql_interrupt_entries = entries;
+    nsql_interrupt_capacity = capacity;
+  }
+
+  /* Handles are never reused, so that a stale handle held by another thread
+     cannot interrupt an unrelated connection. Skip 0 if we ever wrap. */
+
+  handle = nsql_interrupt_next++;
+
+  if (nsql_interrupt_next == 0) {
+    nsql_interrupt_next = 1;
+  }
+
+  nsql_interrupt_entries[nsql_interrupt_count].handle = handle;
+  nsql_interrupt_entries[nsql_interrupt_count].db = db;
+  nsql_interrupt_count++;
+
+end:
+  uv_mutex_unlock(&nsql_interrupt_mutex);
+
+  return handle;
+}
+
+void nsql_interrupt_unregister(uint32_t handle) {
+  struct nsql_interrupt_entry *entry;
+
+  if (handle == 0) {
+    return;
+  }
+
+  uv_once(&nsql_interrupt_once, nsql_interrupt_init);
+  uv_mutex_lock(&nsql_interrupt_mutex);
+
+  entry = nsql_interrupt_find(handle);
+
+  if (entry != NULL) {
+    *entry = nsql_interrupt_entries[--nsql_interrupt_count];
+  }
+
+  uv_mutex_unlock(&nsql_interrupt_mutex);
+}
+
+bool nsql_interrupt(uint32_t handle) {
+  struct nsql_interrupt_entry *entry;
+
+  if (handle == 0) {
+    return false;
+  }
+
+  uv_once(&nsql_interrupt_once, nsql_interrupt_init);
+  uv_mutex_lock(&nsql_interrupt_mutex);
+
+  entry = nsql_interrupt_find(handle);
+
+  if (entry != NULL) {
+    sqlite3_interrupt(entry->db);
+  }
+
+  uv_mutex_unlock(&nsql_interrupt_mutex);
+
+  return entry != NULL;
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <sqlite3.h>
+
+/*
+ * Process-wide registry of connections that may be interrupted from any
+ * thread. Each registered connection is identified by a small integer handle
+ * which, unlike the `Database` object that owns the connection, can be posted
+ * to a worker thread.
+ */
+
+/*
+ * Register `db` and return its handle, or 0 if memory is exhausted. The
+ * connection must be unregistered before it is closed.
+ */
+uint32_t nsql_interrupt_register(sqlite3 *db);
+
+/*
+ * Remove the connection identified by `handle` from the registry. Once this
+ * returns, no other thread will interrupt the connection through it. Does
+ * nothing if `handle` is 0.
+ */
+void nsql_interrupt_unregister(uint32_t handle);
+
+/*
+ * Call `sqlite3_interrupt()` on the connection identified by `handle`. May be
+ * called from any thread. Returns false if no such connection is registered.
+ */
+bool nsql_interrupt(uint32_t handle);
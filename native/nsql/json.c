@@ -0,0 +1,334 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "json.h"
+
+/* Escape sequences for bytes that may not appear literally inside a JSON
+   string. Zero means that no escaping is needed, 'u' means that a \u00XX
+   escape must be used. Bytes >= 0x80 are passed through, since SQLite TEXT
+   values are already UTF-8. */
+
+static const char nsql_json_escapes[256] = {
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'b', 't', 'n', 'u', 'f', 'r',
+    'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u', 'u',
+    'u', 'u', 'u', 'u', 0,   0,   '"', ['\\'] = '\\'};
+
+static const char nsql_json_hex[] = "0123456789abcdef";
+
+static const char nsql_json_base64[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static bool nsql_json_write_value(struct nsql_buf *buf, sqlite3_stmt *stmt,
+                                  int i);
+
+static bool nsql_json_write_string(struct nsql_buf *buf, const uint8_t *str,
+                                   size_t nbytes);
+
+static bool nsql_json_putc(struct nsql_buf *buf, char c);
+
+bool nsql_json_begin(struct nsql_json *self, sqlite3_stmt *stmt, bool objects) {
+  const char *name;
+  int i;
+
+  assert(self != NULL);
+  assert(stmt != NULL);
+  assert(!self->begun);
+
+  self->ncols = sqlite3_column_count(stmt);
+  self->objects = objects;
+
+  /* Render each `"name":` prefix once up front, rather than once per row */
+
+  if (objects) {
+    self->key_ends = calloc(self->ncols + 1, sizeof(*self->key_ends));
+
+    if (self->key_ends == NULL) {
+      return false;
+    }
+
+    for (i = 0; i < self->ncols; i++) {
+      name = sqlite3_column_name(stmt, i);
+
+      if (name == NULL ||
+          !nsql_json_write_string(&self->keys, (const uint8_t *)name,
+                                  strlen(name)) ||
+          !nsql_json_putc(&self->keys, ':')) {
+        return false;
+      }
+
+      self->key_ends[i] = self->keys.nbytes;
+    }
+  }
+
+  self->begun = true;
+
+  return true;
+}
+
+bool nsql_json_push_row(struct nsql_json *self, sqlite3_stmt *stmt) {
+  assert(self != NULL);
+  assert(self->begun);
+
+  if (!nsql_json_putc(&self->out, self->nrows > 0 ? ',' : '[') ||
+      !nsql_json_write_row(self, &self->out, stmt)) {
+    return false;
+  }
+
+  self->nrows++;
+
+  return true;
+}
+
+bool nsql_json_write_row(const struct nsql_json *self, struct nsql_buf *out,
+                         sqlite3_stmt *stmt) {
+  size_t key_start;
+  int i;
+
+  assert(self != NULL);
+  assert(self->begun);
+  assert(out != NULL);
+
+  if (!nsql_json_putc(out, self->objects ? '{' : '[')) {
+    return false;
+  }
+
+  key_start = 0;
+
+  for (i = 0; i < self->ncols; i++) {
+    if (i > 0 && !nsql_json_putc(out, ',')) {
+      return false;
+    }
+
+    if (self->objects) {
+      if (!nsql_buf_append(out, self->keys.bytes + key_start,
+                           self->key_ends[i] - key_start)) {
+        return false;
+      }
+
+      key_start = self->key_ends[i];
+    }
+
+    if (!nsql_json_write_value(out, stmt, i)) {
+      return false;
+    }
+  }
+
+  return nsql_json_putc(out, self->objects ? '}' : ']');
+}
+
+bool nsql_json_end(struct nsql_json *self) {
+  assert(self != NULL);
+  assert(self->begun);
+
+  /* An empty result set still needs its opening bracket */
+
+  if (self->nrows == 0 && !nsql_json_putc(&self->out, '[')) {
+    return false;
+  }
+
+  return nsql_json_putc(&self->out, ']');
+}
+
+void nsql_json_free(struct nsql_json *self) {
+  assert(self != NULL);
+
+  nsql_buf_free(&self->out);
+  nsql_buf_free(&self->keys);
+  free(self->key_ends);
+
+  memset(self, 0, sizeof(*self));
+}
+
+static bool nsql_json_write_value(struct nsql_buf *buf, sqlite3_stmt *stmt,
+                                  int i) {
+  const uint8_t *bytes;
+
+  switch (sqlite3_column_type(stmt, i)) {
+  case SQLITE_INTEGER:
+    return nsql_json_write_int64(buf, sqlite3_column_int64(stmt, i));
+
+  case SQLITE_FLOAT:
+    return nsql_json_write_double(buf, sqlite3_column_double(stmt, i));
+
+  case SQLITE_TEXT:
+    bytes = sqlite3_column_text(stmt, i);
+
+    if (bytes == NULL) {
+      return false;
+    }
+
+    return nsql_json_write_string(buf, bytes, sqlite3_column_bytes(stmt, i));
+
+  case SQLITE_BLOB:
+    /* JSON has no binary type. Base64 is the most common convention. */
+
+    bytes = sqlite3_column_blob(stmt, i);
+
+    return nsql_json_putc(buf, '"') &&
+           nsql_json_write_base64(buf, bytes, sqlite3_column_bytes(stmt, i)) &&
+           nsql_json_putc(buf, '"');
+
+  default:
+    return nsql_buf_append(buf, "null", 4);
+  }
+}
+
+static bool nsql_json_write_string(struct nsql_buf *buf, const uint8_t *str,
+                                   size_t nbytes) {
+  char esc[6];
+  size_t start;
+  size_t i;
+  char c;
+
+  if (!nsql_json_putc(buf, '"')) {
+    return false;
+  }
+
+  start = 0;
+
+  for (i = 0; i < nbytes; i++) {
+    c = nsql_json_escapes[str[i]];
+
+    if (c == 0) {
+      continue;
+    }
+
+    if (!nsql_buf_append(buf, str + start, i - start)) {
+      return false;
+    }
+
+    esc[0] = '\\';
+    esc[1] = c;
+
+    if (c == 'u') {
+      esc[2] = '0';
+      esc[3] = '0';
+      esc[4] = nsql_json_hex[str[i] >> 4];
+      esc[5] = nsql_json_hex[str[i] & 0xf];
+    }
+
+    if (!nsql_buf_append(buf, esc, c == 'u' ? 6 : 2)) {
+      return false;
+    }
+
+    start = i + 1;
+  }
+
+  return nsql_buf_append(buf, str + start, nbytes - start) &&
+         nsql_json_putc(buf, '"');
+}
+
+bool nsql_json_write_int64(struct nsql_buf *buf, sqlite3_int64 value) {
+  char digits[20];
+  uint64_t mag;
+  size_t n;
+
+  /* Integers are written exactly, never via a double, so that 64-bit values
+     survive the trip into a JSON parser that supports them. */
+
+  mag = value < 0 ? 0 - (uint64_t)value : (uint64_t)value;
+  n = sizeof(digits);
+
+  do {
+    digits[--n] = (char)('0' + mag % 10);
+    mag /= 10;
+  } while (mag > 0);
+
+  if (value < 0 && !nsql_json_putc(buf, '-')) {
+    return false;
+  }
+
+  return nsql_buf_append(buf, digits + n, sizeof(digits) - n);
+}
+
+bool nsql_json_write_double(struct nsql_buf *buf, double value) {
+  char str[32];
+  int precision;
+  int n;
+
+  /* Match JSON.stringify(): non-finite values become null, and integral
+     values are written without a fractional part. */
+
+  if (!isfinite(value)) {
+    return nsql_buf_append(buf, "null", 4);
+  }
+
+  if (value == trunc(value) && fabs(value) < 9007199254740992.0) {
+    return nsql_json_write_int64(buf, (sqlite3_int64)value);
+  }
+
+  /* Find the shortest representation that round-trips */
+
+  for (precision = 15; precision <= 17; precision++) {
+    n = snprintf(str, sizeof(str), "%.*g", precision, value);
+
+    if (strtod(str, NULL) == value) {
+      break;
+    }
+  }
+
+  return nsql_buf_append(buf, str, (size_t)n);
+}
+
+bool nsql_json_write_base64(struct nsql_buf *buf, const uint8_t *bytes,
+                            size_t nbytes) {
+  uint8_t *p;
+  uint32_t v;
+  size_t i;
+
+  if (nbytes == 0) {
+    return true;
+  }
+
+  p = nsql_buf_extend(buf, (nbytes + 2) / 3 * 4);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  for (i = 0; i + 2 < nbytes; i += 3) {
+    v = (uint32_t)bytes[i] << 16 | (uint32_t)bytes[i + 1] << 8 | bytes[i + 2];
+    *p++ = nsql_json_base64[v >> 18];
+    *p++ = nsql_json_base64[(v >> 12) & 0x3f];
+    *p++ = nsql_json_base64[(v >> 6) & 0x3f];
+    *p++ = nsql_json_base64[v & 0x3f];
+  }
+
+  if (i < nbytes) {
+    v = (uint32_t)bytes[i] << 16;
+
+    if (i + 1 < nbytes) {
+      v |= (uint32_t)bytes[i + 1] << 8;
+    }
+
+    *p++ = nsql_json_base64[v >> 18];
+    *p++ = nsql_json_base64[(v >> 12) & 0x3f];
+    *p++ = i + 1 < nbytes ? nsql_json_base64[(v >> 6) & 0x3f] : '=';
+    *p++ = '=';
+  }
+
+  return true;
+}
+
+static bool nsql_json_putc(struct nsql_buf *buf, char c) {
+  uint8_t *p;
+
+  p = nsql_buf_extend(buf, 1);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  *p = (uint8_t)c;
+
+  return true;
+}
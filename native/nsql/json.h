@@ -0,0 +1,77 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <sqlite3.h>
+
+#include "buf.h"
+
+/*
+ * Writer that serializes a result set directly into JSON text, without
+ * creating any intermediate JavaScript objects. A zero-initialized
+ * `struct nsql_json` is ready for use.
+ */
+struct nsql_json {
+  struct nsql_buf out;
+  struct nsql_buf keys;
+  size_t *key_ends;
+  int ncols;
+  bool objects;
+  bool begun;
+  uint64_t nrows;
+};
+
+/*
+ * Start a JSON array of rows. If `objects` is true then each row is written as
+ * an object keyed by column name, otherwise as an array of values. Must be
+ * called once, after the first call to `sqlite3_step()`. Returns false if
+ * memory allocation fails.
+ */
+bool nsql_json_begin(struct nsql_json *self, sqlite3_stmt *stmt, bool objects);
+
+/*
+ * Append the statement's current row. Returns false if memory allocation
+ * fails.
+ */
+bool nsql_json_push_row(struct nsql_json *self, sqlite3_stmt *stmt);
+
+/*
+ * Write the statement's current row to `out` as a single JSON object or array,
+ * with no separator. `self` supplies the row shape and must have been begun.
+ * Returns false if memory allocation fails.
+ */
+bool nsql_json_write_row(const struct nsql_json *self, struct nsql_buf *out,
+                         sqlite3_stmt *stmt);
+
+/*
+ * Terminate the JSON array. The complete UTF-8 text is then available in
+ * `self->out`. Returns false if memory allocation fails.
+ */
+bool nsql_json_end(struct nsql_json *self);
+
+/*
+ * Release all memory owned by a writer.
+ */
+void nsql_json_free(struct nsql_json *self);
+
+/*
+ * Append an integer as exact decimal digits. Returns false if memory
+ * allocation fails.
+ */
+bool nsql_json_write_int64(struct nsql_buf *buf, sqlite3_int64 value);
+
+/*
+ * Append a double as JSON.stringify() would: the shortest representation that
+ * round-trips, or `null` if the value is not finite. Returns false if memory
+ * allocation fails.
+ */
+bool nsql_json_write_double(struct nsql_buf *buf, double value);
+
+/*
+ * Append the base64 encoding of `bytes`, without quotes. Returns false if
+ * memory allocation fails.
+ */
+bool nsql_json_write_base64(struct nsql_buf *buf, const uint8_t *bytes,
+                            size_t nbytes);
@@ -0,0 +1,294 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lz4.h"
+
+/* Size of the compressor's hash table of recent positions, as a power of two.
+   Positions are stored as offsets from the start of the input. */
+
+#define NSQL_LZ4_HASH_BITS 12
+#define NSQL_LZ4_NO_POSITION UINT32_MAX
+
+/* Format constraints: matches are at least four bytes long and at most 64 KiB
+   back, no match may start within the last twelve bytes of the input, and the
+   last five bytes are always literals */
+
+#define NSQL_LZ4_MIN_MATCH 4
+#define NSQL_LZ4_MAX_OFFSET 65535
+#define NSQL_LZ4_MF_LIMIT 12
+#define NSQL_LZ4_LAST_LITERALS 5
+
+static uint32_t nsql_lz4_read32(const uint8_t *p);
+
+static uint32_t nsql_lz4_hash(uint32_t value);
+
+static uint8_t *nsql_lz4_put_length(uint8_t *op, const uint8_t *oend,
+                                    size_t len);
+
+static uint8_t *nsql_lz4_emit(uint8_t *op, const uint8_t *oend,
+                              const uint8_t *lit, size_t nlit, size_t offset,
+                              size_t mlen);
+
+size_t nsql_lz4_compress(const uint8_t *src, size_t nbytes, uint8_t *dst,
+                         size_t cap) {
+  uint32_t table[1 << NSQL_LZ4_HASH_BITS];
+  const uint8_t *anchor;
+  const uint8_t *iend;
+  const uint8_t *ip;
+  const uint8_t *match_limit;
+  const uint8_t *mf_limit;
+  const uint8_t *ref;
+  const uint8_t *oend;
+  uint8_t *op;
+  uint32_t cand;
+  uint32_t h;
+  unsigned misses;
+  size_t mlen;
+
+  if (nbytes > NSQL_LZ4_MAX_INPUT) {
+    return 0;
+  }
+
+  iend = src + nbytes;
+  ip = src;
+  anchor = src;
+  op = dst;
+  oend = dst + cap;
+
+  if (nbytes > NSQL_LZ4_MF_LIMIT) {
+    mf_limit = iend - NSQL_LZ4_MF_LIMIT;
+    match_limit = iend - NSQL_LZ4_LAST_LITERALS;
+    misses = 0;
+    memset(table, 0xff, sizeof(table));
+
+    while (ip < mf_limit) {
+      h = nsql_lz4_hash(nsql_lz4_read32(ip));
+      cand = table[h];
+      table[h] = (uint32_t)(ip - src);
+
+      /* Step faster through input that does not compress */
+
+      if (cand == NSQL_LZ4_NO_POSITION ||
+          (size_t)(ip - src) - cand > NSQL_LZ4_MAX_OFFSET ||
+          nsql_lz4_read32(src + cand) != nsql_lz4_read32(ip)) {
+        misses++;
+        ip += 1 + (misses >> 6);
+
+        continue;
+      }
+
+      ref = src + cand;
+
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        ip--;
+        ref--;
+      }
+
+      mlen = NSQL_LZ4_MIN_MATCH;
+
+      while (ip + mlen < match_limit && ip[mlen] == ref[mlen]) {
+        mlen++;
+      }
+
+      op = nsql_lz4_emit(op, oend, anchor, ip - anchor, ip - ref, mlen);
+
+      if (op == NULL) {
+        return 0;
+      }
+
+      ip += mlen;
+      anchor = ip;
+      misses = 0;
+      table[nsql_lz4_hash(nsql_lz4_read32(ip - 2))] = (uint32_t)(ip - 2 - src);
+    }
+  }
+
+  op = nsql_lz4_emit(op, oend, anchor, iend - anchor, 0, 0);
+
+  if (op == NULL) {
+    return 0;
+  }
+
+  return op - dst;
+}
+
+ptrdiff_t nsql_lz4_decompress(const uint8_t *src, size_t nbytes, uint8_t *dst,
+                              size_t cap) {
+  const uint8_t *iend;
+  const uint8_t *ip;
+  const uint8_t *ref;
+  uint8_t *oend;
+  uint8_t *op;
+  uint8_t token;
+  uint8_t b;
+  size_t offset;
+  size_t nlit;
+  size_t mlen;
+  size_t i;
+
+  ip = src;
+  iend = src + nbytes;
+  op = dst;
+  oend = dst + cap;
+
+  while (ip < iend) {
+    token = *ip++;
+    nlit = token >> 4;
+
+    if (nlit == 15) {
+      do {
+        if (ip >= iend) {
+          return -1;
+        }
+
+        b = *ip++;
+        nlit += b;
+      } while (b == 255);
+    }
+
+    if ((size_t)(iend - ip) < nlit || (size_t)(oend - op) < nlit) {
+      return -1;
+    }
+
+    memcpy(op, ip, nlit);
+    ip += nlit;
+    op += nlit;
+
+    /* The last sequence has no match */
+
+    if (ip == iend) {
+      break;
+    }
+
+    if (iend - ip < 2) {
+      return -1;
+    }
+
+    offset = ip[0] | (size_t)ip[1] << 8;
+    ip += 2;
+
+    if (offset == 0 || offset > (size_t)(op - dst)) {
+      return -1;
+    }
+
+    mlen = token & 15;
+
+    if (mlen == 15) {
+      do {
+        if (ip >= iend) {
+          return -1;
+        }
+
+        b = *ip++;
+        mlen += b;
+      } while (b == 255);
+    }
+
+    mlen += NSQL_LZ4_MIN_MATCH;
+
+    if ((size_t)(oend - op) < mlen) {
+      return -1;
+    }
+
+    /* A match may overlap the output it is copying, repeating it */
+
+    ref = op - offset;
+
+    if (offset >= mlen) {
+      memcpy(op, ref, mlen);
+    } else {
+      for (i = 0; i < mlen; i++) {
+        op[i] = ref[i];
+      }
+    }
+
+    op += mlen;
+  }
+
+  return op - dst;
+}
+
+static uint32_t nsql_lz4_read32(const uint8_t *p) {
+  uint32_t value;
+
+  memcpy(&value, p, sizeof(value));
+
+  return value;
+}
+
+static uint32_t nsql_lz4_hash(uint32_t value) {
+  return (value * 2654435761u) >> (32 - NSQL_LZ4_HASH_BITS);
+}
+
+static uint8_t *nsql_lz4_put_length(uint8_t *op, const uint8_t *oend,
+                                    size_t len) {
+  while (len >= 255) {
+    if (op >= oend) {
+      return NULL;
+    }
+
+    *op++ = 255;
+    len -= 255;
+  }
+
+  if (op >= oend) {
+    return NULL;
+  }
+
+  *op++ = (uint8_t)len;
+
+  return op;
+}
+
+static uint8_t *nsql_lz4_emit(uint8_t *op, const uint8_t *oend,
+                              const uint8_t *lit, size_t nlit, size_t offset,
+                              size_t mlen) {
+  uint8_t *token;
+  size_t m;
+
+  /* A sequence is a token holding both lengths, extra length bytes for the
+     literals, the literals, the match offset and extra length bytes for the
+     match. `mlen` is zero for the final sequence, which has no match. */
+
+  if (op >= oend) {
+    return NULL;
+  }
+
+  token = op++;
+  *token = (uint8_t)((nlit >= 15 ? 15 : nlit) << 4);
+
+  if (nlit >= 15) {
+    op = nsql_lz4_put_length(op, oend, nlit - 15);
+
+    if (op == NULL) {
+      return NULL;
+    }
+  }
+
+  if ((size_t)(oend - op) < nlit) {
+    return NULL;
+  }
+
+  memcpy(op, lit, nlit);
+  op += nlit;
+
+  if (mlen == 0) {
+    return op;
+  }
+
+  if (oend - op < 2) {
+    return NULL;
+  }
+
+  *op++ = (uint8_t)(offset & 0xff);
+  *op++ = (uint8_t)(offset >> 8);
+  m = mlen - NSQL_LZ4_MIN_MATCH;
+  *token |= (uint8_t)(m >= 15 ? 15 : m);
+
+  if (m >= 15) {
+    op = nsql_lz4_put_length(op, oend, m - 15);
+  }
+
+  return op;
+}
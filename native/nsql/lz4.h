@@ -0,0 +1,28 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Minimal implementation of the LZ4 block format, see
+ * https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md. Only single
+ * blocks of up to `NSQL_LZ4_MAX_INPUT` bytes are supported, which is enough
+ * for database pages.
+ */
+#define NSQL_LZ4_MAX_INPUT (1 << 20)
+
+/*
+ * Compress `nbytes` bytes from `src` into at most `cap` bytes at `dst`. Returns
+ * the compressed size, or zero if the result would not fit, in which case the
+ * contents of `dst` are unspecified.
+ */
+size_t nsql_lz4_compress(const uint8_t *src, size_t nbytes, uint8_t *dst,
+                         size_t cap);
+
+/*
+ * Decompress the `nbytes` bytes at `src` into at most `cap` bytes at `dst`.
+ * Returns the decompressed size, or -1 if the input is malformed or would
+ * decompress to more than `cap` bytes.
+ */
+ptrdiff_t nsql_lz4_decompress(const uint8_t *src, size_t nbytes, uint8_t *dst,
+                              size_t cap);
@@ -0,0 +1,228 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "error.h"
+#include "macros.h"
+#include "memory.h"
+#include "options.h"
+
+/* Changes in the page cache's size smaller than this are not reported, since
+   each report may prompt V8 to reconsider its garbage collection schedule */
+
+#define NSQL_MEMORY_THRESHOLD (64 * 1024)
+
+struct nsql_memory {
+  int refs;
+  sqlite3 *db;
+  int64_t reported;
+};
+
+struct nsql_memory_field {
+  const char *name;
+  double value;
+};
+
+static napi_status nsql_memory_report(napi_env env, struct nsql_memory *self,
+                                      int64_t nbytes);
+
+struct nsql_memory *nsql_memory_alloc(sqlite3 *db) {
+  struct nsql_memory *self;
+
+  assert(db != NULL);
+
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->refs = 1;
+  self->db = db;
+
+  return self;
+}
+
+struct nsql_memory *nsql_memory_retain(struct nsql_memory *self) {
+  if (self != NULL) {
+    assert(self->refs > 0);
+    self->refs++;
+  }
+
+  return self;
+}
+
+void nsql_memory_release(napi_env env, struct nsql_memory *self) {
+  if (self == NULL) {
+    return;
+  }
+
+  assert(self->refs > 0);
+
+  if (--self->refs > 0) {
+    return;
+  }
+
+  (void)nsql_memory_report(env, self, 0);
+  free(self);
+}
+
+napi_status nsql_memory_update(napi_env env, struct nsql_memory *self) {
+  int64_t delta;
+  int cur;
+  int hi;
+  int sqlr;
+
+  if (self == NULL || self->db == NULL) {
+    return napi_ok;
+  }
+
+  sqlr = sqlite3_db_status(self->db, SQLITE_DBSTATUS_CACHE_USED, &cur, &hi, 0);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, NULL);
+  }
+
+  delta = (int64_t)cur - self->reported;
+
+  if (delta > -NSQL_MEMORY_THRESHOLD && delta < NSQL_MEMORY_THRESHOLD) {
+    return napi_ok;
+  }
+
+  return nsql_memory_report(env, self, cur);
+}
+
+napi_status nsql_memory_detach(napi_env env, struct nsql_memory *self) {
+  if (self == NULL) {
+    return napi_ok;
+  }
+
+  self->db = NULL;
+
+  return nsql_memory_report(env, self, 0);
+}
+
+napi_status nsql_memory_heap_limit(napi_env env, napi_value opts,
+                                   napi_value *out) {
+  struct nsql_memory_field fields[2];
+  sqlite3_int64 cur;
+  sqlite3_int64 hi;
+  napi_value obj;
+  napi_value num;
+  napi_status r;
+  double soft;
+  double hard;
+  size_t i;
+  bool ok;
+  int sqlr;
+
+  assert(out != NULL);
+
+  *out = NULL;
+  soft = -1;
+  hard = -1;
+
+  r = nsql_options_get_double(env, opts, "soft", &soft, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_options_get_double(env, opts, "hard", &hard, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  sqlr = sqlite3_initialize();
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, NULL);
+
+    goto end;
+  }
+
+  /* SQLite accepts but ignores heap limits when it is not tracking memory
+     usage, in which case its usage counter stays at zero */
+
+  if (soft > 0 || hard > 0) {
+    (void)sqlite3_status64(SQLITE_STATUS_MEMORY_USED, &cur, &hi, 0);
+
+    if (cur == 0) {
+      r = napi_throw_error(env, NULL,
+                           "Heap limits require memory statistics, see the "
+                           "nsql_memstatus build variable");
+
+      goto end;
+    }
+  }
+
+  /* A negative limit queries the current value without changing it. The hard
+     limit goes first because setting it may also lower the soft limit. */
+
+  (void)sqlite3_hard_heap_limit64((sqlite3_int64)hard);
+  (void)sqlite3_soft_heap_limit64((sqlite3_int64)soft);
+
+  fields[0].name = "soft";
+  fields[0].value = (double)sqlite3_soft_heap_limit64(-1);
+  fields[1].name = "hard";
+  fields[1].value = (double)sqlite3_hard_heap_limit64(-1);
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  for (i = 0; i < countof(fields); i++) {
+    r = napi_create_double(env, fields[i].value, &num);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_set_named_property(env, obj, fields[i].name, num);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+  }
+
+  *out = obj;
+
+end:
+  return r;
+}
+
+static napi_status nsql_memory_report(napi_env env, struct nsql_memory *self,
+                                      int64_t nbytes) {
+  napi_status r;
+  int64_t total;
+
+  if (nbytes == self->reported) {
+    return napi_ok;
+  }
+
+  r = napi_adjust_external_memory(env, nbytes - self->reported, &total);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  self->reported = nbytes;
+
+  return napi_ok;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Reports the memory held by a connection's page cache to V8 as external
+ * memory. Without this, V8 only sees the few bytes of each wrapper object and
+ * has no reason to collect abandoned connections and statements promptly,
+ * however much native memory they keep alive.
+ *
+ * An accounting record is shared between a connection's wrapper object and all
+ * of its statements, which may outlive the wrapper, and is reference counted.
+ */
+struct nsql_memory;
+
+/*
+ * Allocate an accounting record for `db` with a reference count of one and
+ * nothing reported yet. Returns NULL if memory allocation fails.
+ */
+struct nsql_memory *nsql_memory_alloc(sqlite3 *db);
+
+/*
+ * Increment the reference count of an accounting record and return it. Does
+ * nothing if `self` is NULL.
+ */
+struct nsql_memory *nsql_memory_retain(struct nsql_memory *self);
+
+/*
+ * Decrement the reference count of an accounting record, withdrawing whatever
+ * it still reports and freeing it once the count reaches zero. Does nothing if
+ * `self` is NULL.
+ */
+void nsql_memory_release(napi_env env, struct nsql_memory *self);
+
+/*
+ * Measure the connection's page cache and report any significant change in
+ * its size to V8. Does nothing if `self` is NULL or has been detached.
+ */
+napi_status nsql_memory_update(napi_env env, struct nsql_memory *self);
+
+/*
+ * Withdraw everything reported so far and stop measuring. Must be called
+ * before the connection is closed.
+ */
+napi_status nsql_memory_detach(napi_env env, struct nsql_memory *self);
+
+/*
+ * Apply the `soft` and `hard` properties of the JavaScript options object
+ * `opts`, if present, as SQLite's process-wide heap limits, then return the
+ * limits in effect as a JavaScript object. A JavaScript exception is thrown if
+ * a limit is set while SQLite's memory statistics are disabled, since SQLite
+ * would silently ignore it; see the `nsql_memstatus` build variable.
+ */
+napi_status nsql_memory_heap_limit(napi_env env, napi_value opts,
+                                   napi_value *out);
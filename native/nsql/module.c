@@ -1,9 +1,12 @@
 #include <node_api.h>
 #include <sqlite3.h>
 
+#include "compress.h"
 #include "database.h"
 #include "dprintf.h"
 #include "error.h"
+#include "str.h"
+#include "uring.h"
 
 static void nsql_log(void *ctx, int code, const char *msg);
 
@@ -13,12 +16,28 @@ static void nsql_log(void *ctx, int code, const char *msg) {
 
 napi_value nsql_init(napi_env env, napi_value exports) {
   napi_value nclass;
+  int sqlr;
   int r;
 
   sqlite3_config(SQLITE_CONFIG_LOG, nsql_log, NULL);
+  nsql_str_init();
+  nclass = NULL;
+
+  sqlr = nsql_uring_register();
+
+  if (sqlr == SQLITE_OK) {
+    sqlr = nsql_compress_register();
+  }
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, NULL);
+
+    goto end;
+  }
 
   r = nsql_database_define_class(env, &nclass);
 
+end:
   return nsql_return(env, r, nclass);
 }
 
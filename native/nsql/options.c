@@ -0,0 +1,210 @@
+#include <assert.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <node_api.h>
+
+#include "error.h"
+#include "options.h"
+
+static napi_status nsql_options_get(napi_env env, napi_value opts,
+                                    const char *name, napi_valuetype expected,
+                                    const char *expected_name, napi_value *out,
+                                    bool *ok);
+
+napi_status nsql_options_get_bool(napi_env env, napi_value opts,
+                                  const char *name, bool *out, bool *ok) {
+  napi_value value;
+  napi_status r;
+
+  assert(out != NULL);
+  assert(ok != NULL);
+
+  r = nsql_options_get(env, opts, name, napi_boolean, "boolean", &value, ok);
+
+  if (r != napi_ok || !*ok || value == NULL) {
+    goto end;
+  }
+
+  r = napi_get_value_bool(env, value, out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return r;
+}
+
+napi_status nsql_options_get_double(napi_env env, napi_value opts,
+                                    const char *name, double *out, bool *ok) {
+  char msg[128];
+  napi_value value;
+  napi_status r;
+  double num;
+
+  assert(out != NULL);
+  assert(ok != NULL);
+
+  r = nsql_options_get(env, opts, name, napi_number, "number", &value, ok);
+
+  if (r != napi_ok || !*ok || value == NULL) {
+    goto end;
+  }
+
+  r = napi_get_value_double(env, value, &num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (!isfinite(num) || num < 0) {
+    snprintf(msg, sizeof(msg), "%s: Expected a non-negative number", name);
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE", msg);
+    *ok = false;
+
+    goto end;
+  }
+
+  *out = num;
+
+end:
+  return r;
+}
+
+napi_status nsql_options_get_enum(napi_env env, napi_value opts,
+                                  const char *name, const char *const *choices,
+                                  int *out, bool *ok) {
+  char msg[128];
+  char str[32];
+  napi_value value;
+  napi_status r;
+  size_t nbytes;
+  int i;
+
+  assert(choices != NULL);
+  assert(out != NULL);
+  assert(ok != NULL);
+
+  r = nsql_options_get(env, opts, name, napi_string, "string", &value, ok);
+
+  if (r != napi_ok || !*ok || value == NULL) {
+    goto end;
+  }
+
+  /* Anything too long to fit is truncated, and therefore won't match */
+
+  r = napi_get_value_string_utf8(env, value, str, sizeof(str), &nbytes);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  for (i = 0; choices[i] != NULL; i++) {
+    if (strlen(choices[i]) == nbytes && memcmp(choices[i], str, nbytes) == 0) {
+      *out = i;
+
+      goto end;
+    }
+  }
+
+  snprintf(msg, sizeof(msg), "%s: Unsupported value", name);
+  r = napi_throw_type_error(env, "ERR_INVALID_ARG_VALUE", msg);
+  *ok = false;
+
+end:
+  return r;
+}
+
+napi_status nsql_options_get_object(napi_env env, napi_value opts,
+                                    const char *name, napi_value *out,
+                                    bool *ok) {
+  return nsql_options_get(env, opts, name, napi_object, "object", out, ok);
+}
+
+napi_status nsql_options_get_function(napi_env env, napi_value opts,
+                                      const char *name, napi_value *out,
+                                      bool *ok) {
+  return nsql_options_get(env, opts, name, napi_function, "function", out, ok);
+}
+
+static napi_status nsql_options_get(napi_env env, napi_value opts,
+                                    const char *name, napi_valuetype expected,
+                                    const char *expected_name, napi_value *out,
+                                    bool *ok) {
+  char msg[128];
+  napi_valuetype type;
+  napi_value value;
+  napi_status r;
+
+  assert(name != NULL);
+  assert(out != NULL);
+  assert(ok != NULL);
+
+  *out = NULL;
+  *ok = false;
+
+  r = napi_typeof(env, opts, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type == napi_undefined) {
+    *ok = true;
+
+    goto end;
+  }
+
+  if (type != napi_object) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "options: Expected object");
+
+    goto end;
+  }
+
+  r = napi_get_named_property(env, opts, name, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_typeof(env, value, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type == napi_undefined) {
+    *ok = true;
+
+    goto end;
+  }
+
+  if (type != expected) {
+    snprintf(msg, sizeof(msg), "%s: Expected %s", name, expected_name);
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE", msg);
+
+    goto end;
+  }
+
+  *out = value;
+  *ok = true;
+
+end:
+  return r;
+}
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <node_api.h>
+
+/*
+ * Read an optional boolean property named `name` from an options object.
+ *
+ * `opts` may be `undefined`, in which case `*out` is left untouched. The same
+ * applies if the property itself is absent or `undefined`. Otherwise the
+ * property must be a boolean, and a JavaScript `TypeError` is thrown if it is
+ * not.
+ *
+ * `*ok` is set to false if a JavaScript exception was thrown.
+ */
+napi_status nsql_options_get_bool(napi_env env, napi_value opts,
+                                  const char *name, bool *out, bool *ok);
+
+/*
+ * Read an optional non-negative numeric property named `name` from an options
+ * object. The same conventions as `nsql_options_get_bool()` apply, except that
+ * the property must be a finite, non-negative number.
+ */
+napi_status nsql_options_get_double(napi_env env, napi_value opts,
+                                    const char *name, double *out, bool *ok);
+
+/*
+ * Read an optional string property named `name` from an options object and
+ * match it against a NULL-terminated array of permitted values. The index of
+ * the matching value is written to `*out`. The same conventions as
+ * `nsql_options_get_bool()` apply, except that the property must be a string
+ * and a JavaScript `TypeError` is also thrown if it does not match any of the
+ * permitted values.
+ */
+napi_status nsql_options_get_enum(napi_env env, napi_value opts,
+                                  const char *name, const char *const *choices,
+                                  int *out, bool *ok);
+
+/*
+ * Read an optional object property named `name` from an options object. The
+ * property's value is returned through `*out`, which is set to NULL if it is
+ * absent. The same conventions as `nsql_options_get_bool()` apply, except that
+ * the property must be an object (which includes arrays).
+ */
+napi_status nsql_options_get_object(napi_env env, napi_value opts,
+                                    const char *name, napi_value *out,
+                                    bool *ok);
+
+/*
+ * Read an optional function property named `name` from an options object. The
+ * same conventions as `nsql_options_get_object()` apply, except that the
+ * property must be a function.
+ */
+napi_status nsql_options_get_function(napi_env env, napi_value opts,
+                                      const char *name, napi_value *out,
+                                      bool *ok);
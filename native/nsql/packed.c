@@ -0,0 +1,351 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+#include "error.h"
+#include "packed.h"
+
+#define NSQL_PACKED_MAGIC 0x5051534eu /* "NSQP" */
+#define NSQL_PACKED_VERSION 1u
+#define NSQL_PACKED_HEADER_SIZE 32
+#define NSQL_PACKED_CELL_SIZE 16
+
+/* All multi-byte fields are little-endian regardless of host byte order, so
+   that a packed result can be decoded anywhere it is sent. */
+
+static uint8_t *nsql_packed_extend_row(struct nsql_packed *self);
+
+static bool nsql_packed_put_cell(struct nsql_packed *self, uint8_t *p,
+                                 int type, uint64_t bits, const void *bytes,
+                                 int nbytes);
+
+static void nsql_packed_put_u32(uint8_t *p, uint32_t v);
+
+static void nsql_packed_put_u64(uint8_t *p, uint64_t v);
+
+static uint32_t nsql_packed_get_u32(const uint8_t *p);
+
+static uint64_t nsql_packed_get_u64(const uint8_t *p);
+
+bool nsql_packed_begin(struct nsql_packed *self, sqlite3_stmt *stmt) {
+  const char *name;
+  uint8_t *p;
+  size_t nbytes;
+  size_t pad;
+  int ncols;
+  int i;
+
+  assert(self != NULL);
+  assert(stmt != NULL);
+  assert(!self->begun);
+
+  ncols = sqlite3_column_count(stmt);
+  p = nsql_buf_extend(&self->head, NSQL_PACKED_HEADER_SIZE);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  memset(p, 0, NSQL_PACKED_HEADER_SIZE);
+
+  for (i = 0; i < ncols; i++) {
+    name = sqlite3_column_name(stmt, i);
+
+    if (name == NULL) {
+      return false;
+    }
+
+    nbytes = strlen(name);
+    p = nsql_buf_extend(&self->head, 4);
+
+    if (p == NULL) {
+      return false;
+    }
+
+    nsql_packed_put_u32(p, (uint32_t)nbytes);
+
+    if (!nsql_buf_append(&self->head, name, nbytes)) {
+      return false;
+    }
+  }
+
+  /* Align the cell table so that the decoder's 64-bit reads are aligned */
+
+  pad = (8 - self->head.nbytes % 8) % 8;
+  p = nsql_buf_extend(&self->head, pad);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  memset(p, 0, pad);
+
+  self->ncols = (uint32_t)ncols;
+  self->begun = true;
+
+  return true;
+}
+
+bool nsql_packed_push_row(struct nsql_packed *self, sqlite3_stmt *stmt) {
+  const void *bytes;
+  uint64_t bits;
+  uint8_t *p;
+  double real;
+  int nbytes;
+  int type;
+  uint32_t i;
+
+  assert(self != NULL);
+  assert(self->begun);
+
+  p = nsql_packed_extend_row(self);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  for (i = 0; i < self->ncols; i++, p += NSQL_PACKED_CELL_SIZE) {
+    type = sqlite3_column_type(stmt, (int)i);
+    bytes = NULL;
+    bits = 0;
+    nbytes = 0;
+
+    switch (type) {
+    case SQLITE_INTEGER:
+      bits = (uint64_t)sqlite3_column_int64(stmt, (int)i);
+
+      break;
+
+    case SQLITE_FLOAT:
+      real = sqlite3_column_double(stmt, (int)i);
+      memcpy(&bits, &real, sizeof(bits));
+
+      break;
+
+    case SQLITE_TEXT:
+    case SQLITE_BLOB:
+      if (type == SQLITE_TEXT) {
+        bytes = sqlite3_column_text(stmt, (int)i);
+      } else {
+        bytes = sqlite3_column_blob(stmt, (int)i);
+      }
+
+      nbytes = sqlite3_column_bytes(stmt, (int)i);
+
+      if (nbytes > 0 && bytes == NULL) {
+        return false;
+      }
+
+      break;
+
+    default:
+      type = SQLITE_NULL;
+
+      break;
+    }
+
+    if (!nsql_packed_put_cell(self, p, type, bits, bytes, nbytes)) {
+      return false;
+    }
+  }
+
+  self->nrows++;
+
+  return true;
+}
+
+bool nsql_packed_push_values(struct nsql_packed *self,
+                             const struct nsql_packed_value *values) {
+  const struct nsql_packed_value *value;
+  uint64_t bits;
+  uint8_t *p;
+  uint32_t i;
+
+  assert(self != NULL);
+  assert(self->begun);
+
+  p = nsql_packed_extend_row(self);
+
+  if (p == NULL) {
+    return false;
+  }
+
+  for (i = 0; i < self->ncols; i++, p += NSQL_PACKED_CELL_SIZE) {
+    value = &values[i];
+
+    if (value->type == SQLITE_FLOAT) {
+      memcpy(&bits, &value->f, sizeof(bits));
+    } else {
+      bits = (uint64_t)value->i;
+    }
+
+    if (!nsql_packed_put_cell(self, p, value->type, bits, value->bytes,
+                              (int)value->nbytes)) {
+      return false;
+    }
+  }
+
+  self->nrows++;
+
+  return true;
+}
+
+void nsql_packed_get(const struct nsql_packed *self, uint32_t row,
+                     uint32_t col, struct nsql_packed_value *out) {
+  const uint8_t *p;
+  uint64_t bits;
+
+  assert(self != NULL);
+  assert(row < self->nrows && col < self->ncols);
+  assert(out != NULL);
+
+  p = self->cells.bytes +
+      ((size_t)row * self->ncols + col) * NSQL_PACKED_CELL_SIZE;
+  bits = nsql_packed_get_u64(p + 8);
+
+  memset(out, 0, sizeof(*out));
+  out->type = (int)nsql_packed_get_u32(p);
+
+  switch (out->type) {
+  case SQLITE_INTEGER:
+    out->i = (int64_t)bits;
+
+    break;
+
+  case SQLITE_FLOAT:
+    memcpy(&out->f, &bits, sizeof(out->f));
+
+    break;
+
+  case SQLITE_TEXT:
+  case SQLITE_BLOB:
+    out->bytes = self->heap.bytes + bits;
+    out->nbytes = nsql_packed_get_u32(p + 4);
+
+    break;
+  }
+}
+
+napi_status nsql_packed_finish(napi_env env, struct nsql_packed *self,
+                               napi_value *out) {
+  napi_value buffer;
+  uint8_t *dest;
+  void *bytes;
+  size_t nbytes;
+  napi_status r;
+
+  assert(self != NULL);
+  assert(self->begun);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  /* Header: magic, version, column count, row count, offset of the cell
+     table, offset of the heap. Column names follow. */
+
+  dest = self->head.bytes;
+  nsql_packed_put_u32(dest, NSQL_PACKED_MAGIC);
+  nsql_packed_put_u32(dest + 4, NSQL_PACKED_VERSION);
+  nsql_packed_put_u32(dest + 8, self->ncols);
+  nsql_packed_put_u32(dest + 12, self->nrows);
+  nsql_packed_put_u64(dest + 16, self->head.nbytes);
+  nsql_packed_put_u64(dest + 24, self->head.nbytes + self->cells.nbytes);
+
+  nbytes = self->head.nbytes + self->cells.nbytes + self->heap.nbytes;
+  r = napi_create_arraybuffer(env, nbytes, &bytes, &buffer);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  dest = bytes;
+  memcpy(dest, self->head.bytes, self->head.nbytes);
+  dest += self->head.nbytes;
+
+  if (self->cells.nbytes > 0) {
+    memcpy(dest, self->cells.bytes, self->cells.nbytes);
+    dest += self->cells.nbytes;
+  }
+
+  if (self->heap.nbytes > 0) {
+    memcpy(dest, self->heap.bytes, self->heap.nbytes);
+  }
+
+  *out = buffer;
+
+  return r;
+}
+
+void nsql_packed_free(struct nsql_packed *self) {
+  assert(self != NULL);
+
+  nsql_buf_free(&self->head);
+  nsql_buf_free(&self->cells);
+  nsql_buf_free(&self->heap);
+
+  self->ncols = 0;
+  self->nrows = 0;
+  self->begun = false;
+}
+
+static uint8_t *nsql_packed_extend_row(struct nsql_packed *self) {
+  if (self->nrows == UINT32_MAX) {
+    return NULL;
+  }
+
+  return nsql_buf_extend(&self->cells,
+                         (size_t)self->ncols * NSQL_PACKED_CELL_SIZE);
+}
+
+static bool nsql_packed_put_cell(struct nsql_packed *self, uint8_t *p,
+                                 int type, uint64_t bits, const void *bytes,
+                                 int nbytes) {
+  /* Each cell is a 32-bit type tag, a 32-bit byte length (TEXT and BLOB
+     only), then 64 bits of payload: an INTEGER or REAL value inline, or the
+     offset of a TEXT or BLOB value within the heap. */
+
+  if (type == SQLITE_TEXT || type == SQLITE_BLOB) {
+    bits = self->heap.nbytes;
+
+    if (!nsql_buf_append(&self->heap, bytes, (size_t)nbytes)) {
+      return false;
+    }
+  } else {
+    nbytes = 0;
+  }
+
+  nsql_packed_put_u32(p, (uint32_t)type);
+  nsql_packed_put_u32(p + 4, (uint32_t)nbytes);
+  nsql_packed_put_u64(p + 8, bits);
+
+  return true;
+}
+
+static void nsql_packed_put_u32(uint8_t *p, uint32_t v) {
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static void nsql_packed_put_u64(uint8_t *p, uint64_t v) {
+  nsql_packed_put_u32(p, (uint32_t)v);
+  nsql_packed_put_u32(p + 4, (uint32_t)(v >> 32));
+}
+
+static uint32_t nsql_packed_get_u32(const uint8_t *p) {
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 |
+         (uint32_t)p[3] << 24;
+}
+
+static uint64_t nsql_packed_get_u64(const uint8_t *p) {
+  return nsql_packed_get_u32(p) | (uint64_t)nsql_packed_get_u32(p + 4) << 32;
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "buf.h"
+
+/*
+ * Writer for the packed result set format, which encodes an entire result set
+ * into a single ArrayBuffer so that it can be returned to JavaScript in one
+ * N-API call. The layout is documented in INTERNALS.md and decoded by
+ * `src/packed.js`; the two must be kept in sync.
+ *
+ * A zero-initialized `struct nsql_packed` is ready for use.
+ */
+struct nsql_packed {
+  struct nsql_buf head;
+  struct nsql_buf cells;
+  struct nsql_buf heap;
+  uint32_t ncols;
+  uint32_t nrows;
+  bool begun;
+};
+
+/*
+ * A single value in a packed result set. `i` holds INTEGER values, `f` REAL
+ * values, and `bytes` and `nbytes` the contents of TEXT and BLOB values.
+ */
+struct nsql_packed_value {
+  int type;
+  int64_t i;
+  double f;
+  const void *bytes;
+  uint32_t nbytes;
+};
+
+/*
+ * Record the result set's column names. Must be called once, after the first
+ * call to `sqlite3_step()`, so that the names reflect any re-preparation of the
+ * statement. Returns false if memory allocation fails.
+ */
+bool nsql_packed_begin(struct nsql_packed *self, sqlite3_stmt *stmt);
+
+/*
+ * Append the statement's current row. Returns false if memory allocation fails
+ * or the result set is too large to encode.
+ */
+bool nsql_packed_push_row(struct nsql_packed *self, sqlite3_stmt *stmt);
+
+/*
+ * Append a row of `ncols` values, whose bytes may belong to another writer but
+ * not to this one. Returns false under the same conditions as
+ * `nsql_packed_push_row()`.
+ */
+bool nsql_packed_push_values(struct nsql_packed *self,
+                             const struct nsql_packed_value *values);
+
+/*
+ * Read back the value of a cell that has already been appended. TEXT and BLOB
+ * bytes point into the writer's heap, and remain valid until the next row is
+ * appended.
+ */
+void nsql_packed_get(const struct nsql_packed *self, uint32_t row,
+                     uint32_t col, struct nsql_packed_value *out);
+
+/*
+ * Copy the encoded result set into a new JavaScript ArrayBuffer.
+ */
+napi_status nsql_packed_finish(napi_env env, struct nsql_packed *self,
+                               napi_value *out);
+
+/*
+ * Release all memory owned by a writer.
+ */
+void nsql_packed_free(struct nsql_packed *self);
@@ -0,0 +1,576 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "error.h"
+#include "hash.h"
+#include "profile.h"
+
+/* Histograms are log-linear: each power of two is split into 2^SUB_BITS
+   linearly-spaced buckets, which bounds the relative error of any reported
+   percentile to 1 / 2^SUB_BITS (12.5%) while keeping the histogram a fixed
+   size no matter how wide the range of observed latencies is. */
+
+#define NSQL_PROFILE_SUB_BITS 3
+#define NSQL_PROFILE_SUB_MASK ((1u << NSQL_PROFILE_SUB_BITS) - 1)
+#define NSQL_PROFILE_NBUCKETS                                                  \
+  ((64 - NSQL_PROFILE_SUB_BITS + 1) << NSQL_PROFILE_SUB_BITS)
+
+/* Statements executed through `Database.exec()` may embed literal values in
+   their SQL text, so the number of distinct SQL strings is not necessarily
+   bounded. Everything beyond this limit is lumped together. */
+
+#define NSQL_PROFILE_MAX_ENTRIES 1024
+#define NSQL_PROFILE_MIN_SLOTS 64
+
+struct nsql_profile_entry {
+  struct nsql_profile_entry *next;
+  uint64_t hash;
+  char *sql;
+  uint64_t count;
+  uint64_t total_ns;
+  uint64_t max_ns;
+  uint64_t buckets[NSQL_PROFILE_NBUCKETS];
+};
+
+struct nsql_profile {
+  struct nsql_profile_entry **slots;
+  size_t nslots;
+  size_t nentries;
+  struct nsql_profile_entry *other;
+};
+
+static unsigned nsql_profile_msb(uint64_t x);
+
+static size_t nsql_profile_bucket(uint64_t ns);
+
+static uint64_t nsql_profile_bucket_max(size_t i);
+
+static uint64_t nsql_profile_percentile(const struct nsql_profile_entry *entry,
+                                        double q);
+
+static struct nsql_profile_entry *nsql_profile_entry_alloc(const char *sql,
+                                                           uint64_t hash);
+
+static void nsql_profile_entry_free(struct nsql_profile_entry *entry);
+
+static struct nsql_profile_entry *nsql_profile_lookup(struct nsql_profile *self,
+                                                      const char *sql);
+
+static bool nsql_profile_grow(struct nsql_profile *self);
+
+static void nsql_profile_record(struct nsql_profile *self, const char *sql,
+                                uint64_t ns);
+
+static int nsql_profile_compare(const void *lhs, const void *rhs);
+
+static napi_status
+nsql_profile_entry_to_object(napi_env env,
+                             const struct nsql_profile_entry *entry,
+                             napi_value *out);
+
+static napi_status nsql_profile_set_number(napi_env env, napi_value obj,
+                                           const char *name, double value);
+
+struct nsql_profile *nsql_profile_alloc(void) {
+  struct nsql_profile *self;
+
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    return NULL;
+  }
+
+  self->slots = calloc(NSQL_PROFILE_MIN_SLOTS, sizeof(*self->slots));
+
+  if (self->slots == NULL) {
+    free(self);
+
+    return NULL;
+  }
+
+  self->nslots = NSQL_PROFILE_MIN_SLOTS;
+
+  return self;
+}
+
+void nsql_profile_free(struct nsql_profile *self) {
+  if (self == NULL) {
+    return;
+  }
+
+  nsql_profile_clear(self);
+  free(self->slots);
+  free(self);
+}
+
+void nsql_profile_clear(struct nsql_profile *self) {
+  struct nsql_profile_entry *entry;
+  struct nsql_profile_entry *next;
+  size_t i;
+
+  assert(self != NULL);
+
+  for (i = 0; i < self->nslots; i++) {
+    for (entry = self->slots[i]; entry != NULL; entry = next) {
+      next = entry->next;
+      nsql_profile_entry_free(entry);
+    }
+
+    self->slots[i] = NULL;
+  }
+
+  nsql_profile_entry_free(self->other);
+  self->other = NULL;
+  self->nentries = 0;
+}
+
+int nsql_profile_trace(unsigned type, void *ctx, void *p, void *x) {
+  const char *sql;
+  sqlite3_int64 ns;
+
+  assert(ctx != NULL);
+
+  if (type != SQLITE_TRACE_PROFILE) {
+    return 0;
+  }
+
+  sql = sqlite3_sql(p);
+
+  if (sql == NULL) {
+    return 0;
+  }
+
+  ns = *(sqlite3_int64 *)x;
+  nsql_profile_record(ctx, sql, (uint64_t)ns);
+
+  return 0;
+}
+
+napi_status nsql_profile_snapshot(napi_env env, struct nsql_profile *self,
+                                  napi_value *out) {
+  struct nsql_profile_entry **entries;
+  struct nsql_profile_entry *entry;
+  napi_value array;
+  napi_value obj;
+  napi_status r;
+  size_t nentries;
+  size_t i;
+
+  assert(self != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+  nentries = 0;
+
+  /* One extra slot for the overflow entry, which also conveniently avoids a
+     zero-sized allocation. */
+
+  entries = calloc(self->nentries + 1, sizeof(*entries));
+
+  if (entries == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  for (i = 0; i < self->nslots; i++) {
+    for (entry = self->slots[i]; entry != NULL; entry = entry->next) {
+      entries[nentries++] = entry;
+    }
+  }
+
+  if (self->other != NULL) {
+    entries[nentries++] = self->other;
+  }
+
+  qsort(entries, nentries, sizeof(*entries), nsql_profile_compare);
+
+  r = napi_create_array_with_length(env, nentries, &array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  for (i = 0; i < nentries; i++) {
+    r = nsql_profile_entry_to_object(env, entries[i], &obj);
+
+    if (r != napi_ok) {
+      goto end;
+    }
+
+    r = napi_set_element(env, array, (uint32_t)i, obj);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+  }
+
+  *out = array;
+
+end:
+  free(entries);
+
+  return r;
+}
+
+static unsigned nsql_profile_msb(uint64_t x) {
+  unsigned n;
+
+  n = 0;
+
+  if (x >> 32) {
+    n += 32;
+    x >>= 32;
+  }
+
+  if (x >> 16) {
+    n += 16;
+    x >>= 16;
+  }
+
+  if (x >> 8) {
+    n += 8;
+    x >>= 8;
+  }
+
+  if (x >> 4) {
+    n += 4;
+    x >>= 4;
+  }
+
+  if (x >> 2) {
+    n += 2;
+    x >>= 2;
+  }
+
+  if (x >> 1) {
+    n += 1;
+  }
+
+  return n;
+}
+
+static size_t nsql_profile_bucket(uint64_t ns) {
+  unsigned msb;
+
+  if (ns <= NSQL_PROFILE_SUB_MASK) {
+    return (size_t)ns;
+  }
+
+  msb = nsql_profile_msb(ns);
+
+  return ((size_t)(msb - NSQL_PROFILE_SUB_BITS + 1) << NSQL_PROFILE_SUB_BITS) |
+         (size_t)((ns >> (msb - NSQL_PROFILE_SUB_BITS)) &
+                  NSQL_PROFILE_SUB_MASK);
+}
+
+static uint64_t nsql_profile_bucket_max(size_t i) {
+  unsigned shift;
+  uint64_t sub;
+
+  if (i <= NSQL_PROFILE_SUB_MASK) {
+    return (uint64_t)i;
+  }
+
+  shift = (unsigned)(i >> NSQL_PROFILE_SUB_BITS) - 1;
+  sub = (uint64_t)(i & NSQL_PROFILE_SUB_MASK);
+
+  return ((((uint64_t)1 << NSQL_PROFILE_SUB_BITS) + sub) << shift) +
+         (((uint64_t)1 << shift) - 1);
+}
+
+static uint64_t nsql_profile_percentile(const struct nsql_profile_entry *entry,
+                                        double q) {
+  uint64_t rank;
+  uint64_t seen;
+  uint64_t value;
+  size_t i;
+
+  assert(entry != NULL);
+
+  if (entry->count == 0) {
+    return 0;
+  }
+
+  /* Nearest-rank method: the smallest recorded value such that at least q of
+     all recorded values are less than or equal to it. */
+
+  rank = (uint64_t)(q * (double)entry->count);
+
+  if ((double)rank < q * (double)entry->count) {
+    rank++;
+  }
+
+  if (rank == 0) {
+    rank = 1;
+  }
+
+  seen = 0;
+
+  for (i = 0; i < NSQL_PROFILE_NBUCKETS; i++) {
+    seen += entry->buckets[i];
+
+    if (seen >= rank) {
+      break;
+    }
+  }
+
+  value = nsql_profile_bucket_max(i);
+
+  return value < entry->max_ns ? value : entry->max_ns;
+}
+
+static struct nsql_profile_entry *nsql_profile_entry_alloc(const char *sql,
+                                                           uint64_t hash) {
+  struct nsql_profile_entry *entry;
+  size_t nbytes;
+
+  entry = calloc(1, sizeof(*entry));
+
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  nbytes = strlen(sql) + 1;
+  entry->sql = malloc(nbytes);
+
+  if (entry->sql == NULL) {
+    free(entry);
+
+    return NULL;
+  }
+
+  memcpy(entry->sql, sql, nbytes);
+  entry->hash = hash;
+
+  return entry;
+}
+
+static void nsql_profile_entry_free(struct nsql_profile_entry *entry) {
+  if (entry == NULL) {
+    return;
+  }
+
+  free(entry->sql);
+  free(entry);
+}
+
+static struct nsql_profile_entry *nsql_profile_lookup(struct nsql_profile *self,
+                                                      const char *sql) {
+  struct nsql_profile_entry *entry;
+  uint64_t hash;
+  size_t slot;
+
+  hash = nsql_hash64(sql, strlen(sql));
+  slot = (size_t)(hash & (self->nslots - 1));
+
+  for (entry = self->slots[slot]; entry != NULL; entry = entry->next) {
+    if (entry->hash == hash && strcmp(entry->sql, sql) == 0) {
+      return entry;
+    }
+  }
+
+  if (self->nentries >= NSQL_PROFILE_MAX_ENTRIES) {
+    if (self->other == NULL) {
+      self->other = nsql_profile_entry_alloc("#OTHER", 0);
+    }
+
+    return self->other;
+  }
+
+  if (self->nentries >= self->nslots && nsql_profile_grow(self)) {
+    slot = (size_t)(hash & (self->nslots - 1));
+  }
+
+  entry = nsql_profile_entry_alloc(sql, hash);
+
+  if (entry == NULL) {
+    return NULL;
+  }
+
+  entry->next = self->slots[slot];
+  self->slots[slot] = entry;
+  self->nentries++;
+
+  return entry;
+}
+
+static bool nsql_profile_grow(struct nsql_profile *self) {
+  struct nsql_profile_entry **slots;
+  struct nsql_profile_entry *entry;
+  struct nsql_profile_entry *next;
+  size_t nslots;
+  size_t slot;
+  size_t i;
+
+  nslots = self->nslots * 2;
+  slots = calloc(nslots, sizeof(*slots));
+
+  if (slots == NULL) {
+    /* Not fatal, the chains just get longer */
+    return false;
+  }
+
+  for (i = 0; i < self->nslots; i++) {
+    for (entry = self->slots[i]; entry != NULL; entry = next) {
+      next = entry->next;
+      slot = (size_t)(entry->hash & (nslots - 1));
+      entry->next = slots[slot];
+      slots[slot] = entry;
+    }
+  }
+
+  free(self->slots);
+  self->slots = slots;
+  self->nslots = nslots;
+
+  return true;
+}
+
+static void nsql_profile_record(struct nsql_profile *self, const char *sql,
+                                uint64_t ns) {
+  struct nsql_profile_entry *entry;
+
+  assert(self != NULL);
+  assert(sql != NULL);
+
+  entry = nsql_profile_lookup(self, sql);
+
+  if (entry == NULL) {
+    /* Out of memory. There is nowhere to report this from inside a trace
+       callback, so this sample is simply lost. */
+    return;
+  }
+
+  entry->count++;
+  entry->total_ns += ns;
+  entry->buckets[nsql_profile_bucket(ns)]++;
+
+  if (ns > entry->max_ns) {
+    entry->max_ns = ns;
+  }
+}
+
+static int nsql_profile_compare(const void *lhs, const void *rhs) {
+  const struct nsql_profile_entry *a;
+  const struct nsql_profile_entry *b;
+
+  a = *(const struct nsql_profile_entry *const *)lhs;
+  b = *(const struct nsql_profile_entry *const *)rhs;
+
+  if (a->total_ns > b->total_ns) {
+    return -1;
+  } else if (a->total_ns < b->total_ns) {
+    return 1;
+  } else {
+    return 0;
+  }
+}
+
+static napi_status
+nsql_profile_entry_to_object(napi_env env,
+                             const struct nsql_profile_entry *entry,
+                             napi_value *out) {
+  napi_value obj;
+  napi_value sql;
+  napi_status r;
+
+  assert(entry != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_string_utf8(env, entry->sql, NAPI_AUTO_LENGTH, &sql);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, obj, "sql", sql);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = nsql_profile_set_number(env, obj, "count", (double)entry->count);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = nsql_profile_set_number(env, obj, "total", (double)entry->total_ns);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = nsql_profile_set_number(env, obj, "p50",
+                              (double)nsql_profile_percentile(entry, 0.50));
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = nsql_profile_set_number(env, obj, "p99",
+                              (double)nsql_profile_percentile(entry, 0.99));
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  r = nsql_profile_set_number(env, obj, "max", (double)entry->max_ns);
+
+  if (r != napi_ok) {
+    goto end;
+  }
+
+  *out = obj;
+
+end:
+  return r;
+}
+
+static napi_status nsql_profile_set_number(napi_env env, napi_value obj,
+                                           const char *name, double value) {
+  napi_value num;
+  napi_status r;
+
+  r = napi_create_double(env, value, &num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <node_api.h>
+
+/*
+ * Per-connection statement latency profile. Execution times are accumulated
+ * into a fixed-size histogram for each distinct SQL string, entirely in native
+ * code, so that profiling is cheap enough to leave enabled permanently.
+ */
+struct nsql_profile;
+
+/*
+ * Allocate an empty profile. Returns NULL if memory allocation fails.
+ */
+struct nsql_profile *nsql_profile_alloc(void);
+
+/*
+ * Free a profile and all of its accumulated statistics. Does nothing if `self`
+ * is NULL.
+ */
+void nsql_profile_free(struct nsql_profile *self);
+
+/*
+ * Discard all accumulated statistics.
+ */
+void nsql_profile_clear(struct nsql_profile *self);
+
+/*
+ * `sqlite3_trace_v2()` callback for `SQLITE_TRACE_PROFILE` events. The context
+ * pointer must be a `struct nsql_profile`.
+ */
+int nsql_profile_trace(unsigned type, void *ctx, void *p, void *x);
+
+/*
+ * Convert the accumulated statistics into an array of JavaScript objects, one
+ * per distinct SQL string, ordered by descending total execution time.
+ */
+napi_status nsql_profile_snapshot(napi_env env, struct nsql_profile *self,
+                                  napi_value *out);
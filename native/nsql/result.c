@@ -7,10 +7,14 @@
 #include <sqlite3.h>
 
 #include "error.h"
+#include "intern.h"
 #include "result.h"
+#include "str.h"
 
 static napi_status nsql_result_get_cell(napi_env env, size_t i,
-                                        sqlite3_stmt *stmt, napi_value *out);
+                                        sqlite3_stmt *stmt,
+                                        struct nsql_intern *intern,
+                                        napi_value *out);
 
 napi_status nsql_result_get_columns(napi_env env, sqlite3_stmt *stmt,
                                     napi_value **out_cols, size_t *out_ncols) {
@@ -70,6 +74,7 @@ end:
 
 napi_status nsql_result_push_row(napi_env env, sqlite3_stmt *stmt,
                                  napi_value *cols, size_t ncols,
+                                 struct nsql_intern *intern,
                                  napi_value array) {
   napi_handle_scope scope;
   napi_value row;
@@ -98,7 +103,7 @@ napi_status nsql_result_push_row(napi_env env, sqlite3_stmt *stmt,
     goto end;
   }
 
-  r = nsql_result_get_row(env, stmt, cols, ncols, &row);
+  r = nsql_result_get_row(env, stmt, cols, ncols, intern, &row);
 
   if (r != napi_ok) {
     goto end;
@@ -126,7 +131,7 @@ end:
 
 napi_status nsql_result_get_row(napi_env env, sqlite3_stmt *stmt,
                                 napi_value *cols, size_t ncols,
-                                napi_value *out) {
+                                struct nsql_intern *intern, napi_value *out) {
   napi_escapable_handle_scope scope;
   napi_value result;
   napi_value cell;
@@ -158,7 +163,7 @@ napi_status nsql_result_get_row(napi_env env, sqlite3_stmt *stmt,
   }
 
   for (i = 0; i < ncols; i++) {
-    r = nsql_result_get_cell(env, i, stmt, &cell);
+    r = nsql_result_get_cell(env, i, stmt, intern, &cell);
 
     if (r != napi_ok) {
       goto end;
@@ -194,7 +199,9 @@ end:
 }
 
 static napi_status nsql_result_get_cell(napi_env env, size_t i,
-                                        sqlite3_stmt *stmt, napi_value *out) {
+                                        sqlite3_stmt *stmt,
+                                        struct nsql_intern *intern,
+                                        napi_value *out) {
   napi_status r;
   void *bytes;
   size_t nbytes;
@@ -236,15 +243,15 @@ static napi_status nsql_result_get_cell(napi_env env, size_t i,
     return r;
 
   case SQLITE_TEXT:
-    r = napi_create_string_utf8(env,
-                                (const char *)sqlite3_column_text(stmt, (int)i),
-                                sqlite3_column_bytes(stmt, (int)i), out);
-
-    if (r != napi_ok) {
-      nsql_report_error(env, r);
+    if (intern != NULL) {
+      return nsql_intern_get(env, intern,
+                             (const char *)sqlite3_column_text(stmt, (int)i),
+                             sqlite3_column_bytes(stmt, (int)i), out);
     }
 
-    return r;
+    return nsql_create_string(env,
+                              (const char *)sqlite3_column_text(stmt, (int)i),
+                              sqlite3_column_bytes(stmt, (int)i), out);
 
   case SQLITE_BLOB:
     nbytes = sqlite3_column_bytes(stmt, (int)i);
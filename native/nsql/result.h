@@ -5,6 +5,8 @@
 #include <node_api.h>
 #include <sqlite3.h>
 
+#include "intern.h"
+
 /*
  * Extract a result set's column names as a C array of `napi_value`s. The array
  * itself must be `free()`d after use.
@@ -20,9 +22,12 @@ napi_status nsql_result_get_columns(napi_env env, sqlite3_stmt *stmt,
  *
  * Requires a C array of JavaScript strings representing the result set's
  * column names; this can be constructed by calling `nsql_result_get_columns()`.
+ * If `intern` is non-NULL then short TEXT values are converted through it (see
+ * `nsql_intern_get()`).
  */
 napi_status nsql_result_push_row(napi_env env, sqlite3_stmt *stmt,
                                  napi_value *cols, size_t ncols,
+                                 struct nsql_intern *intern,
                                  napi_value array);
 
 /*
@@ -31,7 +36,8 @@ napi_status nsql_result_push_row(napi_env env, sqlite3_stmt *stmt,
  *
  * Requires a C array of JavaScript strings representing the result set's
  * column names; this can be constructed by calling `nsql_result_get_columns()`.
+ * `intern` is optional, as for `nsql_result_push_row()`.
  */
 napi_status nsql_result_get_row(napi_env env, sqlite3_stmt *stmt,
                                 napi_value *cols, size_t ncols,
-                                napi_value *out);
+                                struct nsql_intern *intern, napi_value *out);
@@ -0,0 +1,684 @@
+#include <assert.h>
+#include <limits.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "dprintf.h"
+#include "error.h"
+#include "macros.h"
+#include "options.h"
+#include "session.h"
+#include "str.h"
+
+enum nsql_session_policy {
+  NSQL_SESSION_ABORT,
+  NSQL_SESSION_OMIT,
+  NSQL_SESSION_REPLACE,
+};
+
+struct nsql_session {
+  /* sqlite3_close_v2() only defers closing a connection while it still has
+     statements or BLOB handles, not sessions, which must be deleted before
+     the connection goes away. Holding a statement that is never stepped keeps
+     the connection alive for as long as the session needs it. */
+
+  sqlite3 *db;
+  sqlite3_stmt *pin;
+  sqlite3_session *session;
+};
+
+typedef int (*nsql_session_output)(sqlite3_session *session, int *nbytes,
+                                   void **bytes);
+
+static napi_value nsql_session_constructor(napi_env env,
+                                           napi_callback_info ctx);
+
+static void nsql_session_destructor(napi_env env, void *ptr, void *hint);
+
+static void nsql_session_release(struct nsql_session *self);
+
+static napi_value nsql_session_attach(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_session_changeset(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_session_patchset(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_session_close(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_session_get_is_empty(napi_env env,
+                                            napi_callback_info ctx);
+
+static napi_status nsql_session_unwrap_open(napi_env env,
+                                            napi_callback_info ctx,
+                                            size_t *argc, napi_value *argv,
+                                            struct nsql_session **out);
+
+static napi_status nsql_session_attach_table(napi_env env,
+                                             struct nsql_session *self,
+                                             napi_value table);
+
+static napi_status nsql_session_attach_tables(napi_env env,
+                                              struct nsql_session *self,
+                                              napi_value tables);
+
+static napi_status nsql_session_output_buffer(napi_env env,
+                                              napi_callback_info ctx,
+                                              nsql_session_output output,
+                                              napi_value *out);
+
+static napi_status nsql_session_get_bytes(napi_env env, napi_value value,
+                                          void **out, size_t *out_nbytes,
+                                          bool *ok);
+
+static int nsql_session_conflict(void *ctx, int conflict,
+                                 sqlite3_changeset_iter *iter);
+
+static const napi_property_descriptor nsql_session_desc[] = {
+    {.utf8name = "attach", .method = nsql_session_attach},
+    {.utf8name = "changeset", .method = nsql_session_changeset},
+    {.utf8name = "patchset", .method = nsql_session_patchset},
+    {.utf8name = "close", .method = nsql_session_close},
+    {.utf8name = "isEmpty", .getter = nsql_session_get_is_empty}};
+
+static const char *const nsql_session_policies[] = {"abort", "omit",
+                                                    "replace", NULL};
+
+napi_status nsql_session_define_class(napi_env env, napi_value *out) {
+  napi_value nclass;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  nsql_dprintf("%s\n", __func__);
+
+  r = napi_define_class(env, "Session", NAPI_AUTO_LENGTH,
+                        nsql_session_constructor, NULL,
+                        countof(nsql_session_desc), nsql_session_desc, &nclass);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  *out = nclass;
+
+end:
+  return r;
+}
+
+napi_status nsql_session_open(napi_env env, napi_value nclass, sqlite3 *db,
+                              napi_value tables, napi_value *out) {
+  struct nsql_session *self;
+  napi_valuetype type;
+  napi_value nself;
+  napi_status r;
+  bool is_array;
+  int sqlr;
+
+  assert(db != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_typeof(env, tables, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_undefined) {
+    r = napi_is_array(env, tables, &is_array);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    if (!is_array) {
+      r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                "tables: Expected an array of strings");
+
+      goto end;
+    }
+  }
+
+  r = napi_new_instance(env, nclass, 0, NULL, &nself);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  sqlr = sqlite3_prepare_v2(db, "SELECT 1", -1, &self->pin, NULL);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, db);
+
+    goto end;
+  }
+
+  self->db = db;
+  sqlr = sqlite3session_create(db, "main", &self->session);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, db);
+
+    goto end;
+  }
+
+  if (type == napi_undefined) {
+    sqlr = sqlite3session_attach(self->session, NULL);
+
+    if (sqlr != SQLITE_OK) {
+      r = nsql_throw_sqlite_error(env, sqlr, db);
+
+      goto end;
+    }
+  } else {
+    r = nsql_session_attach_tables(env, self, tables);
+
+    if (r != napi_ok) {
+      goto end;
+    }
+  }
+
+  *out = nself;
+
+end:
+  return r;
+}
+
+napi_status nsql_session_apply(napi_env env, sqlite3 *db, napi_value buffer,
+                               napi_value opts) {
+  void *bytes;
+  size_t nbytes;
+  int policy;
+  napi_status r;
+  bool ok;
+  int sqlr;
+
+  assert(db != NULL);
+
+  r = nsql_session_get_bytes(env, buffer, &bytes, &nbytes, &ok);
+
+  if (r != napi_ok || !ok) {
+    return r;
+  }
+
+  policy = NSQL_SESSION_ABORT;
+  r = nsql_options_get_enum(env, opts, "onConflict", nsql_session_policies,
+                            &policy, &ok);
+
+  if (r != napi_ok || !ok) {
+    return r;
+  }
+
+  /* The changeset is applied inside a savepoint, which is rolled back if the
+     conflict handler aborts or any other error occurs. The conflict handler
+     never calls back into JavaScript, so the buffer cannot be detached while
+     SQLite is reading from it. */
+
+  sqlr = sqlite3changeset_apply(db, (int)nbytes, bytes, NULL,
+                                nsql_session_conflict, &policy);
+
+  if (sqlr != SQLITE_OK) {
+    return nsql_throw_sqlite_error(env, sqlr, db);
+  }
+
+  return napi_ok;
+}
+
+static napi_value nsql_session_constructor(napi_env env,
+                                           napi_callback_info ctx) {
+  struct nsql_session *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+  self = calloc(1, sizeof(*self));
+
+  if (self == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_wrap(env, nself, self, nsql_session_destructor, NULL, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  nsql_dprintf("%s -> %p\n", __func__, self);
+
+  out = nself;
+  self = NULL;
+
+end:
+  nsql_session_destructor(env, self, NULL);
+
+  return nsql_return(env, r, out);
+}
+
+static void nsql_session_destructor(napi_env env, void *ptr, void *hint) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  nsql_dprintf("%s(%p)\n", __func__, ptr);
+
+  nsql_session_release(ptr);
+  free(ptr);
+}
+
+static void nsql_session_release(struct nsql_session *self) {
+  int sqlr;
+
+  assert(self != NULL);
+
+  /* The session must go first, while the pinned connection is still open */
+
+  if (self->session != NULL) {
+    sqlite3session_delete(self->session);
+  }
+
+  sqlr = sqlite3_finalize(self->pin);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_fatal_sqlite_error(sqlr);
+  }
+
+  self->db = NULL;
+  self->pin = NULL;
+  self->session = NULL;
+}
+
+static napi_value nsql_session_attach(napi_env env, napi_callback_info ctx) {
+  struct nsql_session *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_status r;
+
+  argc = countof(argv);
+  r = nsql_session_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = nsql_session_attach_table(env, self, argv[0]);
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_session_changeset(napi_env env,
+                                         napi_callback_info ctx) {
+  napi_value out;
+  napi_status r;
+
+  r = nsql_session_output_buffer(env, ctx, sqlite3session_changeset, &out);
+
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_session_patchset(napi_env env, napi_callback_info ctx) {
+  napi_value out;
+  napi_status r;
+
+  r = nsql_session_output_buffer(env, ctx, sqlite3session_patchset, &out);
+
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_session_close(napi_env env, napi_callback_info ctx) {
+  struct nsql_session *self;
+  napi_value nself;
+  napi_status r;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+
+  nsql_session_release(self);
+
+  nsql_dprintf("%s\n", __func__);
+
+end:
+  return nsql_return(env, r, NULL);
+}
+
+static napi_value nsql_session_get_is_empty(napi_env env,
+                                            napi_callback_info ctx) {
+  struct nsql_session *self;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = nsql_session_unwrap_open(env, ctx, NULL, NULL, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = napi_get_boolean(env, sqlite3session_isempty(self->session) != 0, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_status nsql_session_unwrap_open(napi_env env,
+                                            napi_callback_info ctx,
+                                            size_t *argc, napi_value *argv,
+                                            struct nsql_session **out) {
+  struct nsql_session *self;
+  napi_value nself;
+  napi_status r;
+
+  assert(out != NULL);
+
+  *out = NULL;
+  self = NULL;
+
+  r = napi_get_cb_info(env, ctx, argc, argv, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+
+  if (self->session == NULL) {
+    r = napi_throw_error(env, NULL, "Session is closed");
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    goto end;
+  }
+
+  *out = self;
+
+end:
+  return r;
+}
+
+static napi_status nsql_session_attach_table(napi_env env,
+                                             struct nsql_session *self,
+                                             napi_value table) {
+  napi_valuetype type;
+  napi_status r;
+  char *ztable;
+  int sqlr;
+
+  ztable = NULL;
+
+  r = napi_typeof(env, table, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_string) {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "table: Expected string");
+
+    goto end;
+  }
+
+  r = nsql_get_string(env, table, &ztable, NULL);
+
+  if (r != napi_ok || ztable == NULL) {
+    goto end;
+  }
+
+  /* Tables without a PRIMARY KEY are accepted here but silently ignored by
+     the session, as documented by SQLite. */
+
+  sqlr = sqlite3session_attach(self->session, ztable);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+end:
+  free(ztable);
+
+  return r;
+}
+
+static napi_status nsql_session_attach_tables(napi_env env,
+                                              struct nsql_session *self,
+                                              napi_value tables) {
+  napi_value table;
+  napi_status r;
+  uint32_t ntables;
+  uint32_t i;
+
+  r = napi_get_array_length(env, tables, &ntables);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  for (i = 0; i < ntables; i++) {
+    r = napi_get_element(env, tables, i, &table);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    r = nsql_session_attach_table(env, self, table);
+
+    if (r != napi_ok) {
+      return r;
+    }
+  }
+
+  return napi_ok;
+}
+
+static napi_status nsql_session_output_buffer(napi_env env,
+                                              napi_callback_info ctx,
+                                              nsql_session_output output,
+                                              napi_value *out) {
+  struct nsql_session *self;
+  void *bytes;
+  void *dest;
+  int nbytes;
+  napi_status r;
+  int sqlr;
+
+  *out = NULL;
+  bytes = NULL;
+
+  r = nsql_session_unwrap_open(env, ctx, NULL, NULL, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  sqlr = output(self->session, &nbytes, &bytes);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+  r = napi_create_arraybuffer(env, nbytes, &dest, out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (nbytes > 0) {
+    memcpy(dest, bytes, nbytes);
+  }
+
+end:
+  sqlite3_free(bytes);
+
+  return r;
+}
+
+static napi_status nsql_session_get_bytes(napi_env env, napi_value value,
+                                          void **out, size_t *out_nbytes,
+                                          bool *ok) {
+  napi_typedarray_type type;
+  bool is_buffer;
+  bool is_array;
+  napi_status r;
+
+  *ok = false;
+
+  r = napi_is_arraybuffer(env, value, &is_buffer);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (is_buffer) {
+    r = napi_get_arraybuffer_info(env, value, out, out_nbytes);
+  } else {
+    r = napi_is_typedarray(env, value, &is_array);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    if (!is_array) {
+      return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                   "changeset: Expected an ArrayBuffer or "
+                                   "Uint8Array");
+    }
+
+    r = napi_get_typedarray_info(env, value, &type, out_nbytes, out, NULL,
+                                 NULL);
+
+    if (r == napi_ok && type != napi_uint8_array) {
+      return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                   "changeset: Expected an ArrayBuffer or "
+                                   "Uint8Array");
+    }
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (*out_nbytes > INT_MAX) {
+    return napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                                  "changeset: Too large");
+  }
+
+  *ok = true;
+
+  return napi_ok;
+}
+
+static int nsql_session_conflict(void *ctx, int conflict,
+                                 sqlite3_changeset_iter *iter) {
+  int policy;
+
+  policy = *(const int *)ctx;
+
+  switch (policy) {
+  case NSQL_SESSION_OMIT:
+    return SQLITE_CHANGESET_OMIT;
+
+  case NSQL_SESSION_REPLACE:
+    /* SQLite only allows conflicting rows to be replaced. A change that has
+       no row to apply to, or that violates a constraint, has to be skipped. */
+
+    if (conflict == SQLITE_CHANGESET_DATA ||
+        conflict == SQLITE_CHANGESET_CONFLICT) {
+      return SQLITE_CHANGESET_REPLACE;
+    }
+
+    return SQLITE_CHANGESET_OMIT;
+
+  default:
+    return SQLITE_CHANGESET_ABORT;
+  }
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Define and return a JavaScript constructor function that can be used to
+ * create `Session` objects. This constructor should not be invoked directly,
+ * but should instead be retained for use with `nsql_session_open()`.
+ */
+napi_status nsql_session_define_class(napi_env env, napi_value *out);
+
+/*
+ * Start recording changes to the `main` database of `db` and wrap the
+ * recording session in a newly constructed JavaScript `Session` object.
+ * `tables` is the JavaScript array of table names supplied by the caller, or
+ * `undefined` to record changes to every table. Requires a constructor
+ * function that was previously defined by `nsql_session_define_class()`; this
+ * should be passed in the `nclass` parameter.
+ */
+napi_status nsql_session_open(napi_env env, napi_value nclass, sqlite3 *db,
+                              napi_value tables, napi_value *out);
+
+/*
+ * Apply the changeset or patchset in the JavaScript ArrayBuffer `buffer` to
+ * `db`, resolving conflicts according to the `onConflict` property of `opts`.
+ * A JavaScript exception is thrown if the arguments are invalid or the
+ * changeset could not be applied, in which case `db` is left unchanged.
+ */
+napi_status nsql_session_apply(napi_env env, sqlite3 *db, napi_value buffer,
+                               napi_value opts);
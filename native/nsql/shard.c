@@ -0,0 +1,1005 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+#include <uv.h>
+
+#include "error.h"
+#include "options.h"
+#include "packed.h"
+#include "shard.h"
+#include "statement.h"
+#include "str.h"
+
+/* How each column of a merged result set is combined across consecutive rows
+   of the same group. Columns that are not aggregated identify the group. */
+
+enum nsql_shard_aggregate {
+  NSQL_SHARD_GROUP,
+  NSQL_SHARD_COUNT,
+  NSQL_SHARD_SUM,
+  NSQL_SHARD_MIN,
+  NSQL_SHARD_MAX,
+};
+
+struct nsql_shard_key {
+  uint32_t col;
+  bool descending;
+};
+
+/* One shard's part of a query. Everything apart from the merge position is
+   written by the shard's own thread, and only read once it has been joined. */
+
+struct nsql_shard_task {
+  struct nsql_statement *statement;
+  sqlite3_stmt *stmt;
+  struct nsql_packed packed;
+  uv_thread_t thread;
+  bool threaded;
+  bool oom;
+  int sqlr;
+  uint32_t pos;
+};
+
+struct nsql_shard_query {
+  struct nsql_shard_task *tasks;
+  uint32_t ntasks;
+  uint32_t ncols;
+  struct nsql_shard_key *keys;
+  uint32_t nkeys;
+  enum nsql_shard_aggregate *aggregates;
+  double limit;
+
+  /* Merged output, the row waiting to be appended to it and the row that has
+     just been taken from a shard */
+
+  struct nsql_packed out;
+  struct nsql_packed_value *row;
+  struct nsql_packed_value *next;
+};
+
+static napi_status nsql_shard_acquire(napi_env env,
+                                      struct nsql_shard_query *self,
+                                      napi_value nstmts, napi_value params,
+                                      bool *ok);
+
+static napi_status nsql_shard_read_options(napi_env env,
+                                           struct nsql_shard_query *self,
+                                           napi_value opts, bool *ok);
+
+static napi_status nsql_shard_read_order(napi_env env,
+                                         struct nsql_shard_query *self,
+                                         napi_value norder, bool *ok);
+
+static napi_status nsql_shard_read_aggregates(napi_env env,
+                                              struct nsql_shard_query *self,
+                                              napi_value naggregate, bool *ok);
+
+static napi_status nsql_shard_check_groups(napi_env env,
+                                           const struct nsql_shard_query *self,
+                                           bool *ok);
+
+static napi_status nsql_shard_column(napi_env env,
+                                     const struct nsql_shard_query *self,
+                                     const char *option, const char *name,
+                                     uint32_t *out, bool *ok);
+
+static void nsql_shard_run(struct nsql_shard_query *self);
+
+static void nsql_shard_main(void *ptr);
+
+static int nsql_shard_merge(struct nsql_shard_query *self);
+
+static struct nsql_shard_task *nsql_shard_next(struct nsql_shard_query *self);
+
+static int nsql_shard_compare_rows(const struct nsql_shard_query *self,
+                                   const struct nsql_shard_task *a,
+                                   const struct nsql_shard_task *b);
+
+static bool nsql_shard_same_group(const struct nsql_shard_query *self);
+
+static int nsql_shard_combine(struct nsql_shard_query *self);
+
+static int nsql_shard_sum(struct nsql_packed_value *acc,
+                          const struct nsql_packed_value *value);
+
+static int nsql_shard_compare(const struct nsql_packed_value *a,
+                              const struct nsql_packed_value *b);
+
+static int nsql_shard_compare_mixed(int64_t i, double f);
+
+static int nsql_shard_rank(int type);
+
+static void nsql_shard_free(struct nsql_shard_query *self);
+
+napi_status nsql_shard_all(napi_env env, napi_value nstmts, napi_value params,
+                           napi_value opts, napi_value *out) {
+  struct nsql_shard_query query;
+  struct nsql_shard_task *task;
+  napi_status r;
+  uint32_t i;
+  bool ok;
+  int sqlr;
+
+  assert(out != NULL);
+
+  *out = NULL;
+  memset(&query, 0, sizeof(query));
+  query.limit = -1;
+
+  r = nsql_shard_acquire(env, &query, nstmts, params, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_shard_read_options(env, &query, opts, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  nsql_shard_run(&query);
+
+  /* Report the first shard to fail, while its connection still holds the
+     error message */
+
+  for (i = 0; i < query.ntasks; i++) {
+    task = &query.tasks[i];
+
+    if (task->oom) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+
+    if (task->sqlr != SQLITE_OK) {
+      r = nsql_throw_sqlite_error(env, task->sqlr,
+                                  sqlite3_db_handle(task->stmt));
+
+      goto end;
+    }
+  }
+
+  sqlr = nsql_shard_merge(&query);
+
+  switch (sqlr) {
+  case SQLITE_OK:
+    r = nsql_packed_finish(env, &query.out, out);
+
+    break;
+
+  case SQLITE_RANGE:
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                               "aggregate: Integer overflow");
+
+    break;
+
+  case SQLITE_MISMATCH:
+    r = napi_throw_type_error(env, NULL,
+                              "aggregate: Cannot sum non-numeric values");
+
+    break;
+
+  default:
+    r = nsql_throw_oom(env);
+
+    break;
+  }
+
+end:
+  for (i = 0; i < query.ntasks; i++) {
+    r = nsql_statement_release(env, query.tasks[i].statement, r);
+  }
+
+  nsql_shard_free(&query);
+
+  return r;
+}
+
+static napi_status nsql_shard_acquire(napi_env env,
+                                      struct nsql_shard_query *self,
+                                      napi_value nstmts, napi_value params,
+                                      bool *ok) {
+  struct nsql_shard_task *task;
+  napi_value value;
+  napi_status r;
+  uint32_t length;
+  uint32_t i;
+  uint32_t j;
+  bool array;
+
+  *ok = false;
+
+  r = napi_is_array(env, nstmts, &array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (!array) {
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                 "statements: Expected an array");
+  }
+
+  r = napi_get_array_length(env, nstmts, &length);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (length == 0) {
+    return napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                                  "statements: Expected at least one");
+  }
+
+  self->tasks = calloc(length, sizeof(*self->tasks));
+
+  if (self->tasks == NULL) {
+    return nsql_throw_oom(env);
+  }
+
+  for (i = 0; i < length; i++) {
+    task = &self->tasks[i];
+
+    r = napi_get_element(env, nstmts, i, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    r = nsql_statement_acquire(env, value, params, &task->statement);
+
+    if (r != napi_ok || task->statement == NULL) {
+      return r;
+    }
+
+    self->ntasks++;
+    task->stmt = nsql_statement_handle(task->statement);
+
+    /* Shards run concurrently, so they must not share a connection, and
+       their hooks must not be called from other threads */
+
+    if (!sqlite3_stmt_readonly(task->stmt)) {
+      return napi_throw_error(env, NULL, "Sharded queries must be read-only");
+    }
+
+    for (j = 0; j < i; j++) {
+      if (sqlite3_db_handle(self->tasks[j].stmt) ==
+          sqlite3_db_handle(task->stmt)) {
+        return napi_throw_error(env, NULL,
+                                "Each shard must have its own connection");
+      }
+    }
+
+    if (sqlite3_column_count(task->stmt) !=
+        sqlite3_column_count(self->tasks[0].stmt)) {
+      return napi_throw_error(env, NULL,
+                              "Shards have different result columns");
+    }
+  }
+
+  self->ncols = (uint32_t)sqlite3_column_count(self->tasks[0].stmt);
+  *ok = true;
+
+  return napi_ok;
+}
+
+static napi_status nsql_shard_read_options(napi_env env,
+                                           struct nsql_shard_query *self,
+                                           napi_value opts, bool *ok) {
+  napi_value naggregate;
+  napi_value norder;
+  napi_status r;
+
+  r = nsql_options_get_object(env, opts, "orderBy", &norder, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  if (norder != NULL) {
+    r = nsql_shard_read_order(env, self, norder, ok);
+
+    if (r != napi_ok || !*ok) {
+      return r;
+    }
+  }
+
+  r = nsql_options_get_object(env, opts, "aggregate", &naggregate, ok);
+
+  if (r != napi_ok || !*ok) {
+    return r;
+  }
+
+  if (naggregate != NULL) {
+    r = nsql_shard_read_aggregates(env, self, naggregate, ok);
+
+    if (r != napi_ok || !*ok) {
+      return r;
+    }
+
+    r = nsql_shard_check_groups(env, self, ok);
+
+    if (r != napi_ok || !*ok) {
+      return r;
+    }
+  }
+
+  return nsql_options_get_double(env, opts, "limit", &self->limit, ok);
+}
+
+static napi_status nsql_shard_read_order(napi_env env,
+                                         struct nsql_shard_query *self,
+                                         napi_value norder, bool *ok) {
+  struct nsql_shard_key *key;
+  napi_valuetype type;
+  napi_value value;
+  napi_value nname;
+  napi_status r;
+  uint32_t length;
+  uint32_t i;
+  char *name;
+  bool object;
+  bool array;
+
+  *ok = false;
+
+  r = napi_is_array(env, norder, &array);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (!array) {
+    return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                 "orderBy: Expected an array");
+  }
+
+  r = napi_get_array_length(env, norder, &length);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (length > 0) {
+    self->keys = calloc(length, sizeof(*self->keys));
+
+    if (self->keys == NULL) {
+      return nsql_throw_oom(env);
+    }
+  }
+
+  for (i = 0; i < length; i++) {
+    key = &self->keys[i];
+
+    r = napi_get_element(env, norder, i, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    r = napi_typeof(env, value, &type);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    /* Keys are either column names or `{column, descending}` objects */
+
+    nname = value;
+    object = type == napi_object;
+
+    if (object) {
+      r = napi_get_named_property(env, value, "column", &nname);
+
+      if (r != napi_ok) {
+        nsql_report_error(env, r);
+
+        return r;
+      }
+
+      r = napi_typeof(env, nname, &type);
+
+      if (r != napi_ok) {
+        nsql_report_error(env, r);
+
+        return r;
+      }
+    }
+
+    if (type != napi_string) {
+      return napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                                   "orderBy: Expected column names");
+    }
+
+    r = nsql_get_string(env, nname, &name, NULL);
+
+    if (r != napi_ok || name == NULL) {
+      return r;
+    }
+
+    r = nsql_shard_column(env, self, "orderBy", name, &key->col, ok);
+    free(name);
+
+    if (r != napi_ok || !*ok) {
+      return r;
+    }
+
+    if (object) {
+      r = nsql_options_get_bool(env, value, "descending", &key->descending,
+                                ok);
+
+      if (r != napi_ok || !*ok) {
+        return r;
+      }
+    }
+
+    self->nkeys++;
+  }
+
+  *ok = true;
+
+  return napi_ok;
+}
+
+static napi_status nsql_shard_read_aggregates(napi_env env,
+                                              struct nsql_shard_query *self,
+                                              napi_value naggregate,
+                                              bool *ok) {
+  static const char *const choices[] = {"count", "sum", "min", "max", NULL};
+  napi_value names;
+  napi_value nname;
+  napi_status r;
+  uint32_t length;
+  uint32_t col;
+  uint32_t i;
+  char *name;
+  int choice;
+
+  *ok = false;
+
+  r = napi_get_property_names(env, naggregate, &names);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_get_array_length(env, names, &length);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  for (i = 0; i < length; i++) {
+    r = napi_get_element(env, names, i, &nname);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      return r;
+    }
+
+    r = nsql_get_string(env, nname, &name, NULL);
+
+    if (r != napi_ok || name == NULL) {
+      return r;
+    }
+
+    r = nsql_shard_column(env, self, "aggregate", name, &col, ok);
+
+    if (r == napi_ok && *ok) {
+      choice = 0;
+      r = nsql_options_get_enum(env, naggregate, name, choices, &choice, ok);
+    }
+
+    free(name);
+
+    if (r != napi_ok || !*ok) {
+      return r;
+    }
+
+    /* Only allocated once a column has been found, so there is at least one */
+
+    if (self->aggregates == NULL) {
+      self->aggregates = calloc(self->ncols, sizeof(*self->aggregates));
+
+      if (self->aggregates == NULL) {
+        *ok = false;
+
+        return nsql_throw_oom(env);
+      }
+    }
+
+    self->aggregates[col] = NSQL_SHARD_COUNT + choice;
+  }
+
+  *ok = true;
+
+  return napi_ok;
+}
+
+static napi_status nsql_shard_check_groups(napi_env env,
+                                           const struct nsql_shard_query *self,
+                                           bool *ok) {
+  const char *name;
+  char msg[256];
+  uint32_t col;
+  uint32_t i;
+
+  *ok = true;
+
+  if (self->aggregates == NULL) {
+    return napi_ok;
+  }
+
+  /* Rows are only combined with their neighbours, so the rows of a group are
+     only adjacent after merging if every group column is a merge key */
+
+  for (col = 0; col < self->ncols; col++) {
+    if (self->aggregates[col] != NSQL_SHARD_GROUP) {
+      continue;
+    }
+
+    for (i = 0; i < self->nkeys; i++) {
+      if (self->keys[i].col == col) {
+        break;
+      }
+    }
+
+    if (i == self->nkeys) {
+      name = sqlite3_column_name(self->tasks[0].stmt, (int)col);
+      snprintf(msg, sizeof(msg), "orderBy: Must include group column \"%s\"",
+               name != NULL ? name : "");
+      *ok = false;
+
+      return napi_throw_type_error(env, "ERR_INVALID_ARG_VALUE", msg);
+    }
+  }
+
+  return napi_ok;
+}
+
+static napi_status nsql_shard_column(napi_env env,
+                                     const struct nsql_shard_query *self,
+                                     const char *option, const char *name,
+                                     uint32_t *out, bool *ok) {
+  const char *col_name;
+  char msg[256];
+  uint32_t i;
+
+  *ok = false;
+
+  for (i = 0; i < self->ncols; i++) {
+    col_name = sqlite3_column_name(self->tasks[0].stmt, (int)i);
+
+    if (col_name != NULL && strcmp(col_name, name) == 0) {
+      *out = i;
+      *ok = true;
+
+      return napi_ok;
+    }
+  }
+
+  snprintf(msg, sizeof(msg), "%s: No result column named \"%s\"", option,
+           name);
+
+  return napi_throw_type_error(env, "ERR_INVALID_ARG_VALUE", msg);
+}
+
+static void nsql_shard_run(struct nsql_shard_query *self) {
+  struct nsql_shard_task *task;
+  uint32_t i;
+
+  for (i = 1; i < self->ntasks; i++) {
+    task = &self->tasks[i];
+    task->threaded =
+        uv_thread_create(&task->thread, nsql_shard_main, task) == 0;
+  }
+
+  nsql_shard_main(&self->tasks[0]);
+
+  /* A shard whose thread could not be started runs on this one instead */
+
+  for (i = 1; i < self->ntasks; i++) {
+    task = &self->tasks[i];
+
+    if (!task->threaded) {
+      nsql_shard_main(task);
+    } else if (uv_thread_join(&task->thread) != 0) {
+      abort();
+    }
+  }
+}
+
+static void nsql_shard_main(void *ptr) {
+  struct nsql_shard_task *self;
+  int sqlr;
+
+  self = ptr;
+
+  for (;;) {
+    sqlr = sqlite3_step(self->stmt);
+
+    if (sqlr != SQLITE_DONE && sqlr != SQLITE_ROW) {
+      self->sqlr = sqlr;
+
+      return;
+    }
+
+    if (!self->packed.begun && !nsql_packed_begin(&self->packed, self->stmt)) {
+      self->oom = true;
+
+      return;
+    }
+
+    if (sqlr == SQLITE_DONE) {
+      return;
+    }
+
+    if (!nsql_packed_push_row(&self->packed, self->stmt)) {
+      self->oom = true;
+
+      return;
+    }
+  }
+}
+
+static int nsql_shard_merge(struct nsql_shard_query *self) {
+  struct nsql_packed_value *tmp;
+  struct nsql_shard_task *task;
+  bool pending;
+  uint32_t i;
+  int sqlr;
+
+  if (!nsql_packed_begin(&self->out, self->tasks[0].stmt)) {
+    return SQLITE_NOMEM;
+  }
+
+  /* Statements without columns cannot return rows */
+
+  if (self->ncols == 0) {
+    return SQLITE_OK;
+  }
+
+  self->row = calloc(self->ncols, sizeof(*self->row));
+  self->next = calloc(self->ncols, sizeof(*self->next));
+
+  if (self->row == NULL || self->next == NULL) {
+    return SQLITE_NOMEM;
+  }
+
+  /* A row is only appended once the next one is known to belong to a
+     different group, since partial results may still have to be combined
+     into it */
+
+  pending = false;
+
+  for (;;) {
+    task = nsql_shard_next(self);
+
+    if (task == NULL) {
+      break;
+    }
+
+    for (i = 0; i < self->ncols; i++) {
+      nsql_packed_get(&task->packed, task->pos, i, &self->next[i]);
+    }
+
+    task->pos++;
+
+    if (pending && self->aggregates != NULL && nsql_shard_same_group(self)) {
+      sqlr = nsql_shard_combine(self);
+
+      if (sqlr != SQLITE_OK) {
+        return sqlr;
+      }
+
+      continue;
+    }
+
+    if (pending) {
+      if (!nsql_packed_push_values(&self->out, self->row)) {
+        return SQLITE_NOMEM;
+      }
+
+      pending = false;
+    }
+
+    if (self->limit >= 0 && self->out.nrows >= self->limit) {
+      break;
+    }
+
+    tmp = self->row;
+    self->row = self->next;
+    self->next = tmp;
+    pending = true;
+  }
+
+  if (pending && (self->limit < 0 || self->out.nrows < self->limit) &&
+      !nsql_packed_push_values(&self->out, self->row)) {
+    return SQLITE_NOMEM;
+  }
+
+  return SQLITE_OK;
+}
+
+static struct nsql_shard_task *nsql_shard_next(struct nsql_shard_query *self) {
+  struct nsql_shard_task *best;
+  struct nsql_shard_task *task;
+  uint32_t i;
+
+  /* Shard counts are small, so a linear scan beats maintaining a heap. Ties
+     go to the earlier shard, keeping the merge stable. */
+
+  best = NULL;
+
+  for (i = 0; i < self->ntasks; i++) {
+    task = &self->tasks[i];
+
+    if (task->pos == task->packed.nrows) {
+      continue;
+    }
+
+    if (self->nkeys == 0) {
+      return task;
+    }
+
+    if (best == NULL || nsql_shard_compare_rows(self, task, best) < 0) {
+      best = task;
+    }
+  }
+
+  return best;
+}
+
+static int nsql_shard_compare_rows(const struct nsql_shard_query *self,
+                                   const struct nsql_shard_task *a,
+                                   const struct nsql_shard_task *b) {
+  const struct nsql_shard_key *key;
+  struct nsql_packed_value va;
+  struct nsql_packed_value vb;
+  uint32_t i;
+  int c;
+
+  for (i = 0; i < self->nkeys; i++) {
+    key = &self->keys[i];
+    nsql_packed_get(&a->packed, a->pos, key->col, &va);
+    nsql_packed_get(&b->packed, b->pos, key->col, &vb);
+    c = nsql_shard_compare(&va, &vb);
+
+    if (c != 0) {
+      return key->descending ? -c : c;
+    }
+  }
+
+  return 0;
+}
+
+static bool nsql_shard_same_group(const struct nsql_shard_query *self) {
+  uint32_t i;
+
+  for (i = 0; i < self->ncols; i++) {
+    if (self->aggregates[i] == NSQL_SHARD_GROUP &&
+        nsql_shard_compare(&self->row[i], &self->next[i]) != 0) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+static int nsql_shard_combine(struct nsql_shard_query *self) {
+  struct nsql_packed_value *acc;
+  struct nsql_packed_value *value;
+  uint32_t i;
+  int sqlr;
+  int c;
+
+  for (i = 0; i < self->ncols; i++) {
+    acc = &self->row[i];
+    value = &self->next[i];
+
+    switch (self->aggregates[i]) {
+    case NSQL_SHARD_COUNT:
+    case NSQL_SHARD_SUM:
+      sqlr = nsql_shard_sum(acc, value);
+
+      if (sqlr != SQLITE_OK) {
+        return sqlr;
+      }
+
+      break;
+
+    case NSQL_SHARD_MIN:
+    case NSQL_SHARD_MAX:
+      /* As in SQL, NULL only wins if there is nothing else, which is what a
+         shard without any matching rows returns */
+
+      if (value->type == SQLITE_NULL) {
+        break;
+      }
+
+      c = acc->type == SQLITE_NULL ? 0 : nsql_shard_compare(value, acc);
+
+      if (acc->type == SQLITE_NULL ||
+          (self->aggregates[i] == NSQL_SHARD_MIN ? c < 0 : c > 0)) {
+        *acc = *value;
+      }
+
+      break;
+
+    default:
+      break;
+    }
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_shard_sum(struct nsql_packed_value *acc,
+                          const struct nsql_packed_value *value) {
+  double a;
+  double b;
+
+  if (value->type == SQLITE_NULL) {
+    return SQLITE_OK;
+  }
+
+  if (nsql_shard_rank(value->type) != 1 ||
+      (acc->type != SQLITE_NULL && nsql_shard_rank(acc->type) != 1)) {
+    return SQLITE_MISMATCH;
+  }
+
+  if (acc->type == SQLITE_NULL) {
+    *acc = *value;
+
+    return SQLITE_OK;
+  }
+
+  /* Integer sums overflow with an error, as SQLite's own sum() does */
+
+  if (acc->type == SQLITE_INTEGER && value->type == SQLITE_INTEGER) {
+    if ((value->i > 0 && acc->i > INT64_MAX - value->i) ||
+        (value->i < 0 && acc->i < INT64_MIN - value->i)) {
+      return SQLITE_RANGE;
+    }
+
+    acc->i += value->i;
+
+    return SQLITE_OK;
+  }
+
+  a = acc->type == SQLITE_INTEGER ? (double)acc->i : acc->f;
+  b = value->type == SQLITE_INTEGER ? (double)value->i : value->f;
+  acc->type = SQLITE_FLOAT;
+  acc->f = a + b;
+
+  return SQLITE_OK;
+}
+
+static int nsql_shard_compare(const struct nsql_packed_value *a,
+                              const struct nsql_packed_value *b) {
+  size_t nbytes;
+  int ra;
+  int rb;
+  int c;
+
+  /* SQLite's sort order: NULL, then numbers, then text, then blobs. Text is
+     compared byte by byte, as with the BINARY collation. */
+
+  ra = nsql_shard_rank(a->type);
+  rb = nsql_shard_rank(b->type);
+
+  if (ra != rb) {
+    return ra < rb ? -1 : 1;
+  }
+
+  switch (a->type) {
+  case SQLITE_NULL:
+    return 0;
+
+  case SQLITE_INTEGER:
+    if (b->type == SQLITE_INTEGER) {
+      return (a->i > b->i) - (a->i < b->i);
+    }
+
+    return nsql_shard_compare_mixed(a->i, b->f);
+
+  case SQLITE_FLOAT:
+    if (b->type == SQLITE_INTEGER) {
+      return -nsql_shard_compare_mixed(b->i, a->f);
+    }
+
+    return (a->f > b->f) - (a->f < b->f);
+
+  default:
+    nbytes = a->nbytes < b->nbytes ? a->nbytes : b->nbytes;
+    c = nbytes > 0 ? memcmp(a->bytes, b->bytes, nbytes) : 0;
+
+    if (c != 0) {
+      return c < 0 ? -1 : 1;
+    }
+
+    return (a->nbytes > b->nbytes) - (a->nbytes < b->nbytes);
+  }
+}
+
+static int nsql_shard_compare_mixed(int64_t i, double f) {
+  int64_t whole;
+
+  /* Converting the integer to a double could lose precision, so compare it
+     with the whole part of the double instead, and then the fraction */
+
+  if (f < -9223372036854775808.0) {
+    return 1;
+  }
+
+  if (f >= 9223372036854775808.0) {
+    return -1;
+  }
+
+  whole = (int64_t)f;
+
+  if (i != whole) {
+    return i < whole ? -1 : 1;
+  }
+
+  return ((double)whole < f) ? -1 : ((double)whole > f);
+}
+
+static int nsql_shard_rank(int type) {
+  switch (type) {
+  case SQLITE_INTEGER:
+  case SQLITE_FLOAT:
+    return 1;
+
+  case SQLITE_TEXT:
+    return 2;
+
+  case SQLITE_BLOB:
+    return 3;
+
+  default:
+    return 0;
+  }
+}
+
+static void nsql_shard_free(struct nsql_shard_query *self) {
+  uint32_t i;
+
+  for (i = 0; i < self->ntasks; i++) {
+    nsql_packed_free(&self->tasks[i].packed);
+  }
+
+  free(self->tasks);
+  free(self->keys);
+  free(self->aggregates);
+  free(self->row);
+  free(self->next);
+  nsql_packed_free(&self->out);
+}
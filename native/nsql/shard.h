@@ -0,0 +1,29 @@
+#pragma once
+
+#include <node_api.h>
+
+/*
+ * Execute the same read-only query on several shards at once and merge the
+ * results into a single packed result set, which is returned as an
+ * ArrayBuffer through `*out`.
+ *
+ * `nstmts` is an array of `Statement` objects, one per shard, each of which
+ * must belong to a different connection. `params` is bound to every one of
+ * them. Each statement runs to completion on a thread of its own, except for
+ * the first, which runs on the calling thread while it waits for the others.
+ *
+ * `opts` may contain:
+ *
+ * - `orderBy`: An array of column names or `{column, descending}` objects.
+ *   Each shard's rows must already be in this order, and they are merged so
+ *   that the combined result is too. Without it, results are concatenated in
+ *   shard order.
+ * - `aggregate`: An object mapping column names to `count`, `sum`, `min` or
+ *   `max`. Consecutive merged rows that are equal in every other column are
+ *   combined into one by applying these functions to their partial results.
+ *   Every other column must therefore appear in `orderBy`, or a TypeError is
+ *   thrown.
+ * - `limit`: The maximum number of rows to return after merging.
+ */
+napi_status nsql_shard_all(napi_env env, napi_value nstmts, napi_value params,
+                           napi_value opts, napi_value *out);
@@ -1,19 +1,53 @@
 #include <assert.h>
+#include <math.h>
 #include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <node_api.h>
 #include <sqlite3.h>
 
+#include "arrow.h"
 #include "bind.h"
+#include "buf.h"
+#include "cache.h"
+#include "changes.h"
+#include "clock.h"
 #include "dprintf.h"
 #include "error.h"
+#include "explain.h"
+#include "export.h"
+#include "json.h"
 #include "macros.h"
+#include "memory.h"
+#include "options.h"
+#include "packed.h"
 #include "result.h"
 #include "statement.h"
 #include "str.h"
 
+/* Number of virtual machine instructions between progress handler callbacks
+   while an execution limit is in effect. */
+
+#define NSQL_PROGRESS_PERIOD 1000
+
+/* Default number of rows per record batch in Statement.arrow() output */
+
+#define NSQL_ARROW_BATCH_SIZE 65536
+
+/* How long an export's connection waits for locks held by other connections,
+   such as the caller's own, before failing with SQLITE_BUSY */
+
+#define NSQL_EXPORT_BUSY_TIMEOUT_MS 5000
+
+enum nsql_statement_limit {
+  NSQL_LIMIT_NONE,
+  NSQL_LIMIT_TIMEOUT,
+  NSQL_LIMIT_VM_STEPS,
+};
+
 struct nsql_statement {
   /* SQLite connection object ownership is handled through internal reference
      counting within SQLite itself. Calling `sqlite3_close_v2()` to dispose of
@@ -27,6 +61,49 @@ struct nsql_statement {
 
   sqlite3 *db;
   sqlite3_stmt *stmt;
+
+  /* Change feed of the originating connection, flushed after every call that
+     executes this statement */
+
+  struct nsql_changes *changes;
+
+  /* Result cache of the originating connection, consulted by calls that opt
+     in to it */
+
+  struct nsql_cache *cache;
+
+  /* Memory accounting record of the originating connection, updated after
+     every call that executes this statement */
+
+  struct nsql_memory *memory;
+
+  /* Execution limits for the current call, if any. The deadline is expressed
+     in terms of `nsql_clock_ns()`. Zero means no limit. */
+
+  uint64_t deadline;
+  uint64_t max_vm_steps;
+  uint64_t vm_steps;
+  int period;
+  enum nsql_statement_limit tripped;
+
+  /* String interning statistics for the latest call that used it */
+
+  double intern_hits;
+  double intern_misses;
+  bool interned;
+};
+
+/* State of a `Statement.exportTo()` call, whose rows are stepped and written
+   out on a libuv worker thread */
+
+struct nsql_statement_export {
+  napi_async_work work;
+  napi_deferred deferred;
+  sqlite3 *db;
+  sqlite3_stmt *stmt;
+  struct nsql_export export;
+  bool failed;
+  int sqlr;
 };
 
 static napi_value nsql_statement_constructor(napi_env env,
@@ -38,9 +115,29 @@ static napi_value nsql_statement_close(napi_env env, napi_callback_info ctx);
 
 static void nsql_statement_reset(struct nsql_statement *self);
 
+static napi_status nsql_statement_finish(napi_env env,
+                                         struct nsql_statement *self,
+                                         napi_status r);
+
+static napi_status nsql_statement_unwrap_open(napi_env env,
+                                              napi_callback_info ctx,
+                                              size_t *argc, napi_value *argv,
+                                              struct nsql_statement **out);
+
 static napi_status nsql_statement_exec_preamble(napi_env env,
                                                 napi_callback_info ctx,
-                                                struct nsql_statement **out);
+                                                struct nsql_statement **out,
+                                                napi_value *out_opts,
+                                                struct nsql_buf *key);
+
+static napi_status nsql_statement_set_limits(napi_env env,
+                                             struct nsql_statement *self,
+                                             napi_value opts, bool *ok);
+
+static int nsql_statement_progress(void *ctx);
+
+static napi_status nsql_statement_throw(napi_env env,
+                                        struct nsql_statement *self, int sqlr);
 
 static napi_value nsql_statement_run(napi_env env, napi_callback_info ctx);
 
@@ -51,14 +148,49 @@ static napi_value nsql_statement_one(napi_env env, napi_callback_info ctx);
 
 static napi_value nsql_statement_all(napi_env env, napi_callback_info ctx);
 
+static napi_value nsql_statement_all_packed(napi_env env,
+                                            napi_callback_info ctx);
+
+static napi_value nsql_statement_json(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_statement_arrow(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_statement_export_to(napi_env env,
+                                           napi_callback_info ctx);
+
+static void nsql_statement_export_execute(napi_env env, void *data);
+
+static void nsql_statement_export_complete(napi_env env, napi_status status,
+                                           void *data);
+
+static void nsql_statement_export_free(napi_env env,
+                                       struct nsql_statement_export *job);
+
+static napi_value nsql_statement_plan(napi_env env, napi_callback_info ctx);
+
+static napi_value nsql_statement_scan_stats(napi_env env,
+                                            napi_callback_info ctx);
+
 static napi_value nsql_statement_get_sql(napi_env env, napi_callback_info ctx);
 
+static napi_value nsql_statement_get_intern_stats(napi_env env,
+                                                  napi_callback_info ctx);
+
 static const napi_property_descriptor nsql_statement_desc[] = {
     {.utf8name = "close", .method = nsql_statement_close},
     {.utf8name = "run", .method = nsql_statement_run},
     {.utf8name = "one", .method = nsql_statement_one},
-    {.utf8name = "all", .method = nsql_statement_all},
-    {.utf8name = "sql", .getter = nsql_statement_get_sql}};
+    {.utf8name = "all",
+     .method = nsql_statement_all,
+     .attributes = napi_writable}, /* Wrapped by src/index.js */
+    {.utf8name = "allPacked", .method = nsql_statement_all_packed},
+    {.utf8name = "json", .method = nsql_statement_json},
+    {.utf8name = "arrow", .method = nsql_statement_arrow},
+    {.utf8name = "exportTo", .method = nsql_statement_export_to},
+    {.utf8name = "plan", .method = nsql_statement_plan},
+    {.utf8name = "scanStats", .method = nsql_statement_scan_stats},
+    {.utf8name = "sql", .getter = nsql_statement_get_sql},
+    {.utf8name = "internStats", .getter = nsql_statement_get_intern_stats}};
 
 napi_status nsql_statement_define_class(napi_env env, napi_value *out) {
   napi_value nclass;
@@ -87,7 +219,10 @@ end:
 }
 
 napi_status nsql_statement_prepare(napi_env env, napi_value nclass, sqlite3 *db,
-                                   napi_value nsql, napi_value *out) {
+                                   struct nsql_changes *changes,
+                                   struct nsql_cache *cache,
+                                   struct nsql_memory *memory, napi_value nsql,
+                                   napi_value *out) {
   struct nsql_statement *self;
   char *sql;
   const char *sql_end;
@@ -156,6 +291,9 @@ napi_status nsql_statement_prepare(napi_env env, napi_value nclass, sqlite3 *db,
   }
 
   self->db = db;
+  self->changes = nsql_changes_retain(changes);
+  self->cache = nsql_cache_retain(cache);
+  self->memory = nsql_memory_retain(memory);
   *out = nself;
 
 end:
@@ -164,6 +302,73 @@ end:
   return r;
 }
 
+napi_status nsql_statement_acquire(napi_env env, napi_value nstmt,
+                                   napi_value params,
+                                   struct nsql_statement **out) {
+  struct nsql_statement *self;
+  napi_valuetype type;
+  napi_status r;
+  bool ok;
+
+  assert(out != NULL);
+
+  *out = NULL;
+  self = NULL;
+
+  r = napi_unwrap(env, nstmt, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  assert(self != NULL);
+
+  if (self->stmt == NULL) {
+    r = napi_throw_error(env, NULL, "Attempted to execute a closed statement");
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    return r;
+  }
+
+  r = napi_typeof(env, params, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  if (type != napi_undefined) {
+    r = nsql_bind(env, params, self->stmt, NULL, &ok);
+
+    if (r != napi_ok || !ok) {
+      nsql_statement_reset(self);
+
+      return r;
+    }
+  }
+
+  *out = self;
+
+  return r;
+}
+
+sqlite3_stmt *nsql_statement_handle(const struct nsql_statement *self) {
+  assert(self != NULL);
+
+  return self->stmt;
+}
+
+napi_status nsql_statement_release(napi_env env, struct nsql_statement *self,
+                                   napi_status r) {
+  return nsql_statement_finish(env, self, r);
+}
+
 static napi_value nsql_statement_constructor(napi_env env,
                                              napi_callback_info ctx) {
   struct nsql_statement *self;
@@ -224,6 +429,9 @@ static void nsql_statement_destructor(napi_env env, void *ptr, void *hint) {
     nsql_fatal_sqlite_error(sqlr);
   }
 
+  nsql_changes_release(env, self->changes);
+  nsql_cache_release(self->cache);
+  nsql_memory_release(env, self->memory);
   free(self);
 }
 
@@ -284,25 +492,54 @@ static void nsql_statement_reset(struct nsql_statement *self) {
   if (sqlr != SQLITE_OK) {
     nsql_fatal_sqlite_error(sqlr);
   }
+
+  if (self->deadline != 0 || self->max_vm_steps != 0) {
+    sqlite3_progress_handler(self->db, 0, NULL, NULL);
+  }
+
+  self->deadline = 0;
+  self->max_vm_steps = 0;
+  self->vm_steps = 0;
+  self->tripped = NSQL_LIMIT_NONE;
 }
 
-static napi_status nsql_statement_exec_preamble(napi_env env,
-                                                napi_callback_info ctx,
-                                                struct nsql_statement **out) {
+static napi_status nsql_statement_finish(napi_env env,
+                                         struct nsql_statement *self,
+                                         napi_status r) {
+  nsql_statement_reset(self);
+
+  if (r != napi_ok || self == NULL) {
+    return r;
+  }
+
+  /* The call may have grown the page cache */
+
+  r = nsql_memory_update(env, self->memory);
+
+  if (r != napi_ok) {
+    return r;
+  }
+
+  /* Deliver whatever this call committed now that the statement has stopped
+     running and the listener is free to use the connection again */
+
+  return nsql_changes_flush(env, self->changes);
+}
+
+static napi_status nsql_statement_unwrap_open(napi_env env,
+                                              napi_callback_info ctx,
+                                              size_t *argc, napi_value *argv,
+                                              struct nsql_statement **out) {
   struct nsql_statement *self;
-  size_t argc;
-  napi_value argv[1];
   napi_value nself;
   napi_status r;
-  bool ok;
 
   assert(out != NULL);
 
   *out = NULL;
   self = NULL;
 
-  argc = countof(argv);
-  r = napi_get_cb_info(env, ctx, &argc, argv, &nself, NULL);
+  r = napi_get_cb_info(env, ctx, argc, argv, &nself, NULL);
 
   if (r != napi_ok) {
     nsql_report_error(env, r);
@@ -330,8 +567,89 @@ static napi_status nsql_statement_exec_preamble(napi_env env,
     goto end;
   }
 
+  *out = self;
+
+end:
+  return r;
+}
+
+static napi_status nsql_statement_exec_preamble(napi_env env,
+                                                napi_callback_info ctx,
+                                                struct nsql_statement **out,
+                                                napi_value *out_opts,
+                                                struct nsql_buf *key) {
+  struct nsql_statement *self;
+  size_t argc;
+  napi_value argv[2];
+  napi_valuetype type;
+  napi_status r;
+  const char *sql;
+  bool cache;
+  bool ok;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  argc = countof(argv);
+  r = nsql_statement_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  /* Callers that can serve results from the cache supply a buffer in which
+     to build the cache key, which is left empty unless the call opts in */
+
+  if (key != NULL) {
+    cache = false;
+    r = nsql_options_get_bool(env, argv[1], "cache", &cache, &ok);
+
+    if (r != napi_ok || !ok) {
+      goto end;
+    }
+
+    sql = sqlite3_sql(self->stmt);
+
+    if (!cache || !nsql_cache_enabled(self->cache)) {
+      key = NULL;
+    } else if (!nsql_buf_append(key, sql, strlen(sql) + 1)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  /* Methods with options of their own share the execution limits object */
+
+  if (out_opts != NULL) {
+    *out_opts = argv[1];
+  }
+
   if (argc > 0) {
-    r = nsql_bind(env, argv[0], self->stmt, &ok);
+    r = napi_typeof(env, argv[0], &type);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    /* Allow bind parameters to be skipped when only options are passed */
+
+    if (type != napi_undefined || argc < 2) {
+      r = nsql_bind(env, argv[0], self->stmt, key, &ok);
+
+      if (r != napi_ok || !ok) {
+        nsql_statement_reset(self);
+
+        goto end;
+      }
+    }
+  }
+
+  if (argc > 1) {
+    r = nsql_statement_set_limits(env, self, argv[1], &ok);
 
     if (r != napi_ok || !ok) {
       nsql_statement_reset(self);
@@ -346,6 +664,121 @@ end:
   return r;
 }
 
+static napi_status nsql_statement_set_limits(napi_env env,
+                                             struct nsql_statement *self,
+                                             napi_value opts, bool *ok) {
+  double timeout_ms;
+  double max_vm_steps;
+  napi_status r;
+
+  assert(self != NULL);
+  assert(ok != NULL);
+
+  timeout_ms = 0;
+  max_vm_steps = 0;
+
+  r = nsql_options_get_double(env, opts, "timeoutMs", &timeout_ms, ok);
+
+  if (r != napi_ok || !*ok) {
+    goto end;
+  }
+
+  r = nsql_options_get_double(env, opts, "maxVmSteps", &max_vm_steps, ok);
+
+  if (r != napi_ok || !*ok) {
+    goto end;
+  }
+
+  /* Timeouts too long for the clock to reach, roughly 292 years and beyond,
+     impose no deadline, rather than overflowing it */
+
+  if (timeout_ms > 0 && timeout_ms * 1e6 < (double)INT64_MAX) {
+    self->deadline = nsql_clock_ns() + (uint64_t)(timeout_ms * 1e6);
+  }
+
+  if (max_vm_steps >= 1) {
+    self->max_vm_steps = max_vm_steps < (double)UINT64_MAX
+                             ? (uint64_t)max_vm_steps
+                             : UINT64_MAX;
+  }
+
+  if (self->deadline == 0 && self->max_vm_steps == 0) {
+    goto end;
+  }
+
+  /* The progress handler belongs to the connection, not the statement, but
+     statements execute synchronously so only one can be running at a time. It
+     is removed again by nsql_statement_reset(). */
+
+  self->period = NSQL_PROGRESS_PERIOD;
+
+  if (self->max_vm_steps != 0 && self->max_vm_steps < (uint64_t)self->period) {
+    self->period = (int)self->max_vm_steps;
+  }
+
+  sqlite3_progress_handler(self->db, self->period, nsql_statement_progress,
+                           self);
+
+end:
+  return r;
+}
+
+static int nsql_statement_progress(void *ctx) {
+  struct nsql_statement *self;
+
+  self = ctx;
+
+  /* SQLITE_STMTSTATUS_VM_STEP is only updated when sqlite3_step() returns, so
+     count steps ourselves. The handler runs once every `period` steps. */
+
+  self->vm_steps += self->period;
+
+  if (self->max_vm_steps != 0 && self->vm_steps >= self->max_vm_steps) {
+    self->tripped = NSQL_LIMIT_VM_STEPS;
+
+    return 1;
+  }
+
+  if (self->deadline != 0 && nsql_clock_ns() >= self->deadline) {
+    self->tripped = NSQL_LIMIT_TIMEOUT;
+
+    return 1;
+  }
+
+  return 0;
+}
+
+static napi_status nsql_statement_throw(napi_env env,
+                                        struct nsql_statement *self, int sqlr) {
+  napi_status r;
+
+  /* Distinguish our own execution limits from a generic interruption, but use
+     the same error code so that callers only have one thing to test for. */
+
+  switch (sqlr == SQLITE_INTERRUPT ? self->tripped : NSQL_LIMIT_NONE) {
+  case NSQL_LIMIT_TIMEOUT:
+    r = napi_throw_error(env, "SQLITE_INTERRUPT",
+                         "Statement execution timed out");
+
+    break;
+
+  case NSQL_LIMIT_VM_STEPS:
+    r = napi_throw_error(env, "SQLITE_INTERRUPT",
+                         "Statement exceeded its VM step limit");
+
+    break;
+
+  default:
+    return nsql_throw_sqlite_error(env, sqlr, self->db);
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
+
 static napi_value nsql_statement_run(napi_env env, napi_callback_info ctx) {
   struct nsql_statement *self;
   napi_value result;
@@ -355,7 +788,7 @@ static napi_value nsql_statement_run(napi_env env, napi_callback_info ctx) {
   self = NULL;
   result = NULL;
 
-  r = nsql_statement_exec_preamble(env, ctx, &self);
+  r = nsql_statement_exec_preamble(env, ctx, &self, NULL, NULL);
 
   if (r != napi_ok || self == NULL) {
     goto end;
@@ -366,7 +799,7 @@ static napi_value nsql_statement_run(napi_env env, napi_callback_info ctx) {
   } while (sqlr == SQLITE_ROW);
 
   if (sqlr != SQLITE_DONE) {
-    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+    r = nsql_statement_throw(env, self, sqlr);
 
     goto end;
   }
@@ -374,7 +807,7 @@ static napi_value nsql_statement_run(napi_env env, napi_callback_info ctx) {
   r = nsql_statement_run_result(env, self->db, &result);
 
 end:
-  nsql_statement_reset(self);
+  r = nsql_statement_finish(env, self, r);
 
   return nsql_return(env, r, result);
 }
@@ -449,7 +882,7 @@ static napi_value nsql_statement_one(napi_env env, napi_callback_info ctx) {
   cols = NULL;
   result = NULL;
 
-  r = nsql_statement_exec_preamble(env, ctx, &self);
+  r = nsql_statement_exec_preamble(env, ctx, &self, NULL, NULL);
 
   if (r != napi_ok || self == NULL) {
     goto end;
@@ -474,18 +907,18 @@ static napi_value nsql_statement_one(napi_env env, napi_callback_info ctx) {
       goto end;
     }
 
-    r = nsql_result_get_row(env, self->stmt, cols, ncols, &result);
+    r = nsql_result_get_row(env, self->stmt, cols, ncols, NULL, &result);
 
     break;
 
   default:
-    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+    r = nsql_statement_throw(env, self, sqlr);
 
     break;
   }
 
 end:
-  nsql_statement_reset(self);
+  r = nsql_statement_finish(env, self, r);
   free(cols);
 
   return nsql_return(env, r, result);
@@ -493,22 +926,42 @@ end:
 
 static napi_value nsql_statement_all(napi_env env, napi_callback_info ctx) {
   struct nsql_statement *self;
+  struct nsql_intern intern;
   size_t ncols;
   napi_value *cols;
   napi_value result;
+  napi_value opts;
   napi_value out;
   napi_status r;
+  bool use_intern;
+  bool ok;
   int sqlr;
 
   out = NULL;
   cols = NULL;
+  use_intern = false;
+  memset(&intern, 0, sizeof(intern));
 
-  r = nsql_statement_exec_preamble(env, ctx, &self);
+  r = nsql_statement_exec_preamble(env, ctx, &self, &opts, NULL);
 
   if (r != napi_ok || self == NULL) {
     goto end;
   }
 
+  r = nsql_options_get_bool(env, opts, "intern", &use_intern, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  if (use_intern) {
+    r = nsql_intern_init(env, &intern);
+
+    if (r != napi_ok) {
+      goto end;
+    }
+  }
+
   r = napi_create_array(env, &result);
 
   if (r != napi_ok) {
@@ -525,7 +978,7 @@ static napi_value nsql_statement_all(napi_env env, napi_callback_info ctx) {
     }
 
     if (sqlr != SQLITE_ROW) {
-      r = nsql_throw_sqlite_error(env, sqlr, self->db);
+      r = nsql_statement_throw(env, self, sqlr);
 
       goto end;
     }
@@ -541,7 +994,8 @@ static napi_value nsql_statement_all(napi_env env, napi_callback_info ctx) {
       }
     }
 
-    r = nsql_result_push_row(env, self->stmt, cols, ncols, result);
+    r = nsql_result_push_row(env, self->stmt, cols, ncols,
+                             use_intern ? &intern : NULL, result);
 
     if (r != napi_ok) {
       goto end;
@@ -551,25 +1005,646 @@ static napi_value nsql_statement_all(napi_env env, napi_callback_info ctx) {
   out = result;
 
 end:
-  nsql_statement_reset(self);
+  if (use_intern && self != NULL) {
+    self->intern_hits = intern.hits;
+    self->intern_misses = intern.misses;
+    self->interned = true;
+  }
+
+  r = nsql_statement_finish(env, self, r);
+  nsql_intern_free(&intern);
   free(cols);
 
   return nsql_return(env, r, out);
 }
 
-static napi_value nsql_statement_get_sql(napi_env env, napi_callback_info ctx) {
-  const char *str;
+static napi_value nsql_statement_all_packed(napi_env env,
+                                            napi_callback_info ctx) {
   struct nsql_statement *self;
-  napi_value nself;
+  struct nsql_packed packed;
+  struct nsql_buf key;
+  const uint8_t *cached;
+  void *bytes;
+  size_t nbytes;
   napi_value out;
   napi_status r;
+  int sqlr;
 
   out = NULL;
+  memset(&packed, 0, sizeof(packed));
+  memset(&key, 0, sizeof(key));
 
-  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
-
-  if (r != napi_ok) {
-    nsql_report_error(env, r);
+  r = nsql_statement_exec_preamble(env, ctx, &self, NULL, &key);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  /* A cache hit is served without executing the statement at all */
+
+  if (key.nbytes > 0 &&
+      nsql_cache_get(self->cache, &key, &cached, &nbytes)) {
+    r = napi_create_arraybuffer(env, nbytes, &bytes, &out);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    memcpy(bytes, cached, nbytes);
+
+    goto end;
+  }
+
+  for (;;) {
+    sqlr = sqlite3_step(self->stmt);
+
+    if (sqlr != SQLITE_DONE && sqlr != SQLITE_ROW) {
+      r = nsql_statement_throw(env, self, sqlr);
+
+      goto end;
+    }
+
+    /* Column names are recorded even if there are no rows */
+
+    if (!packed.begun && !nsql_packed_begin(&packed, self->stmt)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+
+    if (sqlr == SQLITE_DONE) {
+      break;
+    }
+
+    if (!nsql_packed_push_row(&packed, self->stmt)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  r = nsql_packed_finish(env, &packed, &out);
+
+  if (r != napi_ok || key.nbytes == 0) {
+    goto end;
+  }
+
+  r = napi_get_arraybuffer_info(env, out, &bytes, &nbytes);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  nsql_cache_put(self->cache, self->stmt, &key, bytes, nbytes);
+
+end:
+  r = nsql_statement_finish(env, self, r);
+  nsql_packed_free(&packed);
+  nsql_buf_free(&key);
+
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_statement_json(napi_env env, napi_callback_info ctx) {
+  static const char *const shapes[] = {"objects", "arrays", NULL};
+  struct nsql_statement *self;
+  struct nsql_json json;
+  napi_value opts;
+  napi_value out;
+  napi_status r;
+  bool buffer;
+  bool ok;
+  int shape;
+  int sqlr;
+
+  out = NULL;
+  memset(&json, 0, sizeof(json));
+
+  r = nsql_statement_exec_preamble(env, ctx, &self, &opts, NULL);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  shape = 0;
+  r = nsql_options_get_enum(env, opts, "shape", shapes, &shape, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  buffer = false;
+  r = nsql_options_get_bool(env, opts, "buffer", &buffer, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  for (;;) {
+    sqlr = sqlite3_step(self->stmt);
+
+    if (sqlr != SQLITE_DONE && sqlr != SQLITE_ROW) {
+      r = nsql_statement_throw(env, self, sqlr);
+
+      goto end;
+    }
+
+    if (!json.begun && !nsql_json_begin(&json, self->stmt, shape == 0)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+
+    if (sqlr == SQLITE_DONE) {
+      break;
+    }
+
+    if (!nsql_json_push_row(&json, self->stmt)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  if (!nsql_json_end(&json)) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  if (buffer) {
+    r = napi_create_buffer_copy(env, json.out.nbytes, json.out.bytes, NULL,
+                                &out);
+  } else {
+    r = napi_create_string_utf8(env, (const char *)json.out.bytes,
+                                json.out.nbytes, &out);
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  r = nsql_statement_finish(env, self, r);
+  nsql_json_free(&json);
+
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_statement_arrow(napi_env env, napi_callback_info ctx) {
+  struct nsql_statement *self;
+  struct nsql_arrow arrow;
+  struct nsql_buf stream;
+  double batch_size;
+  napi_value opts;
+  napi_value out;
+  napi_status r;
+  void *bytes;
+  bool ok;
+  int sqlr;
+
+  out = NULL;
+  memset(&arrow, 0, sizeof(arrow));
+  memset(&stream, 0, sizeof(stream));
+
+  r = nsql_statement_exec_preamble(env, ctx, &self, &opts, NULL);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  batch_size = NSQL_ARROW_BATCH_SIZE;
+  r = nsql_options_get_double(env, opts, "batchSize", &batch_size, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  if (batch_size < 1 || batch_size != floor(batch_size) ||
+      batch_size > INT32_MAX) {
+    r = napi_throw_range_error(env, "ERR_OUT_OF_RANGE",
+                               "batchSize: Expected a positive integer");
+
+    goto end;
+  }
+
+  for (;;) {
+    sqlr = sqlite3_step(self->stmt);
+
+    if (sqlr != SQLITE_DONE && sqlr != SQLITE_ROW) {
+      r = nsql_statement_throw(env, self, sqlr);
+
+      goto end;
+    }
+
+    if (!arrow.begun && !nsql_arrow_begin(&arrow, self->stmt)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+
+    if (sqlr == SQLITE_DONE) {
+      break;
+    }
+
+    if (!nsql_arrow_push_row(&arrow, self->stmt)) {
+      r = nsql_throw_oom(env);
+
+      goto end;
+    }
+  }
+
+  if (!nsql_arrow_finish(&arrow, (int64_t)batch_size, &stream)) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  r = napi_create_arraybuffer(env, stream.nbytes, &bytes, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  memcpy(bytes, stream.bytes, stream.nbytes);
+
+end:
+  r = nsql_statement_finish(env, self, r);
+  nsql_arrow_free(&arrow);
+  nsql_buf_free(&stream);
+
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_statement_export_to(napi_env env,
+                                           napi_callback_info ctx) {
+  struct nsql_statement_export *job;
+  struct nsql_statement *self;
+  const char *filename;
+  sqlite3_vfs *vfs;
+  size_t argc;
+  napi_value argv[2];
+  napi_value params;
+  napi_value name;
+  napi_value promise;
+  napi_value out;
+  napi_valuetype type;
+  napi_status r;
+  bool ok;
+  int sqlr;
+
+  out = NULL;
+  self = NULL;
+  job = calloc(1, sizeof(*job));
+
+  if (job == NULL) {
+    r = nsql_throw_oom(env);
+
+    goto end;
+  }
+
+  argc = countof(argv);
+  r = nsql_statement_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  /* Bind parameters travel inside the options object, since the target
+     already occupies the first argument */
+
+  r = napi_typeof(env, argv[1], &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type == napi_object) {
+    r = napi_get_named_property(env, argv[1], "params", &params);
+  } else if (type == napi_undefined) {
+    r = napi_get_undefined(env, &params);
+  } else {
+    r = napi_throw_type_error(env, "ERR_INVALID_ARG_TYPE",
+                              "options: Expected object");
+
+    goto end;
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (!sqlite3_stmt_readonly(self->stmt)) {
+    r = napi_throw_error(env, NULL, "Exported statements must be read-only");
+
+    goto end;
+  }
+
+  /* The export steps a copy of the statement on a read-only connection of its
+     own, so that this connection, along with its execution limits, remains
+     free for use by this thread in the meantime. That connection must be able
+     to open the same database through the same VFS. */
+
+  filename = sqlite3_db_filename(self->db, "main");
+
+  if (filename == NULL || filename[0] == '\0') {
+    r = napi_throw_error(env, NULL, "Exporting requires a file database");
+
+    goto end;
+  }
+
+  vfs = NULL;
+  sqlr = sqlite3_file_control(self->db, "main", SQLITE_FCNTL_VFS_POINTER, &vfs);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, self->db);
+
+    goto end;
+  }
+
+  sqlr = sqlite3_open_v2(filename, &job->db,
+                         SQLITE_OPEN_READONLY | SQLITE_OPEN_NOMUTEX,
+                         vfs != NULL ? vfs->zName : NULL);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, job->db);
+
+    goto end;
+  }
+
+  (void)sqlite3_extended_result_codes(job->db, 1);
+  (void)sqlite3_busy_timeout(job->db, NSQL_EXPORT_BUSY_TIMEOUT_MS);
+
+  sqlr = sqlite3_prepare_v2(job->db, sqlite3_sql(self->stmt), -1, &job->stmt,
+                            NULL);
+
+  if (sqlr != SQLITE_OK) {
+    r = nsql_throw_sqlite_error(env, sqlr, job->db);
+
+    goto end;
+  }
+
+  r = napi_typeof(env, params, &type);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  if (type != napi_undefined) {
+    r = nsql_bind(env, params, job->stmt, NULL, &ok);
+
+    if (r != napi_ok || !ok) {
+      goto end;
+    }
+  }
+
+  /* Only create or truncate the file once everything else has checked out */
+
+  r = nsql_export_open(env, &job->export, argv[0], argv[1], &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = napi_create_string_utf8(env, "nsql export", NAPI_AUTO_LENGTH, &name);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_async_work(env, NULL, name, nsql_statement_export_execute,
+                             nsql_statement_export_complete, job, &job->work);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_promise(env, &job->deferred, &promise);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_queue_async_work(env, job->work);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  out = promise;
+  job = NULL;
+
+end:
+  nsql_statement_export_free(env, job);
+
+  r = nsql_statement_finish(env, self, r);
+
+  return nsql_return(env, r, out);
+}
+
+static void nsql_statement_export_execute(napi_env env, void *data) {
+  struct nsql_statement_export *job;
+  int sqlr;
+
+  /* This runs on a libuv worker thread, so it must not call into N-API. The
+     connection belongs to this job alone. */
+
+  job = data;
+
+  for (;;) {
+    sqlr = sqlite3_step(job->stmt);
+
+    if (sqlr != SQLITE_DONE && sqlr != SQLITE_ROW) {
+      job->sqlr = sqlr;
+
+      return;
+    }
+
+    if (!job->export.begun && !nsql_export_begin(&job->export, job->stmt)) {
+      job->failed = true;
+
+      return;
+    }
+
+    if (sqlr == SQLITE_DONE) {
+      break;
+    }
+
+    if (!nsql_export_push_row(&job->export, job->stmt)) {
+      job->failed = true;
+
+      return;
+    }
+  }
+
+  if (!nsql_export_finish(&job->export)) {
+    job->failed = true;
+  }
+}
+
+static void nsql_statement_export_complete(napi_env env, napi_status status,
+                                           void *data) {
+  struct nsql_statement_export *job;
+  napi_value value;
+  napi_status r;
+  bool failed;
+
+  job = data;
+  failed = job->failed || job->sqlr != SQLITE_OK;
+
+  if (job->sqlr != SQLITE_OK) {
+    (void)nsql_throw_sqlite_error(env, job->sqlr, job->db);
+  } else if (job->failed) {
+    (void)nsql_export_throw(env, &job->export);
+  }
+
+  /* A failed close can lose buffered data, so it counts as a failure too */
+
+  if (!nsql_export_close(&job->export) && !failed) {
+    (void)nsql_export_throw(env, &job->export);
+    failed = true;
+  }
+
+  if (!failed) {
+    r = napi_create_int64(env, job->export.nrows, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_resolve_deferred(env, job->deferred, value);
+  } else {
+    r = napi_get_and_clear_last_exception(env, &value);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+
+      goto end;
+    }
+
+    r = napi_reject_deferred(env, job->deferred, value);
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+end:
+  nsql_statement_export_free(env, job);
+}
+
+static void nsql_statement_export_free(napi_env env,
+                                       struct nsql_statement_export *job) {
+  int sqlr;
+
+  if (job == NULL) {
+    return;
+  }
+
+  (void)nsql_export_close(&job->export);
+
+  if (job->work != NULL) {
+    (void)napi_delete_async_work(env, job->work);
+  }
+
+  sqlite3_finalize(job->stmt);
+  sqlr = sqlite3_close_v2(job->db);
+
+  if (sqlr != SQLITE_OK) {
+    nsql_fatal_sqlite_error(sqlr);
+  }
+
+  free(job);
+}
+
+static napi_value nsql_statement_plan(napi_env env, napi_callback_info ctx) {
+  struct nsql_statement *self;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = nsql_statement_unwrap_open(env, ctx, NULL, NULL, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  r = nsql_explain_plan(env, self->db, self->stmt, &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_statement_scan_stats(napi_env env,
+                                            napi_callback_info ctx) {
+  struct nsql_statement *self;
+  size_t argc;
+  napi_value argv[1];
+  napi_value out;
+  napi_status r;
+  bool reset;
+  bool ok;
+
+  out = NULL;
+
+  argc = countof(argv);
+  r = nsql_statement_unwrap_open(env, ctx, &argc, argv, &self);
+
+  if (r != napi_ok || self == NULL) {
+    goto end;
+  }
+
+  reset = false;
+  r = nsql_options_get_bool(env, argv[0], "reset", &reset, &ok);
+
+  if (r != napi_ok || !ok) {
+    goto end;
+  }
+
+  r = nsql_explain_scan_stats(env, self->stmt, reset, &out);
+
+end:
+  return nsql_return(env, r, out);
+}
+
+static napi_value nsql_statement_get_sql(napi_env env, napi_callback_info ctx) {
+  const char *str;
+  struct nsql_statement *self;
+  napi_value nself;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
 
     goto end;
   }
@@ -607,3 +1682,85 @@ static napi_value nsql_statement_get_sql(napi_env env, napi_callback_info ctx) {
 end:
   return nsql_return(env, r, out);
 }
+
+static napi_value nsql_statement_get_intern_stats(napi_env env,
+                                                  napi_callback_info ctx) {
+  struct nsql_statement *self;
+  napi_value nself;
+  napi_value value;
+  napi_value out;
+  napi_status r;
+
+  out = NULL;
+
+  r = napi_get_cb_info(env, ctx, NULL, NULL, &nself, NULL);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_unwrap(env, nself, (void **)&self);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  assert(self != NULL);
+
+  if (!self->interned) {
+    r = napi_get_null(env, &out);
+
+    if (r != napi_ok) {
+      nsql_report_error(env, r);
+    }
+
+    goto end;
+  }
+
+  r = napi_create_object(env, &out);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_double(env, self->intern_hits, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, out, "hits", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_create_double(env, self->intern_misses, &value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  r = napi_set_named_property(env, out, "misses", value);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+end:
+  return nsql_return(env, r, out);
+}
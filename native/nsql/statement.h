@@ -3,6 +3,12 @@
 #include <node_api.h>
 #include <sqlite3.h>
 
+#include "cache.h"
+#include "changes.h"
+#include "memory.h"
+
+struct nsql_statement;
+
 /*
  * Define and return a JavaScript constructor function that can be used to
  * create `Statement` objects. This constructor should not be invoked directly,
@@ -14,7 +20,37 @@ napi_status nsql_statement_define_class(napi_env env, napi_value *out);
  * Construct a prepared statement and then wrap it in a newly-constructed
  * JavaScript `Statement` object. Requires a constructor function that was
  * previously defined by `nsql_statement_define_class()`; this should be passed
- * in the `nclass` parameter.
+ * in the `nclass` parameter. The statement retains `changes`, the change feed
+ * of `db`, and flushes it after each execution. It also retains `cache`, the
+ * result cache of `db`, for calls that opt in to caching, and `memory`, the
+ * memory accounting record of `db`, which it updates after each execution.
  */
 napi_status nsql_statement_prepare(napi_env env, napi_value nclass, sqlite3 *db,
-                                   napi_value nsql, napi_value *out);
+                                   struct nsql_changes *changes,
+                                   struct nsql_cache *cache,
+                                   struct nsql_memory *memory, napi_value nsql,
+                                   napi_value *out);
+
+/*
+ * Unwrap the JavaScript `Statement` object `nstmt` and bind `params` to it, if
+ * not `undefined`, so that it can be executed by another part of NSQL, possibly
+ * on another thread. `*out` is set to NULL if a JavaScript exception was
+ * thrown, and must otherwise be passed to `nsql_statement_release()` once
+ * execution has finished.
+ */
+napi_status nsql_statement_acquire(napi_env env, napi_value nstmt,
+                                   napi_value params,
+                                   struct nsql_statement **out);
+
+/*
+ * Return the SQLite prepared statement of an acquired statement.
+ */
+sqlite3_stmt *nsql_statement_handle(const struct nsql_statement *self);
+
+/*
+ * Reset an acquired statement and carry out the same bookkeeping as a call to
+ * one of its own methods. `r` is the status of the execution so far, and the
+ * status after the bookkeeping is returned.
+ */
+napi_status nsql_statement_release(napi_env env, struct nsql_statement *self,
+                                   napi_status r);
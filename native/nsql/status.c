@@ -0,0 +1,174 @@
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+#include "error.h"
+#include "macros.h"
+#include "status.h"
+
+struct nsql_status_field {
+  int op;
+  const char *name;
+  bool highwater;
+};
+
+/* Some counters are only reported through their high-water mark, see
+   https://sqlite.org/c3ref/c_dbstatus_options.html */
+
+static const struct nsql_status_field nsql_status_db_fields[] = {
+    {SQLITE_DBSTATUS_CACHE_USED, "cacheUsed", false},
+    {SQLITE_DBSTATUS_CACHE_HIT, "cacheHit", false},
+    {SQLITE_DBSTATUS_CACHE_MISS, "cacheMiss", false},
+    {SQLITE_DBSTATUS_CACHE_WRITE, "cacheWrite", false},
+    {SQLITE_DBSTATUS_CACHE_SPILL, "cacheSpill", false},
+    {SQLITE_DBSTATUS_LOOKASIDE_USED, "lookasideUsed", false},
+    {SQLITE_DBSTATUS_LOOKASIDE_USED, "lookasideHighwater", true},
+    {SQLITE_DBSTATUS_LOOKASIDE_HIT, "lookasideHit", true},
+    {SQLITE_DBSTATUS_LOOKASIDE_MISS_SIZE, "lookasideMissSize", true},
+    {SQLITE_DBSTATUS_LOOKASIDE_MISS_FULL, "lookasideMissFull", true},
+    {SQLITE_DBSTATUS_SCHEMA_USED, "schemaUsed", false},
+    {SQLITE_DBSTATUS_STMT_USED, "stmtUsed", false}};
+
+static const struct nsql_status_field nsql_status_global_fields[] = {
+    {SQLITE_STATUS_MEMORY_USED, "memoryUsed", false},
+    {SQLITE_STATUS_MEMORY_USED, "memoryHighwater", true},
+    {SQLITE_STATUS_MALLOC_COUNT, "mallocCount", false},
+    {SQLITE_STATUS_MALLOC_SIZE, "largestMalloc", true},
+    {SQLITE_STATUS_PAGECACHE_OVERFLOW, "pagecacheOverflow", false},
+    {SQLITE_STATUS_PAGECACHE_SIZE, "largestPagecache", true}};
+
+static napi_status nsql_status_set(napi_env env, napi_value obj,
+                                   const char *name, double value);
+
+napi_status nsql_status_db(napi_env env, sqlite3 *db, bool reset,
+                           napi_value *out) {
+  const struct nsql_status_field *field;
+  napi_value obj;
+  napi_status r;
+  size_t i;
+  int cur;
+  int hi;
+  int sqlr;
+
+  assert(db != NULL);
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  for (i = 0; i < countof(nsql_status_db_fields); i++) {
+    field = &nsql_status_db_fields[i];
+    sqlr = sqlite3_db_status(db, field->op, &cur, &hi, 0);
+
+    if (sqlr != SQLITE_OK) {
+      r = nsql_throw_sqlite_error(env, sqlr, NULL);
+
+      goto end;
+    }
+
+    r = nsql_status_set(env, obj, field->name, field->highwater ? hi : cur);
+
+    if (r != napi_ok) {
+      goto end;
+    }
+  }
+
+  /* Reset in a separate pass, since several fields may be read from the same
+     counter. */
+
+  if (reset) {
+    for (i = 0; i < countof(nsql_status_db_fields); i++) {
+      field = &nsql_status_db_fields[i];
+      (void)sqlite3_db_status(db, field->op, &cur, &hi, 1);
+    }
+  }
+
+  *out = obj;
+
+end:
+  return r;
+}
+
+napi_status nsql_status_global(napi_env env, bool reset, napi_value *out) {
+  const struct nsql_status_field *field;
+  sqlite3_int64 cur;
+  sqlite3_int64 hi;
+  napi_value obj;
+  napi_status r;
+  size_t i;
+  int sqlr;
+
+  assert(out != NULL);
+
+  *out = NULL;
+
+  r = napi_create_object(env, &obj);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    goto end;
+  }
+
+  for (i = 0; i < countof(nsql_status_global_fields); i++) {
+    field = &nsql_status_global_fields[i];
+    sqlr = sqlite3_status64(field->op, &cur, &hi, 0);
+
+    if (sqlr != SQLITE_OK) {
+      r = nsql_throw_sqlite_error(env, sqlr, NULL);
+
+      goto end;
+    }
+
+    r = nsql_status_set(env, obj, field->name,
+                        (double)(field->highwater ? hi : cur));
+
+    if (r != napi_ok) {
+      goto end;
+    }
+  }
+
+  if (reset) {
+    for (i = 0; i < countof(nsql_status_global_fields); i++) {
+      field = &nsql_status_global_fields[i];
+      (void)sqlite3_status64(field->op, &cur, &hi, 1);
+    }
+  }
+
+  *out = obj;
+
+end:
+  return r;
+}
+
+static napi_status nsql_status_set(napi_env env, napi_value obj,
+                                   const char *name, double value) {
+  napi_value num;
+  napi_status r;
+
+  r = napi_create_double(env, value, &num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+
+    return r;
+  }
+
+  r = napi_set_named_property(env, obj, name, num);
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
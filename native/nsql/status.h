@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdbool.h>
+
+#include <node_api.h>
+#include <sqlite3.h>
+
+/*
+ * Collect the `sqlite3_db_status()` counters for a database connection into a
+ * JavaScript object. If `reset` is true then the resettable counters are
+ * zeroed after they have been read.
+ */
+napi_status nsql_status_db(napi_env env, sqlite3 *db, bool reset,
+                           napi_value *out);
+
+/*
+ * Collect the process-wide `sqlite3_status64()` counters into a JavaScript
+ * object. If `reset` is true then the high-water marks are reset after they
+ * have been read.
+ *
+ * Most of these counters are only maintained if SQLite was built with memory
+ * statistics enabled; see the `nsql_memstatus` build variable.
+ */
+napi_status nsql_status_global(napi_env env, bool reset, napi_value *out);
@@ -1,12 +1,94 @@
 #include <assert.h>
+#include <stdbool.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dlfcn.h>
+#endif
 
 #include <node_api.h>
 
 #include "error.h"
 #include "str.h"
 
+/* ASCII strings at least this long are created as external strings */
+
+#define NSQL_EXTERNAL_STRING_MIN (64 * 1024)
+
+#define NSQL_SWAR_HIGHS 0x8080808080808080ull
+
+typedef napi_status (*nsql_create_external_latin1_fn)(
+    napi_env env, char *str, size_t length, napi_finalize finalize_cb,
+    void *finalize_hint, napi_value *out, bool *copied);
+
+/* External strings arrived in N-API version 10. Rather than require that, the
+   function is looked up at runtime and used when present. */
+
+static nsql_create_external_latin1_fn nsql_create_external_latin1;
+
+static void *nsql_str_lookup(const char *name);
+
+static bool nsql_str_is_ascii(const char *bytes, size_t nbytes);
+
+static void nsql_str_finalize(napi_env env, void *data, void *hint);
+
+void nsql_str_init(void) {
+  nsql_create_external_latin1 =
+      (nsql_create_external_latin1_fn)nsql_str_lookup(
+          "node_api_create_external_string_latin1");
+}
+
+napi_status nsql_create_string(napi_env env, const char *bytes, size_t nbytes,
+                               napi_value *out) {
+  napi_status r;
+  bool copied;
+  char *copy;
+
+  assert(out != NULL);
+
+  /* ASCII is a subset of both UTF-8 and Latin-1, and V8 stores Latin-1
+     strings as they are, without having to decode them first */
+
+  if (!nsql_str_is_ascii(bytes, nbytes)) {
+    r = napi_create_string_utf8(env, bytes, nbytes, out);
+  } else if (nsql_create_external_latin1 == NULL ||
+             nbytes < NSQL_EXTERNAL_STRING_MIN) {
+    r = napi_create_string_latin1(env, bytes, nbytes, out);
+  } else {
+    /* SQLite's copy is only valid until the next step, so the external string
+       needs one of its own */
+
+    copy = malloc(nbytes);
+
+    if (copy == NULL) {
+      return nsql_throw_oom(env);
+    }
+
+    memcpy(copy, bytes, nbytes);
+
+    /* If the runtime copies the string anyway then it has already called the
+       finalizer by the time this returns */
+
+    r = nsql_create_external_latin1(env, copy, nbytes, nsql_str_finalize,
+                                    NULL, out, &copied);
+
+    if (r != napi_ok) {
+      free(copy);
+    }
+  }
+
+  if (r != napi_ok) {
+    nsql_report_error(env, r);
+  }
+
+  return r;
+}
+
 napi_status nsql_get_string(napi_env env, napi_value value, char **out,
                             size_t *out_nbytes) {
   napi_status r;
@@ -58,3 +140,52 @@ end:
 
   return r;
 }
+
+static void *nsql_str_lookup(const char *name) {
+#ifdef _WIN32
+  return (void *)GetProcAddress(GetModuleHandle(NULL), name);
+#else
+  void *self;
+  void *sym;
+
+  self = dlopen(NULL, RTLD_LAZY);
+
+  if (self == NULL) {
+    return NULL;
+  }
+
+  sym = dlsym(self, name);
+  dlclose(self);
+
+  return sym;
+#endif
+}
+
+static bool nsql_str_is_ascii(const char *bytes, size_t nbytes) {
+  uint64_t bits;
+  uint64_t word;
+  size_t i;
+
+  /* Eight bytes at a time, checking all of their high bits at once */
+
+  bits = 0;
+
+  for (i = 0; i + 8 <= nbytes; i += 8) {
+    memcpy(&word, bytes + i, 8);
+    bits |= word;
+
+    if ((i & 63) == 56 && (bits & NSQL_SWAR_HIGHS) != 0) {
+      return false;
+    }
+  }
+
+  for (; i < nbytes; i++) {
+    bits |= (unsigned char)bytes[i];
+  }
+
+  return (bits & NSQL_SWAR_HIGHS) == 0;
+}
+
+static void nsql_str_finalize(napi_env env, void *data, void *hint) {
+  free(data);
+}
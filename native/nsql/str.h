@@ -18,3 +18,18 @@
  */
 napi_status nsql_get_string(napi_env env, napi_value value, char **out,
                             size_t *out_nbytes);
+
+/*
+ * Look up optional N-API functions that are newer than the N-API version this
+ * module is built against. Must be called once when the module is loaded.
+ */
+void nsql_str_init(void);
+
+/*
+ * Create a JavaScript string from UTF-8 bytes. Pure ASCII input, which is by
+ * far the most common case, is created as Latin-1 to skip UTF-8 decoding, and
+ * large ASCII strings are kept outside the JavaScript heap where the runtime
+ * supports external strings.
+ */
+napi_status nsql_create_string(napi_env env, const char *bytes, size_t nbytes,
+                               napi_value *out);
@@ -0,0 +1,36 @@
+#include <stddef.h>
+
+#include <sqlite3.h>
+
+#include "unixfile.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/stat.h>
+
+/* Leading members of the unix VFS's private `unixFile` structure, which has
+   begun this way since SQLite 3.7 */
+
+struct nsql_unixfile {
+  const sqlite3_io_methods *methods;
+  sqlite3_vfs *vfs;
+  void *inode;
+  int h;
+};
+
+int nsql_unixfile_fd(sqlite3_file *file, const char *name) {
+  const struct nsql_unixfile *self;
+  struct stat a;
+  struct stat b;
+
+  self = (const struct nsql_unixfile *)file;
+
+  if (name == NULL || self->h < 0 || fstat(self->h, &a) != 0 ||
+      stat(name, &b) != 0 || a.st_dev != b.st_dev || a.st_ino != b.st_ino) {
+    return -1;
+  }
+
+  return self->h;
+}
+#else
+int nsql_unixfile_fd(sqlite3_file *file, const char *name) { return -1; }
+#endif
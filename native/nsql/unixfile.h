@@ -0,0 +1,15 @@
+#pragma once
+
+#include <sqlite3.h>
+
+/*
+ * Return the file descriptor behind `file`, which must have been opened by the
+ * unix VFS from the path `name`, or -1 if it cannot be determined. The unix VFS
+ * does not expose its descriptors, so this relies on the layout of its private
+ * file object, but the result is checked against `name` before it is
+ * returned. Always returns -1 on platforms without the unix VFS.
+ *
+ * The descriptor belongs to the unix VFS and must not be closed, since that
+ * would release every POSIX lock the process holds on the file.
+ */
+int nsql_unixfile_fd(sqlite3_file *file, const char *name);
@@ -0,0 +1,1249 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sqlite3.h>
+
+#include "macros.h"
+#include "unixfile.h"
+#include "uring.h"
+
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+
+/* io_uring is used through raw system calls, so that there is no dependency on
+   liburing, but the kernel headers must know about it */
+
+#if defined(__linux__) && defined(__NR_io_uring_setup)
+#define NSQL_URING 1
+#else
+#define NSQL_URING 0
+#endif
+
+#if NSQL_URING
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+/* Submission queue size of each file's ring, which also bounds the number of
+   requests in flight */
+
+#define NSQL_URING_ENTRIES 64
+
+/* Writes are copied into a staging area until they are submitted. A full
+   staging area, or a full table of pending writes, forces a flush. */
+
+#define NSQL_URING_STAGE_NBYTES (2 * 1024 * 1024)
+#define NSQL_URING_MAX_WRITES 512
+
+/* Size of each read-ahead window, and the number of consecutive sequential
+   reads after which read-ahead starts */
+
+#define NSQL_URING_WINDOW_NBYTES (128 * 1024)
+#define NSQL_URING_STREAK 4
+
+/* The upper half of an SQE's user data says what kind of request it is, and
+   the lower half indexes the pending write or read-ahead slot it belongs to */
+
+enum nsql_uring_tag {
+  NSQL_URING_TAG_WRITE,
+  NSQL_URING_TAG_FSYNC,
+  NSQL_URING_TAG_READ,
+};
+
+enum nsql_uring_slot_state {
+  NSQL_URING_SLOT_IDLE,
+  NSQL_URING_SLOT_BUSY,
+  NSQL_URING_SLOT_DONE,
+};
+
+struct nsql_uring_write {
+  sqlite3_int64 off;
+  const uint8_t *bytes;
+  size_t nbytes;
+};
+
+struct nsql_uring_slot {
+  enum nsql_uring_slot_state state;
+  uint8_t *buf;
+  sqlite3_int64 off;
+  size_t nbytes;
+};
+
+/* The default VFS's own file object follows this structure in memory. The
+   ring and buffers are set up on first use, since many connections never write
+   or scan. `failed` is set if that is not possible, in which case everything
+   is passed through. */
+
+struct nsql_uring_file {
+  sqlite3_file base;
+  sqlite3_file *real;
+  int fd;
+  bool failed;
+
+  /* A main database file and its WAL file know about each other, since shared
+     memory operations are made on the former but publish writes to the
+     latter. The first sync of a WAL file is passed through so that the
+     default VFS can also sync the directory that holds it. */
+
+  struct nsql_uring_file *main;
+  struct nsql_uring_file *wal;
+  bool is_wal;
+  bool synced;
+
+  /* Ring, mapped from the kernel */
+
+  int ring_fd;
+  void *ring;
+  size_t ring_nbytes;
+  struct io_uring_sqe *sqes;
+  size_t sqes_nbytes;
+  unsigned *sq_head;
+  unsigned *sq_tail;
+  unsigned *sq_mask;
+  unsigned *sq_array;
+  unsigned *cq_head;
+  unsigned *cq_tail;
+  unsigned *cq_mask;
+  struct io_uring_cqe *cqes;
+  unsigned entries;
+
+  /* `tail` runs ahead of the kernel's view of the submission queue by the
+     number of queued SQEs. `inflight` counts submitted requests that have not
+     completed, and `writing` counts writes and syncs that have not completed,
+     whether submitted or not. */
+
+  unsigned tail;
+  unsigned queued;
+  unsigned inflight;
+  unsigned writing;
+
+  /* Writes since the last flush, the range of the file that they cover, and
+     the SQE of the latest one while it can still be extended */
+
+  uint8_t *stage;
+  size_t stage_used;
+  struct nsql_uring_write *writes;
+  unsigned nwrites;
+  sqlite3_int64 lo;
+  sqlite3_int64 hi;
+  struct io_uring_sqe *last;
+  int error;
+
+  /* Read-ahead */
+
+  struct nsql_uring_slot slots[2];
+  sqlite3_int64 next_off;
+  unsigned streak;
+};
+
+static bool nsql_uring_supported;
+
+static int nsql_uring_close(sqlite3_file *file);
+
+static int nsql_uring_read(sqlite3_file *file, void *buf, int amt,
+                           sqlite3_int64 off);
+
+static int nsql_uring_write(sqlite3_file *file, const void *buf, int amt,
+                            sqlite3_int64 off);
+
+static int nsql_uring_truncate(sqlite3_file *file, sqlite3_int64 size);
+
+static int nsql_uring_sync(sqlite3_file *file, int flags);
+
+static int nsql_uring_file_size(sqlite3_file *file, sqlite3_int64 *out);
+
+static int nsql_uring_lock(sqlite3_file *file, int lock);
+
+static int nsql_uring_unlock(sqlite3_file *file, int lock);
+
+static int nsql_uring_check_reserved_lock(sqlite3_file *file, int *out);
+
+static int nsql_uring_file_control(sqlite3_file *file, int op, void *arg);
+
+static int nsql_uring_sector_size(sqlite3_file *file);
+
+static int nsql_uring_device_characteristics(sqlite3_file *file);
+
+static int nsql_uring_shm_map(sqlite3_file *file, int region, int nbytes,
+                              int extend, void volatile **out);
+
+static int nsql_uring_shm_lock(sqlite3_file *file, int offset, int n,
+                               int flags);
+
+static void nsql_uring_shm_barrier(sqlite3_file *file);
+
+static int nsql_uring_shm_unmap(sqlite3_file *file, int delete_flag);
+
+static int nsql_uring_fetch(sqlite3_file *file, sqlite3_int64 off, int amt,
+                            void **out);
+
+static int nsql_uring_unfetch(sqlite3_file *file, sqlite3_int64 off, void *ptr);
+
+static bool nsql_uring_probe(void);
+
+static int nsql_uring_file_open(sqlite3_vfs *base, sqlite3_filename name,
+                                sqlite3_file *file, int flags, int *out_flags);
+
+static bool nsql_uring_ready(struct nsql_uring_file *self);
+
+static void nsql_uring_teardown(struct nsql_uring_file *self);
+
+static int nsql_uring_sqe(struct nsql_uring_file *self,
+                          struct io_uring_sqe **out);
+
+static int nsql_uring_submit(struct nsql_uring_file *self);
+
+static int nsql_uring_wait(struct nsql_uring_file *self);
+
+static void nsql_uring_complete(struct nsql_uring_file *self, uint64_t data,
+                                int res);
+
+static int nsql_uring_flush(struct nsql_uring_file *self, int sync_flags);
+
+static int nsql_uring_forget(struct nsql_uring_file *self);
+
+static int nsql_uring_settle(struct nsql_uring_file *self);
+
+static bool nsql_uring_overlaps(const struct nsql_uring_file *self,
+                                sqlite3_int64 off, sqlite3_int64 end);
+
+static int nsql_uring_read_ahead(struct nsql_uring_file *self,
+                                 sqlite3_int64 off);
+
+static int nsql_uring_read_slot(struct nsql_uring_file *self, void *buf,
+                                int amt, sqlite3_int64 off, bool *hit);
+
+static int nsql_uring_pwrite(int fd, const uint8_t *bytes, size_t nbytes,
+                             sqlite3_int64 off);
+
+static const sqlite3_io_methods nsql_uring_methods = {
+    .iVersion = 3,
+    .xClose = nsql_uring_close,
+    .xRead = nsql_uring_read,
+    .xWrite = nsql_uring_write,
+    .xTruncate = nsql_uring_truncate,
+    .xSync = nsql_uring_sync,
+    .xFileSize = nsql_uring_file_size,
+    .xLock = nsql_uring_lock,
+    .xUnlock = nsql_uring_unlock,
+    .xCheckReservedLock = nsql_uring_check_reserved_lock,
+    .xFileControl = nsql_uring_file_control,
+    .xSectorSize = nsql_uring_sector_size,
+    .xDeviceCharacteristics = nsql_uring_device_characteristics,
+    .xShmMap = nsql_uring_shm_map,
+    .xShmLock = nsql_uring_shm_lock,
+    .xShmBarrier = nsql_uring_shm_barrier,
+    .xShmUnmap = nsql_uring_shm_unmap,
+    .xFetch = nsql_uring_fetch,
+    .xUnfetch = nsql_uring_unfetch};
+#endif
+
+/* The registered VFS is a copy of the default VFS with a different `xOpen()`.
+   Every other method is the default VFS's own, and none of them depend on the
+   identity of the VFS object they are called through. */
+
+static sqlite3_vfs *nsql_uring_base;
+static sqlite3_vfs nsql_uring_vfs;
+
+static int nsql_uring_open(sqlite3_vfs *vfs, sqlite3_filename name,
+                           sqlite3_file *file, int flags, int *out_flags);
+
+int nsql_uring_register(void) {
+  sqlite3_mutex *mutex;
+  sqlite3_vfs *base;
+  int sqlr;
+
+  sqlr = sqlite3_initialize();
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  /* Each worker thread that loads this module registers it again */
+
+  mutex = sqlite3_mutex_alloc(SQLITE_MUTEX_STATIC_APP1);
+  sqlite3_mutex_enter(mutex);
+
+  if (sqlite3_vfs_find(NSQL_URING_VFS) != NULL) {
+    goto end;
+  }
+
+  base = sqlite3_vfs_find(NULL);
+
+  if (base == NULL) {
+    sqlr = SQLITE_ERROR;
+
+    goto end;
+  }
+
+  nsql_uring_base = base;
+  nsql_uring_vfs = *base;
+  nsql_uring_vfs.pNext = NULL;
+  nsql_uring_vfs.zName = NSQL_URING_VFS;
+  nsql_uring_vfs.xOpen = nsql_uring_open;
+
+#if NSQL_URING
+  nsql_uring_supported =
+      strncmp(base->zName, "unix", 4) == 0 && nsql_uring_probe();
+
+  if (nsql_uring_supported) {
+    nsql_uring_vfs.szOsFile = sizeof(struct nsql_uring_file) + base->szOsFile;
+  }
+#endif
+
+  sqlr = sqlite3_vfs_register(&nsql_uring_vfs, 0);
+
+end:
+  sqlite3_mutex_leave(mutex);
+
+  return sqlr;
+}
+
+static int nsql_uring_open(sqlite3_vfs *vfs, sqlite3_filename name,
+                           sqlite3_file *file, int flags, int *out_flags) {
+  sqlite3_vfs *base;
+
+  base = nsql_uring_base;
+
+#if NSQL_URING
+  if (nsql_uring_supported && name != NULL &&
+      (flags & (SQLITE_OPEN_MAIN_DB | SQLITE_OPEN_WAL)) != 0) {
+    return nsql_uring_file_open(base, name, file, flags, out_flags);
+  }
+#endif
+
+  return base->xOpen(base, name, file, flags, out_flags);
+}
+
+#if NSQL_URING
+static int nsql_uring_setup(unsigned entries, struct io_uring_params *p) {
+  return (int)syscall(__NR_io_uring_setup, entries, p);
+}
+
+static int nsql_uring_enter(int fd, unsigned to_submit, unsigned min_complete,
+                            unsigned flags) {
+  return (int)syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags,
+                      NULL, 0);
+}
+
+static bool nsql_uring_probe(void) {
+  struct io_uring_params p;
+  unsigned required;
+  int fd;
+
+  /* A single mapping for both queues and plain read and write requests both
+     arrived in Linux 5.6, along with the last of these features */
+
+  required =
+      IORING_FEAT_SINGLE_MMAP | IORING_FEAT_NODROP | IORING_FEAT_RW_CUR_POS;
+
+  memset(&p, 0, sizeof(p));
+  fd = nsql_uring_setup(1, &p);
+
+  if (fd < 0) {
+    return false;
+  }
+
+  close(fd);
+
+  return (p.features & required) == required;
+}
+
+static int nsql_uring_file_open(sqlite3_vfs *base, sqlite3_filename name,
+                                sqlite3_file *file, int flags, int *out_flags) {
+  struct nsql_uring_file *self;
+  struct nsql_uring_file *main;
+  sqlite3_file *main_file;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  memset(self, 0, sizeof(*self));
+  self->real = (sqlite3_file *)(self + 1);
+  self->fd = -1;
+  self->ring_fd = -1;
+  self->is_wal = (flags & SQLITE_OPEN_WAL) != 0;
+
+  sqlr = base->xOpen(base, name, self->real, flags, out_flags);
+
+  if (sqlr != SQLITE_OK) {
+    file->pMethods = NULL;
+
+    return sqlr;
+  }
+
+  file->pMethods = &nsql_uring_methods;
+  self->fd = nsql_unixfile_fd(self->real, name);
+  self->failed = self->fd < 0;
+
+  if (self->is_wal) {
+    main_file = sqlite3_database_file_object(name);
+
+    if (main_file != NULL && main_file->pMethods == &nsql_uring_methods) {
+      main = (struct nsql_uring_file *)main_file;
+      main->wal = self;
+      self->main = main;
+    }
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_uring_close(sqlite3_file *file) {
+  struct nsql_uring_file *self;
+  int sqlr;
+  int close_sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_flush(self, 0);
+  (void)nsql_uring_forget(self);
+
+  /* Nothing may be unmapped or freed while the kernel can still use it */
+
+  while (self->ring_fd >= 0 && self->inflight > 0) {
+    if (nsql_uring_wait(self) != SQLITE_OK) {
+      break;
+    }
+  }
+
+  nsql_uring_teardown(self);
+
+  if (self->main != NULL) {
+    self->main->wal = NULL;
+  }
+
+  if (self->wal != NULL) {
+    self->wal->main = NULL;
+  }
+
+  close_sqlr = self->real->pMethods->xClose(self->real);
+
+  return sqlr != SQLITE_OK ? sqlr : close_sqlr;
+}
+
+static int nsql_uring_read(sqlite3_file *file, void *buf, int amt,
+                           sqlite3_int64 off) {
+  struct nsql_uring_file *self;
+  bool hit;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_flush(self, 0);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  /* WAL frames are read in no particular order */
+
+  if (self->is_wal || self->failed) {
+    goto pass;
+  }
+
+  self->streak = off == self->next_off ? self->streak + 1 : 0;
+  self->next_off = off + amt;
+
+  if (self->streak >= NSQL_URING_STREAK && nsql_uring_ready(self)) {
+    sqlr = nsql_uring_read_ahead(self, off);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+  }
+
+  hit = false;
+  sqlr = nsql_uring_read_slot(self, buf, amt, off, &hit);
+
+  if (sqlr != SQLITE_OK || hit) {
+    return sqlr;
+  }
+
+pass:
+  return self->real->pMethods->xRead(self->real, buf, amt, off);
+}
+
+static int nsql_uring_write(sqlite3_file *file, const void *buf, int amt,
+                            sqlite3_int64 off) {
+  struct nsql_uring_file *self;
+  struct nsql_uring_write *write;
+  struct io_uring_sqe *sqe;
+  sqlite3_int64 end;
+  uint8_t *bytes;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+
+  if (!nsql_uring_ready(self)) {
+    return self->real->pMethods->xWrite(self->real, buf, amt, off);
+  }
+
+  sqlr = nsql_uring_forget(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  /* Requests in a submission may complete in any order, so a write that
+     overlaps a pending one must wait for it */
+
+  end = off + amt;
+
+  if (nsql_uring_overlaps(self, off, end) ||
+      self->stage_used + amt > NSQL_URING_STAGE_NBYTES ||
+      self->nwrites == NSQL_URING_MAX_WRITES) {
+    sqlr = nsql_uring_flush(self, 0);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+  }
+
+  if (amt > NSQL_URING_STAGE_NBYTES) {
+    return self->real->pMethods->xWrite(self->real, buf, amt, off);
+  }
+
+  bytes = self->stage + self->stage_used;
+  memcpy(bytes, buf, amt);
+  self->stage_used += amt;
+
+  /* A write that continues the previous one, such as a WAL frame following its
+     header, extends the same request if it has not been submitted yet */
+
+  write = self->nwrites > 0 ? &self->writes[self->nwrites - 1] : NULL;
+
+  if (self->last != NULL && write->off + (sqlite3_int64)write->nbytes == off &&
+      write->bytes + write->nbytes == bytes) {
+    write->nbytes += amt;
+    self->last->len += amt;
+  } else {
+    sqlr = nsql_uring_sqe(self, &sqe);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+
+    write = &self->writes[self->nwrites];
+    write->off = off;
+    write->bytes = bytes;
+    write->nbytes = amt;
+
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = self->fd;
+    sqe->addr = (uintptr_t)bytes;
+    sqe->len = amt;
+    sqe->off = off;
+    sqe->user_data = (uint64_t)NSQL_URING_TAG_WRITE << 32 | self->nwrites;
+
+    self->nwrites++;
+    self->writing++;
+    self->last = sqe;
+  }
+
+  if (self->nwrites == 1 && write->nbytes == (size_t)amt) {
+    self->lo = off;
+    self->hi = end;
+  } else {
+    self->lo = off < self->lo ? off : self->lo;
+    self->hi = end > self->hi ? end : self->hi;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_uring_truncate(sqlite3_file *file, sqlite3_int64 size) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_settle(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return self->real->pMethods->xTruncate(self->real, size);
+}
+
+static int nsql_uring_sync(sqlite3_file *file, int flags) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+
+  if (self->ring_fd < 0 || (self->is_wal && !self->synced)) {
+    sqlr = nsql_uring_flush(self, 0);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+
+    sqlr = self->real->pMethods->xSync(self->real, flags);
+    self->synced = sqlr == SQLITE_OK;
+
+    return sqlr;
+  }
+
+  return nsql_uring_flush(self, flags);
+}
+
+static int nsql_uring_file_size(sqlite3_file *file, sqlite3_int64 *out) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_flush(self, 0);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return self->real->pMethods->xFileSize(self->real, out);
+}
+
+static int nsql_uring_lock(sqlite3_file *file, int lock) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_settle(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return self->real->pMethods->xLock(self->real, lock);
+}
+
+static int nsql_uring_unlock(sqlite3_file *file, int lock) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_settle(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return self->real->pMethods->xUnlock(self->real, lock);
+}
+
+static int nsql_uring_check_reserved_lock(sqlite3_file *file, int *out) {
+  struct nsql_uring_file *self;
+
+  self = (struct nsql_uring_file *)file;
+
+  return self->real->pMethods->xCheckReservedLock(self->real, out);
+}
+
+static int nsql_uring_file_control(sqlite3_file *file, int op, void *arg) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_settle(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return self->real->pMethods->xFileControl(self->real, op, arg);
+}
+
+static int nsql_uring_sector_size(sqlite3_file *file) {
+  struct nsql_uring_file *self;
+
+  self = (struct nsql_uring_file *)file;
+
+  return self->real->pMethods->xSectorSize(self->real);
+}
+
+static int nsql_uring_device_characteristics(sqlite3_file *file) {
+  struct nsql_uring_file *self;
+
+  self = (struct nsql_uring_file *)file;
+
+  return self->real->pMethods->xDeviceCharacteristics(self->real);
+}
+
+static int nsql_uring_shm_map(sqlite3_file *file, int region, int nbytes,
+                              int extend, void volatile **out) {
+  struct nsql_uring_file *self;
+
+  self = (struct nsql_uring_file *)file;
+
+  return self->real->pMethods->xShmMap(self->real, region, nbytes, extend,
+                                       out);
+}
+
+static int nsql_uring_shm_lock(sqlite3_file *file, int offset, int n,
+                               int flags) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_settle(self);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return self->real->pMethods->xShmLock(self->real, offset, n, flags);
+}
+
+static void nsql_uring_shm_barrier(sqlite3_file *file) {
+  struct nsql_uring_file *self;
+
+  /* A barrier precedes publishing new frames in the WAL index, so the frames
+     themselves must have been written by then. There is no way to report an
+     error from here, but any error is reported again by the next flush. */
+
+  self = (struct nsql_uring_file *)file;
+  (void)nsql_uring_settle(self);
+  self->real->pMethods->xShmBarrier(self->real);
+}
+
+static int nsql_uring_shm_unmap(sqlite3_file *file, int delete_flag) {
+  struct nsql_uring_file *self;
+
+  self = (struct nsql_uring_file *)file;
+
+  return self->real->pMethods->xShmUnmap(self->real, delete_flag);
+}
+
+static int nsql_uring_fetch(sqlite3_file *file, sqlite3_int64 off, int amt,
+                            void **out) {
+  struct nsql_uring_file *self;
+  int sqlr;
+
+  self = (struct nsql_uring_file *)file;
+  sqlr = nsql_uring_flush(self, 0);
+
+  if (sqlr != SQLITE_OK) {
+    *out = NULL;
+
+    return sqlr;
+  }
+
+  return self->real->pMethods->xFetch(self->real, off, amt, out);
+}
+
+static int nsql_uring_unfetch(sqlite3_file *file, sqlite3_int64 off,
+                              void *ptr) {
+  struct nsql_uring_file *self;
+
+  self = (struct nsql_uring_file *)file;
+
+  return self->real->pMethods->xUnfetch(self->real, off, ptr);
+}
+
+static bool nsql_uring_ready(struct nsql_uring_file *self) {
+  struct io_uring_params p;
+  size_t cq_nbytes;
+  uint8_t *ring;
+
+  if (self->ring_fd >= 0) {
+    return true;
+  }
+
+  if (self->failed) {
+    return false;
+  }
+
+  /* Anything that goes wrong here leaves the file to the default VFS */
+
+  self->failed = true;
+  memset(&p, 0, sizeof(p));
+  self->ring_fd = nsql_uring_setup(NSQL_URING_ENTRIES, &p);
+
+  if (self->ring_fd < 0) {
+    self->ring_fd = -1;
+
+    return false;
+  }
+
+  self->ring_nbytes = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+  cq_nbytes = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+
+  if (cq_nbytes > self->ring_nbytes) {
+    self->ring_nbytes = cq_nbytes;
+  }
+
+  self->ring = mmap(NULL, self->ring_nbytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, self->ring_fd,
+                    IORING_OFF_SQ_RING);
+
+  if (self->ring == MAP_FAILED) {
+    self->ring = NULL;
+    nsql_uring_teardown(self);
+
+    return false;
+  }
+
+  self->sqes_nbytes = p.sq_entries * sizeof(struct io_uring_sqe);
+  self->sqes = mmap(NULL, self->sqes_nbytes, PROT_READ | PROT_WRITE,
+                    MAP_SHARED | MAP_POPULATE, self->ring_fd, IORING_OFF_SQES);
+
+  if (self->sqes == MAP_FAILED) {
+    self->sqes = NULL;
+    nsql_uring_teardown(self);
+
+    return false;
+  }
+
+  self->stage = malloc(NSQL_URING_STAGE_NBYTES);
+  self->writes = malloc(NSQL_URING_MAX_WRITES * sizeof(*self->writes));
+
+  if (self->stage == NULL || self->writes == NULL) {
+    nsql_uring_teardown(self);
+
+    return false;
+  }
+
+  ring = self->ring;
+  self->sq_head = (unsigned *)(ring + p.sq_off.head);
+  self->sq_tail = (unsigned *)(ring + p.sq_off.tail);
+  self->sq_mask = (unsigned *)(ring + p.sq_off.ring_mask);
+  self->sq_array = (unsigned *)(ring + p.sq_off.array);
+  self->cq_head = (unsigned *)(ring + p.cq_off.head);
+  self->cq_tail = (unsigned *)(ring + p.cq_off.tail);
+  self->cq_mask = (unsigned *)(ring + p.cq_off.ring_mask);
+  self->cqes = (struct io_uring_cqe *)(ring + p.cq_off.cqes);
+  self->entries = p.sq_entries;
+  self->tail = *self->sq_tail;
+  self->failed = false;
+
+  return true;
+}
+
+static void nsql_uring_teardown(struct nsql_uring_file *self) {
+  size_t i;
+
+  if (self->sqes != NULL) {
+    munmap(self->sqes, self->sqes_nbytes);
+    self->sqes = NULL;
+  }
+
+  if (self->ring != NULL) {
+    munmap(self->ring, self->ring_nbytes);
+    self->ring = NULL;
+  }
+
+  if (self->ring_fd >= 0) {
+    close(self->ring_fd);
+    self->ring_fd = -1;
+  }
+
+  free(self->stage);
+  self->stage = NULL;
+  free(self->writes);
+  self->writes = NULL;
+
+  for (i = 0; i < countof(self->slots); i++) {
+    free(self->slots[i].buf);
+    self->slots[i].buf = NULL;
+  }
+}
+
+static int nsql_uring_sqe(struct nsql_uring_file *self,
+                          struct io_uring_sqe **out) {
+  struct io_uring_sqe *sqe;
+  unsigned idx;
+  int sqlr;
+
+  /* Never have more requests outstanding than the submission queue can hold,
+     which keeps well clear of the completion queue's capacity */
+
+  while (self->queued + self->inflight >= self->entries) {
+    sqlr = self->queued > 0 ? nsql_uring_submit(self) : nsql_uring_wait(self);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+  }
+
+  idx = self->tail & *self->sq_mask;
+  sqe = &self->sqes[idx];
+  memset(sqe, 0, sizeof(*sqe));
+  self->sq_array[idx] = idx;
+  self->tail++;
+  self->queued++;
+  *out = sqe;
+
+  return SQLITE_OK;
+}
+
+static int nsql_uring_submit(struct nsql_uring_file *self) {
+  int n;
+
+  __atomic_store_n(self->sq_tail, self->tail, __ATOMIC_RELEASE);
+  self->last = NULL;
+
+  while (self->queued > 0) {
+    n = nsql_uring_enter(self->ring_fd, self->queued, 0, 0);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n <= 0) {
+      return SQLITE_IOERR;
+    }
+
+    self->queued -= n;
+    self->inflight += n;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_uring_wait(struct nsql_uring_file *self) {
+  struct io_uring_cqe *cqe;
+  unsigned head;
+  unsigned tail;
+  int sqlr;
+  int n;
+
+  if (self->queued > 0) {
+    sqlr = nsql_uring_submit(self);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+  }
+
+  head = *self->cq_head;
+  tail = __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE);
+
+  while (head == tail) {
+    n = nsql_uring_enter(self->ring_fd, 0, 1, IORING_ENTER_GETEVENTS);
+
+    if (n < 0 && errno != EINTR) {
+      return SQLITE_IOERR;
+    }
+
+    tail = __atomic_load_n(self->cq_tail, __ATOMIC_ACQUIRE);
+  }
+
+  while (head != tail) {
+    cqe = &self->cqes[head & *self->cq_mask];
+    nsql_uring_complete(self, cqe->user_data, cqe->res);
+    head++;
+  }
+
+  __atomic_store_n(self->cq_head, head, __ATOMIC_RELEASE);
+
+  return SQLITE_OK;
+}
+
+static void nsql_uring_complete(struct nsql_uring_file *self, uint64_t data,
+                                int res) {
+  const struct nsql_uring_write *write;
+  struct nsql_uring_slot *slot;
+  unsigned idx;
+  int sqlr;
+
+  idx = (unsigned)data;
+  sqlr = SQLITE_OK;
+  self->inflight--;
+
+  switch (data >> 32) {
+  case NSQL_URING_TAG_WRITE:
+    self->writing--;
+    write = &self->writes[idx];
+
+    /* Short writes are unusual for regular files, but permitted */
+
+    if (res == -ENOSPC || res == -EDQUOT) {
+      sqlr = SQLITE_FULL;
+    } else if (res < 0) {
+      sqlr = SQLITE_IOERR_WRITE;
+    } else if ((size_t)res < write->nbytes) {
+      sqlr = nsql_uring_pwrite(self->fd, write->bytes + res,
+                               write->nbytes - res, write->off + res);
+    }
+
+    break;
+
+  case NSQL_URING_TAG_FSYNC:
+    self->writing--;
+
+    if (res < 0) {
+      sqlr = SQLITE_IOERR_FSYNC;
+    }
+
+    break;
+
+  case NSQL_URING_TAG_READ:
+    slot = &self->slots[idx];
+    slot->state = NSQL_URING_SLOT_DONE;
+    slot->nbytes = res > 0 ? (size_t)res : 0;
+
+    break;
+  }
+
+  if (self->error == SQLITE_OK) {
+    self->error = sqlr;
+  }
+}
+
+static int nsql_uring_flush(struct nsql_uring_file *self, int sync_flags) {
+  struct io_uring_sqe *sqe;
+  int sqlr;
+
+  if (self->ring_fd < 0 || (self->nwrites == 0 && sync_flags == 0)) {
+    return SQLITE_OK;
+  }
+
+  /* The sync is drained behind every write before it, so that a commit costs
+     a single submission */
+
+  if (sync_flags != 0) {
+    sqlr = nsql_uring_sqe(self, &sqe);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = self->fd;
+    sqe->flags = IOSQE_IO_DRAIN;
+    sqe->fsync_flags =
+        (sync_flags & SQLITE_SYNC_DATAONLY) != 0 ? IORING_FSYNC_DATASYNC : 0;
+    sqe->user_data = (uint64_t)NSQL_URING_TAG_FSYNC << 32;
+    self->writing++;
+  }
+
+  sqlr = nsql_uring_submit(self);
+
+  while (sqlr == SQLITE_OK && self->writing > 0) {
+    sqlr = nsql_uring_wait(self);
+  }
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  sqlr = self->error;
+  self->error = SQLITE_OK;
+  self->stage_used = 0;
+  self->nwrites = 0;
+
+  return sqlr;
+}
+
+static int nsql_uring_forget(struct nsql_uring_file *self) {
+  struct nsql_uring_slot *slot;
+  size_t i;
+  int sqlr;
+
+  self->streak = 0;
+
+  for (i = 0; i < countof(self->slots); i++) {
+    slot = &self->slots[i];
+
+    while (slot->state == NSQL_URING_SLOT_BUSY) {
+      sqlr = nsql_uring_wait(self);
+
+      if (sqlr != SQLITE_OK) {
+        return sqlr;
+      }
+    }
+
+    slot->state = NSQL_URING_SLOT_IDLE;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_uring_settle(struct nsql_uring_file *self) {
+  int sqlr;
+
+  /* Called whenever locks or shared memory change hands, at which point other
+     connections must be able to see every write made so far, and data read
+     ahead may no longer be current */
+
+  if (self->wal != NULL) {
+    sqlr = nsql_uring_flush(self->wal, 0);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+  }
+
+  sqlr = nsql_uring_flush(self, 0);
+
+  if (sqlr != SQLITE_OK) {
+    return sqlr;
+  }
+
+  return nsql_uring_forget(self);
+}
+
+static bool nsql_uring_overlaps(const struct nsql_uring_file *self,
+                                sqlite3_int64 off, sqlite3_int64 end) {
+  const struct nsql_uring_write *write;
+  unsigned i;
+
+  /* Writes usually proceed in ascending order, so this is usually decided
+     without looking at individual writes */
+
+  if (self->nwrites == 0 || end <= self->lo || off >= self->hi) {
+    return false;
+  }
+
+  for (i = 0; i < self->nwrites; i++) {
+    write = &self->writes[i];
+
+    if (off < write->off + (sqlite3_int64)write->nbytes && end > write->off) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static int nsql_uring_read_ahead(struct nsql_uring_file *self,
+                                 sqlite3_int64 off) {
+  struct nsql_uring_slot *slot;
+  struct io_uring_sqe *sqe;
+  sqlite3_int64 want;
+  size_t i;
+  size_t j;
+  int sqlr;
+
+  /* Keep both windows filled, starting from the window that covers `off` */
+
+  want = off;
+
+  for (i = 0; i < countof(self->slots); i++) {
+    slot = NULL;
+
+    for (j = 0; j < countof(self->slots); j++) {
+      if (self->slots[j].state != NSQL_URING_SLOT_IDLE &&
+          self->slots[j].off <= want &&
+          want < self->slots[j].off + NSQL_URING_WINDOW_NBYTES) {
+        slot = &self->slots[j];
+      }
+    }
+
+    if (slot != NULL) {
+      if (slot->state == NSQL_URING_SLOT_DONE &&
+          slot->nbytes < NSQL_URING_WINDOW_NBYTES) {
+        break; /* End of file */
+      }
+
+      want = slot->off + NSQL_URING_WINDOW_NBYTES;
+
+      continue;
+    }
+
+    for (j = 0; j < countof(self->slots); j++) {
+      if (self->slots[j].state == NSQL_URING_SLOT_IDLE ||
+          (self->slots[j].state == NSQL_URING_SLOT_DONE &&
+           self->slots[j].off + NSQL_URING_WINDOW_NBYTES <= off)) {
+        slot = &self->slots[j];
+      }
+    }
+
+    if (slot == NULL) {
+      break;
+    }
+
+    if (slot->buf == NULL) {
+      slot->buf = malloc(NSQL_URING_WINDOW_NBYTES);
+
+      if (slot->buf == NULL) {
+        break;
+      }
+    }
+
+    sqlr = nsql_uring_sqe(self, &sqe);
+
+    if (sqlr != SQLITE_OK) {
+      return sqlr;
+    }
+
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = self->fd;
+    sqe->addr = (uintptr_t)slot->buf;
+    sqe->len = NSQL_URING_WINDOW_NBYTES;
+    sqe->off = want;
+    sqe->user_data = (uint64_t)NSQL_URING_TAG_READ << 32 | (slot - self->slots);
+
+    slot->state = NSQL_URING_SLOT_BUSY;
+    slot->off = want;
+    slot->nbytes = 0;
+    want += NSQL_URING_WINDOW_NBYTES;
+  }
+
+  return self->queued > 0 ? nsql_uring_submit(self) : SQLITE_OK;
+}
+
+static int nsql_uring_read_slot(struct nsql_uring_file *self, void *buf,
+                                int amt, sqlite3_int64 off, bool *hit) {
+  struct nsql_uring_slot *slot;
+  size_t i;
+  int sqlr;
+
+  for (i = 0; i < countof(self->slots); i++) {
+    slot = &self->slots[i];
+
+    if (slot->state == NSQL_URING_SLOT_IDLE || off < slot->off ||
+        off + amt > slot->off + NSQL_URING_WINDOW_NBYTES) {
+      continue;
+    }
+
+    while (slot->state == NSQL_URING_SLOT_BUSY) {
+      sqlr = nsql_uring_wait(self);
+
+      if (sqlr != SQLITE_OK) {
+        return sqlr;
+      }
+    }
+
+    /* A window cut short by the end of the file is left to the default VFS,
+       which knows how to report a short read */
+
+    if (off + amt <= slot->off + (sqlite3_int64)slot->nbytes) {
+      memcpy(buf, slot->buf + (off - slot->off), amt);
+      *hit = true;
+    }
+
+    break;
+  }
+
+  return SQLITE_OK;
+}
+
+static int nsql_uring_pwrite(int fd, const uint8_t *bytes, size_t nbytes,
+                             sqlite3_int64 off) {
+  ssize_t n;
+
+  while (nbytes > 0) {
+    n = pwrite(fd, bytes, nbytes, off);
+
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+
+    if (n < 0 && (errno == ENOSPC || errno == EDQUOT)) {
+      return SQLITE_FULL;
+    }
+
+    if (n <= 0) {
+      return SQLITE_IOERR_WRITE;
+    }
+
+    bytes += n;
+    nbytes -= n;
+    off += n;
+  }
+
+  return SQLITE_OK;
+}
+#endif
@@ -0,0 +1,21 @@
+#pragma once
+
+/*
+ * Name under which the io_uring VFS is registered
+ */
+#define NSQL_URING_VFS "nsql-uring"
+
+/*
+ * Register a VFS that layers io_uring on top of the default VFS, unless it has
+ * already been registered. It is not made the default. Main database and WAL
+ * files opened through it queue their writes and submit them in batches, with
+ * the `fsync()` that ends a commit or checkpoint issued in the same
+ * submission, and read ahead during sequential scans. Locking, shared memory
+ * and every other file type are left to the default VFS.
+ *
+ * If io_uring is unavailable, because the kernel predates it, the process is
+ * not allowed to use it or this is not Linux, the VFS is still registered but
+ * simply passes everything through to the default VFS. Returns an SQLite
+ * result code.
+ */
+int nsql_uring_register(void);
@@ -0,0 +1,368 @@
+import Database from ".";
+
+// Just enough of an Arrow IPC stream reader to check the output of
+// Statement.arrow(): flat schemas of Null, Int, FloatingPoint, Binary and Utf8
+// fields, optionally dictionary-encoded.
+
+type Value = null | bigint | number | string | number[];
+
+interface Field {
+  name: string;
+  type: number;
+  dictionary?: number;
+}
+
+interface Batch {
+  length: number;
+  nulls: number[];
+  columns: Value[][];
+}
+
+interface Stream {
+  fields: Field[];
+  batches: Batch[];
+}
+
+const utf8 = new TextDecoder();
+
+function readStream(buffer: ArrayBuffer): Stream {
+  const view = new DataView(buffer);
+  const dictionaries = new Map<number, Value[]>();
+  const batches: Batch[] = [];
+  let fields: Field[] = [];
+  let pos = 0;
+
+  function table(pos: number) {
+    const vt = pos - view.getInt32(pos, true);
+    const vtLength = view.getUint16(vt, true);
+
+    return function(i: number) {
+      const offset =
+        4 + i * 2 < vtLength ? view.getUint16(vt + 4 + i * 2, true) : 0;
+
+      return offset !== 0 ? pos + offset : 0;
+    };
+  }
+
+  function deref(pos: number) {
+    return pos + view.getUint32(pos, true);
+  }
+
+  function string(pos: number) {
+    const nbytes = view.getUint32(pos, true);
+
+    return utf8.decode(new Uint8Array(buffer, pos + 4, nbytes));
+  }
+
+  function vector(pos: number) {
+    return { length: view.getUint32(pos, true), start: pos + 4 };
+  }
+
+  function readBatch(meta: number, body: number, fields: Field[]) {
+    const batch = table(meta);
+    const length = Number(view.getBigInt64(batch(0), true));
+    const nodes = vector(deref(batch(1)));
+    const buffers = vector(deref(batch(2)));
+    const result: Batch = { length, nulls: [], columns: [] };
+    let node = 0;
+    let buf = 0;
+
+    function next() {
+      const pos = buffers.start + 16 * buf++;
+      const offset = Number(view.getBigInt64(pos, true));
+      const nbytes = Number(view.getBigInt64(pos + 8, true));
+
+      expect(offset % 8).toBe(0);
+
+      return { start: body + offset, nbytes };
+    }
+
+    for (const field of fields) {
+      const pos = nodes.start + 16 * node;
+      const n = Number(view.getBigInt64(pos, true));
+      const nulls = Number(view.getBigInt64(pos + 8, true));
+      const values: Value[] = [];
+
+      node++;
+      expect(n).toBe(length);
+      result.nulls.push(nulls);
+
+      if (field.type === 1) {
+        result.columns.push(new Array(n).fill(null));
+
+        continue;
+      }
+
+      const validity = next();
+      const valid = (i: number) =>
+        validity.nbytes === 0 ||
+        (view.getUint8(validity.start + (i >> 3)) & (1 << (i & 7))) !== 0;
+
+      if (field.dictionary !== undefined) {
+        const indices = next();
+        const dict = dictionaries.get(field.dictionary)!;
+
+        for (let i = 0; i < n; i++) {
+          const index = view.getInt32(indices.start + i * 4, true);
+
+          values.push(valid(i) ? dict[index] : null);
+        }
+      } else if (field.type === 2 || field.type === 3) {
+        const data = next();
+
+        expect(data.nbytes).toBe(n * 8);
+
+        for (let i = 0; i < n; i++) {
+          const pos = data.start + i * 8;
+
+          values.push(
+            !valid(i)
+              ? null
+              : field.type === 2
+              ? view.getBigInt64(pos, true)
+              : view.getFloat64(pos, true)
+          );
+        }
+      } else {
+        const offsets = next();
+        const data = next();
+
+        expect(view.getInt32(offsets.start, true)).toBe(0);
+
+        for (let i = 0; i < n; i++) {
+          const start = view.getInt32(offsets.start + i * 4, true);
+          const end = view.getInt32(offsets.start + i * 4 + 4, true);
+          const bytes = new Uint8Array(
+            buffer,
+            data.start + start,
+            end - start
+          );
+
+          expect(end).toBeLessThanOrEqual(data.nbytes);
+          values.push(
+            !valid(i)
+              ? null
+              : field.type === 5
+              ? utf8.decode(bytes)
+              : [...bytes]
+          );
+        }
+      }
+
+      result.columns.push(values);
+    }
+
+    expect(buf).toBe(buffers.length);
+
+    return result;
+  }
+
+  for (;;) {
+    expect(pos % 8).toBe(0);
+    expect(view.getUint32(pos, true)).toBe(0xffffffff);
+
+    const metaLength = view.getInt32(pos + 4, true);
+
+    if (metaLength === 0) {
+      expect(pos + 8).toBe(buffer.byteLength);
+
+      break;
+    }
+
+    const meta = pos + 8;
+    const message = table(deref(meta));
+    const headerType = view.getUint8(message(1));
+    const header = deref(message(2));
+    const bodyLength = Number(view.getBigInt64(message(3), true));
+    const body = meta + metaLength;
+
+    expect(view.getUint16(message(0), true)).toBe(4);
+
+    if (headerType === 1) {
+      const list = vector(deref(table(header)(1)));
+
+      fields = [];
+
+      for (let i = 0; i < list.length; i++) {
+        const field = table(deref(list.start + i * 4));
+        const encoding = field(4);
+
+        fields.push({
+          name: string(deref(field(0))),
+          type: view.getUint8(field(2)),
+          dictionary:
+            encoding !== 0
+              ? Number(view.getBigInt64(table(deref(encoding))(0), true))
+              : undefined
+        });
+      }
+    } else if (headerType === 2) {
+      const dict = table(header);
+      const id = Number(view.getBigInt64(dict(0), true));
+      const data = readBatch(deref(dict(1)), body, [{ name: "", type: 5 }]);
+
+      dictionaries.set(id, data.columns[0]);
+    } else {
+      expect(headerType).toBe(3);
+      batches.push(readBatch(header, body, fields));
+    }
+
+    pos = body + bodyLength;
+  }
+
+  return { fields, batches };
+}
+
+function rows(stream: Stream) {
+  const result = [];
+
+  for (const batch of stream.batches) {
+    for (let i = 0; i < batch.length; i++) {
+      const row: Record<string, Value> = {};
+
+      stream.fields.forEach(function(field, j) {
+        row[field.name] = batch.columns[j][i];
+      });
+
+      result.push(row);
+    }
+  }
+
+  return result;
+}
+
+describe("arrow", function() {
+  test("returns an ArrayBuffer", function() {
+    const db = new Database(":memory:");
+    const buf = db.prepare("select 1 as x").arrow();
+
+    expect(buf).toBeInstanceOf(ArrayBuffer);
+  });
+
+  test("round-trip all types", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "select null as a, 1234.5 as b, 'héllo 🌍' as c, " +
+        "-9223372036854775808 as d, x'01020304' as e, '' as f, x'' as g"
+    );
+    const stream = readStream(stmt.arrow());
+
+    expect(stream.fields.map(f => [f.name, f.type])).toEqual([
+      ["a", 1],
+      ["b", 3],
+      ["c", 5],
+      ["d", 2],
+      ["e", 4],
+      ["f", 5],
+      ["g", 4]
+    ]);
+    expect(rows(stream)).toEqual([
+      {
+        a: null,
+        b: 1234.5,
+        c: "héllo 🌍",
+        d: -9223372036854775808n,
+        e: [1, 2, 3, 4],
+        f: "",
+        g: []
+      }
+    ]);
+  });
+
+  test("nulls and batches", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table t (id integer primary key, name text, score real);
+      insert into t (name, score)
+      with recursive c(x) as (select 1 union all select x + 1 from c
+        where x < 10)
+      select case when x % 4 = 0 then null else 'name ' || x end,
+        case when x % 3 = 0 then null else x * 1.5 end from c;
+    `);
+
+    const stmt = db.prepare("select id, name, score from t order by id");
+    const stream = readStream(stmt.arrow(undefined, { batchSize: 3 }));
+    const expected = stmt.all().map(function(row) {
+      return { ...row, id: BigInt(row.id as number) };
+    });
+
+    expect(stream.batches.map(b => b.length)).toEqual([3, 3, 3, 1]);
+    expect(stream.batches.map(b => b.nulls)).toEqual([
+      [0, 0, 1],
+      [0, 1, 1],
+      [0, 1, 1],
+      [0, 0, 0]
+    ]);
+    expect(rows(stream)).toEqual(expected);
+  });
+
+  test("leading nulls", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "select null as a, null as b union all select 1, 'x' union all " +
+        "select null, null"
+    );
+    const stream = readStream(stmt.arrow());
+
+    expect(stream.fields.map(f => f.type)).toEqual([2, 5]);
+    expect(rows(stream)).toEqual([
+      { a: null, b: null },
+      { a: 1n, b: "x" },
+      { a: null, b: null }
+    ]);
+  });
+
+  test("integer columns widen to float", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "select 1 as x union all select 2.5 union all select 3"
+    );
+    const stream = readStream(stmt.arrow());
+
+    expect(stream.fields[0].type).toBe(3);
+    expect(rows(stream)).toEqual([{ x: 1 }, { x: 2.5 }, { x: 3 }]);
+  });
+
+  test("dictionary encoding", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table t (color text, label text);
+      insert into t
+      with recursive c(x) as (select 1 union all select x + 1 from c
+        where x < 100)
+      select case x % 3 when 0 then 'red' when 1 then 'green' else null end,
+        'label ' || x from c;
+    `);
+
+    const stmt = db.prepare("select color, label from t order by rowid");
+    const stream = readStream(stmt.arrow(undefined, { batchSize: 40 }));
+
+    expect(stream.fields[0].dictionary).toBe(0);
+    expect(stream.fields[1].dictionary).toBe(undefined);
+    expect(rows(stream)).toEqual(stmt.all());
+  });
+
+  test("empty result", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1 as x where 0");
+    const stream = readStream(stmt.arrow());
+
+    expect(stream.fields.map(f => [f.name, f.type])).toEqual([["x", 1]]);
+    expect(stream.batches).toEqual([]);
+  });
+
+  test("validates batchSize", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    expect(() => stmt.arrow(undefined, { batchSize: 0 })).toThrow(RangeError);
+    expect(() => stmt.arrow(undefined, { batchSize: 1.5 })).toThrow(
+      RangeError
+    );
+    expect(() => stmt.arrow(undefined, { batchSize: "1" as any })).toThrow(
+      TypeError
+    );
+  });
+});
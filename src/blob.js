@@ -0,0 +1,62 @@
+const { Readable, Writable } = require("stream");
+
+// Stream adapters for Blob handles. Each call to read() or write() on the
+// stream maps onto a single positional read or write on the underlying handle,
+// so memory usage is bounded by the stream's high water mark.
+
+function createReadStream(options = {}) {
+  const blob = this;
+  const { start = 0, end = blob.size, highWaterMark = 65536 } = options;
+  let pos = start;
+
+  return new Readable({
+    highWaterMark,
+    read(size) {
+      const n = Math.min(size, end - pos);
+
+      if (n <= 0) {
+        this.push(null);
+
+        return;
+      }
+
+      const buf = Buffer.allocUnsafe(n);
+      let nread;
+
+      try {
+        nread = blob.read(buf, pos);
+      } catch (e) {
+        this.destroy(e);
+
+        return;
+      }
+
+      pos += nread;
+      this.push(nread > 0 ? buf.subarray(0, nread) : null);
+    }
+  });
+}
+
+function createWriteStream(options = {}) {
+  const blob = this;
+  const { start = 0, highWaterMark = 65536 } = options;
+  let pos = start;
+
+  return new Writable({
+    highWaterMark,
+    write(chunk, encoding, callback) {
+      try {
+        blob.write(chunk, pos);
+      } catch (e) {
+        callback(e);
+
+        return;
+      }
+
+      pos += chunk.length;
+      callback();
+    }
+  });
+}
+
+module.exports = { createReadStream, createWriteStream };
@@ -0,0 +1,250 @@
+import Database from ".";
+
+function fixture() {
+  const db = new Database(":memory:");
+
+  db.exec(`
+    create table files (id integer primary key, data blob);
+    insert into files (id, data) values (1, x'0102030405060708');
+    insert into files (id, data) values (2, x'1112');
+    insert into files (id, data) values (3, zeroblob(100000));
+  `);
+
+  return db;
+}
+
+describe("openBlob", function() {
+  test("size", function() {
+    const db = fixture();
+
+    expect(db.openBlob("files", "data", 1n).size).toBe(8);
+    expect(db.openBlob("files", "data", 3).size).toBe(100000);
+  });
+
+  test("missing row", function() {
+    const db = fixture();
+
+    expect(() => db.openBlob("files", "data", 99n)).toThrow(
+      expect.objectContaining({ code: "SQLITE_ERROR" })
+    );
+  });
+
+  test("validate arguments", function() {
+    const db = fixture();
+
+    expect(() => db.openBlob(1 as any, "data", 1n)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => db.openBlob("files", null as any, 1n)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => db.openBlob("files", "data", "1" as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => db.openBlob("files", "data", 1.5)).toThrow(
+      expect.objectContaining({ code: "ERR_VALUE_OUT_OF_RANGE" })
+    );
+    expect(() =>
+      db.openBlob("files", "data", 1n, { write: "yes" } as any)
+    ).toThrow(expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" }));
+  });
+
+  test("open after database close", function() {
+    const db = fixture();
+
+    db.close();
+    expect(() => db.openBlob("files", "data", 1n)).toThrow();
+  });
+});
+
+describe("read", function() {
+  test("positional read", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+    const buf = new Uint8Array(3);
+
+    expect(blob.read(buf, 2)).toBe(3);
+    expect([...buf]).toEqual([3, 4, 5]);
+  });
+
+  test("short read at end of blob", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+    const buf = Buffer.alloc(16);
+
+    expect(blob.read(buf, 6)).toBe(2);
+    expect([...buf.subarray(0, 2)]).toEqual([7, 8]);
+    expect(blob.read(buf, 8)).toBe(0);
+    expect(blob.read(buf, 1000)).toBe(0);
+  });
+
+  test("read into ArrayBuffer", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 2n);
+    const buf = new ArrayBuffer(2);
+
+    expect(blob.read(buf)).toBe(2);
+    expect([...new Uint8Array(buf)]).toEqual([0x11, 0x12]);
+  });
+
+  test("validate arguments", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+
+    expect(() => blob.read([1, 2] as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => blob.read(new Uint8Array(1), -1)).toThrow(
+      expect.objectContaining({ code: "ERR_OUT_OF_RANGE" })
+    );
+  });
+});
+
+describe("write", function() {
+  test("positional write", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n, { write: true });
+
+    blob.write(new Uint8Array([0xaa, 0xbb]), 3);
+    blob.close();
+
+    const row = db.prepare("select hex(data) as hex from files where id = 1");
+
+    expect(row.one()).toEqual({ hex: "010203AABB060708" });
+  });
+
+  test("write past end", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 2n, { write: true });
+
+    expect(() => blob.write(new Uint8Array(3), 0)).toThrow(
+      expect.objectContaining({ code: "ERR_OUT_OF_RANGE" })
+    );
+    expect(() => blob.write(new Uint8Array(1), 3)).toThrow(
+      expect.objectContaining({ code: "ERR_OUT_OF_RANGE" })
+    );
+  });
+
+  test("write to read-only handle", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+
+    expect(() => blob.write(new Uint8Array(1), 0)).toThrow(
+      expect.objectContaining({ code: "SQLITE_READONLY" })
+    );
+  });
+});
+
+describe("reopen", function() {
+  test("walk rows", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+
+    expect(blob.size).toBe(8);
+    blob.reopen(2n);
+    expect(blob.size).toBe(2);
+    blob.reopen(3);
+    expect(blob.size).toBe(100000);
+  });
+
+  test("reopen missing row", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+
+    expect(() => blob.reopen(99n)).toThrow(
+      expect.objectContaining({ code: "SQLITE_ERROR" })
+    );
+  });
+});
+
+describe("close", function() {
+  test("close twice", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+
+    blob.close();
+    blob.close();
+  });
+
+  test("use after close", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+
+    blob.close();
+    expect(() => blob.read(new Uint8Array(1))).toThrow();
+    expect(() => blob.size).toThrow();
+  });
+
+  test("blob outlives database close", function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 2n);
+    const buf = new Uint8Array(2);
+
+    db.close();
+    expect(blob.read(buf)).toBe(2);
+    expect([...buf]).toEqual([0x11, 0x12]);
+  });
+});
+
+describe("streams", function() {
+  test("read stream", async function() {
+    const db = fixture();
+
+    db.exec(`update files set data = randomblob(100000) where id = 3`);
+
+    const blob = db.openBlob("files", "data", 3n);
+    const chunks: Buffer[] = [];
+
+    for await (const chunk of blob.createReadStream({ highWaterMark: 4096 })) {
+      expect(chunk.length).toBeLessThanOrEqual(4096);
+      chunks.push(chunk);
+    }
+
+    const expected = db
+      .prepare("select data from files where id = 3")
+      .one()!.data as ArrayBuffer;
+
+    expect(Buffer.concat(chunks).equals(Buffer.from(expected))).toBe(true);
+  });
+
+  test("read stream range", async function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n);
+    const chunks: Buffer[] = [];
+
+    for await (const chunk of blob.createReadStream({ start: 2, end: 5 })) {
+      chunks.push(chunk);
+    }
+
+    expect([...Buffer.concat(chunks)]).toEqual([3, 4, 5]);
+  });
+
+  test("write stream", async function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 1n, { write: true });
+    const stream = blob.createWriteStream({ start: 4 });
+
+    await new Promise((resolve, reject) => {
+      stream.on("error", reject);
+      stream.write(Buffer.from([9, 9]));
+      stream.end(Buffer.from([9]), resolve);
+    });
+
+    const row = db.prepare("select hex(data) as hex from files where id = 1");
+
+    expect(row.one()).toEqual({ hex: "0102030409090908" });
+  });
+
+  test("write stream overflow", async function() {
+    const db = fixture();
+    const blob = db.openBlob("files", "data", 2n, { write: true });
+    const stream = blob.createWriteStream();
+
+    const err = await new Promise(resolve => {
+      stream.on("error", resolve);
+      stream.end(Buffer.alloc(3));
+    });
+
+    expect(err).toEqual(expect.objectContaining({ code: "ERR_OUT_OF_RANGE" }));
+  });
+});
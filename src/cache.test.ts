@@ -0,0 +1,217 @@
+import Database from ".";
+
+function fixture() {
+  const db = new Database(":memory:");
+
+  db.exec(
+    "create table a (id integer primary key, x text);" +
+      "create table b (id integer primary key, y text);" +
+      "insert into a values (1, 'one'), (2, 'two');" +
+      "insert into b values (1, 'uno');"
+  );
+  db.resultCache();
+
+  return db;
+}
+
+describe("resultCache", function() {
+  it("is disabled by default", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1 as x");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ x: 1n }]);
+    expect(db.resultCacheStats()).toBe(null);
+  });
+
+  it("serves repeated reads from the cache", function() {
+    const db = fixture();
+    const stmt = db.prepare("select x from a where id = ?");
+
+    expect(stmt.all([1], { cache: true })).toEqual([{ x: "one" }]);
+    expect(stmt.all([1], { cache: true })).toEqual([{ x: "one" }]);
+    expect(stmt.all([2], { cache: true })).toEqual([{ x: "two" }]);
+    expect(stmt.all([1])).toEqual([{ x: "one" }]);
+
+    const stats = db.resultCacheStats()!;
+
+    expect(stats.enabled).toBe(true);
+    expect(stats.hits).toBe(1);
+    expect(stats.misses).toBe(2);
+    expect(stats.hitRate).toBeCloseTo(1 / 3);
+    expect(stats.entries).toBe(2);
+    expect(stats.bytes).toBeGreaterThan(0);
+  });
+
+  it("returns packed results", function() {
+    const db = fixture();
+    const stmt = db.prepare("select id, x from a order by id");
+    const first = stmt.allPacked(undefined, { cache: true });
+    const second = stmt.allPacked(undefined, { cache: true });
+
+    expect(second).not.toBe(first);
+    expect(new Uint8Array(second)).toEqual(new Uint8Array(first));
+    expect(db.resultCacheStats()!.hits).toBe(1);
+  });
+
+  it("distinguishes bind parameter types", function() {
+    const db = fixture();
+    const stmt = db.prepare("select typeof(?) as t");
+
+    expect(stmt.all([1], { cache: true })).toEqual([{ t: "real" }]);
+    expect(stmt.all([1n], { cache: true })).toEqual([{ t: "integer" }]);
+    expect(stmt.all(["1"], { cache: true })).toEqual([{ t: "text" }]);
+    expect(db.resultCacheStats()!.hits).toBe(0);
+  });
+
+  it("invalidates results that read a written table", function() {
+    const db = fixture();
+    const sa = db.prepare("select count(*) as n from a");
+    const sb = db.prepare("select count(*) as n from b");
+
+    sa.all(undefined, { cache: true });
+    sb.all(undefined, { cache: true });
+    db.exec("insert into a values (3, 'three')");
+
+    expect(sa.all(undefined, { cache: true })).toEqual([{ n: 3n }]);
+    expect(sb.all(undefined, { cache: true })).toEqual([{ n: 1n }]);
+
+    const stats = db.resultCacheStats()!;
+
+    expect(stats.invalidations).toBe(1);
+    expect(stats.hits).toBe(1);
+  });
+
+  it("sees through views", function() {
+    const db = fixture();
+
+    db.exec("create view v as select * from a");
+
+    const stmt = db.prepare("select count(*) as n from v");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 2n }]);
+    db.exec("delete from a where id = 1");
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 1n }]);
+  });
+
+  it("invalidates everything on unconditional deletes", function() {
+    const db = fixture();
+    const stmt = db.prepare("select count(*) as n from a");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 2n }]);
+    db.exec("delete from a");
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 0n }]);
+  });
+
+  it("invalidates results on BLOB writes", function() {
+    const db = fixture();
+
+    db.exec("create table c (id integer primary key, z blob)");
+    db.exec("insert into c values (1, zeroblob(4))");
+
+    const stmt = db.prepare("select hex(z) as z from c");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ z: "00000000" }]);
+
+    const blob = db.openBlob("c", "z", 1, { write: true });
+
+    blob.write(new Uint8Array([1, 2, 3, 4]), 0);
+    blob.close();
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ z: "01020304" }]);
+    expect(db.resultCacheStats()!.invalidations).toBe(1);
+  });
+
+  it("detects writes from other connections", function() {
+    const dir = require("fs").mkdtempSync(
+      require("path").join(require("os").tmpdir(), "nsql-")
+    );
+    const path = require("path").join(dir, "test.db");
+    const db = new Database(path);
+    const other = new Database(path);
+
+    db.exec("create table a (id integer primary key, x text)");
+    db.resultCache();
+
+    const stmt = db.prepare("select count(*) as n from a");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 0n }]);
+    other.exec("insert into a values (1, 'one')");
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 1n }]);
+
+    db.close();
+    other.close();
+    require("fs").rmSync(dir, { recursive: true });
+  });
+
+  it("detects schema changes", function() {
+    const db = fixture();
+    const stmt = db.prepare("select * from b");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([
+      { id: 1n, y: "uno" }
+    ]);
+    db.exec("drop table b; create table b (id integer primary key, y text)");
+    expect(stmt.all(undefined, { cache: true })).toEqual([]);
+  });
+
+  it("is bypassed inside transactions", function() {
+    const db = fixture();
+    const stmt = db.prepare("select count(*) as n from a");
+
+    db.exec("begin; insert into a values (3, 'three')");
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 3n }]);
+    db.exec("rollback");
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ n: 2n }]);
+    expect(db.resultCacheStats()!.hits).toBe(0);
+  });
+
+  it("does not cache writes", function() {
+    const db = fixture();
+    const stmt = db.prepare("insert into b (y) values ('x') returning id");
+
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ id: 2n }]);
+    expect(stmt.all(undefined, { cache: true })).toEqual([{ id: 3n }]);
+  });
+
+  it("evicts the least recently used results", function() {
+    const db = fixture();
+    const stmt = db.prepare("select ? as x");
+
+    db.resultCache({ maxBytes: 1000 });
+
+    for (let i = 0; i < 20; i++) {
+      stmt.all(["value " + i], { cache: true });
+    }
+
+    const stats = db.resultCacheStats()!;
+
+    expect(stats.evictions).toBeGreaterThan(0);
+    expect(stats.bytes).toBeLessThanOrEqual(1000);
+    expect(stmt.all(["value 19"], { cache: true })).toEqual([
+      { x: "value 19" }
+    ]);
+    expect(db.resultCacheStats()!.hits).toBe(1);
+  });
+
+  it("can be disabled", function() {
+    const db = fixture();
+    const stmt = db.prepare("select 1 as x");
+
+    stmt.all(undefined, { cache: true });
+    db.resultCache({ enabled: false });
+    stmt.all(undefined, { cache: true });
+
+    expect(db.resultCacheStats()).toEqual(
+      expect.objectContaining({ enabled: false, entries: 0, misses: 0 })
+    );
+  });
+
+  it("validates options", function() {
+    const db = fixture();
+
+    expect(() => db.resultCache({ maxBytes: -1 })).toThrow(RangeError);
+    expect(() =>
+      db.prepare("select 1").all(undefined, { cache: 1 as any })
+    ).toThrow(TypeError);
+  });
+});
@@ -0,0 +1,191 @@
+import Database, { ChangeBatch } from ".";
+
+function fixture() {
+  const db = new Database(":memory:");
+  const batches: ChangeBatch[] = [];
+
+  db.exec(
+    "create table a (id integer primary key, x text);" +
+      "create table b (id integer primary key, y text);"
+  );
+  db.onChange(batch => batches.push(batch));
+
+  return { db, batches };
+}
+
+function changes(batch: ChangeBatch) {
+  const result = [];
+
+  for (let i = 0; i < batch.length; i++) {
+    result.push([batch.op[i], batch.tables[batch.table[i]], batch.rowid[i]]);
+  }
+
+  return result;
+}
+
+describe("onChange", function() {
+  it("delivers autocommitted changes", function() {
+    const { db, batches } = fixture();
+
+    db.prepare("insert into a values (1, 'one')").run();
+    db.prepare("update a set x = 'uno' where id = 1").run();
+    db.prepare("delete from a where id = 1").run();
+
+    expect(batches.map(changes)).toEqual([
+      [[0, "a", 1n]],
+      [[1, "a", 1n]],
+      [[2, "a", 1n]]
+    ]);
+    expect(batches[0].truncated).toBe(false);
+  });
+
+  it("batches a transaction", function() {
+    const { db, batches } = fixture();
+    const ins = db.prepare("insert into b values (?, ?)");
+
+    db.exec("begin");
+    ins.run([1, "one"]);
+    ins.run([2, "two"]);
+    db.prepare("insert into a values (3, 'three')").run();
+
+    expect(batches).toEqual([]);
+
+    db.exec("commit");
+
+    expect(batches.map(changes)).toEqual([
+      [
+        [0, "b", 1n],
+        [0, "b", 2n],
+        [0, "a", 3n]
+      ]
+    ]);
+  });
+
+  it("discards rolled back changes", function() {
+    const { db, batches } = fixture();
+
+    db.exec("begin; insert into a values (1, 'one'); rollback");
+    db.exec("insert into a values (2, 'two')");
+
+    expect(batches.map(changes)).toEqual([[[0, "a", 2n]]]);
+  });
+
+  it("delivers changes from other entry points", function() {
+    const { db, batches } = fixture();
+
+    db.prepare("insert into a values (1, 'one') returning id").one();
+    db.prepare("insert into a values (2, 'two') returning id").all();
+
+    expect(batches.map(changes)).toEqual([[[0, "a", 1n]], [[0, "a", 2n]]]);
+  });
+
+  it("flags changes that bypass the update hook", function() {
+    const { db, batches } = fixture();
+
+    db.exec("insert into a values (1, 'one'), (2, 'two')");
+    db.exec("delete from a");
+    db.exec("insert into a values (3, 'three')");
+
+    expect(batches.map(changes)).toEqual([
+      [
+        [0, "a", 1n],
+        [0, "a", 2n]
+      ],
+      [],
+      [[0, "a", 3n]]
+    ]);
+    expect(batches.map(batch => batch.truncated)).toEqual([false, true, false]);
+  });
+
+  it("reports BLOB writes as updates", function() {
+    const { db, batches } = fixture();
+
+    db.exec("create table c (id integer primary key, z blob)");
+    db.exec("insert into c values (7, zeroblob(4))");
+
+    const blob = db.openBlob("c", "z", 7, { write: true });
+
+    blob.write(new Uint8Array([1, 2]), 0);
+    blob.write(new Uint8Array([3, 4]), 2);
+    blob.close();
+
+    expect(batches.map(changes)).toEqual([
+      [[0, "c", 7n]],
+      [
+        [1, "c", 7n],
+        [1, "c", 7n]
+      ]
+    ]);
+    expect(batches.map(batch => batch.truncated)).toEqual([false, false]);
+  });
+
+  it("does not flag trigger changes", function() {
+    const { db, batches } = fixture();
+
+    db.exec(`
+      create trigger copy after insert on a begin
+        insert into b values (new.id, new.x);
+      end
+    `);
+    db.prepare(
+      "insert into a values (1, 'one'), (2, 'two') returning id"
+    ).one();
+    db.exec("delete from a where id > 0");
+
+    expect(batches.map(batch => batch.truncated)).toEqual([false, false]);
+    expect(batches[0].length).toBe(4);
+  });
+
+  it("allows the listener to use the connection", function() {
+    const db = new Database(":memory:");
+    const seen: bigint[] = [];
+
+    db.exec("create table a (id integer primary key, x text)");
+    db.onChange(function(batch) {
+      const row = db.prepare("select count(*) as n from a").one();
+
+      seen.push(batch.rowid[0], row!.n as bigint);
+    });
+    db.exec("insert into a values (5, 'five')");
+
+    expect(seen).toEqual([5n, 1n]);
+  });
+
+  it("propagates listener exceptions", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table a (id integer primary key, x text)");
+    db.onChange(function() {
+      throw new Error("boom");
+    });
+
+    expect(() => db.exec("insert into a values (1, 'one')")).toThrow("boom");
+    expect(db.prepare("select count(*) as n from a").one()).toEqual({
+      n: 1n
+    });
+  });
+
+  it("stops listening", function() {
+    const { db, batches } = fixture();
+
+    db.exec("insert into a values (1, 'one')");
+    db.onChange(null);
+    db.exec("insert into a values (2, 'two')");
+
+    expect(batches.length).toBe(1);
+  });
+
+  it("rejects invalid listeners", function() {
+    const db = new Database(":memory:");
+
+    expect(() => db.onChange("nope" as any)).toThrow(TypeError);
+  });
+
+  it("throws after close", function() {
+    const db = new Database(":memory:");
+
+    db.close();
+
+    expect(() => db.onChange(null)).toThrow("Database handle is closed");
+  });
+});
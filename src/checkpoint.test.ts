@@ -0,0 +1,183 @@
+import { mkdtempSync, rmSync } from "fs";
+import { tmpdir } from "os";
+import path from "path";
+
+import Database from ".";
+
+const dirs: string[] = [];
+
+function fixture() {
+  const dir = mkdtempSync(path.join(tmpdir(), "nsql-checkpoint-"));
+  const db = new Database(path.join(dir, "test.db"));
+
+  dirs.push(dir);
+  db.exec("pragma journal_mode = wal; create table t (x)");
+
+  return db;
+}
+
+async function waitFor(predicate: () => boolean) {
+  for (let i = 0; i < 200 && !predicate(); i++) {
+    await new Promise(resolve => setTimeout(resolve, 10));
+  }
+}
+
+afterAll(function() {
+  for (const dir of dirs) {
+    rmSync(dir, { recursive: true, force: true });
+  }
+});
+
+describe("checkpointer", function() {
+  test("checkpoints in the background", async function() {
+    const db = fixture();
+    const insert = db.prepare("insert into t values (?)");
+
+    db.checkpointer({ intervalMs: 5, mode: "truncate" });
+
+    for (let i = 0; i < 100; i++) {
+      insert.run([i]);
+    }
+
+    await waitFor(function() {
+      const stats = db.checkpointerStats()!;
+
+      return stats.checkpoints > 0 && stats.walFrames === 0;
+    });
+
+    const stats = db.checkpointerStats()!;
+
+    expect(stats.running).toBe(true);
+    expect(stats.checkpoints).toBeGreaterThan(0);
+    expect(stats.errors).toBe(0);
+    expect(stats.walFrames).toBe(0);
+    expect(stats.maxDuration).toBeGreaterThanOrEqual(stats.lastDuration);
+    expect(stats.lastError).toBeNull();
+
+    db.close();
+
+    expect(db.checkpointerStats()!.running).toBe(false);
+  });
+
+  test("does not make writers fail", async function() {
+    const db = fixture();
+    const insert = db.prepare("insert into t values (?)");
+    const end = Date.now() + 500;
+
+    db.checkpointer({ intervalMs: 1, mode: "truncate" });
+
+    for (let i = 0; Date.now() < end; i++) {
+      insert.run([i]);
+    }
+
+    await waitFor(() => db.checkpointerStats()!.checkpoints > 0);
+
+    const stats = db.checkpointerStats()!;
+
+    expect(stats.checkpoints).toBeGreaterThan(0);
+    expect(stats.errors).toBe(0);
+
+    db.close();
+  });
+
+  test("sets a busy timeout while running", function() {
+    const db = fixture();
+    const pragma = () => db.prepare("pragma busy_timeout").one();
+
+    db.checkpointer({ mode: "passive" });
+    expect(pragma()).toEqual({ timeout: 0n });
+
+    db.checkpointer({ mode: "restart" });
+    expect(pragma()).toEqual({ timeout: 5000n });
+
+    db.checkpointer({ enabled: false });
+    expect(pragma()).toEqual({ timeout: 0n });
+
+    db.exec("pragma busy_timeout = 250");
+    db.checkpointer({ mode: "full" });
+    expect(pragma()).toEqual({ timeout: 250n });
+
+    db.close();
+  });
+
+  test("huge intervals never elapse", async function() {
+    const db = fixture();
+
+    db.checkpointer({ intervalMs: 1e20 });
+    db.exec("insert into t values (1)");
+    await new Promise(resolve => setTimeout(resolve, 50));
+
+    expect(db.checkpointerStats()!.checkpoints).toBe(0);
+
+    db.checkpointer({ intervalMs: Number.MAX_VALUE });
+    await new Promise(resolve => setTimeout(resolve, 50));
+
+    expect(db.checkpointerStats()!.checkpoints).toBe(0);
+
+    db.close();
+  });
+
+  test("disables automatic checkpoints while running", function() {
+    const db = fixture();
+    const pragma = () => db.prepare("pragma wal_autocheckpoint").one();
+
+    db.checkpointer();
+    expect(pragma()).toEqual({ wal_autocheckpoint: 0n });
+
+    db.checkpointer({ enabled: false });
+    expect(pragma()).toEqual({ wal_autocheckpoint: 1000n });
+    expect(db.checkpointerStats()).toBeNull();
+
+    db.close();
+  });
+
+  test("WAL size alarm", async function() {
+    const db = fixture();
+    const insert = db.prepare("insert into t values (?)");
+    const alarms: any[] = [];
+
+    db.checkpointer({
+      intervalMs: 5,
+      walSizeLimit: 4096,
+      onWalSizeLimit: stats => alarms.push(stats)
+    });
+
+    /* An open read transaction keeps the WAL from being reset */
+
+    const reader = new Database(db.dbFilename);
+
+    reader.exec("begin; select * from t");
+
+    for (let i = 0; i < 100; i++) {
+      insert.run([i]);
+    }
+
+    await waitFor(() => alarms.length > 0);
+
+    expect(alarms.length).toBe(1);
+    expect(alarms[0].walBytes).toBeGreaterThan(4096);
+    expect(db.checkpointerStats()!.alarms).toBe(1);
+
+    reader.close();
+    db.close();
+  });
+
+  test("requirements", function() {
+    const mem = new Database(":memory:");
+
+    expect(() => mem.checkpointer()).toThrow(
+      "Checkpointing requires a file database"
+    );
+
+    const db = fixture();
+
+    db.exec("pragma journal_mode = delete");
+    expect(() => db.checkpointer()).toThrow(
+      "Checkpointing requires WAL journal mode"
+    );
+    expect(() => db.checkpointer({ intervalMs: 0 })).toThrow(RangeError);
+    expect(() => db.checkpointer({ mode: "eager" as any })).toThrow(TypeError);
+
+    db.close();
+  });
+});
@@ -0,0 +1,107 @@
+import Database from ".";
+
+function fixture() {
+  const db = new Database(":memory:");
+
+  db.exec("create table users (id integer primary key, name text)");
+
+  const stmt = db.prepare("insert into users values (?, ?)");
+
+  for (let i = 1; i <= 5; i++) {
+    stmt.run([BigInt(i), "user" + i]);
+  }
+
+  db.registerColumnarTable("batch", {
+    user_id: new BigInt64Array([2n, 4n, 9n, 2n]),
+    score: new Float64Array([1.5, 2, 3, 4]),
+    tag: ["a", "b", "c", "a"]
+  });
+
+  return db;
+}
+
+describe("registerColumnarTable", function() {
+  test("scan and join", function() {
+    const db = fixture();
+    const stmt = db.prepare(
+      "select b.rowid, b.*, u.name from batch b " +
+        "left join users u on u.id = b.user_id"
+    );
+
+    expect(stmt.all()).toEqual([
+      { rowid: 1n, user_id: 2n, score: 1.5, tag: "a", name: "user2" },
+      { rowid: 2n, user_id: 4n, score: 2, tag: "b", name: "user4" },
+      { rowid: 3n, user_id: 9n, score: 3, tag: "c", name: null },
+      { rowid: 4n, user_id: 2n, score: 4, tag: "a", name: "user2" }
+    ]);
+  });
+
+  test("rowid lookup", function() {
+    const db = fixture();
+    const stmt = db.prepare("select tag from batch where rowid = ?");
+
+    expect(stmt.all([2n])).toEqual([{ tag: "b" }]);
+    expect(stmt.all([0n])).toEqual([]);
+    expect(stmt.all([5n])).toEqual([]);
+  });
+
+  test("equality lookups", function() {
+    const db = fixture();
+
+    function rowids(sql: string) {
+      return db
+        .prepare(sql)
+        .all()
+        .map(row => row.rowid);
+    }
+
+    expect(rowids("select rowid from batch where tag = 'a'")).toEqual([1n, 4n]);
+    expect(rowids("select rowid from batch where user_id = 2")).toEqual([
+      1n,
+      4n
+    ]);
+    expect(rowids("select rowid from batch where score = 2")).toEqual([2n]);
+    expect(rowids("select rowid from batch where user_id = '2'")).toEqual([]);
+    expect(rowids("select rowid from batch where tag = 'x'")).toEqual([]);
+    expect(
+      rowids("select rowid from batch where tag = 'A' collate nocase")
+    ).toEqual([1n, 4n]);
+  });
+
+  test("replace", function() {
+    const db = fixture();
+
+    db.registerColumnarTable("batch", { x: new Int32Array([7]) });
+
+    expect(db.prepare("select * from batch").all()).toEqual([{ x: 7n }]);
+  });
+
+  test("data is copied", function() {
+    const db = new Database(":memory:");
+    const ids = new Int32Array([1, 2]);
+
+    db.registerColumnarTable("t", { id: ids });
+    ids.fill(0);
+
+    expect(db.prepare("select sum(id) as n from t").one()).toEqual({ n: 3n });
+  });
+
+  test("invalid arguments", function() {
+    const db = new Database(":memory:");
+
+    expect(() => db.registerColumnarTable(1 as any, {})).toThrow(TypeError);
+    expect(() => db.registerColumnarTable("t", null as any)).toThrow(
+      TypeError
+    );
+    expect(() => db.registerColumnarTable("t", {})).toThrow(RangeError);
+    expect(() =>
+      db.registerColumnarTable("t", { a: [1] as any })
+    ).toThrow(TypeError);
+    expect(() =>
+      db.registerColumnarTable("t", {
+        a: new Int32Array(1),
+        b: new Int32Array(2)
+      })
+    ).toThrow(RangeError);
+  });
+});
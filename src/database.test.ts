@@ -1,6 +1,7 @@
 import { unlinkSync } from "fs";
 import { tmpdir } from "os";
 import path from "path";
+import { Worker } from "worker_threads";
 
 import Database, { Statement } from ".";
 
@@ -124,6 +125,74 @@ describe("prepare", function() {
   });
 });
 
+describe("interrupt", function() {
+  test("interrupting an idle connection is harmless", function() {
+    const db = new Database(":memory:");
+
+    expect(Database.interrupt(db.interruptHandle())).toBe(true);
+    expect(db.prepare("select 1 as x").one()).toEqual({ x: 1n });
+  });
+
+  test("interrupt from a worker thread", async function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(`
+      with recursive c(x) as (select 1 union all select x + 1 from c)
+      select count(*) from c
+    `);
+    const done = new Int32Array(new SharedArrayBuffer(4));
+
+    // The worker keeps interrupting until we tell it to stop, since it has no
+    // way of knowing when the query has started
+
+    const worker = new Worker(
+      `
+      const { workerData } = require("worker_threads");
+      const Database = require(workerData.module);
+
+      while (Atomics.load(workerData.done, 0) === 0) {
+        Database.interrupt(workerData.handle);
+        Atomics.wait(workerData.done, 0, 0, 10);
+      }
+      `,
+      {
+        eval: true,
+        workerData: { module: __dirname, handle: db.interruptHandle(), done }
+      }
+    );
+    const exited = new Promise(resolve => worker.on("exit", resolve));
+    const start = Date.now();
+
+    try {
+      expect(() => stmt.one(undefined, { timeoutMs: 10000 })).toThrow(
+        expect.objectContaining({ code: "SQLITE_INTERRUPT" })
+      );
+    } finally {
+      Atomics.store(done, 0, 1);
+      Atomics.notify(done, 0);
+    }
+
+    expect(Date.now() - start).toBeLessThan(5000);
+    await exited;
+    db.close();
+  });
+
+  test("interrupt after close", function() {
+    const db = new Database(":memory:");
+    const handle = db.interruptHandle();
+
+    expect(db.interruptHandle()).toBe(handle);
+    db.close();
+    expect(Database.interrupt(handle)).toBe(false);
+    expect(() => db.interruptHandle()).toThrow();
+  });
+
+  test("invalid handles", function() {
+    expect(() => Database.interrupt("1" as any)).toThrow(TypeError);
+    expect(() => Database.interrupt(0)).toThrow(RangeError);
+    expect(() => Database.interrupt(1.5)).toThrow(RangeError);
+  });
+});
+
 describe("dbName", function() {
   test("in-memory database", function() {
     const db = new Database(":memory:");
@@ -152,6 +221,189 @@ describe("dbName", function() {
   });
 });
 
+describe("profile", function() {
+  test("snapshot is empty before profiling", function() {
+    const db = new Database(":memory:");
+
+    expect(db.profileSnapshot()).toEqual([]);
+  });
+
+  test("records statement executions", function() {
+    const db = new Database(":memory:");
+
+    db.profile({ enabled: true });
+
+    const stmt = db.prepare("select ? as x");
+
+    for (let i = 0; i < 10; i++) {
+      stmt.one([BigInt(i)]);
+    }
+
+    const entry = db
+      .profileSnapshot()
+      .find(entry => entry.sql === "select ? as x");
+
+    expect(entry).toBeDefined();
+    expect(entry!.count).toBe(10);
+    expect(entry!.p50).toBeLessThanOrEqual(entry!.p99);
+    expect(entry!.p99).toBeLessThanOrEqual(entry!.max);
+    expect(entry!.max).toBeLessThanOrEqual(entry!.total);
+  });
+
+  test("disable stops recording", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    db.profile({ enabled: true });
+    stmt.run();
+    db.profile({ enabled: false });
+    stmt.run();
+
+    expect(db.profileSnapshot()).toEqual([
+      expect.objectContaining({ sql: "select 1", count: 1 })
+    ]);
+  });
+
+  test("reset discards statistics", function() {
+    const db = new Database(":memory:");
+
+    db.profile({ enabled: true });
+    db.exec("select 1");
+    db.profile({ enabled: true, reset: true });
+
+    expect(db.profileSnapshot()).toEqual([]);
+  });
+
+  test("option type check", function() {
+    const db = new Database(":memory:");
+
+    expect(() => db.profile({ enabled: 1 as any })).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+  });
+
+  test("statements outliving the database are safe", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    db.profile({ enabled: true });
+    db.close();
+    stmt.run();
+
+    expect(db.profileSnapshot()).toEqual([]);
+  });
+});
+
+describe("status", function() {
+  test("reports page cache activity", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table x (y integer)");
+    db.exec("insert into x values (1)");
+
+    const status = db.status();
+
+    expect(status.cacheUsed).toBeGreaterThan(0);
+    expect(status.schemaUsed).toBeGreaterThan(0);
+    expect(status.cacheHit + status.cacheMiss).toBeGreaterThan(0);
+  });
+
+  test("reset zeroes counters", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table x (y integer)");
+    db.status({ reset: true });
+
+    expect(db.status()).toEqual(
+      expect.objectContaining({ cacheHit: 0, cacheMiss: 0, cacheWrite: 0 })
+    );
+  });
+
+  test("status after close does not crash the process", function() {
+    const db = new Database(":memory:");
+
+    db.close();
+    expect(() => db.status()).toThrow();
+  });
+
+  test("global status", function() {
+    const status = Database.globalStatus();
+
+    expect(typeof status.memoryUsed).toBe("number");
+    expect(typeof status.memoryHighwater).toBe("number");
+  });
+});
+
+describe("memory", function() {
+  test("page cache accounting outlives the connection", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table x (y blob)");
+
+    const stmt = db.prepare("insert into x values (randomblob(1048576))");
+
+    for (let i = 0; i < 8; i++) {
+      stmt.run();
+    }
+
+    expect(db.status().cacheUsed).toBeGreaterThan(4 * 1048576);
+    expect(db.releaseMemory()).toBeGreaterThanOrEqual(0);
+
+    // Statements keep the underlying connection open after close()
+
+    db.close();
+    stmt.run();
+  });
+
+  test("release memory", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table x (y integer)");
+
+    expect(db.releaseMemory()).toBeGreaterThanOrEqual(0);
+
+    db.close();
+    expect(() => db.releaseMemory()).toThrow();
+  });
+
+  test("query heap limits", function() {
+    const limit = Database.heapLimit();
+
+    expect(limit).toEqual({
+      soft: expect.any(Number),
+      hard: expect.any(Number)
+    });
+    expect(Database.heapLimit({ soft: 0 })).toEqual(
+      expect.objectContaining({ soft: 0 })
+    );
+    expect(() => (Database as any).heapLimit({ soft: "1" })).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => Database.heapLimit({ hard: -1 })).toThrow(
+      expect.objectContaining({ code: "ERR_OUT_OF_RANGE" })
+    );
+  });
+
+  test("set heap limits", function() {
+    const memoryUsed = Database.globalStatus().memoryUsed;
+    const limit = Database.heapLimit();
+
+    if (memoryUsed === 0) {
+      expect(() => Database.heapLimit({ soft: 1 << 30 })).toThrow();
+
+      return;
+    }
+
+    try {
+      expect(Database.heapLimit({ soft: 1 << 30 })).toEqual(
+        expect.objectContaining({ soft: 1 << 30 })
+      );
+    } finally {
+      Database.heapLimit(limit);
+    }
+  });
+});
+
 test("locking crash regression test", function() {
   // This used to cause a mistaken abort() in response to an error being
   // returned from sqlite3_reset(), but testing that we gracefully recover from
@@ -0,0 +1,228 @@
+import {
+  closeSync,
+  mkdtempSync,
+  openSync,
+  readFileSync,
+  rmSync,
+  unlinkSync
+} from "fs";
+import { tmpdir } from "os";
+import path from "path";
+
+import Database from ".";
+
+// Exports run on a connection of their own, so every test needs a database
+// file rather than an in-memory database
+
+const dir = mkdtempSync(path.join(tmpdir(), "nsql-export-"));
+let counter = 0;
+
+async function withFile(callback: (filename: string) => Promise<void>) {
+  const filename = path.join(dir, "output.txt");
+
+  try {
+    await callback(filename);
+  } finally {
+    unlinkSync(filename);
+  }
+}
+
+function open() {
+  return new Database(path.join(dir, `${counter++}.db`));
+}
+
+function fixture() {
+  const db = open();
+
+  db.exec(`
+    create table t (a, b, c);
+    insert into t values (1, 'plain', null);
+    insert into t values (2.5, 'say "hi", twice', '');
+    insert into t values (-3, 'tab\tand\nline\\\\', x'010203');
+  `);
+
+  return db;
+}
+
+afterAll(function() {
+  rmSync(dir, { recursive: true, force: true });
+});
+
+describe("exportTo", function() {
+  test("csv", async function() {
+    const db = fixture();
+
+    await withFile(async function(filename) {
+      expect(await db.prepare("select * from t").exportTo(filename)).toBe(3);
+      expect(readFileSync(filename, "utf8")).toBe(
+        "a,b,c\n" +
+          "1,plain,\n" +
+          '2.5,"say ""hi"", twice",""\n' +
+          '-3,"tab\tand\nline\\\\",AQID\n'
+      );
+    });
+  });
+
+  test("tsv", async function() {
+    const db = fixture();
+
+    await withFile(async function(filename) {
+      await db.prepare("select * from t").exportTo(filename, {
+        format: "tsv",
+        header: false
+      });
+
+      expect(readFileSync(filename, "utf8")).toBe(
+        "1\tplain\t\\N\n" +
+          '2.5\tsay "hi", twice\t\n' +
+          "-3\ttab\\tand\\nline\\\\\\\\\tAQID\n"
+      );
+    });
+  });
+
+  test("ndjson", async function() {
+    const db = fixture();
+
+    await withFile(async function(filename) {
+      await db.prepare("select * from t where a > ?").exportTo(filename, {
+        format: "ndjson",
+        params: [0]
+      });
+
+      expect(readFileSync(filename, "utf8")).toBe(
+        '{"a":1,"b":"plain","c":null}\n' +
+          '{"a":2.5,"b":"say \\"hi\\", twice","c":""}\n'
+      );
+    });
+  });
+
+  test("empty result set", async function() {
+    const db = fixture();
+
+    await withFile(async function(filename) {
+      expect(
+        await db.prepare("select a, b from t where 0").exportTo(filename)
+      ).toBe(0);
+      expect(readFileSync(filename, "utf8")).toBe("a,b\n");
+    });
+  });
+
+  test("large values", async function() {
+    const db = open();
+    const big = "x".repeat(100000);
+
+    db.exec("create table t (a, b)");
+
+    const insert = db.prepare("insert into t values (?, ?)");
+
+    for (let i = 0; i < 200; i++) {
+      insert.run([i, i % 2 ? big : "small"]);
+    }
+
+    await withFile(async function(filename) {
+      await db.prepare("select * from t").exportTo(filename, { header: false });
+
+      const lines = readFileSync(filename, "utf8").split("\n");
+
+      expect(lines.length).toBe(201);
+      expect(lines[0]).toBe("0,small");
+      expect(lines[199]).toBe("199," + big);
+    });
+  });
+
+  test("file descriptor", async function() {
+    const db = fixture();
+
+    await withFile(async function(filename) {
+      const fd = openSync(filename, "w");
+
+      try {
+        await db.prepare("select a from t").exportTo(fd, { header: false });
+        await db
+          .prepare("select b from t limit 1")
+          .exportTo(fd, { header: false });
+      } finally {
+        closeSync(fd);
+      }
+
+      expect(readFileSync(filename, "utf8")).toBe("1\n2.5\n-3\nplain\n");
+    });
+  });
+
+  test("round trip through importFile", async function() {
+    const db = open();
+
+    db.exec(`
+      create table t (a, b, c);
+      insert into t values (1, 'plain', null);
+      insert into t values (2.5, 'say "hi", twice', '');
+      create table u (a, b, c);
+    `);
+
+    await withFile(async function(filename) {
+      await db.prepare("select a, b, c from t").exportTo(filename);
+      await db.importFile(filename, "u");
+    });
+
+    expect(db.prepare("select * from u").all()).toEqual([
+      { a: "1", b: "plain", c: null },
+      { a: "2.5", b: 'say "hi", twice', c: "" }
+    ]);
+  });
+
+  test("connection and statement remain usable", async function() {
+    const db = fixture();
+    const stmt = db.prepare("select * from t");
+
+    await withFile(async function(filename) {
+      const promise = stmt.exportTo(filename);
+
+      // Execution limits on the caller's connection do not reach the export
+
+      expect(stmt.all(undefined, { maxVmSteps: 1000 })).toHaveLength(3);
+      expect(db.prepare("select count(*) as n from t").one()).toEqual({
+        n: 3n
+      });
+      expect(await promise).toBe(3);
+    });
+  });
+
+  test("sees committed data only", async function() {
+    const db = fixture();
+
+    db.exec("begin; delete from t");
+
+    await withFile(async function(filename) {
+      expect(await db.prepare("select * from t").exportTo(filename)).toBe(3);
+    });
+
+    db.exec("rollback");
+  });
+
+  test("errors", async function() {
+    const db = fixture();
+    const stmt = db.prepare("select * from t");
+
+    expect(() => stmt.exportTo("/nonexistent/file.csv")).toThrow(
+      "/nonexistent/file.csv: "
+    );
+    expect(() => stmt.exportTo({} as any)).toThrow(TypeError);
+    expect(() => stmt.exportTo(-1)).toThrow(RangeError);
+    expect(() => stmt.exportTo("x", { format: "xml" as any })).toThrow(
+      TypeError
+    );
+    expect(() => stmt.exportTo("x", { params: 1 as any })).toThrow(TypeError);
+    expect(() => db.prepare("delete from t").exportTo("x")).toThrow(
+      "read-only"
+    );
+    expect(() =>
+      new Database(":memory:").prepare("select 1").exportTo("x")
+    ).toThrow("Exporting requires a file database");
+
+    await withFile(async function(filename) {
+      await expect(
+        db.prepare("select abs(-9223372036854775807 - 1)").exportTo(filename)
+      ).rejects.toThrow(expect.objectContaining({ code: "SQLITE_ERROR" }));
+    });
+  });
+});
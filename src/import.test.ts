@@ -0,0 +1,287 @@
+import { mkdtempSync, rmSync, writeFileSync } from "fs";
+import { tmpdir } from "os";
+import path from "path";
+
+import Database from ".";
+
+// Imports run on a connection of their own, so every test needs a database
+// file rather than an in-memory database
+
+const dir = mkdtempSync(path.join(tmpdir(), "nsql-import-"));
+let counter = 0;
+
+async function withFile(
+  contents: string,
+  callback: (filename: string) => Promise<void>
+) {
+  const filename = path.join(dir, "input.txt");
+
+  writeFileSync(filename, contents);
+
+  try {
+    await callback(filename);
+  } finally {
+    rmSync(filename);
+  }
+}
+
+function open() {
+  return new Database(path.join(dir, `${counter++}.db`));
+}
+
+function fixture() {
+  const db = open();
+
+  db.exec("create table t (a integer, b text, c text)");
+
+  return db;
+}
+
+afterAll(function() {
+  rmSync(dir, { recursive: true, force: true });
+});
+
+describe("importFile csv", function() {
+  test("header row", async function() {
+    const db = fixture();
+
+    await withFile("c,a,b\nx,1,y\nz,2,w\n", async function(filename) {
+      expect(await db.importFile(filename, "t")).toBe(2);
+    });
+
+    expect(db.prepare("select * from t").all()).toEqual([
+      { a: 1n, b: "y", c: "x" },
+      { a: 2n, b: "w", c: "z" }
+    ]);
+  });
+
+  test("quoting, line endings and empty fields", async function() {
+    const db = fixture();
+    const csv = 'a,b,c\r\n1,"say ""hi""",\r\n2,"two\nlines",""\n\n3,,"a,b"';
+
+    await withFile(csv, async function(filename) {
+      expect(await db.importFile(filename, "t")).toBe(3);
+    });
+
+    expect(db.prepare("select * from t").all()).toEqual([
+      { a: 1n, b: 'say "hi"', c: null },
+      { a: 2n, b: "two\nlines", c: "" },
+      { a: 3n, b: null, c: "a,b" }
+    ]);
+  });
+
+  test("no header row", async function() {
+    const db = fixture();
+
+    await withFile("1,x,y\n2,z,w\n", async function(filename) {
+      await db.importFile(filename, "t", { header: false });
+    });
+
+    await withFile("p,3\n", async function(filename) {
+      await db.importFile(filename, "t", {
+        header: false,
+        columns: ["c", "a"]
+      });
+    });
+
+    expect(db.prepare("select * from t").all()).toEqual([
+      { a: 1n, b: "x", c: "y" },
+      { a: 2n, b: "z", c: "w" },
+      { a: 3n, b: null, c: "p" }
+    ]);
+  });
+
+  test("wrong number of fields", async function() {
+    const db = fixture();
+
+    await withFile("a,b,c\n1,x,y\n2,z\n", async function(filename) {
+      await expect(db.importFile(filename, "t")).rejects.toThrow(
+        filename + ":3: Wrong number of fields"
+      );
+    });
+
+    expect(db.prepare("select count(*) as n from t").one()).toEqual({
+      n: 0n
+    });
+  });
+
+  test("earlier batches remain committed", async function() {
+    const db = fixture();
+
+    await withFile("a,b,c\n1,,\n2,,\n3,,\n4,\n", async function(filename) {
+      await expect(
+        db.importFile(filename, "t", { batchSize: 2 })
+      ).rejects.toThrow();
+    });
+
+    expect(db.prepare("select a from t").all()).toEqual([
+      { a: 1n },
+      { a: 2n }
+    ]);
+  });
+
+  test("progress", async function() {
+    const db = fixture();
+    const reports: any[] = [];
+    const csv = "a,b,c\n1,,\n2,,\n3,,\n";
+
+    await withFile(csv, async function(filename) {
+      await db.importFile(filename, "t", {
+        batchSize: 2,
+        onProgress: report => reports.push(report)
+      });
+    });
+
+    expect(reports).toEqual([
+      { rows: 2, bytes: 14, totalBytes: csv.length },
+      { rows: 3, bytes: csv.length, totalBytes: csv.length }
+    ]);
+  });
+
+  test("progress callback can abort", async function() {
+    const db = fixture();
+    const stop = new Error("stop");
+
+    await withFile("a,b,c\n1,,\n2,,\n3,,\n", async function(filename) {
+      await expect(
+        db.importFile(filename, "t", {
+          batchSize: 1,
+          onProgress: function() {
+            throw stop;
+          }
+        })
+      ).rejects.toThrow("stop");
+    });
+
+    expect(db.prepare("select a from t").all()).toEqual([{ a: 1n }]);
+  });
+
+  test("connection remains usable", async function() {
+    const db = fixture();
+    const rows = ["a,b,c"];
+
+    for (let i = 0; i < 1000; i++) {
+      rows.push(`${i},,`);
+    }
+
+    await withFile(rows.join("\n"), async function(filename) {
+      const promise = db.importFile(filename, "t", { batchSize: 100 });
+
+      expect(db.prepare("select 1 as x").one()).toEqual({ x: 1n });
+      expect(await promise).toBe(1000);
+    });
+
+    expect(db.prepare("select count(*) as n from t").one()).toEqual({
+      n: 1000n
+    });
+  });
+});
+
+describe("importFile ndjson", function() {
+  test("types", async function() {
+    const db = open();
+    const ndjson = [
+      '{"id": 1, "name": "caf\\u00e9 \\ud83c\\udf0d", "tags": [1, {"x": "]"}]}',
+      '{"tags": null, "id": 2.5, "name": "plain", "ignored": true}',
+      '{"name": "esc \\"\\\\\\n", "id": false}'
+    ].join("\n");
+
+    db.exec("create table j (id, name, tags)");
+
+    await withFile(ndjson, async function(filename) {
+      expect(
+        await db.importFile(filename, "j", {
+          format: "ndjson",
+          columns: ["id", "name", "tags"]
+        })
+      ).toBe(3);
+    });
+
+    expect(db.prepare("select * from j").all()).toEqual([
+      { id: 1n, name: "café 🌍", tags: '[1, {"x": "]"}]' },
+      { id: 2.5, name: "plain", tags: null },
+      { id: 0n, name: 'esc "\\\n', tags: null }
+    ]);
+  });
+
+  test("columns from first object", async function() {
+    const db = open();
+
+    db.exec("create table j (a, b)");
+
+    await withFile('{"b": "x", "a": 1}\n{"a": 2}\n', async function(filename) {
+      await db.importFile(filename, "j", { format: "ndjson" });
+    });
+
+    expect(db.prepare("select * from j").all()).toEqual([
+      { a: 1n, b: "x" },
+      { a: 2n, b: null }
+    ]);
+  });
+
+  test("syntax error", async function() {
+    const db = open();
+
+    db.exec("create table j (a)");
+
+    await withFile('{"a": 1}\n{"a": 2,}\n', async function(filename) {
+      await expect(
+        db.importFile(filename, "j", { format: "ndjson" })
+      ).rejects.toThrow(filename + ":2: Expected a string key");
+    });
+  });
+});
+
+describe("importFile", function() {
+  test("missing file", async function() {
+    const db = fixture();
+
+    await expect(
+      db.importFile("/nonexistent/file.csv", "t")
+    ).rejects.toThrow("/nonexistent/file.csv: ");
+  });
+
+  test("missing table", async function() {
+    const db = fixture();
+
+    await withFile("a\n1\n", async function(filename) {
+      await expect(db.importFile(filename, "nope")).rejects.toThrow(
+        expect.objectContaining({ code: "SQLITE_ERROR" })
+      );
+    });
+  });
+
+  test("inside a transaction", async function() {
+    const db = fixture();
+
+    db.exec("begin");
+
+    await withFile("a,b,c\n", async function(filename) {
+      expect(() => db.importFile(filename, "t")).toThrow(
+        "Cannot import a file inside a transaction"
+      );
+    });
+  });
+
+  test("in-memory database", function() {
+    const db = new Database(":memory:");
+
+    expect(() => db.importFile("x", "t")).toThrow(
+      "Importing requires a file database"
+    );
+  });
+
+  test("invalid options", function() {
+    const db = fixture();
+
+    expect(() => db.importFile("x", "t", { format: "xml" as any })).toThrow(
+      TypeError
+    );
+    expect(() => db.importFile("x", "t", { batchSize: 0 })).toThrow(
+      RangeError
+    );
+    expect(() => db.importFile("x", "t", { columns: [1] as any })).toThrow(
+      TypeError
+    );
+  });
+});
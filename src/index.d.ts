@@ -5,6 +5,8 @@
  * @module SQLite
  */
 
+import { Readable, Writable } from "stream";
+
 /**
  * Bind parameter or result set value for an SQL statement.
  *
@@ -27,10 +29,23 @@
  */
 export type SqlValue = null | number | bigint | string | ArrayBuffer;
 
+/**
+ * A list of values bound to a single parameter for use with the `carray`
+ * table-valued function, e.g. `SELECT * FROM t WHERE id IN carray(?)`. This
+ * allows one prepared statement to serve `IN` lists of any length.
+ *
+ * `Int32Array` and `BigInt64Array` elements become `INTEGER`s, `Float64Array`
+ * elements become `REAL`s and the elements of an array of strings become
+ * `TEXT`. The list is copied when it is bound, so later changes to it have no
+ * effect on the statement.
+ */
+export type SqlList = Int32Array | BigInt64Array | Float64Array | string[];
+
 /**
  * A collection of bind parameters suitable for passing to a prepared statement.
  * This can either be an array of `SqlValue`s or an object whose values all
- * conform to the `SqlValue` definition.
+ * conform to the `SqlValue` definition. Any parameter may also be bound to an
+ * {@link SqlList}.
  *
  * If an array is supplied then its elements will be bound to the statement's
  * positional parameters (or to named parameters in the order in which they
@@ -41,7 +56,9 @@ export type SqlValue = null | number | bigint | string | ArrayBuffer;
  * Please note that the symbol at the start of a bind parameter is considered to
  * be part of the parameter's name.
  */
-export type BindParams = SqlValue[] | { [key: string]: SqlValue };
+export type BindParams =
+  | (SqlValue | SqlList)[]
+  | { [key: string]: SqlValue | SqlList };
 
 /**
  * A single row from an SQLite result set. See {@link SqlValue} for the data
@@ -60,6 +77,424 @@ export interface RunResult {
   lastInsertRowid: bigint;
 }
 
+/**
+ * Execution limits accepted by {@link Statement.run}, {@link Statement.one} and
+ * {@link Statement.all}.
+ *
+ * If a limit is exceeded then execution is abandoned and an error whose `code`
+ * is `SQLITE_INTERRUPT` is thrown. Any changes made by the statement are
+ * rolled back, and the statement may be executed again afterwards.
+ */
+export interface ExecOptions {
+  /** Maximum wall-clock execution time in milliseconds. */
+  timeoutMs?: number;
+
+  /** Maximum number of SQLite virtual machine instructions to execute. */
+  maxVmSteps?: number;
+}
+
+/** Options accepted by {@link Statement.allPacked}. */
+export interface PackedOptions extends ExecOptions {
+  /**
+   * Serve the result set from the connection's result cache if possible, and
+   * store it there otherwise. Has no effect unless the cache has been enabled
+   * with {@link Database.resultCache}. Defaults to `false`.
+   */
+  cache?: boolean;
+}
+
+/** Options accepted by {@link Statement.all}. */
+export interface AllOptions extends PackedOptions {
+  /**
+   * Decode each cell on first access. Defaults to `false`.
+   *
+   * As with eager rows, a column name that appears more than once refers to
+   * the last column of that name. A result set with a column named `toJSON` is
+   * decoded up front, since that column would hide the row's own `toJSON()`.
+   */
+  lazy?: boolean;
+
+  /**
+   * Convert identical short `TEXT` values to a single shared string, instead
+   * of allocating a separate string for every cell. This reduces heap usage
+   * and garbage collection work for columns with few distinct values. See
+   * {@link Statement.internStats}. Defaults to `false`.
+   */
+  intern?: boolean;
+}
+
+/** String interning statistics, see {@link Statement.internStats}. */
+export interface InternStats {
+  /** Number of `TEXT` values that reused an existing string. */
+  hits: number;
+
+  /** Number of short `TEXT` values that required a new string. */
+  misses: number;
+}
+
+/** Options accepted by {@link Statement.json}. */
+export interface JsonOptions extends ExecOptions {
+  /**
+   * Whether each row is written as an object keyed by column name or as an
+   * array of values in column order. Defaults to `"objects"`.
+   */
+  shape?: "objects" | "arrays";
+
+  /** Return a UTF-8 `Buffer` instead of a string. Defaults to `false`. */
+  buffer?: boolean;
+}
+
+/** Options accepted by {@link Statement.arrow}. */
+export interface ArrowOptions extends ExecOptions {
+  /** Maximum number of rows per record batch. Defaults to 65536. */
+  batchSize?: number;
+}
+
+/** Options accepted by {@link Statement.exportTo}. */
+export interface ExportOptions {
+  /** Bind parameters (see {@link BindParams}). */
+  params?: BindParams;
+
+  /** Output format. Defaults to `"csv"`. */
+  format?: "csv" | "tsv" | "ndjson";
+
+  /**
+   * Whether CSV or TSV output starts with a row of column names. Defaults to
+   * `true`.
+   */
+  header?: boolean;
+}
+
+/** Options accepted by {@link Database.profile}. */
+export interface ProfileOptions {
+  /** Whether statement execution times should be recorded. */
+  enabled: boolean;
+
+  /** Discard all statistics recorded so far. Defaults to `false`. */
+  reset?: boolean;
+}
+
+/** Options accepted by {@link Database.checkpointer}. */
+export interface CheckpointerOptions {
+  /**
+   * Whether background checkpointing should run. Pass `false` to stop it.
+   * Defaults to `true`.
+   */
+  enabled?: boolean;
+
+  /** Time between checkpoints in milliseconds. Defaults to 1000. */
+  intervalMs?: number;
+
+  /**
+   * Checkpoint mode, see https://sqlite.org/c3ref/wal_checkpoint_v2.html.
+   * Defaults to `"passive"`, which never waits for readers or writers. The
+   * other modes briefly block writers, see {@link Database.checkpointer}.
+   */
+  mode?: "passive" | "full" | "restart" | "truncate";
+
+  /**
+   * WAL size in bytes above which `onWalSizeLimit` is called. Defaults to 0,
+   * meaning no limit.
+   */
+  walSizeLimit?: number;
+
+  /**
+   * Called once each time the WAL grows beyond `walSizeLimit`, which usually
+   * means that long-running readers are preventing checkpoints from making
+   * progress. Calls are asynchronous and do not keep the process alive.
+   */
+  onWalSizeLimit?: (stats: CheckpointerStats) => void;
+}
+
+/** Options accepted by {@link Database.resultCache}. */
+export interface ResultCacheOptions {
+  /**
+   * Whether results should be cached. Pass `false` to disable the cache and
+   * discard its contents. Defaults to `true`.
+   */
+  enabled?: boolean;
+
+  /**
+   * Memory budget in bytes, beyond which the least recently used results are
+   * evicted. Defaults to 16 MiB.
+   */
+  maxBytes?: number;
+}
+
+/**
+ * Statistics recorded by the result cache, as returned by
+ * {@link Database.resultCacheStats}.
+ */
+export interface ResultCacheStats {
+  /** Whether the cache is currently enabled. */
+  enabled: boolean;
+
+  /** Number of calls served from the cache. */
+  hits: number;
+
+  /** Number of calls that found no cached result. */
+  misses: number;
+
+  /** Proportion of lookups that were hits, or 0 if there were none. */
+  hitRate: number;
+
+  /** Number of results evicted to stay within the memory budget. */
+  evictions: number;
+
+  /** Number of results discarded because the data they depend on changed. */
+  invalidations: number;
+
+  /** Number of results currently cached. */
+  entries: number;
+
+  /** Memory used by the cached results in bytes. */
+  bytes: number;
+
+  /** Memory budget in bytes. */
+  maxBytes: number;
+}
+
+/**
+ * Statistics recorded by the background checkpointer, as returned by
+ * {@link Database.checkpointerStats}. All times are in nanoseconds.
+ */
+export interface CheckpointerStats {
+  /** Whether the checkpointer thread is currently running. */
+  running: boolean;
+
+  /** Number of checkpoints that ran to completion. */
+  checkpoints: number;
+
+  /** Number of checkpoints cut short by other connections' locks. */
+  busy: number;
+
+  /** Number of checkpoints that failed with an error. */
+  errors: number;
+
+  /** Number of times the WAL has grown beyond `walSizeLimit`. */
+  alarms: number;
+
+  /** Number of frames in the WAL as of the last checkpoint. */
+  walFrames: number;
+
+  /** Number of those frames that have been copied back into the database. */
+  checkpointedFrames: number;
+
+  /** Size of the WAL's contents in bytes as of the last checkpoint. */
+  walBytes: number;
+
+  /** Duration of the last checkpoint. */
+  lastDuration: number;
+
+  /** Duration of the longest checkpoint. */
+  maxDuration: number;
+
+  /** Total time spent checkpointing. */
+  totalDuration: number;
+
+  /** Description of the most recent checkpoint error, if any. */
+  lastError: string | null;
+}
+
+/**
+ * Latency statistics for a single SQL string, as returned by
+ * {@link Database.profileSnapshot}. All times are in nanoseconds.
+ *
+ * Percentiles are read from a log-linear histogram and are accurate to within
+ * 12.5% of the true value. The count, total and maximum are exact.
+ */
+export interface ProfileEntry {
+  /**
+   * SQL text of the statement, including placeholders. Statements that were
+   * executed after the profiler started tracking its maximum number of
+   * distinct SQL strings are reported together under a dummy string.
+   */
+  sql: string;
+
+  /** Number of times the statement was executed. */
+  count: number;
+
+  /** Total execution time. */
+  total: number;
+
+  /** Median execution time. */
+  p50: number;
+
+  /** 99th percentile execution time. */
+  p99: number;
+
+  /** Longest execution time. */
+  max: number;
+}
+
+/**
+ * Options accepted by {@link Database.status},
+ * {@link Database.globalStatus} and {@link Statement.scanStats}.
+ */
+export interface StatusOptions {
+  /**
+   * Reset the counters and high-water marks after reading them, so that the
+   * next call reports activity since this one. Defaults to `false`.
+   */
+  reset?: boolean;
+}
+
+/**
+ * Cache and memory counters for a single connection, as returned by
+ * {@link Database.status}. Memory sizes are in bytes.
+ *
+ * See https://sqlite.org/c3ref/c_dbstatus_options.html for the precise meaning
+ * of each counter.
+ */
+export interface DatabaseStatus {
+  /** Heap memory used by this connection's page caches. */
+  cacheUsed: number;
+
+  /** Number of page cache hits. */
+  cacheHit: number;
+
+  /** Number of page cache misses. */
+  cacheMiss: number;
+
+  /** Number of dirty cache pages written to disk. */
+  cacheWrite: number;
+
+  /** Number of dirty cache pages written to disk mid-transaction. */
+  cacheSpill: number;
+
+  /** Number of lookaside memory slots currently in use. */
+  lookasideUsed: number;
+
+  /** Highest number of lookaside memory slots in use at any one time. */
+  lookasideHighwater: number;
+
+  /** Number of allocations satisfied from lookaside memory. */
+  lookasideHit: number;
+
+  /** Number of allocations too large for lookaside memory. */
+  lookasideMissSize: number;
+
+  /** Number of allocations that missed because lookaside memory was full. */
+  lookasideMissFull: number;
+
+  /** Heap memory used to store the schemas of all attached databases. */
+  schemaUsed: number;
+
+  /** Heap and lookaside memory used by all prepared statements. */
+  stmtUsed: number;
+}
+
+/**
+ * Process-wide SQLite memory counters, as returned by
+ * {@link Database.globalStatus}. Memory sizes are in bytes.
+ *
+ * SQLite only maintains these counters if memory statistics are enabled, which
+ * they are not in the default build; most of them read as zero otherwise.
+ */
+export interface GlobalStatus {
+  /** Memory currently allocated by SQLite. */
+  memoryUsed: number;
+
+  /** Highest amount of memory allocated by SQLite at any one time. */
+  memoryHighwater: number;
+
+  /** Number of outstanding memory allocations. */
+  mallocCount: number;
+
+  /** Size of the largest single memory allocation request. */
+  largestMalloc: number;
+
+  /** Page cache memory that was allocated from the general-purpose heap. */
+  pagecacheOverflow: number;
+
+  /** Size of the largest single page cache allocation request. */
+  largestPagecache: number;
+}
+
+/**
+ * Options for {@link Database.heapLimit}. Limits are in bytes, and zero
+ * removes a limit. Omitted limits are left unchanged.
+ */
+export interface HeapLimitOptions {
+  /**
+   * Amount of memory above which SQLite starts releasing unused page cache
+   * memory before it allocates more. Allocations still succeed once nothing
+   * more can be released.
+   */
+  soft?: number;
+
+  /**
+   * Amount of memory above which SQLite allocations fail, causing the
+   * statement that requested them to fail with `SQLITE_NOMEM`. Setting a hard
+   * limit also lowers the soft limit to match if it is unset or higher.
+   */
+  hard?: number;
+}
+
+/**
+ * SQLite's process-wide heap limits, as returned by {@link Database.heapLimit}.
+ * Limits are in bytes, and zero means no limit.
+ */
+export interface HeapLimit {
+  /** Soft heap limit. */
+  soft: number;
+
+  /** Hard heap limit. */
+  hard: number;
+}
+
+/**
+ * A single element of a statement's query plan, as returned by
+ * {@link Statement.plan}.
+ *
+ * See https://sqlite.org/eqp.html for details.
+ */
+export interface PlanRow {
+  /** Identifier of this plan element. */
+  id: number;
+
+  /** Identifier of the parent element, or zero for top-level elements. */
+  parent: number;
+
+  /** Human-readable description of this step, e.g. `SCAN t`. */
+  detail: string;
+}
+
+/**
+ * Runtime counters for a single element of a statement's query plan, as
+ * returned by {@link Statement.scanStats}.
+ *
+ * See https://sqlite.org/c3ref/stmt_scanstatus.html for details.
+ */
+export interface ScanStats {
+  /** Identifier of this plan element, matching {@link PlanRow.id}. */
+  id: number;
+
+  /** Identifier of the parent element, matching {@link PlanRow.parent}. */
+  parent: number;
+
+  /** Name of the table or index being accessed, if any. */
+  name: string | null;
+
+  /** Human-readable description of this step, as in {@link PlanRow.detail}. */
+  detail: string | null;
+
+  /** Number of times this loop was started. */
+  loops: number;
+
+  /** Total number of rows visited by all iterations of this loop. */
+  rowsVisited: number;
+
+  /**
+   * The query planner's estimate of `rowsVisited`. A large discrepancy
+   * between the two indicates that the planner's statistics are misleading.
+   */
+  estimatedRows: number;
+
+  /** Approximate CPU cycles spent in this step, where supported. */
+  cycles: number;
+}
+
 /**
  * An SQLite prepared statement.
  *
@@ -82,22 +517,141 @@ export declare class Statement {
    * Execute a statement, returning status information.
    *
    * @param params Bind parameters (see {@link BindParams}).
+   * @param options Execution limits (see {@link ExecOptions}).
    */
-  run(params?: BindParams): RunResult;
+  run(params?: BindParams, options?: ExecOptions): RunResult;
 
   /**
    * Execute a statement, returning a single row or `undefined`.
    *
    * @param params Bind parameters (see {@link BindParams}).
+   * @param options Execution limits (see {@link ExecOptions}).
    */
-  one(params?: BindParams): ResultRow | undefined;
+  one(params?: BindParams, options?: ExecOptions): ResultRow | undefined;
 
   /**
    * Execute a statement, returning an array of multiple (possibly zero) rows.
    *
+   * With the `lazy` option, the result set is first transferred in the same
+   * compact form as {@link Statement.allPacked}, and each cell is only
+   * converted to a JavaScript value when its property is first read. This
+   * saves time and memory when only a few columns of a wide result set are
+   * used. Lazy rows expose their columns through getters on a shared
+   * prototype rather than own properties, so use `toJSON()` to obtain a plain
+   * object.
+   *
+   * With the `cache` option, the result set is likewise transferred in
+   * compact form, from the result cache if possible, and then converted in
+   * full.
+   *
+   * The `intern` option cannot be combined with `lazy` or `cache`, since
+   * neither decodes strings through the interning table. Doing so throws a
+   * `TypeError`.
+   *
+   * @param params Bind parameters (see {@link BindParams}).
+   * @param options Lazy row mode, caching and execution limits.
+   */
+  all(params?: BindParams, options?: AllOptions): ResultRow[];
+
+  /**
+   * Execute a statement, returning the entire result set encoded into a
+   * single `ArrayBuffer`. This avoids creating any per-row or per-cell
+   * JavaScript objects during execution, and the buffer can be transferred to
+   * a worker thread before it is decoded.
+   *
+   * Use {@link PackedResult} to decode the buffer.
+   *
    * @param params Bind parameters (see {@link BindParams}).
+   * @param options Caching and execution limits.
    */
-  all(params?: BindParams): ResultRow[];
+  allPacked(params?: BindParams, options?: PackedOptions): ArrayBuffer;
+
+  /**
+   * Execute a statement, returning the entire result set serialized as a JSON
+   * array. The text is generated directly from SQLite's result set, without
+   * creating any intermediate JavaScript objects.
+   *
+   * The output is the same as `JSON.stringify(stmt.all(params))` would produce
+   * if that worked with BigInts, except as follows:
+   *
+   * - `INTEGER`s are written exactly, as JSON numbers. Values beyond
+   *   `Number.MAX_SAFE_INTEGER` lose precision if parsed with `JSON.parse()`.
+   * - `BLOB`s are written as base64 strings.
+   *
+   * @param params Bind parameters (see {@link BindParams}).
+   * @param options JSON options and execution limits.
+   */
+  json(
+    params?: BindParams,
+    options?: JsonOptions & { buffer?: false }
+  ): string;
+  json(
+    params: BindParams | undefined,
+    options: JsonOptions & { buffer: true }
+  ): Buffer;
+
+  /**
+   * Execute a statement, returning the entire result set as an Apache Arrow
+   * IPC stream. The buffer can be read by any Arrow implementation, e.g. with
+   * `tableFromIPC()` from the `apache-arrow` package.
+   *
+   * Each column's Arrow type is chosen from its first non-`NULL` value:
+   * `INTEGER` becomes `Int64`, `REAL` becomes `Float64`, `TEXT` becomes `Utf8`
+   * and `BLOB` becomes `Binary`. An `Int64` column that also contains `REAL`
+   * values becomes `Float64`; other mismatched values are converted using
+   * SQLite's usual rules. A column that contains nothing but `NULL`s has the
+   * `Null` type. `TEXT` columns with few distinct values are
+   * dictionary-encoded.
+   *
+   * @param params Bind parameters (see {@link BindParams}).
+   * @param options Arrow options and execution limits.
+   */
+  arrow(params?: BindParams, options?: ArrowOptions): ArrayBuffer;
+
+  /**
+   * Execute a statement, streaming its result set to a file. Rows are written
+   * out as they are produced, so the result set never has to fit in memory.
+   *
+   * - CSV follows RFC 4180, except that lines end with `\n`. `NULL` is written
+   *   as an empty field and an empty string as `""`.
+   * - TSV escapes tabs, line breaks and backslashes with a backslash, and
+   *   writes `NULL` as `\N`.
+   * - NDJSON writes one JSON object per line, as {@link Statement.json} would.
+   *
+   * `BLOB`s are written as base64 in every format. CSV and NDJSON exports can
+   * be loaded back with {@link Database.importFile}, although `BLOB`s then
+   * come back as base64 text.
+   *
+   * The statement must be read-only. A copy of it is executed and its output
+   * written on a background thread using a separate connection to the same
+   * database file, so exports are not available for in-memory databases, and
+   * they only see committed data: neither this connection's open transaction,
+   * if any, nor its temporary tables. This connection and this statement
+   * remain usable in the meantime. Invalid arguments, SQL errors found while
+   * preparing the copy, and a path that cannot be opened, are thrown
+   * synchronously; errors that occur during the export reject the promise.
+   *
+   * @param target A file descriptor, which is left open, or a path, which is
+   * created or truncated.
+   * @param options Export options and bind parameters.
+   * @returns A promise for the number of rows written.
+   */
+  exportTo(target: number | string, options?: ExportOptions): Promise<number>;
+
+  /**
+   * Return the query plan that SQLite has chosen for this statement, as
+   * reported by `EXPLAIN QUERY PLAN`.
+   */
+  plan(): PlanRow[];
+
+  /**
+   * Return runtime counters for each element of this statement's query plan.
+   * Counters accumulate across executions of the statement until they are
+   * reset.
+   *
+   * @param options Status options.
+   */
+  scanStats(options?: StatusOptions): ScanStats[];
 
   /**
    * The original SQL used to prepare this statement, including placeholders.
@@ -108,6 +662,313 @@ export declare class Statement {
    * This property is primarily provided for diagnostic purposes.
    */
   readonly sql: string;
+
+  /**
+   * String interning statistics for the most recent call to
+   * {@link Statement.all} that used the `intern` option, or `null` if there
+   * has not been one. Values longer than 64 bytes are never interned and are
+   * not counted.
+   */
+  readonly internStats: InternStats | null;
+}
+
+/** Progress report passed to {@link ImportOptions.onProgress}. */
+export interface ImportProgress {
+  /** Number of rows inserted and committed so far. */
+  rows: number;
+
+  /** Number of bytes of the input file consumed so far. */
+  bytes: number;
+
+  /** Size of the input file in bytes. */
+  totalBytes: number;
+}
+
+/** Options accepted by {@link Database.importFile}. */
+export interface ImportOptions {
+  /**
+   * Input file format. `"csv"` is RFC 4180 CSV; `"ndjson"` is one JSON object
+   * per line. Defaults to `"csv"`.
+   */
+  format?: "csv" | "ndjson";
+
+  /**
+   * Names of the columns to insert into. For CSV input these are matched to
+   * fields by position, and override the header row if there is one. For
+   * NDJSON input these are matched to object keys by name, and other keys are
+   * ignored.
+   *
+   * If omitted, CSV input uses the header row, or inserts every column of the
+   * table positionally if there is no header row, and NDJSON input uses the
+   * keys of the first object.
+   */
+  columns?: string[];
+
+  /** Whether CSV input starts with a header row. Defaults to `true`. */
+  header?: boolean;
+
+  /** Number of rows to insert per transaction. Defaults to 10000. */
+  batchSize?: number;
+
+  /**
+   * Called on the main thread after each transaction commits. The import
+   * waits for this callback to return before starting the next batch. An
+   * exception thrown by it stops the import and rejects the promise with that
+   * exception; rows committed up to that point remain.
+   */
+  onProgress?: (progress: ImportProgress) => void;
+}
+
+/** Options accepted by {@link Database.openBlob}. */
+export interface BlobOptions {
+  /** Open the BLOB for writing as well as reading. Defaults to `false`. */
+  write?: boolean;
+}
+
+/** Options accepted by {@link Blob.createReadStream}. */
+export interface BlobReadStreamOptions {
+  /** Byte offset to start reading from. Defaults to `0`. */
+  start?: number;
+
+  /** Byte offset to stop reading at (exclusive). Defaults to the BLOB size. */
+  end?: number;
+
+  /** Maximum size of each chunk, in bytes. Defaults to 64 KiB. */
+  highWaterMark?: number;
+}
+
+/** Options accepted by {@link Blob.createWriteStream}. */
+export interface BlobWriteStreamOptions {
+  /** Byte offset to start writing at. Defaults to `0`. */
+  start?: number;
+
+  /** Stream buffering threshold, in bytes. Defaults to 64 KiB. */
+  highWaterMark?: number;
+}
+
+/**
+ * A handle for incremental I/O on a single BLOB value, which allows large
+ * values to be read or written piecewise without materializing them in memory.
+ *
+ * Incremental I/O cannot change the size of a BLOB. To write a new value, first
+ * insert a placeholder of the correct size using SQLite's `zeroblob()`
+ * function.
+ *
+ * If the row that a handle refers to is modified or deleted by anything other
+ * than the handle itself then the handle expires, and further reads and writes
+ * will throw an error whose `code` is `SQLITE_ABORT`.
+ *
+ * This class cannot be instantiated directly.
+ */
+export declare class Blob {
+  /**
+   * Close this handle. Calling any methods on a closed handle will result in
+   * an error, with the exception of further calls to `close()` which will have
+   * no effect.
+   */
+  close(): undefined;
+
+  /**
+   * Read bytes from the BLOB into `buffer`, starting at `offset`. Returns the
+   * number of bytes read, which is less than the size of `buffer` if the end
+   * of the BLOB is reached.
+   *
+   * @param buffer Destination buffer.
+   * @param offset Byte offset within the BLOB. Defaults to `0`.
+   */
+  read(buffer: ArrayBuffer | ArrayBufferView, offset?: number): number;
+
+  /**
+   * Write the entire contents of `buffer` into the BLOB, starting at
+   * `offset`. Throws an error if the write would extend past the end of the
+   * BLOB.
+   *
+   * @param buffer Source buffer.
+   * @param offset Byte offset within the BLOB. Defaults to `0`.
+   */
+  write(buffer: ArrayBuffer | ArrayBufferView, offset?: number): undefined;
+
+  /**
+   * Point this handle at the same column of a different row. This is much
+   * cheaper than opening a new handle.
+   *
+   * @param rowid ROWID of the row to move to.
+   */
+  reopen(rowid: bigint | number): undefined;
+
+  /** Create a readable stream over the contents of this BLOB. */
+  createReadStream(options?: BlobReadStreamOptions): Readable;
+
+  /** Create a writable stream that overwrites the contents of this BLOB. */
+  createWriteStream(options?: BlobWriteStreamOptions): Writable;
+
+  /** Size of the BLOB in bytes. */
+  readonly size: number;
+}
+
+/** Options accepted by {@link Database.applyChangeset}. */
+export interface ApplyChangesetOptions {
+  /**
+   * How to resolve a change that conflicts with the target database:
+   *
+   * - `"abort"` throws an error and applies none of the changes.
+   * - `"omit"` skips the conflicting change.
+   * - `"replace"` overwrites the conflicting row. Changes that cannot be
+   *    resolved this way, such as updates to rows that do not exist or changes
+   *    that violate a constraint, are skipped.
+   *
+   * Defaults to `"abort"`.
+   */
+  onConflict?: "abort" | "omit" | "replace";
+}
+
+/**
+ * Records changes made to the `main` database of a connection, so that they
+ * can be replayed elsewhere with {@link Database.applyChangeset}.
+ *
+ * Only tables with a declared `PRIMARY KEY` can be recorded. Changes to other
+ * tables are ignored.
+ *
+ * Holding an open session keeps the underlying connection alive until the
+ * session is closed, even if the connection has been closed from JavaScript
+ * in the meantime.
+ *
+ * This class cannot be instantiated directly.
+ */
+export declare class Session {
+  /**
+   * Start recording changes to another table.
+   *
+   * @param table Table name.
+   */
+  attach(table: string): undefined;
+
+  /**
+   * Return every change recorded since the session was created as a
+   * changeset. A changeset contains the original values of updated and deleted
+   * rows, which are used to detect conflicts when it is applied.
+   */
+  changeset(): ArrayBuffer;
+
+  /**
+   * Return every change recorded since the session was created as a patchset.
+   * This is more compact than a changeset, because it omits the original
+   * values of updated and deleted rows other than their primary keys, but
+   * conflicts are detected less precisely.
+   */
+  patchset(): ArrayBuffer;
+
+  /**
+   * Stop recording and release the session. Calling any methods on a closed
+   * session will result in an error, with the exception of further calls to
+   * `close()` which will have no effect.
+   */
+  close(): undefined;
+
+  /** Whether no changes have been recorded. */
+  readonly isEmpty: boolean;
+}
+
+/**
+ * Row changes committed on a connection, as delivered to a
+ * {@link Database.onChange} listener. Element `i` of `op`, `table` and `rowid`
+ * together describe the `i`th change, in the order in which they were made.
+ */
+export interface ChangeBatch {
+  /** Number of changes in the batch. */
+  readonly length: number;
+
+  /** Kind of each change: `0` for insert, `1` for update, `2` for delete. */
+  readonly op: Uint8Array;
+
+  /** Table of each change, as an index into `tables`. */
+  readonly table: Uint32Array;
+
+  /** ROWID of the row affected by each change. */
+  readonly rowid: BigInt64Array;
+
+  /** Names of the tables referred to by `table`. */
+  readonly tables: string[];
+
+  /**
+   * Whether the batch is incomplete, either because memory ran out while
+   * recording changes or because SQLite made changes that it does not report
+   * individually. See {@link Database.onChange}.
+   */
+  readonly truncated: boolean;
+}
+
+/**
+ * Decoder for result sets returned by {@link Statement.allPacked}. Values are
+ * only decoded when they are accessed, so columns that are never read cost
+ * nothing.
+ */
+export declare class PackedResult implements Iterable<ResultRow> {
+  /**
+   * Wrap a buffer returned by {@link Statement.allPacked}. Throws an error if
+   * the buffer is not in the expected format.
+   *
+   * @param buffer Packed result set.
+   */
+  constructor(buffer: ArrayBuffer);
+
+  /** Result set column names. */
+  readonly columns: string[];
+
+  /** Number of rows in the result set. */
+  readonly length: number;
+
+  /**
+   * Return the value of a single cell.
+   *
+   * @param row Row index.
+   * @param column Column index or name.
+   */
+  get(row: number, column: number | string): SqlValue;
+
+  /**
+   * Decode a single row into an object, as returned by {@link Statement.all}.
+   *
+   * @param row Row index.
+   */
+  row(row: number): ResultRow;
+
+  /** Decode every row, producing the same result as {@link Statement.all}. */
+  toArray(): ResultRow[];
+
+  /**
+   * Return an array of rows that decode each cell on first access, as
+   * returned by {@link Statement.all} with the `lazy` option.
+   */
+  lazyRows(): ResultRow[];
+
+  [Symbol.iterator](): Iterator<ResultRow>;
+}
+
+/**
+ * Options for the {@link Database} constructor.
+ */
+export interface DatabaseOptions {
+  /**
+   * The VFS through which the connection accesses its files.
+   *
+   * - `default`: SQLite's default VFS.
+   * - `io_uring`: On Linux, batch the writes made to the main database and WAL
+   *   files during a commit or checkpoint and submit them, along with the
+   *   `fsync()` that completes it, to the kernel through io_uring. Sequential
+   *   scans also read ahead. Everything else is handled by the default VFS,
+   *   which is also used throughout if io_uring is unavailable.
+   * - `compressed`: Compress each page of the main database file with LZ4 and
+   *   store it in a sparse file, leaving the unused part of its slot as a hole.
+   *   Space is only saved where the filesystem supports sparse files and pages
+   *   shrink by at least one filesystem block, so set a large `page_size`,
+   *   such as 65536, before creating the database. Its page size cannot be
+   *   changed afterwards, memory-mapped I/O is not used, and the file cannot
+   *   be opened with any other VFS. Journals and WAL files are not compressed.
+   *
+   * Defaults to `default`.
+   */
+  vfs?: "default" | "io_uring" | "compressed";
 }
 
 /**
@@ -131,8 +992,9 @@ declare class Database {
    *   SQLite will open a persistent database file at this location.
    *
    * @param uri Path to a database file, or `:memory:`, or the empty string.
+   * @param options Connection options.
    */
-  constructor(uri: string);
+  constructor(uri: string, options?: DatabaseOptions);
 
   /**
    * Close the database connection. Calling any methods on a closed database
@@ -159,6 +1021,64 @@ declare class Database {
    */
   exec(sql: string): undefined;
 
+  /**
+   * Bulk-load a CSV or NDJSON file into an existing table, resolving to the
+   * number of rows inserted.
+   *
+   * The file is parsed natively and each record is inserted by a single
+   * prepared statement, with rows committed in batches. If an error occurs
+   * then the current batch is rolled back, but earlier batches remain
+   * committed, and the promise rejects with an error whose message includes
+   * the line number at which parsing failed. This method cannot be called
+   * while a transaction is open.
+   *
+   * The import runs on a background thread using a separate connection to the
+   * same database file, so it is not available for in-memory databases, and
+   * the rows it inserts are not reported to {@link Database.onChange}. This
+   * connection remains usable in the meantime, although its writes contend
+   * with the import's for the database lock.
+   *
+   * CSV fields are inserted as text and converted according to the column's
+   * type affinity. An empty unquoted field is `NULL`, whereas `""` is an empty
+   * string. NDJSON numbers, booleans and `null` keep their types, and nested
+   * objects and arrays are stored as JSON text.
+   *
+   * @param path Path to the input file.
+   * @param table Name of the table to insert into.
+   * @param options Import options.
+   */
+  importFile(
+    path: string,
+    table: string,
+    options?: ImportOptions
+  ): Promise<number>;
+
+  /**
+   * Return a handle that identifies this connection to
+   * {@link Database.interrupt}. The handle is a plain number, so it can be
+   * posted to a worker thread.
+   *
+   * The same handle is returned every time. It stops working once the
+   * connection is closed, and is never reused for another connection.
+   */
+  interruptHandle(): number;
+
+  /**
+   * Open a handle for incremental I/O on the BLOB stored in the given table,
+   * column and row of the `main` database.
+   *
+   * @param table Table name.
+   * @param column Column name.
+   * @param rowid ROWID of the row containing the BLOB.
+   * @param options BLOB options.
+   */
+  openBlob(
+    table: string,
+    column: string,
+    rowid: bigint | number,
+    options?: BlobOptions
+  ): Blob;
+
   /**
    * Prepare an SQL statement.
    *
@@ -178,6 +1098,220 @@ declare class Database {
    */
   prepare(sql: string): Statement;
 
+  /**
+   * Enable or disable statement profiling for this connection.
+   *
+   * While profiling is enabled, the execution time of every statement run on
+   * this connection (including statements run by {@link Database.exec}) is
+   * recorded into a latency histogram for its SQL text. Recording happens
+   * entirely in native code, so the overhead is small enough to leave
+   * profiling enabled in production.
+   *
+   * Disabling profiling stops recording but retains the statistics gathered
+   * so far. Use the `reset` option to discard them.
+   *
+   * @param options Profiling options.
+   */
+  profile(options: ProfileOptions): undefined;
+
+  /**
+   * Apply a changeset or patchset produced by {@link Session} to the `main`
+   * database of this connection. The changes are applied atomically: if an
+   * error occurs or a conflict aborts the operation then none of them take
+   * effect.
+   *
+   * @param changeset Changeset or patchset.
+   * @param options Conflict handling options.
+   */
+  applyChangeset(
+    changeset: ArrayBuffer | Uint8Array,
+    options?: ApplyChangesetOptions
+  ): undefined;
+
+  /**
+   * Start recording changes to this connection's `main` database. Use
+   * {@link Session.changeset} or {@link Session.patchset} to retrieve them.
+   *
+   * @param tables Names of the tables to record. Defaults to all tables,
+   *    including ones created after the session.
+   */
+  session(tables?: string[]): Session;
+
+  /**
+   * Register a listener that is called with the row changes made on this
+   * connection each time they are committed, replacing any previous listener.
+   * Pass `null` to stop listening.
+   *
+   * Changes are recorded natively and delivered in a single batch once the
+   * call that committed them returns, so the listener may safely use the
+   * connection. Changes discarded by a rolled back transaction are never
+   * delivered, but those discarded by `ROLLBACK TO` a savepoint still are.
+   * Each write through a {@link Blob} is reported as an update of its row;
+   * outside of a transaction, these are committed and delivered when the
+   * `Blob` is closed.
+   *
+   * As with SQLite's update hook, changes to `WITHOUT ROWID` tables, rows
+   * deleted by an `ON CONFLICT REPLACE` and rows deleted by an unconditional
+   * `DELETE` that SQLite optimizes into a truncation are not reported. Apart
+   * from `ON CONFLICT REPLACE`, such changes are detected once they are
+   * committed and the batch that contains them is marked `truncated`,
+   * even if it would otherwise be empty. A transaction that made such changes
+   * and was then rolled back may also be reported this way.
+   *
+   * An exception thrown by the listener propagates out of the call that
+   * committed the changes, which is not rolled back.
+   *
+   * @param listener Function to call with each batch of changes, or `null`.
+   */
+  onChange(listener: ((batch: ChangeBatch) => void) | null): undefined;
+
+  /**
+   * Start, reconfigure or stop background WAL checkpointing.
+   *
+   * Normally SQLite checkpoints the WAL from inside whichever commit pushes it
+   * past 1000 pages, so that commit absorbs the cost of writing back and
+   * syncing the database file. While the checkpointer is running, automatic
+   * checkpoints are disabled on this connection and are instead performed at
+   * a fixed interval by a background thread with its own connection to the
+   * same file. The database must be a file in WAL journal mode.
+   *
+   * Each pass first checkpoints as much as it can without blocking anyone.
+   * Modes other than `"passive"` then hold the writer lock while they finish,
+   * waiting up to 100 ms for writers and readers before trying again on the
+   * next pass. So that writes made in the meantime wait rather than fail with
+   * `SQLITE_BUSY`, this connection is given a busy timeout of 5 seconds while
+   * such a mode is in use, unless `PRAGMA busy_timeout` has already set one.
+   * Other connections that write to the database need a busy timeout too.
+   *
+   * Reconfiguring restarts the checkpointer and resets its statistics.
+   * Closing the connection stops it.
+   *
+   * @param options Checkpointer options.
+   */
+  checkpointer(options?: CheckpointerOptions): undefined;
+
+  /**
+   * Return the statistics recorded by {@link Database.checkpointer}, or `null`
+   * if it has never been started on this connection.
+   */
+  checkpointerStats(): CheckpointerStats | null;
+
+  /**
+   * Enable, reconfigure or disable the result cache.
+   *
+   * While enabled, calls to {@link Statement.all} and
+   * {@link Statement.allPacked} that pass the `cache` option look up their
+   * SQL text and bind parameters in a cache on this connection, and are served
+   * from it without executing the statement if an earlier call stored its
+   * result set there. Only read-only statements are cached.
+   *
+   * Results are invalidated when a table they read is written through this
+   * connection, and entirely when another connection writes to the `main`
+   * database, when the schema changes or when a {@link Blob} is written.
+   * Statements that read attached databases are not cached, and statements
+   * that read virtual tables are invalidated by any write. The cache is
+   * bypassed while a transaction is open. Results of functions such as
+   * `random()` or `datetime('now')` are cached like any other, so do not use
+   * the `cache` option for such statements.
+   *
+   * Reconfiguring discards all cached results and resets the statistics.
+   * Closing the connection disables the cache.
+   *
+   * @param options Result cache options.
+   */
+  resultCache(options?: ResultCacheOptions): undefined;
+
+  /**
+   * Return the statistics recorded by {@link Database.resultCache}, or `null`
+   * if it has never been enabled on this connection.
+   */
+  resultCacheStats(): ResultCacheStats | null;
+
+  /**
+   * Return the statistics recorded by {@link Database.profile}, one entry per
+   * distinct SQL string, in descending order of total execution time.
+   */
+  profileSnapshot(): ProfileEntry[];
+
+  /**
+   * Expose columnar data as a read-only virtual table, so that it can be
+   * joined against persistent tables without first being inserted into a
+   * temporary table.
+   *
+   * Each property of `columns` becomes a column of the table, in property
+   * order, and all of them must have the same length. Row `i` of the table
+   * has `rowid` `i + 1`. See {@link SqlList} for the types of the values.
+   *
+   * The data is copied into native memory once, when this method is called.
+   * Lookups by `rowid` take constant time, and an equality constraint on any
+   * other column is served by a hash index built on the column the first time
+   * a query uses it.
+   *
+   * The table behaves as if it existed in the `main` schema of this
+   * connection, but it is not stored in the database. Registering another
+   * table under the same name replaces it.
+   *
+   * @param name Table name.
+   * @param columns Column data, keyed by column name.
+   */
+  registerColumnarTable(
+    name: string,
+    columns: { [column: string]: SqlList }
+  ): undefined;
+
+  /**
+   * Release as much of this connection's page cache memory as possible and
+   * return the number of bytes released. Pages belonging to an open
+   * transaction or a running statement cannot be released.
+   *
+   * The size of each connection's page cache is reported to the JavaScript
+   * engine as external memory, so that the garbage collector takes it into
+   * account when deciding whether to reclaim abandoned connections and
+   * statements.
+   */
+  releaseMemory(): number;
+
+  /**
+   * Return this connection's page cache and memory usage counters.
+   *
+   * @param options Status options.
+   */
+  status(options?: StatusOptions): DatabaseStatus;
+
+  /**
+   * Return SQLite's process-wide memory usage counters.
+   *
+   * @param options Status options.
+   */
+  static globalStatus(options?: StatusOptions): GlobalStatus;
+
+  /**
+   * Set SQLite's process-wide heap limits, which apply to all connections,
+   * and return the limits in effect afterwards. Call without options to query
+   * the limits without changing them.
+   *
+   * SQLite only enforces these limits if memory statistics are enabled, which
+   * they are not in the default build. Setting a non-zero limit without them
+   * throws an error.
+   *
+   * @param options Heap limit options.
+   */
+  static heapLimit(options?: HeapLimitOptions): HeapLimit;
+
+  /**
+   * Abort the statement that is currently executing on the connection
+   * identified by `handle`, which will then throw an error whose `code` is
+   * `SQLITE_INTERRUPT`. Does nothing if no statement is executing.
+   *
+   * Statements execute synchronously, so this is meant to be called from a
+   * worker thread while the connection's own thread is blocked. Use
+   * {@link ExecOptions} to bound the execution time of a statement in advance.
+   *
+   * @param handle A handle returned by {@link Database.interruptHandle}.
+   * @returns `false` if the connection has been closed.
+   */
+  static interrupt(handle: number): boolean;
+
   /**
    * The absolute path to the file backing this database connection.
    *
@@ -190,4 +1324,127 @@ declare class Database {
   readonly dbFilename: string;
 }
 
+/**
+ * Options for the {@link ShardedDatabase} constructor. All other options are
+ * passed to each shard's {@link Database} constructor.
+ */
+export interface ShardedDatabaseOptions extends DatabaseOptions {
+  /**
+   * Map a key to the index of the shard that owns it. By default, integer keys
+   * are taken modulo the number of shards and string keys are hashed.
+   */
+  shardKey?: (key: any, shards: number) => number;
+}
+
+/**
+ * A sort key for {@link ShardedDatabase.all}: a column name, which sorts in
+ * ascending order, or an object naming the column and its direction.
+ */
+export type ShardedOrderKey = string | { column: string; descending?: boolean };
+
+/**
+ * How {@link ShardedDatabase.all} combines a column's partial results from
+ * different shards. `count` and `sum` add them up, while `min` and `max` keep
+ * the smallest or largest, ignoring NULLs.
+ */
+export type ShardedAggregate = "count" | "sum" | "min" | "max";
+
+/** Options for {@link ShardedDatabase.all}. */
+export interface ShardedAllOptions {
+  /**
+   * Merge shard results in this order, which each shard's query must already
+   * produce with a matching `ORDER BY`. Values are compared as SQLite does
+   * with the `BINARY` collation. Without this option, results are
+   * concatenated in shard order.
+   */
+  orderBy?: ShardedOrderKey[];
+
+  /**
+   * Combine consecutive merged rows that are equal in every column not named
+   * here into a single row. Without `orderBy`, this combines the one row each
+   * shard returns for an aggregate query without `GROUP BY`. For grouped
+   * queries, `orderBy` must name every column not named here, and a
+   * `TypeError` is thrown otherwise.
+   */
+  aggregate?: { [column: string]: ShardedAggregate };
+
+  /**
+   * Maximum number of rows to return after merging. Each shard's query should
+   * also be limited to avoid producing rows that are thrown away.
+   */
+  limit?: number;
+
+  /** Decode each cell on first access, as with {@link AllOptions.lazy}. */
+  lazy?: boolean;
+}
+
+/**
+ * A set of databases with the same schema that split their rows between them
+ * by key. Each shard has its own connection, so writes to different shards do
+ * not contend for the same lock, and queries run on every shard at once.
+ *
+ * There are no transactions across shards.
+ */
+export declare class ShardedDatabase {
+  /**
+   * Open one database per file.
+   *
+   * @param filenames Paths to the shards' database files.
+   * @param options Shard routing and connection options.
+   */
+  constructor(filenames: string[], options?: ShardedDatabaseOptions);
+
+  /** The shards' connections, in the order their files were given. */
+  readonly shards: Database[];
+
+  /**
+   * Return the index of the shard that owns a key.
+   *
+   * @param key Shard key.
+   */
+  shardFor(key: any): number;
+
+  /**
+   * Return the connection of the shard that owns a key.
+   *
+   * @param key Shard key.
+   */
+  shard(key: any): Database;
+
+  /**
+   * Execute SQL on every shard, as {@link Database.exec} does. Useful for
+   * creating and upgrading the schema.
+   *
+   * @param sql One or more SQL statements.
+   */
+  exec(sql: string): undefined;
+
+  /**
+   * Execute a statement on the shard that owns `key`.
+   *
+   * @param key Shard key.
+   * @param sql SQL statement.
+   * @param params Bind parameters.
+   */
+  run(key: any, sql: string, params?: BindParams): RunResult;
+
+  /**
+   * Execute a read-only query on every shard and merge the results. Each
+   * shard runs its query on a thread of its own, and the results are merged
+   * natively before any rows are created.
+   *
+   * @param sql SQL query.
+   * @param params Bind parameters, used on every shard.
+   * @param options Merge options.
+   */
+  all(
+    sql: string,
+    params?: BindParams,
+    options?: ShardedAllOptions
+  ): ResultRow[];
+
+  /** Close every shard's statements and connection. */
+  close(): undefined;
+}
+
 export default Database;
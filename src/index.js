@@ -1,5 +1,8 @@
 const Database = require("node-gyp-build")(__dirname + "/..");
 const util = require("util");
+const blob = require("./blob");
+const PackedResult = require("./packed");
+const ShardedDatabase = require("./sharded");
 
 Database.prototype[util.inspect.custom] = function(depth, options) {
   const { dbFilename } = this;
@@ -14,4 +17,37 @@ Database._Statement.prototype[util.inspect.custom] = function(depth, options) {
   return options.stylize(`<${this.sql}>`, "special");
 };
 
+const all = Database._Statement.prototype.all;
+
+Database._Statement.prototype.all = function(params, options) {
+  if (options !== null && typeof options === "object") {
+    // Lazy and cached rows are decoded from a packed result set, which never
+    // goes through the string interning table
+
+    if (options.intern && (options.lazy || options.cache)) {
+      throw new TypeError(
+        "options: intern cannot be combined with lazy or cache"
+      );
+    }
+
+    if (options.lazy) {
+      return new PackedResult(this.allPacked(params, options)).lazyRows();
+    }
+
+    // Cached result sets are stored in packed form
+
+    if (options.cache) {
+      return new PackedResult(this.allPacked(params, options)).toArray();
+    }
+  }
+
+  return all.apply(this, arguments);
+};
+
+Database._Blob.prototype.createReadStream = blob.createReadStream;
+Database._Blob.prototype.createWriteStream = blob.createWriteStream;
+
+Database.PackedResult = PackedResult;
+Database.ShardedDatabase = ShardedDatabase;
+
 module.exports = Database;
@@ -0,0 +1,225 @@
+// Decoder for the packed result format produced by Statement.allPacked(). See
+// INTERNALS.md for the layout. Nothing is decoded until it is accessed, so
+// columns that are never read cost nothing beyond the initial transfer.
+
+const MAGIC = 0x5051534e;
+const VERSION = 1;
+const HEADER_SIZE = 32;
+const CELL_SIZE = 16;
+
+const SQLITE_INTEGER = 1;
+const SQLITE_FLOAT = 2;
+const SQLITE_TEXT = 3;
+const SQLITE_BLOB = 4;
+
+const utf8 = new TextDecoder();
+
+const inspect = Symbol.for("nodejs.util.inspect.custom");
+const base = Symbol("base");
+const cache = Symbol("cache");
+
+function readOffset(view, pos) {
+  return view.getUint32(pos, true) + view.getUint32(pos + 4, true) * 2 ** 32;
+}
+
+class PackedResult {
+  constructor(buffer) {
+    if (!(buffer instanceof ArrayBuffer)) {
+      throw new TypeError("buffer: Expected ArrayBuffer");
+    }
+
+    const view = new DataView(buffer);
+
+    if (
+      buffer.byteLength < HEADER_SIZE ||
+      view.getUint32(0, true) !== MAGIC ||
+      view.getUint32(4, true) !== VERSION
+    ) {
+      throw new Error("Not a packed result");
+    }
+
+    const ncols = view.getUint32(8, true);
+    const columns = [];
+    let pos = HEADER_SIZE;
+
+    for (let i = 0; i < ncols; i++) {
+      const nbytes = view.getUint32(pos, true);
+
+      pos += 4;
+      columns.push(utf8.decode(new Uint8Array(buffer, pos, nbytes)));
+      pos += nbytes;
+    }
+
+    this._buffer = buffer;
+    this._view = view;
+    this._cells = readOffset(view, 16);
+    this._heap = readOffset(view, 24);
+    this.columns = columns;
+    this.length = view.getUint32(12, true);
+  }
+
+  // Return the value of a single cell. `col` may be a column index or name.
+
+  get(row, col) {
+    const i = typeof col === "number" ? col : this.columns.indexOf(col);
+
+    if (!Number.isInteger(row) || row < 0 || row >= this.length) {
+      throw new RangeError("Row index out of range");
+    }
+
+    if (!Number.isInteger(i) || i < 0 || i >= this.columns.length) {
+      throw new RangeError("Column index out of range");
+    }
+
+    return this._cell(row * this.columns.length + i);
+  }
+
+  // Decode a single row into a plain object, as returned by Statement.all().
+
+  row(row) {
+    if (!Number.isInteger(row) || row < 0 || row >= this.length) {
+      throw new RangeError("Row index out of range");
+    }
+
+    const { columns } = this;
+    const base = row * columns.length;
+    const result = {};
+
+    for (let i = 0; i < columns.length; i++) {
+      result[columns[i]] = this._cell(base + i);
+    }
+
+    return result;
+  }
+
+  toArray() {
+    const result = new Array(this.length);
+
+    for (let i = 0; i < this.length; i++) {
+      result[i] = this.row(i);
+    }
+
+    return result;
+  }
+
+  // Return an array of row objects whose properties decode their cell on first
+  // access and remember the result. All rows share a prototype that carries one
+  // getter per column, so each row only holds its position and its cache.
+
+  lazyRows() {
+    const { columns } = this;
+
+    // Lazy rows have no own properties, so JSON.stringify() relies on toJSON()
+    // to see their columns. A column of that name would shadow it, so decode
+    // such result sets up front instead.
+
+    if (columns.includes("toJSON")) {
+      return this.toArray();
+    }
+
+    const result = this;
+    const ncols = columns.length;
+    const proto = {};
+
+    // As with row(), the last of several columns with the same name wins,
+    // but the name keeps the position of its first occurrence
+
+    const names = new Map();
+
+    for (let i = 0; i < ncols; i++) {
+      names.set(columns[i], i);
+    }
+
+    function LazyRow(row) {
+      this[base] = row * ncols;
+      this[cache] = undefined;
+    }
+
+    names.forEach(function(i, name) {
+      Object.defineProperty(proto, name, {
+        enumerable: true,
+        get() {
+          let values = this[cache];
+
+          if (values === undefined) {
+            values = this[cache] = new Array(ncols);
+          }
+
+          // Decoded cells are never undefined, NULL becomes null
+
+          if (values[i] === undefined) {
+            values[i] = result._cell(this[base] + i);
+          }
+
+          return values[i];
+        }
+      });
+    });
+
+    Object.defineProperty(proto, "toJSON", {
+      value() {
+        const obj = {};
+
+        for (const name of names.keys()) {
+          obj[name] = this[name];
+        }
+
+        return obj;
+      }
+    });
+
+    Object.defineProperty(proto, inspect, {
+      value(depth, options, format) {
+        return format(this.toJSON(), options);
+      }
+    });
+
+    LazyRow.prototype = proto;
+
+    const rows = new Array(this.length);
+
+    for (let i = 0; i < this.length; i++) {
+      rows[i] = new LazyRow(i);
+    }
+
+    return rows;
+  }
+
+  *[Symbol.iterator]() {
+    for (let i = 0; i < this.length; i++) {
+      yield this.row(i);
+    }
+  }
+
+  _cell(index) {
+    const view = this._view;
+    const pos = this._cells + index * CELL_SIZE;
+
+    switch (view.getUint32(pos, true)) {
+      case SQLITE_INTEGER:
+        return view.getBigInt64(pos + 8, true);
+
+      case SQLITE_FLOAT:
+        return view.getFloat64(pos + 8, true);
+
+      case SQLITE_TEXT: {
+        const start = this._heap + readOffset(view, pos + 8);
+        const nbytes = view.getUint32(pos + 4, true);
+
+        return utf8.decode(new Uint8Array(this._buffer, start, nbytes));
+      }
+
+      case SQLITE_BLOB: {
+        const start = this._heap + readOffset(view, pos + 8);
+        const nbytes = view.getUint32(pos + 4, true);
+
+        return this._buffer.slice(start, start + nbytes);
+      }
+
+      default:
+        return null;
+    }
+  }
+}
+
+module.exports = PackedResult;
@@ -0,0 +1,168 @@
+import { inspect } from "util";
+
+import Database, { PackedResult } from ".";
+
+describe("allPacked", function() {
+  test("returns an ArrayBuffer", function() {
+    const db = new Database(":memory:");
+    const buf = db.prepare("select 1 as x").allPacked();
+
+    expect(buf).toBeInstanceOf(ArrayBuffer);
+  });
+
+  test("round-trip all types", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "select null as a, 1234.5 as b, 'héllo 🌍' as c, " +
+        "-9223372036854775808 as d, x'01020304' as e, '' as f, x'' as g"
+    );
+    const result = new PackedResult(stmt.allPacked());
+
+    expect(result.columns).toEqual(["a", "b", "c", "d", "e", "f", "g"]);
+    expect(result.length).toBe(1);
+
+    const row = result.row(0);
+
+    expect(row.a).toBe(null);
+    expect(row.b).toBe(1234.5);
+    expect(row.c).toBe("héllo 🌍");
+    expect(row.d).toBe(-9223372036854775808n);
+    expect([...new Uint8Array(row.e as ArrayBuffer)]).toEqual([1, 2, 3, 4]);
+    expect(row.f).toBe("");
+    expect((row.g as ArrayBuffer).byteLength).toBe(0);
+  });
+
+  test("matches all()", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table t (id integer primary key, name text, score real);
+      insert into t (name, score)
+      with recursive c(x) as (select 1 union all select x + 1 from c
+        where x < 1000)
+      select 'name ' || x, x / 3.0 from c;
+    `);
+
+    const stmt = db.prepare("select * from t where id > ? order by id");
+    const result = new PackedResult(stmt.allPacked([10n]));
+
+    expect(result.length).toBe(990);
+    expect(result.toArray()).toEqual(stmt.all([10n]));
+    expect([...result]).toEqual(stmt.all([10n]));
+  });
+
+  test("random access", function() {
+    const db = new Database(":memory:");
+    const result = new PackedResult(
+      db.prepare("select 1 as x, 'a' as y union all select 2, 'b'").allPacked()
+    );
+
+    expect(result.get(1, "y")).toBe("b");
+    expect(result.get(0, 0)).toBe(1n);
+    expect(() => result.get(2, 0)).toThrow(RangeError);
+    expect(() => result.get(0, "z")).toThrow(RangeError);
+  });
+
+  test("empty result keeps column names", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table t (a, b)");
+
+    const result = new PackedResult(db.prepare("select * from t").allPacked());
+
+    expect(result.columns).toEqual(["a", "b"]);
+    expect(result.length).toBe(0);
+    expect(result.toArray()).toEqual([]);
+  });
+
+  test("accepts execution limits", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "with recursive c(x) as (select 1 union all select x + 1 from c) " +
+        "select x from c"
+    );
+
+    expect(() => stmt.allPacked(undefined, { maxVmSteps: 10000 })).toThrow(
+      expect.objectContaining({ code: "SQLITE_INTERRUPT" })
+    );
+  });
+
+  test("rejects foreign buffers", function() {
+    expect(() => new PackedResult(new ArrayBuffer(64))).toThrow();
+    expect(() => new PackedResult("x" as any)).toThrow(TypeError);
+  });
+});
+
+describe("all lazy", function() {
+  test("decodes cells on access", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table t (a, b, c);
+      insert into t values (1, 'one', null), (2, x'0203', 2.5);
+    `);
+
+    const stmt = db.prepare("select * from t where a >= ?");
+    const rows = stmt.all([1], { lazy: true });
+
+    expect(rows.length).toBe(2);
+    expect(rows[0].b).toBe("one");
+    expect(rows[0].b).toBe(rows[0].b);
+    expect(rows[0].c).toBe(null);
+    expect(rows[1].a).toBe(2n);
+    expect([...new Uint8Array(rows[1].b as ArrayBuffer)]).toEqual([2, 3]);
+    expect(rows[1].b).toBe(rows[1].b);
+    expect("c" in rows[1]).toBe(true);
+    expect(rows.map(row => (row as any).toJSON())).toEqual(stmt.all([1]));
+  });
+
+  test("serializes like a plain object", function() {
+    const db = new Database(":memory:");
+    const [row] = db
+      .prepare("select 'x' as s, null as n")
+      .all(undefined, { lazy: true });
+
+    expect(JSON.stringify(row)).toBe('{"s":"x","n":null}');
+    expect(inspect(row)).toBe("{ s: 'x', n: null }");
+  });
+
+  test("duplicate column names", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table a (id, x);
+      create table b (id, y);
+      insert into a values ('a1', 'ax');
+      insert into b values ('b1', 'by');
+    `);
+
+    const stmt = db.prepare("select a.id, a.x, b.id, b.y from a join b");
+    const [row] = stmt.all(undefined, { lazy: true });
+
+    expect(row.id).toBe("b1");
+    expect(JSON.stringify(row)).toBe('{"id":"b1","x":"ax","y":"by"}');
+    expect((row as any).toJSON()).toEqual(stmt.all()[0]);
+  });
+
+  test("column named toJSON", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1 as toJSON, 'x' as s");
+    const rows = stmt.all(undefined, { lazy: true });
+
+    expect(rows).toEqual(stmt.all());
+    expect(rows[0].toJSON).toBe(1n);
+    expect(rows[0].s).toBe("x");
+  });
+
+  test("accepts execution limits", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "with recursive c(x) as (select 1 union all select x + 1 from c) " +
+        "select x from c"
+    );
+
+    expect(() =>
+      stmt.all(undefined, { lazy: true, maxVmSteps: 10000 })
+    ).toThrow(expect.objectContaining({ code: "SQLITE_INTERRUPT" }));
+  });
+});
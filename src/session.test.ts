@@ -0,0 +1,163 @@
+import Database from ".";
+
+function fixture() {
+  const db = new Database(":memory:");
+
+  db.exec(
+    "create table a (id integer primary key, x text);" +
+      "create table b (id integer primary key, y text);" +
+      "insert into a values (1, 'one'), (2, 'two');"
+  );
+
+  return db;
+}
+
+function contents(db: Database) {
+  return {
+    a: db.prepare("select * from a order by id").all(),
+    b: db.prepare("select * from b order by id").all()
+  };
+}
+
+describe("session", function() {
+  test("changeset round trip", function() {
+    const src = fixture();
+    const dst = fixture();
+    const session = src.session();
+
+    expect(session.isEmpty).toBe(true);
+
+    src.exec(
+      "insert into a values (3, 'three');" +
+        "update a set x = 'uno' where id = 1;" +
+        "delete from a where id = 2;" +
+        "insert into b values (1, 'bee');"
+    );
+
+    expect(session.isEmpty).toBe(false);
+
+    dst.applyChangeset(session.changeset());
+
+    expect(contents(dst)).toEqual(contents(src));
+  });
+
+  test("patchset round trip", function() {
+    const src = fixture();
+    const dst = fixture();
+    const session = src.session();
+
+    src.exec("update a set x = 'deux' where id = 2");
+    dst.applyChangeset(new Uint8Array(session.patchset()));
+
+    expect(contents(dst)).toEqual(contents(src));
+  });
+
+  test("selected tables", function() {
+    const src = fixture();
+    const dst = fixture();
+    const session = src.session(["b"]);
+
+    src.exec("insert into a values (3, 'x'); insert into b values (1, 'x')");
+    dst.applyChangeset(session.changeset());
+
+    expect(contents(dst)).toEqual({
+      a: [
+        { id: 1n, x: "one" },
+        { id: 2n, x: "two" }
+      ],
+      b: [{ id: 1n, y: "x" }]
+    });
+
+    // The second changeset repeats the insert into b, which now conflicts
+
+    session.attach("a");
+    src.exec("delete from a where id = 1");
+    dst.applyChangeset(session.changeset(), { onConflict: "omit" });
+
+    expect(dst.prepare("select id from a").all()).toEqual([{ id: 2n }]);
+  });
+
+  test("close", function() {
+    const db = fixture();
+    const session = db.session();
+
+    session.close();
+    session.close();
+
+    expect(() => session.changeset()).toThrow("Session is closed");
+  });
+
+  test("close after database close is safe", function() {
+    const db = fixture();
+    const session = db.session();
+
+    db.exec("insert into b values (1, 'x')");
+    db.close();
+    session.close();
+  });
+
+  test("invalid arguments", function() {
+    const db = fixture();
+
+    expect(() => db.session("a" as any)).toThrow(TypeError);
+  });
+});
+
+describe("applyChangeset", function() {
+  function conflict(onConflict?: "abort" | "omit" | "replace") {
+    const src = fixture();
+    const dst = fixture();
+    const session = src.session();
+
+    src.exec(
+      "update a set x = 'src' where id = 1; insert into b values (1, 'b')"
+    );
+    dst.exec("update a set x = 'dst' where id = 1");
+
+    const changeset = session.changeset();
+
+    if (onConflict === "abort") {
+      expect(() => dst.applyChangeset(changeset, { onConflict })).toThrow();
+    } else {
+      dst.applyChangeset(changeset, { onConflict });
+    }
+
+    return contents(dst);
+  }
+
+  test("conflict policies", function() {
+    expect(conflict("abort")).toEqual({
+      a: [
+        { id: 1n, x: "dst" },
+        { id: 2n, x: "two" }
+      ],
+      b: []
+    });
+    expect(conflict("omit")).toEqual({
+      a: [
+        { id: 1n, x: "dst" },
+        { id: 2n, x: "two" }
+      ],
+      b: [{ id: 1n, y: "b" }]
+    });
+    expect(conflict("replace")).toEqual({
+      a: [
+        { id: 1n, x: "src" },
+        { id: 2n, x: "two" }
+      ],
+      b: [{ id: 1n, y: "b" }]
+    });
+  });
+
+  test("invalid arguments", function() {
+    const db = fixture();
+
+    expect(() => db.applyChangeset("x" as any)).toThrow(TypeError);
+    expect(() => db.applyChangeset(new Float64Array(1) as any)).toThrow(
+      TypeError
+    );
+    expect(() =>
+      db.applyChangeset(new ArrayBuffer(0), { onConflict: "merge" as any })
+    ).toThrow(TypeError);
+  });
+});
@@ -0,0 +1,159 @@
+// A set of databases that share a schema, with rows partitioned between them
+// by key. Writes go to the shard that owns their key, and queries run on every
+// shard at once, their results merged natively (see native/nsql/shard.c).
+
+const Database = require("node-gyp-build")(__dirname + "/..");
+const PackedResult = require("./packed");
+
+// Prepared statements are kept for this many distinct SQL strings
+
+const STATEMENT_CACHE_SIZE = 64;
+
+// 32-bit FNV-1a over UTF-16 code units
+
+function hashString(str) {
+  let hash = 0x811c9dc5;
+
+  for (let i = 0; i < str.length; i++) {
+    hash ^= str.charCodeAt(i);
+    hash = Math.imul(hash, 0x01000193);
+  }
+
+  return hash >>> 0;
+}
+
+function defaultShardKey(key, nshards) {
+  switch (typeof key) {
+    case "number":
+      if (Number.isSafeInteger(key)) {
+        return ((key % nshards) + nshards) % nshards;
+      }
+
+      break;
+
+    case "bigint": {
+      const n = BigInt(nshards);
+
+      return Number(((key % n) + n) % n);
+    }
+
+    case "string":
+      return hashString(key) % nshards;
+  }
+
+  throw new TypeError("key: Expected an integer or a string");
+}
+
+function closeAll(stmts) {
+  for (const stmt of stmts) {
+    if (stmt !== undefined) {
+      stmt.close();
+    }
+  }
+}
+
+class ShardedDatabase {
+  constructor(filenames, options) {
+    if (!Array.isArray(filenames) || filenames.length === 0) {
+      throw new TypeError("filenames: Expected a non-empty array");
+    }
+
+    const { shardKey, ...dbOptions } = options || {};
+
+    if (shardKey !== undefined && typeof shardKey !== "function") {
+      throw new TypeError("shardKey: Expected a function");
+    }
+
+    this._shardKey = shardKey || defaultShardKey;
+    this._statements = new Map();
+    this.shards = [];
+
+    try {
+      for (const filename of filenames) {
+        this.shards.push(new Database(filename, dbOptions));
+      }
+    } catch (e) {
+      this.close();
+
+      throw e;
+    }
+  }
+
+  shardFor(key) {
+    const i = this._shardKey(key, this.shards.length);
+
+    if (!Number.isInteger(i) || i < 0 || i >= this.shards.length) {
+      throw new RangeError("shardKey: Expected a shard index");
+    }
+
+    return i;
+  }
+
+  shard(key) {
+    return this.shards[this.shardFor(key)];
+  }
+
+  exec(sql) {
+    for (const db of this.shards) {
+      db.exec(sql);
+    }
+  }
+
+  run(key, sql, params) {
+    const i = this.shardFor(key);
+    const stmt = this._prepare(sql, i);
+
+    return params !== undefined ? stmt.run(params) : stmt.run();
+  }
+
+  all(sql, params, options) {
+    const { lazy, ...merge } = options || {};
+    const stmts = [];
+
+    for (let i = 0; i < this.shards.length; i++) {
+      stmts.push(this._prepare(sql, i));
+    }
+
+    const result = new PackedResult(
+      Database._shardedAll(stmts, params, merge)
+    );
+
+    return lazy ? result.lazyRows() : result.toArray();
+  }
+
+  close() {
+    for (const stmts of this._statements.values()) {
+      closeAll(stmts);
+    }
+
+    this._statements.clear();
+
+    for (const db of this.shards) {
+      db.close();
+    }
+  }
+
+  _prepare(sql, i) {
+    let stmts = this._statements.get(sql);
+
+    if (stmts === undefined) {
+      if (this._statements.size >= STATEMENT_CACHE_SIZE) {
+        const [oldest, evicted] = this._statements.entries().next().value;
+
+        this._statements.delete(oldest);
+        closeAll(evicted);
+      }
+
+      stmts = new Array(this.shards.length);
+      this._statements.set(sql, stmts);
+    }
+
+    if (stmts[i] === undefined) {
+      stmts[i] = this.shards[i].prepare(sql);
+    }
+
+    return stmts[i];
+  }
+}
+
+module.exports = ShardedDatabase;
@@ -0,0 +1,170 @@
+import { mkdtempSync, rmSync } from "fs";
+import { tmpdir } from "os";
+import path from "path";
+
+import { ShardedDatabase } from ".";
+
+const dirs: string[] = [];
+
+function fixture(nshards: number) {
+  const dir = mkdtempSync(path.join(tmpdir(), "nsql-shard-"));
+  const filenames = [];
+
+  dirs.push(dir);
+
+  for (let i = 0; i < nshards; i++) {
+    filenames.push(path.join(dir, `${i}.db`));
+  }
+
+  const db = new ShardedDatabase(filenames);
+
+  db.exec("create table t (x integer primary key, g text, y real)");
+
+  for (let i = 1; i <= 100; i++) {
+    db.run(i, "insert into t values (?, ?, ?)", [
+      BigInt(i),
+      `g${i % 3}`,
+      i / 4
+    ]);
+  }
+
+  return db;
+}
+
+afterAll(function() {
+  for (const dir of dirs) {
+    rmSync(dir, { recursive: true, force: true });
+  }
+});
+
+describe("ShardedDatabase", function() {
+  test("routes writes by key", function() {
+    const db = fixture(4);
+
+    expect(db.shardFor(5)).toBe(1);
+    expect(db.shardFor(-1n)).toBe(3);
+    expect(db.shard(6)).toBe(db.shards[2]);
+    expect(
+      db.shards.map(shard => shard.prepare("select count(*) as n from t").one())
+    ).toEqual([{ n: 25n }, { n: 25n }, { n: 25n }, { n: 25n }]);
+    expect(() => db.shardFor(1.5)).toThrow(TypeError);
+
+    db.close();
+  });
+
+  test("custom shard keys", function() {
+    const dir = mkdtempSync(path.join(tmpdir(), "nsql-shard-"));
+
+    dirs.push(dir);
+
+    const db = new ShardedDatabase(
+      [path.join(dir, "a.db"), path.join(dir, "b.db")],
+      { shardKey: (key: string) => (key < "m" ? 0 : 1) }
+    );
+
+    expect(db.shardFor("apple")).toBe(0);
+    expect(db.shardFor("pear")).toBe(1);
+
+    db.close();
+  });
+
+  test("concatenates results in shard order", function() {
+    const db = fixture(3);
+
+    expect(db.all("select x from t where x < ?", [7])).toEqual([
+      { x: 3n },
+      { x: 6n },
+      { x: 1n },
+      { x: 4n },
+      { x: 2n },
+      { x: 5n }
+    ]);
+  });
+
+  test("merges ordered results", function() {
+    const db = fixture(4);
+    const rows = db.all(
+      "select x, g from t order by g desc, x limit 10",
+      undefined,
+      { orderBy: [{ column: "g", descending: true }, "x"], limit: 10 }
+    );
+
+    expect(rows.map(row => row.x)).toEqual([
+      2n,
+      5n,
+      8n,
+      11n,
+      14n,
+      17n,
+      20n,
+      23n,
+      26n,
+      29n
+    ]);
+    expect(
+      db.all("select x from t order by x", undefined, {
+        orderBy: ["x"],
+        lazy: true
+      })
+    ).toHaveLength(100);
+  });
+
+  test("combines aggregates", function() {
+    const db = fixture(4);
+
+    expect(
+      db.all(
+        "select count(*) as n, sum(x) as s, min(y) as lo, max(g) as hi from t",
+        undefined,
+        { aggregate: { n: "count", s: "sum", lo: "min", hi: "max" } }
+      )
+    ).toEqual([{ n: 100n, s: 5050n, lo: 0.25, hi: "g2" }]);
+    expect(
+      db.all(
+        "select g, count(*) as n, sum(y) as s from t group by g order by g",
+        undefined,
+        { orderBy: ["g"], aggregate: { n: "count", s: "sum" } }
+      )
+    ).toEqual([
+      { g: "g0", n: 33n, s: 420.75 },
+      { g: "g1", n: 34n, s: 429.25 },
+      { g: "g2", n: 33n, s: 412.5 }
+    ]);
+
+    // Shards without any matching rows return NULL
+
+    expect(
+      db.all("select max(x) as hi from t where x < 3", undefined, {
+        aggregate: { hi: "max" }
+      })
+    ).toEqual([{ hi: 2n }]);
+  });
+
+  test("errors", function() {
+    const db = fixture(2);
+
+    expect(() => db.all("delete from t")).toThrow("read-only");
+    expect(() =>
+      db.all("select x from t", undefined, { orderBy: ["nope"] })
+    ).toThrow(expect.objectContaining({ code: "ERR_INVALID_ARG_VALUE" }));
+    expect(() =>
+      db.all("select g from t", undefined, { aggregate: { g: "sum" } })
+    ).toThrow(TypeError);
+    expect(() =>
+      db.all("select g, count(*) as n from t group by g", undefined, {
+        aggregate: { n: "count" }
+      })
+    ).toThrow('orderBy: Must include group column "g"');
+    expect(() =>
+      db.all(
+        "select g, y, count(*) as n from t group by g, y order by g",
+        undefined,
+        { orderBy: ["g"], aggregate: { n: "count" } }
+      )
+    ).toThrow(expect.objectContaining({ code: "ERR_INVALID_ARG_VALUE" }));
+    expect(() => db.all("select * from nope")).toThrow(
+      expect.objectContaining({ code: "SQLITE_ERROR" })
+    );
+    expect(() => new ShardedDatabase([])).toThrow(TypeError);
+  });
+});
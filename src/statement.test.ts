@@ -312,6 +312,80 @@ describe("named binds", function() {
   });
 });
 
+describe("carray", function() {
+  function fixture() {
+    const db = new Database(":memory:");
+
+    db.exec("create table t (id integer primary key, name text)");
+
+    const stmt = db.prepare("insert into t values (?, ?)");
+
+    for (let i = 1; i <= 10; i++) {
+      stmt.run([BigInt(i), "n" + i]);
+    }
+
+    return db;
+  }
+
+  test("typed arrays", function() {
+    const db = fixture();
+    const stmt = db.prepare("select id from t where id in carray(?)");
+
+    expect(stmt.all([new BigInt64Array([3n, 7n, 99n])])).toEqual([
+      { id: 3n },
+      { id: 7n }
+    ]);
+    expect(stmt.all([new Float64Array([2, 2.5])])).toEqual([{ id: 2n }]);
+    expect(stmt.all([new Int32Array([10])])).toEqual([{ id: 10n }]);
+    expect(stmt.all([new Int32Array(0)])).toEqual([]);
+  });
+
+  test("string arrays", function() {
+    const db = fixture();
+    const stmt = db.prepare("select value from carray(?)");
+
+    expect(stmt.all([["", "héllo", "n1"]])).toEqual([
+      { value: "" },
+      { value: "héllo" },
+      { value: "n1" }
+    ]);
+    expect(
+      db
+        .prepare("select id from t where name in carray(:names)")
+        .all({ ":names": ["n4", "n5"] })
+    ).toEqual([{ id: 4n }, { id: 5n }]);
+  });
+
+  test("list is copied at bind time", function() {
+    const db = fixture();
+    const ids = new BigInt64Array([1n, 2n]);
+    const stmt = db.prepare(
+      "select count(*) as n from carray(?) join t on id = value"
+    );
+
+    expect(stmt.one([ids])).toEqual({ n: 2n });
+
+    ids.fill(1000n);
+
+    expect(stmt.one([ids])).toEqual({ n: 0n });
+  });
+
+  test("unbound or non-list parameter yields no rows", function() {
+    const db = fixture();
+
+    expect(db.prepare("select * from carray(?)").all([null])).toEqual([]);
+    expect(db.prepare("select * from carray(?)").all(["x"])).toEqual([]);
+  });
+
+  test("unsupported lists", function() {
+    const db = fixture();
+    const stmt = db.prepare("select * from carray(?)");
+
+    expect(() => stmt.all([new Uint8Array(1) as any])).toThrow(TypeError);
+    expect(() => stmt.all([[1, 2] as any])).toThrow(TypeError);
+  });
+});
+
 describe("all", function() {
   test("all() after close does not crash the process", function() {
     const db = new Database(":memory:");
@@ -362,6 +436,53 @@ describe("all", function() {
     expect(result).toHaveLength(1);
     expect(result).toContainEqual({ x: 1n });
   });
+
+  test("text conversion", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select ? as s");
+    const samples = [
+      "",
+      "a",
+      "ascii only",
+      "x".repeat(63) + "é",
+      "é" + "x".repeat(63),
+      "日本語",
+      "y".repeat(100000),
+      "z".repeat(100000) + "🌍"
+    ];
+
+    for (const sample of samples) {
+      expect(stmt.all([sample])).toEqual([{ s: sample }]);
+    }
+  });
+
+  test("string interning", function() {
+    const db = new Database(":memory:");
+    const long = "x".repeat(100);
+
+    db.exec(`
+      create table t (status text);
+      insert into t values ('open'), ('closed'), ('open'), ('${long}'),
+        ('open'), ('closed'), ('${long}');
+    `);
+
+    const stmt = db.prepare("select status from t");
+
+    expect(stmt.internStats).toBe(null);
+    expect(stmt.all(undefined, { intern: true })).toEqual(stmt.all());
+    expect(stmt.internStats).toEqual({ hits: 3, misses: 2 });
+    expect(() => stmt.all(undefined, { intern: 1 as any })).toThrow(TypeError);
+
+    // Lazy and cached rows bypass the interning table
+
+    expect(() => stmt.all(undefined, { intern: true, lazy: true })).toThrow(
+      TypeError
+    );
+    expect(() => stmt.all(undefined, { intern: true, cache: true })).toThrow(
+      "intern cannot be combined with lazy or cache"
+    );
+    expect(stmt.internStats).toEqual({ hits: 3, misses: 2 });
+  });
 });
 
 describe("sql getter", function() {
@@ -380,3 +501,341 @@ describe("sql getter", function() {
     expect(typeof stmt.sql).toBe("string");
   });
 });
+
+describe("execution limits", function() {
+  const forever = `
+    with recursive c(x) as (select 1 union all select x + 1 from c)
+    select count(*) as n from c`;
+
+  test("timeoutMs interrupts a runaway query", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(forever);
+
+    expect(() => stmt.one(undefined, { timeoutMs: 20 })).toThrow(
+      expect.objectContaining({ code: "SQLITE_INTERRUPT" })
+    );
+  });
+
+  test("maxVmSteps interrupts a runaway query", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(forever);
+
+    expect(() => stmt.all(undefined, { maxVmSteps: 10000 })).toThrow(
+      expect.objectContaining({ code: "SQLITE_INTERRUPT" })
+    );
+  });
+
+  test("limits are not exceeded by quick statements", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select ? as x");
+
+    expect(stmt.one([1n], { timeoutMs: 1000, maxVmSteps: 1000 })).toEqual({
+      x: 1n
+    });
+  });
+
+  test("huge timeouts impose no deadline", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(`
+      with recursive c(x) as (select 1 union all select x + 1 from c)
+      select count(*) as n from (select x from c limit 10000)`);
+
+    for (const timeoutMs of [1e20, Number.MAX_VALUE]) {
+      expect(stmt.one(undefined, { timeoutMs })).toEqual({ n: 10000n });
+    }
+  });
+
+  test("statement is reusable after being interrupted", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table t (x integer)");
+
+    const insert = db.prepare("insert into t (x) values (1)");
+    const stmt = db.prepare(`
+      insert into t (x)
+      with recursive c(x) as (select 1 union all select x + 1 from c)
+      select x from c`);
+
+    expect(() => stmt.run(undefined, { maxVmSteps: 5000 })).toThrow(
+      expect.objectContaining({ code: "SQLITE_INTERRUPT" })
+    );
+
+    // Partial changes were rolled back, and the limit does not stick
+
+    insert.run();
+
+    expect(db.prepare("select count(*) as n from t").one()).toEqual({ n: 1n });
+  });
+
+  test("limits do not leak into subsequent calls", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "with recursive c(x) as (select 1 union all select x + 1 from c " +
+        "where x < 10000) select count(*) as n from c"
+    );
+
+    expect(() => stmt.one(undefined, { maxVmSteps: 100 })).toThrow();
+    expect(stmt.one()).toEqual({ n: 10000n });
+  });
+
+  test("bind params and limits together", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare(
+      "with recursive c(x) as (select 1 union all select x + 1 from c " +
+        "where x < ?) select count(*) as n from c"
+    );
+
+    expect(() => stmt.one([1000000n], { maxVmSteps: 1000 })).toThrow(
+      expect.objectContaining({ code: "SQLITE_INTERRUPT" })
+    );
+    expect(stmt.one([10n], { maxVmSteps: 1000 })).toEqual({ n: 10n });
+  });
+
+  test("validate options", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    expect(() => stmt.one(undefined, 1 as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => stmt.one(undefined, { timeoutMs: "1" } as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => stmt.one(undefined, { maxVmSteps: -1 })).toThrow(
+      expect.objectContaining({ code: "ERR_OUT_OF_RANGE" })
+    );
+    expect(() => stmt.one(undefined, { timeoutMs: NaN })).toThrow(
+      expect.objectContaining({ code: "ERR_OUT_OF_RANGE" })
+    );
+  });
+});
+
+describe("plan", function() {
+  function fixture() {
+    const db = new Database(":memory:");
+
+    db.exec("create table t (a integer, b text); create index t_a on t (a)");
+
+    return db;
+  }
+
+  test("returns query plan rows", function() {
+    const db = fixture();
+    const plan = db.prepare("select b from t where a = ?").plan();
+
+    expect(plan).toHaveLength(1);
+    expect(plan[0]).toEqual({
+      id: expect.any(Number),
+      parent: 0,
+      detail: expect.stringMatching(/SEARCH t USING INDEX t_a/)
+    });
+  });
+
+  test("returns nested plans", function() {
+    const db = fixture();
+    const plan = db
+      .prepare("select * from t where a in (select a from t where b = 'x')")
+      .plan();
+    const ids = plan.map(row => row.id);
+
+    expect(plan.length).toBeGreaterThan(1);
+    expect(plan.some(row => row.parent !== 0)).toBeTruthy();
+
+    for (const row of plan) {
+      expect(row.parent === 0 || ids.includes(row.parent)).toBeTruthy();
+    }
+  });
+
+  test("statement still executes normally afterwards", function() {
+    const db = fixture();
+
+    db.exec("insert into t values (1, 'one')");
+
+    const stmt = db.prepare("select b from t where a = ?");
+
+    stmt.plan();
+    expect(stmt.all([1n])).toEqual([{ b: "one" }]);
+  });
+
+  test("plan after close", function() {
+    const db = fixture();
+    const stmt = db.prepare("select 1");
+
+    stmt.close();
+    expect(() => stmt.plan()).toThrow();
+  });
+});
+
+describe("scanStats", function() {
+  test("counts loops and rows after execution", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table t (a integer);
+      insert into t
+      with recursive c(x) as (select 1 union all select x + 1 from c
+        where x < 100)
+      select x from c`);
+
+    const stmt = db.prepare("select count(*) from t where a > 0");
+
+    stmt.all();
+
+    const stats = stmt.scanStats();
+    const scan = stats.find(row => row.name === "t");
+
+    expect(scan).toEqual(
+      expect.objectContaining({
+        detail: expect.stringMatching(/SCAN t/),
+        loops: 1,
+        rowsVisited: 100
+      })
+    );
+    expect(typeof scan!.estimatedRows).toBe("number");
+  });
+
+  test("counts accumulate and can be reset", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table t (a integer); insert into t values (1), (2)");
+
+    const stmt = db.prepare("select * from t");
+
+    stmt.all();
+    stmt.all();
+
+    const before = stmt.scanStats({ reset: true }).find(r => r.name === "t");
+    const after = stmt.scanStats().find(r => r.name === "t");
+
+    expect(before!.loops).toBe(2);
+    expect(after!.loops).toBe(0);
+  });
+
+  test("scanStats after close", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    stmt.close();
+    expect(() => stmt.scanStats()).toThrow();
+  });
+
+  test("validate options", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    expect(() => stmt.scanStats({ reset: 1 } as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+  });
+});
+
+describe("json", function() {
+  test("objects shape matches JSON.stringify", function() {
+    const db = new Database(":memory:");
+
+    db.exec(`
+      create table t (id integer primary key, name text, score real);
+      insert into t (name, score) values ('a', 1.5), ('b', null), ('c', 3);
+    `);
+
+    const json = db.prepare("select * from t").json();
+
+    expect(json).toBe(
+      '[{"id":1,"name":"a","score":1.5},{"id":2,"name":"b","score":null},' +
+        '{"id":3,"name":"c","score":3}]'
+    );
+  });
+
+  test("arrays shape", function() {
+    const db = new Database(":memory:");
+    const json = db
+      .prepare("select 1 as a, 'x' as b union all select 2, 'y'")
+      .json(undefined, { shape: "arrays" });
+
+    expect(json).toBe('[[1,"x"],[2,"y"]]');
+  });
+
+  test("empty result", function() {
+    const db = new Database(":memory:");
+
+    db.exec("create table t (a)");
+    expect(db.prepare("select * from t").json()).toBe("[]");
+  });
+
+  test("string escaping round-trips", function() {
+    const db = new Database(":memory:");
+    const str = 'quote " backslash \\ newline \n tab \t nul \0 bell \x07 🌍 é';
+    const json = db.prepare("select ? as s").json([str]);
+
+    expect(JSON.parse(json)).toEqual([{ s: str }]);
+    expect(json).toBe(JSON.stringify([{ s: str }]));
+  });
+
+  test("column names are escaped", function() {
+    const db = new Database(":memory:");
+    const json = db.prepare('select 1 as "a""b"').json();
+
+    expect(JSON.parse(json)).toEqual([{ 'a"b': 1 }]);
+  });
+
+  test("64-bit integers are exact", function() {
+    const db = new Database(":memory:");
+    const json = db
+      .prepare(
+        "select 9223372036854775807 as max, -9223372036854775808 as min, " +
+          "0 as zero, -1 as neg"
+      )
+      .json();
+
+    expect(json).toBe(
+      '[{"max":9223372036854775807,"min":-9223372036854775808,' +
+        '"zero":0,"neg":-1}]'
+    );
+  });
+
+  test("reals round-trip", function() {
+    const db = new Database(":memory:");
+    const values = [0.1, -2.5e-8, 1 / 3, 1e300, 123456789.123, 2 ** 60];
+    const stmt = db.prepare("select ? as x");
+
+    for (const x of values) {
+      expect(JSON.parse(stmt.json([x]))[0].x).toBe(x);
+    }
+
+    expect(stmt.json([Infinity])).toBe('[{"x":null}]');
+  });
+
+  test("blobs are base64", function() {
+    const db = new Database(":memory:");
+    const json = db
+      .prepare("select x'' as a, x'66' as b, x'666f' as c, x'666f6f' as d")
+      .json(undefined, { shape: "arrays" });
+
+    expect(json).toBe('[["","Zg==","Zm8=","Zm9v"]]');
+  });
+
+  test("buffer output", function() {
+    const db = new Database(":memory:");
+    const buf = db.prepare("select 'é' as s").json(undefined, {
+      buffer: true
+    });
+
+    expect(Buffer.isBuffer(buf)).toBe(true);
+    expect(buf.toString("utf8")).toBe('[{"s":"é"}]');
+  });
+
+  test("validate options", function() {
+    const db = new Database(":memory:");
+    const stmt = db.prepare("select 1");
+
+    expect(() => stmt.json(undefined, { shape: "rows" } as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_VALUE" })
+    );
+    expect(() => stmt.json(undefined, { shape: 1 } as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+    expect(() => stmt.json(undefined, { buffer: 1 } as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+  });
+});
@@ -0,0 +1,241 @@
+import { mkdtempSync, rmSync, statSync } from "fs";
+import { tmpdir } from "os";
+import path from "path";
+
+import Database from ".";
+
+const dirs: string[] = [];
+
+function fixture() {
+  const dir = mkdtempSync(path.join(tmpdir(), "nsql-vfs-"));
+
+  dirs.push(dir);
+
+  return path.join(dir, "test.db");
+}
+
+function fill(db: Database, rows: number) {
+  db.exec(
+    "create table t (x integer primary key, y blob);" +
+      "begin;" +
+      "with recursive n(i) as (select 1 union all select i + 1 from n" +
+      ` where i < ${rows}) insert into t select i, randomblob(1000) from n;` +
+      "commit"
+  );
+}
+
+afterAll(function() {
+  for (const dir of dirs) {
+    rmSync(dir, { recursive: true, force: true });
+  }
+});
+
+describe("io_uring vfs", function() {
+  test("rollback journal commits are durable", function() {
+    const filename = fixture();
+    const db = new Database(filename, { vfs: "io_uring" });
+
+    fill(db, 2000);
+    db.exec("update t set y = zeroblob(10) where x % 3 = 0");
+    db.close();
+
+    const check = new Database(filename);
+
+    expect(check.prepare("pragma integrity_check").one()).toEqual({
+      integrity_check: "ok"
+    });
+    expect(
+      check.prepare("select count(*) as n, sum(length(y)) as len from t").one()
+    ).toEqual({ n: 2000n, len: 1334n * 1000n + 666n * 10n });
+  });
+
+  test("wal commits are visible to other connections", function() {
+    const filename = fixture();
+    const db = new Database(filename, { vfs: "io_uring" });
+    const other = new Database(filename);
+
+    db.exec("pragma journal_mode = wal");
+    fill(db, 500);
+
+    const count = other.prepare("select count(*) as n from t");
+
+    expect(count.one()).toEqual({ n: 500n });
+
+    const insert = db.prepare("insert into t (y) values (?)");
+
+    for (let i = 0; i < 50; i++) {
+      insert.run([new ArrayBuffer(100)]);
+      expect(count.one()).toEqual({ n: BigInt(501 + i) });
+    }
+
+    db.exec("pragma wal_checkpoint(truncate)");
+    expect(count.one()).toEqual({ n: 550n });
+    expect(other.prepare("pragma integrity_check").one()).toEqual({
+      integrity_check: "ok"
+    });
+  });
+
+  test("sequential scans read ahead correctly", function() {
+    const filename = fixture();
+    const db = new Database(filename);
+
+    fill(db, 5000);
+
+    const expected = db
+      .prepare("select sum(x) as x, sum(length(y)) as len from t")
+      .one();
+
+    db.close();
+
+    const scan = new Database(filename, { vfs: "io_uring" });
+    const sum = scan.prepare(
+      "select sum(x) as x, sum(length(y)) as len from t"
+    );
+
+    expect(sum.one()).toEqual(expected);
+
+    // Writes in between scans must not be hidden by data read ahead earlier
+
+    scan.exec("update t set y = zeroblob(1) where x > 4000");
+    scan.exec("pragma cache_size = 1");
+
+    expect(sum.one()).toEqual({ x: expected!.x, len: 4000n * 1000n + 1000n });
+  });
+
+  test("checkpointer uses the same vfs", async function() {
+    const filename = fixture();
+    const db = new Database(filename, { vfs: "io_uring" });
+
+    db.exec("pragma journal_mode = wal");
+    db.checkpointer({ intervalMs: 5, mode: "truncate" });
+    fill(db, 200);
+
+    for (let i = 0; i < 200 && db.checkpointerStats()!.checkpoints === 0; i++) {
+      await new Promise(resolve => setTimeout(resolve, 10));
+    }
+
+    expect(db.checkpointerStats()).toEqual(
+      expect.objectContaining({ errors: 0 })
+    );
+    db.close();
+
+    const check = new Database(filename);
+
+    expect(check.prepare("select count(*) as n from t").one()).toEqual({
+      n: 200n
+    });
+  });
+
+  test("in-memory databases", function() {
+    const db = new Database(":memory:", { vfs: "io_uring" });
+
+    fill(db, 10);
+    expect(db.prepare("select count(*) as n from t").one()).toEqual({
+      n: 10n
+    });
+  });
+
+  test("vfs option type check", function() {
+    expect(() => new Database(":memory:", { vfs: "bogus" } as any)).toThrow(
+      TypeError
+    );
+    expect(() => new Database(":memory:", { vfs: 1 } as any)).toThrow(
+      expect.objectContaining({ code: "ERR_INVALID_ARG_TYPE" })
+    );
+  });
+});
+
+describe("compressed vfs", function() {
+  test("round trip", function() {
+    const filename = fixture();
+    const db = new Database(filename, { vfs: "compressed" });
+
+    db.exec("pragma page_size = 65536");
+    db.exec(
+      "create table t (x integer primary key, y text);" +
+        "begin;" +
+        "with recursive n(i) as (select 1 union all select i + 1 from n" +
+        " where i < 20000) insert into t" +
+        " select i, printf('row %d %s', i, hex(zeroblob(100))) from n;" +
+        "commit"
+    );
+    db.exec("update t set y = 'x' where x % 2 = 0");
+    db.exec("vacuum");
+    db.close();
+
+    const { size, blocks } = statSync(filename);
+
+    expect(blocks * 512).toBeLessThan(size / 2);
+
+    const check = new Database(filename, { vfs: "compressed" });
+
+    expect(check.prepare("pragma integrity_check").one()).toEqual({
+      integrity_check: "ok"
+    });
+    expect(
+      check.prepare("select count(*) as n, sum(y = 'x') as x from t").one()
+    ).toEqual({ n: 20000n, x: 10000n });
+  });
+
+  test("incompressible pages", function() {
+    const filename = fixture();
+    const db = new Database(filename, { vfs: "compressed" });
+
+    fill(db, 1000);
+    db.exec("delete from t where x % 2 = 0");
+    db.close();
+
+    const check = new Database(filename, { vfs: "compressed" });
+
+    expect(check.prepare("pragma integrity_check").one()).toEqual({
+      integrity_check: "ok"
+    });
+    expect(
+      check.prepare("select count(*) as n, sum(length(y)) as len from t").one()
+    ).toEqual({ n: 500n, len: 500n * 1000n });
+  });
+
+  test("wal mode", function() {
+    const filename = fixture();
+    const db = new Database(filename, { vfs: "compressed" });
+    const other = new Database(filename, { vfs: "compressed" });
+
+    db.exec("pragma journal_mode = wal");
+    fill(db, 500);
+
+    const count = other.prepare("select count(*) as n from t");
+
+    expect(count.one()).toEqual({ n: 500n });
+    db.exec("insert into t (y) values (zeroblob(5000))");
+    db.exec("pragma wal_checkpoint(truncate)");
+    expect(count.one()).toEqual({ n: 501n });
+    expect(other.prepare("pragma integrity_check").one()).toEqual({
+      integrity_check: "ok"
+    });
+  });
+
+  test("page size cannot change", function() {
+    const db = new Database(fixture(), { vfs: "compressed" });
+
+    fill(db, 10);
+    expect(() => db.exec("pragma page_size = 8192")).toThrow(
+      "cannot be changed"
+    );
+    db.exec("pragma page_size = 4096");
+  });
+
+  test("files are not interchangeable with the default vfs", function() {
+    const plain = fixture();
+    const compressed = fixture();
+
+    fill(new Database(plain), 10);
+    fill(new Database(compressed, { vfs: "compressed" }), 10);
+
+    expect(() => new Database(plain, { vfs: "compressed" })).toThrow(
+      expect.objectContaining({ code: "SQLITE_NOTADB" })
+    );
+    expect(() =>
+      new Database(compressed).prepare("select * from t").all()
+    ).toThrow(expect.objectContaining({ code: "SQLITE_NOTADB" }));
+  });
+});